@@ -0,0 +1,97 @@
+/**
+ * Crypto::Base64 throughput for every kernel this CPU supports, the scalar
+ * fallback included
+ *
+ * Usage: base64_bench [megabytes]
+ *
+ * Encodes and decodes random data of a few sizes (a SHA-256 hash, a
+ * signature, a certificate, a large document) until about the given amount
+ * of input has been processed per kernel and size (default 200), and prints
+ * MB/s of input. Each kernel's output is checked against the scalar one.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "base64.h"
+
+using namespace ArhintSigner;
+using Crypto::Base64;
+
+namespace {
+
+bool supported(Base64::Kernel kernel) {
+    switch (kernel) {
+        case Base64::Kernel::Avx2: return Cpu::features().avx2;
+        case Base64::Kernel::Ssse3: return Cpu::features().ssse3;
+        default: return true;
+    }
+}
+
+double seconds(std::chrono::steady_clock::duration elapsed) {
+    return std::chrono::duration<double>(elapsed).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    long megabytes = argc > 1 ? atol(argv[1]) : 200;
+    if (megabytes <= 0) {
+        fprintf(stderr, "Usage: %s [megabytes]\n", argv[0]);
+        return 2;
+    }
+
+    const size_t sizes[] = { 32, 256, 1400, 65536 };
+    const Base64::Kernel kernels[] = { Base64::Kernel::Scalar, Base64::Kernel::Ssse3, Base64::Kernel::Avx2 };
+    std::mt19937 random(20251016);
+    int failures = 0;
+
+    printf("%8s  %-6s %10s %10s\n", "size", "kernel", "encode", "decode");
+    for (size_t size : sizes) {
+        std::vector<uint8_t> data(size);
+        for (auto& byte : data) byte = (uint8_t)random();
+
+        std::string reference = Base64::encode(data.data(), data.size());
+        std::string encoded(reference.size(), '\0');
+        std::vector<uint8_t> decoded(Base64::maxDecodedLength(encoded.size()));
+        size_t iterations = (size_t)megabytes * 1000000 / size + 1;
+
+        for (Base64::Kernel kernel : kernels) {
+            if (!supported(kernel)) {
+                printf("%8zu  %-6s %10s %10s\n", size, Base64::kernelName(kernel), "-", "-");
+                continue;
+            }
+
+            volatile size_t sink = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                sink += Base64::encodeWith(kernel, data.data(), data.size(), &encoded[0]);
+            }
+            auto encodeTime = std::chrono::steady_clock::now() - start;
+
+            size_t decodedLength = 0;
+            bool valid = true;
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                valid &= Base64::decodeWith(kernel, reference.data(), reference.size(), decoded.data(), decodedLength);
+                sink += decodedLength;
+            }
+            auto decodeTime = std::chrono::steady_clock::now() - start;
+
+            if (encoded != reference || !valid || decodedLength != size ||
+                !std::equal(data.begin(), data.end(), decoded.begin())) {
+                printf("%8zu  %-6s output differs from the scalar kernel\n", size, Base64::kernelName(kernel));
+                failures++;
+                continue;
+            }
+            double input = (double)iterations * (double)size / 1e6;
+            printf("%8zu  %-6s %5.0f MB/s %5.0f MB/s\n", size, Base64::kernelName(kernel),
+                   input / seconds(encodeTime), (double)iterations * (double)reference.size() / 1e6 / seconds(decodeTime));
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
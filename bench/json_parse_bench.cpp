@@ -0,0 +1,93 @@
+/**
+ * /sign body parsing: Json::FixedDocument and Json::StreamParser against the
+ * regex parser they replaced (regex_json_parse.h)
+ *
+ * Usage: json_parse_bench [iterations]
+ *
+ * Prints nanoseconds and heap allocations per parse for a compact SHA-256
+ * body and a pretty-printed SHA-512 body, as /sign receives them.
+ * Allocations are counted through a replaced global operator new.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "json_utils.h"
+#include "regex_json_parse.h"
+
+using namespace ArhintSigner;
+
+namespace {
+
+std::atomic<size_t> allocations(0);
+
+template <typename Parse>
+void run(const char* name, const std::string& body, long iterations, Parse parse) {
+    volatile size_t sink = 0;
+    for (long i = 0; i < iterations / 100 + 1; i++) sink += parse();
+
+    size_t allocationsBefore = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) sink += parse();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    size_t allocated = allocations.load() - allocationsBefore;
+
+    double nanos = std::chrono::duration<double, std::nano>(elapsed).count() / (double)iterations;
+    printf("  %-30s %10.0f ns %8.0f MB/s %8.1f allocs\n", name, nanos, (double)body.size() / nanos * 1000.0,
+           (double)allocated / (double)iterations);
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    const std::string bodies[] = {
+        "{\"hash\":\"q83vEjRWeJCrze8SNFZ4kKvN7xI0VniQq83vEjRWeJA=\","
+        "\"thumbprint\":\"0123456789ABCDEF0123456789ABCDEF01234567\"}",
+        "{\n  \"thumbprint\": \"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\",\n"
+        "  \"hash\": \"q83vEjRWeJCrze8SNFZ4kKvN7xI0VniQq83vEjRWeJCrze8SNFZ4kKvN7xI0VniQq83vEjRWeJCrze8SNFZ4kKvN7xI0VniQq83vEjRWeJA=\"\n}",
+    };
+
+    for (const std::string& body : bodies) {
+        printf("%zu-byte body, %ld iterations\n", body.size(), iterations);
+        run("regex Json::parse (baseline)", body, iterations / 100 + 1, [&]() {
+            return RegexJson::parse(body)["hash"].size();
+        });
+
+        // FixedDocument decodes escapes in place, so each run parses a fresh copy
+        // in a buffer that is reused rather than reallocated
+        std::string buffer;
+        buffer.reserve(body.size());
+        run("Json::FixedDocument", body, iterations, [&]() {
+            buffer.assign(body);
+            Json::FixedDocument<64> document;
+            document.parse(buffer);
+            return document.root().getString("hash").size();
+        });
+        run("Json::StreamParser (no-op)", body, iterations, [&]() {
+            Json::Handler handler;
+            Json::StreamParser parser(handler);
+            parser.feed(body.data(), body.size());
+            parser.finish();
+            return parser.offset();
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <map>
+#include <regex>
+#include <stdexcept>
+#include <string>
+
+namespace ArhintSigner {
+namespace RegexJson {
+
+/**
+ * The regex-based Json::parse that json_utils.h replaced, kept verbatim as
+ * the baseline for json_parse_bench
+ */
+inline std::map<std::string, std::string> parse(const std::string& json) {
+    std::map<std::string, std::string> result;
+    
+    // Security: Prevent regex DoS with input size limit
+    if (json.length() > 10240) {
+        throw std::runtime_error("JSON input too large (max 10KB)");
+    }
+    
+    std::regex keyValueRegex("\"([^\"]+)\"\\s*:\\s*\"([^\"]+)\"");
+    auto begin = std::sregex_iterator(json.begin(), json.end(), keyValueRegex);
+    auto end = std::sregex_iterator();
+    
+    for (auto i = begin; i != end; ++i) {
+        std::smatch match = *i;
+        result[match[1].str()] = match[2].str();
+    }
+    
+    return result;
+}
+
+} // namespace RegexJson
+} // namespace ArhintSigner
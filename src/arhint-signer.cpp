@@ -6,68 +6,168 @@
  * 
  * Architecture:
  * - src/include/http_server.h       : HTTP server initialization and request loop
+ * - src/include/epoll_server.h      : Portable epoll HTTP/1.1 backend (Linux builds)
+ * - src/include/http_exchange.h     : Backend-independent request/response interface
+ * - src/include/worker_pool.h       : Work-stealing worker pool for request dispatch
+ * - src/include/admission.h         : Adaptive admission control and load shedding
+ * - src/include/config.h            : Command-line options
  * - src/include/request_handler.h   : Request routing and endpoint handling
- * - src/include/certificate_manager.h : Certificate operations (list, sign)
+ * - src/include/key_store.h         : Key store interface (certificates, signing keys)
+ * - src/include/signing.h           : Backend-independent signing path
+ * - src/include/system_store.h      : Windows certificate store backend
+ * - src/include/software_store.h    : PEM directory key store (--key-dir)
+ * - src/include/pkcs11_store.h      : PKCS#11 token key store (--pkcs11-module)
+ * - src/include/pkcs11.h            : PKCS#11 ABI subset and module loader
+ * - src/include/certificate_manager.h : Windows key operations (probe, acquire, sign)
+ * - src/include/signature_algorithm.h : Supported key, scheme and hash combinations
+ * - src/include/rsa.h               : Portable RSA PKCS#1 v1.5 and PSS signing
+ * - src/include/ec.h                : Portable ECDSA signing (P-256, P-384)
+ * - src/include/bignum.h            : Constant-time Montgomery arithmetic
+ * - src/include/sha2.h              : SHA-256/384/512 and HMAC
+ * - src/include/random.h            : Operating system random numbers
+ * - src/include/key_scheduler.h     : Per-device signing queues
+ * - src/include/signature_cache.h   : Signature cache and request coalescing
+ * - src/include/presignature_pool.h : Background ECDSA presignatures for software keys
  * - src/include/http_utils.h        : HTTP response utilities
  * - src/include/json_utils.h        : JSON serialization/parsing
+ * - src/include/arena.h             : Per-request arena and heap allocation counters
+ * - src/include/buffer_pool.h       : Recycled receive buffers
  * - src/include/crypto_utils.h      : Base64 encoding/decoding
  * - src/include/string_utils.h      : String manipulation utilities
+ * - src/include/logger.h            : Asynchronous leveled logging
+ * - src/include/metrics.h           : Per-thread metrics for /metrics
  * - src/include/system_tray.h       : System tray icon management
  */
 
+// Console entry point for CI testing and for non-Windows builds
+#if defined(CI_TEST_MODE) || !defined(_WIN32)
+#define ARHINT_CONSOLE_MODE
+#endif
+
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <winsock2.h>
 #include <windows.h>
-#include <iostream>
+#else
+#include <csignal>
+#endif
 #include <atomic>
 #include <thread>
+#include <new>
+#include <cstdlib>
 
+#include "config.h"
+#ifdef _WIN32
 #include "http_server.h"
+#else
+#include "epoll_server.h"
+#endif
 #include "request_handler.h"
-#ifndef CI_TEST_MODE
+#ifndef ARHINT_CONSOLE_MODE
 #include "system_tray.h"
 #endif
 
 using namespace ArhintSigner;
 
+#ifdef _WIN32
+using HttpServerBackend = Server::HttpServer;
+#else
+using HttpServerBackend = Server::EpollHttpServer;
+#endif
+
 // Global flag for clean shutdown
 std::atomic<bool> g_running(true);
 
-#ifndef CI_TEST_MODE
+// Count every heap allocation per thread so /stats can show which requests
+// allocate (Memory::heapAllocations). The array and nothrow forms forward
+// to these by default.
+#ifdef __GNUC__
+// Kept out of line: GCC's -Wmismatched-new-delete misreads free() inlined
+// into a caller as releasing memory from operator new
+#define ARHINT_NOINLINE __attribute__((noinline))
+#else
+#define ARHINT_NOINLINE
+#endif
+
+void* operator new(std::size_t size) {
+    Memory::countHeapAllocation();
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* memory = std::malloc(size)) return memory;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+ARHINT_NOINLINE void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    operator delete(memory);
+}
+
+/**
+ * Apply the --log-* options; falls back to info level on an unknown name
+ */
+static void configureLogging(const Config::Options& options) {
+    Log::Level level = Log::Level::Info;
+    bool levelValid = Log::parseLevel(options.logLevel, level);
+    bool fileOpened = Log::configure(level, options.logFile, options.logRate);
+    if (!levelValid) {
+        Log::warn("Unknown log level '", options.logLevel, "', using info");
+    }
+    if (!fileOpened) {
+        Log::warn("Cannot open log file ", options.logFile, ", logging to the console");
+    }
+}
+
+#ifndef ARHINT_CONSOLE_MODE
 // Forward declare tray icon pointer
 SystemTray::TrayIcon* g_trayIcon = nullptr;
 #endif
 
-#ifdef CI_TEST_MODE
-// Console mode entry point for CI testing
+#ifdef ARHINT_CONSOLE_MODE
+// Console mode entry point for CI testing and non-Windows builds
 int main(int argc, char* argv[]) {
-    // Parse port from command line (default: 8082)
-    int port = 8082;
-    if (argc > 1) {
-        port = atoi(argv[1]);
-        if (port <= 0 || port > 65535) {
-            port = 8082;
-        }
-    }
+    // Parse port and dispatch options from command line (default port: 8082)
+    Config::Options options = Config::parseArguments(std::vector<std::string>(argv + 1, argv + argc));
+    int port = options.port;
+    configureLogging(options);
+
+#ifndef _WIN32
+    // Stop cleanly on Ctrl+C / SIGTERM so profilers can flush their data
+    signal(SIGINT, [](int) { g_running = false; });
+    signal(SIGTERM, [](int) { g_running = false; });
+    signal(SIGPIPE, SIG_IGN);
+#endif
 
-    std::cout << "ArhintSigner Web Service (Test Mode)" << std::endl;
-    std::cout << "Starting on port " << port << "..." << std::endl;
+    Log::info("ArhintSigner Web Service (Test Mode)");
+    Log::info("Starting on port ", port, "...");
 
     // Create and initialize server
-    Server::HttpServer server(port);
+    HttpServerBackend server(port, options.workers, options.outstandingReceives);
+#ifndef _WIN32
+    server.setRequestWorkers(options.requestWorkers);
+#endif
     
     if (!server.initialize()) {
-        std::cerr << "Failed to initialize HTTP server on port " << port << std::endl;
-        std::cerr << "Make sure the URL is reserved:" << std::endl;
-        std::cerr << "netsh http add urlacl url=http://+:" << port << "/ user=Everyone" << std::endl;
+        Log::error("Failed to initialize HTTP server on port ", port);
+#ifdef _WIN32
+        Log::error("Make sure the URL is reserved:");
+        Log::error("netsh http add urlacl url=http://+:", port, "/ user=Everyone");
+#endif
         return 1;
     }
 
-    std::cout << "Server initialized successfully" << std::endl;
-    std::cout << "Processing requests... (Press Ctrl+C to stop)" << std::endl;
+    Log::info("Server initialized successfully");
+    RequestHandler::configure(options, server.getConcurrency());
+    Log::info("Processing requests... (Press Ctrl+C to stop)");
 
     // Process requests directly in main thread
-    server.processRequests(RequestHandler::handleRequest);
+    server.processRequests(RequestHandler::handleRequest, RequestHandler::servedInline);
+    RequestHandler::shutdown();
     
     return 0;
 }
@@ -80,17 +180,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     // No console created at startup - prevents flicker and taskbar icon
     // Console will be allocated only when user requests it via tray menu
     
-    // Parse port from command line (default: 8082)
-    int port = 8082;
-    if (lpCmdLine && strlen(lpCmdLine) > 0) {
-        port = atoi(lpCmdLine);
-        if (port <= 0 || port > 65535) {
-            port = 8082;
-        }
-    }
+    // Parse port and dispatch options from command line (default port: 8082)
+    Config::Options options = Config::parseArguments(Config::splitCommandLine(lpCmdLine));
+    int port = options.port;
+    configureLogging(options);
 
     // Create and initialize server
-    Server::HttpServer server(port);
+    HttpServerBackend server(port, options.workers, options.outstandingReceives);
     
     if (!server.initialize()) {
         // Show error in message box since no console exists
@@ -101,6 +197,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 1;
     }
 
+    RequestHandler::configure(options, server.getConcurrency());
+
     // Initialize system tray icon
     SystemTray::TrayIcon trayIcon;
     g_trayIcon = &trayIcon;  // Set global pointer for console handler
@@ -119,7 +217,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
     // Start HTTP processing in a separate thread
     std::thread httpThread([&server]() {
-        server.processRequests(RequestHandler::handleRequest);
+        server.processRequests(RequestHandler::handleRequest, RequestHandler::servedInline);
     });
 
     // Main message loop for tray icon
@@ -140,9 +238,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     if (httpThread.joinable()) {
         httpThread.join();
     }
+    RequestHandler::shutdown();
     
     trayIcon.cleanup();
     
     return 0;
 }
-#endif // CI_TEST_MODE
+#endif // ARHINT_CONSOLE_MODE
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+namespace ArhintSigner {
+namespace Concurrency {
+
+/**
+ * Admission class of a request, in shedding order: listings are shed before
+ * signing; exempt requests (CORS preflight, home page, /stats, /metrics)
+ * are cheap and always admitted so overload stays observable.
+ */
+enum class AdmissionClass : uint8_t { Exempt, Sign, Listing, Count };
+
+inline const char* admissionClassName(AdmissionClass admissionClass) {
+    switch (admissionClass) {
+        case AdmissionClass::Sign: return "sign";
+        case AdmissionClass::Listing: return "listing";
+        default: return "exempt";
+    }
+}
+
+/**
+ * Settings of an AdmissionController
+ */
+struct AdmissionLimits {
+    double minLimit = 1;
+    double maxLimit = 16;                                // requests in progress, normally what the server backend handles at once
+    std::chrono::milliseconds targetQueueDelay{ 50 };    // back off when requests wait longer on average
+    std::chrono::milliseconds maxQueueDelay{ 1000 };     // reject requests that waited longer, 0 = admit all
+    double listingShare = 0.5;                           // part of the limit /listCerts may use
+};
+
+/**
+ * Counters reported by AdmissionController
+ */
+struct AdmissionStats {
+    double limit = 0;
+    int64_t inFlight = 0;
+    uint64_t admitted = 0;
+    uint64_t rejected[(size_t)AdmissionClass::Count] = {};
+    uint64_t queueDelayMicros = 0;   // average of the last window
+    uint64_t serviceMicros = 0;      // average of the last window
+    uint64_t baselineMicros = 0;     // service time without load
+    bool enabled = false;
+};
+
+/**
+ * Adaptive concurrency limit in front of request handling
+ *
+ * Every admitted request reports how long it waited between arrival and
+ * admission (queueing delay) and how long it then took (service time).
+ * Once per window the limit is adjusted:
+ * - average queueing delay above the target: multiplicative decrease
+ * - otherwise a gradient step, limit * baseline / service + sqrt(limit),
+ *   where baseline is the service time seen without load; the limit shrinks
+ *   as requests slow down (e.g. a token's queue grows) and grows back by the
+ *   sqrt term while they stay fast
+ *
+ * Requests above the limit, or that already waited longer than
+ * maxQueueDelay, are rejected at once so the backlog drains instead of
+ * every client timing out. Listings get only listingShare of the limit,
+ * so they are shed first. Requests admitted unsampled count against the
+ * limit but leave the window's averages alone, for endpoints whose duration
+ * does not reflect load.
+ */
+class AdmissionController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Outcome of admit(). An admitted ticket counts its request as in
+     * progress until destroyed.
+     */
+    class Ticket {
+    private:
+        AdmissionController* controller;  // null when not counted
+        bool accepted;
+        bool sampled;  // reports its delays to the limit's window
+        Clock::time_point admittedAt;
+        uint64_t queueMicros;
+
+    public:
+        Ticket(AdmissionController* owner, bool admitted, bool sample, Clock::time_point admittedTime, uint64_t queued)
+            : controller(owner), accepted(admitted), sampled(sample), admittedAt(admittedTime), queueMicros(queued) {}
+
+        Ticket(Ticket&& other) noexcept
+            : controller(other.controller), accepted(other.accepted), sampled(other.sampled)
+            , admittedAt(other.admittedAt), queueMicros(other.queueMicros) {
+            other.controller = nullptr;
+        }
+
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+        Ticket& operator=(Ticket&&) = delete;
+
+        ~Ticket() {
+            if (controller) controller->complete(sampled, queueMicros, admittedAt);
+        }
+
+        bool admitted() const { return accepted; }
+    };
+
+private:
+    static constexpr std::chrono::milliseconds WINDOW{ 100 };
+    static constexpr uint64_t MIN_WINDOW_SAMPLES = 8;
+
+    std::atomic<bool> enabled{ true };
+    std::atomic<double> limit{ 16 };
+    std::atomic<double> listingShare{ 0.5 };
+    std::atomic<uint64_t> maxQueueMicros{ 1000000 };
+    std::atomic<int64_t> inFlight{ 0 };
+    std::atomic<uint64_t> admitted{ 0 };
+    std::atomic<uint64_t> rejected[(size_t)AdmissionClass::Count] = {};
+
+    // Samples of the current window
+    std::atomic<uint64_t> windowSamples{ 0 };
+    std::atomic<uint64_t> windowQueueMicros{ 0 };
+    std::atomic<uint64_t> windowServiceMicros{ 0 };
+    std::atomic<int64_t> windowStart{ 0 };  // Clock ticks
+
+    std::mutex updateMutex;  // one window update at a time; guards the fields below
+    AdmissionLimits limits;
+    double baselineMicros = 0;
+    std::atomic<uint64_t> lastQueueMicros{ 0 };
+    std::atomic<uint64_t> lastServiceMicros{ 0 };
+
+    static uint64_t microsBetween(Clock::time_point from, Clock::time_point to) {
+        return to > from ? (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(to - from).count() : 0;
+    }
+
+    void complete(bool sampled, uint64_t queueMicros, Clock::time_point admittedAt) {
+        inFlight.fetch_sub(1, std::memory_order_relaxed);
+        if (!sampled) return;
+
+        Clock::time_point now = Clock::now();
+        windowQueueMicros.fetch_add(queueMicros, std::memory_order_relaxed);
+        windowServiceMicros.fetch_add(microsBetween(admittedAt, now), std::memory_order_relaxed);
+        windowSamples.fetch_add(1, std::memory_order_relaxed);
+
+        int64_t start = windowStart.load(std::memory_order_relaxed);
+        if (now.time_since_epoch().count() - start >= std::chrono::duration_cast<Clock::duration>(WINDOW).count()) {
+            std::unique_lock<std::mutex> lock(updateMutex, std::try_to_lock);
+            if (lock.owns_lock()) update(now);
+        }
+    }
+
+    /** Adjust the limit from the samples of the window that just ended */
+    void update(Clock::time_point now) {
+        uint64_t samples = windowSamples.load(std::memory_order_relaxed);
+        if (samples < MIN_WINDOW_SAMPLES) return;  // keep collecting
+        windowSamples.fetch_sub(samples, std::memory_order_relaxed);
+        uint64_t queueSum = windowQueueMicros.exchange(0, std::memory_order_relaxed);
+        uint64_t serviceSum = windowServiceMicros.exchange(0, std::memory_order_relaxed);
+        windowStart.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+
+        double queueMicros = (double)queueSum / (double)samples;
+        double serviceMicros = std::max(1.0, (double)serviceSum / (double)samples);
+        lastQueueMicros.store((uint64_t)queueMicros, std::memory_order_relaxed);
+        lastServiceMicros.store((uint64_t)serviceMicros, std::memory_order_relaxed);
+
+        // Baseline follows drops at once and rises slowly, so it tracks the unloaded service time
+        if (baselineMicros == 0 || serviceMicros < baselineMicros) {
+            baselineMicros = serviceMicros;
+        } else {
+            baselineMicros += (serviceMicros - baselineMicros) * 0.01;
+        }
+
+        double current = limit.load(std::memory_order_relaxed);
+        double next;
+        if (queueMicros > (double)std::chrono::duration_cast<std::chrono::microseconds>(limits.targetQueueDelay).count()) {
+            next = current * 0.9;
+        } else {
+            // Service time up to twice the baseline counts as noise
+            double gradient = std::clamp(2.0 * baselineMicros / serviceMicros, 0.5, 1.0);
+            double target = current * gradient + std::sqrt(current);
+            next = current * 0.8 + target * 0.2;
+        }
+        limit.store(std::clamp(next, limits.minLimit, limits.maxLimit), std::memory_order_relaxed);
+    }
+
+public:
+    AdmissionController() {
+        windowStart = Clock::now().time_since_epoch().count();
+    }
+
+    void setLimits(const AdmissionLimits& newLimits) {
+        std::lock_guard<std::mutex> lock(updateMutex);
+        limits = newLimits;
+        if (limits.maxLimit < limits.minLimit) limits.maxLimit = limits.minLimit;
+        limit = limits.maxLimit;
+        listingShare = limits.listingShare;
+        maxQueueMicros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(limits.maxQueueDelay).count();
+        enabled = limits.maxQueueDelay.count() > 0;
+    }
+
+    /**
+     * Admit or reject a request that arrived at arrival. Exempt requests,
+     * and every request while admission control is off, are admitted
+     * without being counted. An unsampled request is counted in progress
+     * but its delays do not adjust the limit.
+     */
+    Ticket admit(AdmissionClass admissionClass, Clock::time_point arrival, bool sampled = true) {
+        Clock::time_point now = Clock::now();
+        if (admissionClass == AdmissionClass::Exempt || !enabled.load(std::memory_order_relaxed)) {
+            return Ticket(nullptr, true, false, now, 0);
+        }
+
+        uint64_t queueMicros = microsBetween(arrival, now);
+        double allowed = limit.load(std::memory_order_relaxed);
+        uint64_t queueLimit = maxQueueMicros.load(std::memory_order_relaxed);
+        if (admissionClass == AdmissionClass::Listing) {
+            allowed = std::max(1.0, allowed * listingShare.load(std::memory_order_relaxed));
+            queueLimit /= 2;
+        }
+
+        int64_t running = inFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+        if ((double)running > allowed || queueMicros > queueLimit) {
+            inFlight.fetch_sub(1, std::memory_order_relaxed);
+            rejected[(size_t)admissionClass].fetch_add(1, std::memory_order_relaxed);
+            return Ticket(nullptr, false, false, now, 0);
+        }
+        admitted.fetch_add(1, std::memory_order_relaxed);
+        return Ticket(this, true, sampled, now, queueMicros);
+    }
+
+    /**
+     * Seconds a rejected client should wait: about the time the requests in
+     * progress need to finish, at least 1
+     */
+    unsigned retryAfterSeconds() const {
+        double micros = (double)(lastQueueMicros.load(std::memory_order_relaxed) +
+                                 lastServiceMicros.load(std::memory_order_relaxed));
+        return (unsigned)std::clamp(std::ceil(micros / 1e6), 1.0, 60.0);
+    }
+
+    AdmissionStats stats() {
+        std::lock_guard<std::mutex> lock(updateMutex);
+        AdmissionStats result;
+        result.enabled = enabled.load(std::memory_order_relaxed);
+        result.limit = limit.load(std::memory_order_relaxed);
+        result.inFlight = inFlight.load(std::memory_order_relaxed);
+        result.admitted = admitted.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < (size_t)AdmissionClass::Count; i++) {
+            result.rejected[i] = rejected[i].load(std::memory_order_relaxed);
+        }
+        result.queueDelayMicros = lastQueueMicros.load(std::memory_order_relaxed);
+        result.serviceMicros = lastServiceMicros.load(std::memory_order_relaxed);
+        result.baselineMicros = (uint64_t)baselineMicros;
+        return result;
+    }
+};
+
+/**
+ * Process-wide admission controller used by handleRequest()
+ */
+inline AdmissionController& admissionController() {
+    static AdmissionController controller;
+    return controller;
+}
+
+} // namespace Concurrency
+} // namespace ArhintSigner
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <atomic>
+
+namespace ArhintSigner {
+namespace Memory {
+
+/**
+ * Heap allocations made by the current thread
+ * Counted by the global operator new in arhint-signer.cpp; stays 0 in
+ * builds that do not install it.
+ */
+inline thread_local uint64_t threadHeapAllocations = 0;
+
+inline void countHeapAllocation() {
+    threadHeapAllocations++;
+}
+
+inline uint64_t heapAllocations() {
+    return threadHeapAllocations;
+}
+
+/**
+ * Monotonic (bump) allocator for data that lives as long as one request
+ *
+ * Allocation is a pointer increment; nothing is freed individually and
+ * reset() releases everything at once. After a reset the arena keeps a single
+ * block large enough for the biggest request seen so far, so requests of a
+ * familiar size run without touching the heap.
+ */
+class Arena {
+private:
+    struct Block {
+        Block* next;
+        size_t size;
+    };
+
+    static constexpr size_t HEADER = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    static constexpr size_t MAX_RETAINED = 1048576;  // larger blocks are released on reset
+
+    Block* blocks = nullptr;  // newest first
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t blockSize;
+    size_t used = 0;          // bytes handed out since the last reset, including padding
+    size_t highWater = 0;
+    uint64_t blockAllocations = 0;
+
+    void addBlock(size_t minimum) {
+        size_t size = blockSize;
+        while (size < minimum) size *= 2;
+        Block* block = (Block*)std::malloc(HEADER + size);
+        if (!block) throw std::bad_alloc();
+        block->next = blocks;
+        block->size = size;
+        blocks = block;
+        cursor = (char*)block + HEADER;
+        limit = cursor + size;
+        blockAllocations++;
+    }
+
+    void releaseBlocks() {
+        while (blocks) {
+            Block* next = blocks->next;
+            std::free(blocks);
+            blocks = next;
+        }
+        cursor = limit = nullptr;
+    }
+
+public:
+    explicit Arena(size_t initialBlockSize = 16384)
+        : blockSize(initialBlockSize) {
+    }
+
+    ~Arena() {
+        releaseBlocks();
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t aligned = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        if (!cursor || aligned + size > (uintptr_t)limit) {
+            addBlock(size + alignment);
+            aligned = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        }
+        used += (size_t)(aligned - (uintptr_t)cursor) + size;
+        cursor = (char*)(aligned + size);
+        return (void*)aligned;
+    }
+
+    template<typename T>
+    T* allocateArray(size_t count) {
+        return (T*)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    /** Copy of text in the arena (not null-terminated) */
+    std::string_view copy(std::string_view text) {
+        char* data = allocateArray<char>(text.size());
+        if (!text.empty()) memcpy(data, text.data(), text.size());
+        return std::string_view(data, text.size());
+    }
+
+    /**
+     * Release everything allocated since the last reset
+     * A request that needed several blocks leaves one block behind that
+     * fits it whole next time.
+     */
+    void reset() {
+        if (used > highWater) highWater = used;
+        if (blocks && blocks->next) {
+            releaseBlocks();
+            while (blockSize < highWater && blockSize < MAX_RETAINED) blockSize *= 2;
+            addBlock(blockSize);
+        } else if (blocks && blocks->size > MAX_RETAINED) {
+            releaseBlocks();
+        } else if (blocks) {
+            cursor = (char*)blocks + HEADER;
+        }
+        used = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t largestRequest() const { return used > highWater ? used : highWater; }
+    size_t capacity() const { return blocks ? blocks->size : 0; }
+    uint64_t blocksAllocated() const { return blockAllocations; }
+};
+
+/**
+ * Arena of the calling worker thread, reset when its outermost RequestScope ends
+ */
+inline Arena& requestArena() {
+    thread_local Arena arena;
+    return arena;
+}
+
+/**
+ * Marks the lifetime of one request on this thread: the request arena is
+ * reset when the outermost scope ends
+ */
+class RequestScope {
+private:
+    static size_t& depth() {
+        thread_local size_t nesting = 0;
+        return nesting;
+    }
+
+public:
+    RequestScope() {
+        depth()++;
+    }
+
+    ~RequestScope() {
+        if (--depth() == 0) requestArena().reset();
+    }
+
+    RequestScope(const RequestScope&) = delete;
+    RequestScope& operator=(const RequestScope&) = delete;
+
+    Arena& arena() const { return requestArena(); }
+};
+
+/**
+ * Heap allocation counters for one kind of request
+ */
+struct AllocationStats {
+    uint64_t requests = 0;
+    uint64_t heapAllocations = 0;
+    uint64_t allocationFreeRequests = 0;  // requests that never called operator new
+};
+
+/**
+ * Lock-free accumulator for AllocationStats
+ */
+class AllocationCounter {
+private:
+    std::atomic<uint64_t> requests{ 0 };
+    std::atomic<uint64_t> heapAllocations{ 0 };
+    std::atomic<uint64_t> allocationFreeRequests{ 0 };
+
+public:
+    void record(uint64_t allocations) {
+        requests.fetch_add(1, std::memory_order_relaxed);
+        heapAllocations.fetch_add(allocations, std::memory_order_relaxed);
+        if (allocations == 0) allocationFreeRequests.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    AllocationStats stats() const {
+        AllocationStats result;
+        result.requests = requests.load(std::memory_order_relaxed);
+        result.heapAllocations = heapAllocations.load(std::memory_order_relaxed);
+        result.allocationFreeRequests = allocationFreeRequests.load(std::memory_order_relaxed);
+        return result;
+    }
+};
+
+} // namespace Memory
+} // namespace ArhintSigner
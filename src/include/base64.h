@@ -0,0 +1,366 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "cpu_features.h"
+
+#ifdef ARHINT_CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace ArhintSigner {
+namespace Crypto {
+
+/**
+ * Base64 (RFC 4648 section 4) and base64url (section 5) codec
+ *
+ * Encoding and decoding write into caller-provided buffers. Full blocks go
+ * through SSSE3 or AVX2 kernels chosen at runtime from the CPU features,
+ * the rest through a table-driven scalar path. Decoding validates as it
+ * goes: any character outside the alphabet, misplaced padding, an
+ * impossible length or non-zero trailing bits make it fail.
+ */
+class Base64 {
+public:
+    enum class Alphabet { Standard, Url };
+    enum class Kernel { Scalar, Ssse3, Avx2 };
+
+    /** Encoded size of length bytes */
+    static constexpr size_t encodedLength(size_t length, bool padding = true) {
+        return padding ? (length + 2) / 3 * 4 : length / 3 * 4 + (length % 3 == 0 ? 0 : length % 3 + 1);
+    }
+
+    /** Output buffer size that is always enough to decode length characters */
+    static constexpr size_t maxDecodedLength(size_t length) {
+        return (length + 3) / 4 * 3;
+    }
+
+    /** Fastest kernel supported by this CPU */
+    static Kernel bestKernel() {
+        static const Kernel best = Cpu::features().avx2 ? Kernel::Avx2
+                                 : Cpu::features().ssse3 ? Kernel::Ssse3
+                                 : Kernel::Scalar;
+        return best;
+    }
+
+    static const char* kernelName(Kernel kernel) {
+        switch (kernel) {
+            case Kernel::Avx2: return "avx2";
+            case Kernel::Ssse3: return "ssse3";
+            default: return "scalar";
+        }
+    }
+
+    /**
+     * Encode length bytes into out, which must hold encodedLength(length, padding)
+     * characters. Returns the number of characters written.
+     */
+    static size_t encode(const void* data, size_t length, char* out,
+                         Alphabet alphabet = Alphabet::Standard, bool padding = true) {
+        return encodeWith(bestKernel(), data, length, out, alphabet, padding);
+    }
+
+    static size_t encodeWith(Kernel kernel, const void* data, size_t length, char* out,
+                             Alphabet alphabet = Alphabet::Standard, bool padding = true) {
+        const uint8_t* in = (const uint8_t*)data;
+        size_t done = 0;
+#ifdef ARHINT_CPU_X86
+        if (kernel == Kernel::Avx2) done = encodeAvx2(in, length, out, alphabet);
+        else if (kernel == Kernel::Ssse3) done = encodeSsse3(in, length, out, alphabet);
+#else
+        (void)kernel;
+#endif
+        char* end = encodeScalar(in + done, length - done, out + done / 3 * 4, alphabet, padding);
+        return (size_t)(end - out);
+    }
+
+    /**
+     * Decode length characters into out, which must hold maxDecodedLength(length)
+     * bytes. Padding is optional. Returns false if the input is not valid
+     * base64 in the given alphabet; decodedLength is set on success.
+     */
+    static bool decode(const char* text, size_t length, uint8_t* out, size_t& decodedLength,
+                       Alphabet alphabet = Alphabet::Standard) {
+        return decodeWith(bestKernel(), text, length, out, decodedLength, alphabet);
+    }
+
+    static bool decodeWith(Kernel kernel, const char* text, size_t length, uint8_t* out, size_t& decodedLength,
+                           Alphabet alphabet = Alphabet::Standard) {
+        // Padding only ever completes the last quad
+        size_t body = length;
+        if (length % 4 == 0 && length > 0 && text[length - 1] == '=') {
+            body--;
+            if (text[length - 2] == '=') body--;
+        }
+        if (body % 4 == 1) return false;
+
+        size_t done = 0;
+#ifdef ARHINT_CPU_X86
+        // Kernels stop at the first block with an invalid character; the
+        // scalar path then rejects it
+        if (kernel == Kernel::Avx2) done = decodeAvx2(text, body, out, alphabet);
+        else if (kernel == Kernel::Ssse3) done = decodeSsse3(text, body, out, alphabet);
+#else
+        (void)kernel;
+#endif
+        uint8_t* end = out + done / 4 * 3;
+        if (!decodeScalar(text + done, body - done, end, alphabet)) return false;
+        decodedLength = (size_t)(end - out);
+        return true;
+    }
+
+    /** Encoded string */
+    static std::string encode(const void* data, size_t length, Alphabet alphabet = Alphabet::Standard,
+                              bool padding = true) {
+        std::string result(encodedLength(length, padding), '\0');
+        if (!result.empty()) result.resize(encode(data, length, &result[0], alphabet, padding));
+        return result;
+    }
+
+    /** Decoded bytes; false if the input is not valid base64 */
+    static bool decode(const std::string& text, std::vector<uint8_t>& result,
+                       Alphabet alphabet = Alphabet::Standard) {
+        result.resize(maxDecodedLength(text.size()));
+        size_t decodedLength = 0;
+        if (!decode(text.data(), text.size(), result.data(), decodedLength, alphabet)) {
+            result.clear();
+            return false;
+        }
+        result.resize(decodedLength);
+        return true;
+    }
+
+private:
+    static constexpr uint8_t INVALID = 0xFF;
+
+    struct Tables {
+        char encode[64];
+        uint8_t decode[256];
+    };
+
+    static Tables buildTables(char c62, char c63) {
+        Tables tables = {};
+        const char* letters = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+        for (int i = 0; i < 62; i++) tables.encode[i] = letters[i];
+        tables.encode[62] = c62;
+        tables.encode[63] = c63;
+        for (int i = 0; i < 256; i++) tables.decode[i] = INVALID;
+        for (int i = 0; i < 64; i++) tables.decode[(uint8_t)tables.encode[i]] = (uint8_t)i;
+        return tables;
+    }
+
+    static const Tables& tables(Alphabet alphabet) {
+        static const Tables standard = buildTables('+', '/');
+        static const Tables url = buildTables('-', '_');
+        return alphabet == Alphabet::Url ? url : standard;
+    }
+
+    static char* encodeScalar(const uint8_t* in, size_t length, char* out, Alphabet alphabet, bool padding) {
+        const char* table = tables(alphabet).encode;
+        size_t i = 0;
+        for (; i + 3 <= length; i += 3) {
+            uint32_t triple = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+            *out++ = table[triple >> 18];
+            *out++ = table[(triple >> 12) & 0x3F];
+            *out++ = table[(triple >> 6) & 0x3F];
+            *out++ = table[triple & 0x3F];
+        }
+        size_t rest = length - i;
+        if (rest > 0) {
+            uint32_t triple = (uint32_t)in[i] << 16;
+            if (rest == 2) triple |= (uint32_t)in[i + 1] << 8;
+            *out++ = table[triple >> 18];
+            *out++ = table[(triple >> 12) & 0x3F];
+            if (rest == 2) *out++ = table[(triple >> 6) & 0x3F];
+            if (padding) {
+                if (rest == 1) *out++ = '=';
+                *out++ = '=';
+            }
+        }
+        return out;
+    }
+
+    static bool decodeScalar(const char* text, size_t length, uint8_t*& out, Alphabet alphabet) {
+        const uint8_t* table = tables(alphabet).decode;
+        uint32_t invalid = 0;
+        size_t i = 0;
+        for (; i + 4 <= length; i += 4) {
+            uint32_t a = table[(uint8_t)text[i]], b = table[(uint8_t)text[i + 1]];
+            uint32_t c = table[(uint8_t)text[i + 2]], d = table[(uint8_t)text[i + 3]];
+            invalid |= a | b | c | d;
+            uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+            *out++ = (uint8_t)(triple >> 16);
+            *out++ = (uint8_t)(triple >> 8);
+            *out++ = (uint8_t)triple;
+        }
+        size_t rest = length - i;
+        if (rest >= 2) {
+            uint32_t a = table[(uint8_t)text[i]], b = table[(uint8_t)text[i + 1]];
+            uint32_t c = rest == 3 ? table[(uint8_t)text[i + 2]] : 0;
+            invalid |= a | b | c;
+            uint32_t triple = (a << 18) | (b << 12) | (c << 6);
+            // Unused low bits of the last character must be zero (canonical encoding)
+            if (rest == 2 && (b & 0x0F) != 0) return false;
+            if (rest == 3 && (c & 0x03) != 0) return false;
+            *out++ = (uint8_t)(triple >> 16);
+            if (rest == 3) *out++ = (uint8_t)(triple >> 8);
+        }
+        return (invalid & 0x80) == 0;
+    }
+
+#ifdef ARHINT_CPU_X86
+    // Vector kernels after W. Mula and D. Lemire, "Faster Base64 Encoding and
+    // Decoding Using AVX2 Instructions" (2018). Each returns how much input it
+    // consumed, always whole blocks.
+
+    /** 6-bit values -> ASCII, 16 lanes */
+    ARHINT_TARGET("ssse3")
+    static __m128i translateEncode(__m128i indices, Alphabet alphabet) {
+        char c62 = alphabet == Alphabet::Url ? '-' : '+';
+        char c63 = alphabet == Alphabet::Url ? '_' : '/';
+        // 0: a-z, 1-10: digits, 11: c62, 12: c63, 13: A-Z
+        __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                      (char)(c62 - 62), (char)(c63 - 63), 'A', 0, 0);
+        __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        reduced = _mm_or_si128(reduced, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        return _mm_add_epi8(_mm_shuffle_epi8(shift, reduced), indices);
+    }
+
+    ARHINT_TARGET("ssse3")
+    static size_t encodeSsse3(const uint8_t* in, size_t length, char* out, Alphabet alphabet) {
+        size_t i = 0;
+        // 12 input bytes per step, loaded as 16
+        for (; i + 16 <= length; i += 12, out += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i*)(in + i));
+            block = _mm_shuffle_epi8(block, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+            __m128i t0 = _mm_and_si128(block, _mm_set1_epi32(0x0fc0fc00));
+            __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+            __m128i t2 = _mm_and_si128(block, _mm_set1_epi32(0x003f03f0));
+            __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+            _mm_storeu_si128((__m128i*)out, translateEncode(_mm_or_si128(t1, t3), alphabet));
+        }
+        return i;
+    }
+
+    ARHINT_TARGET("avx2")
+    static size_t encodeAvx2(const uint8_t* in, size_t length, char* out, Alphabet alphabet) {
+        char c62 = alphabet == Alphabet::Url ? '-' : '+';
+        char c63 = alphabet == Alphabet::Url ? '_' : '/';
+        const __m256i shift = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            (char)(c62 - 62), (char)(c63 - 63), 'A', 0, 0,
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            (char)(c62 - 62), (char)(c63 - 63), 'A', 0, 0);
+        const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        size_t i = 0;
+        // 24 input bytes per step, as two 12-byte lanes loaded 16 bytes each
+        for (; i + 28 <= length; i += 24, out += 32) {
+            __m256i block = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in + i))),
+                _mm_loadu_si128((const __m128i*)(in + i + 12)), 1);
+            block = _mm256_shuffle_epi8(block, spread);
+            __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+            __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+            __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+            __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+            __m256i indices = _mm256_or_si256(t1, t3);
+
+            __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+            __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+            reduced = _mm256_or_si256(reduced, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+            _mm256_storeu_si256((__m256i*)out, _mm256_add_epi8(_mm256_shuffle_epi8(shift, reduced), indices));
+        }
+        return i;
+    }
+
+    /**
+     * ASCII -> 6-bit values for 16 characters; valid is false if any is not
+     * in the alphabet. Range checks rather than lookups keep both alphabets
+     * on the same code.
+     */
+    ARHINT_TARGET("ssse3")
+    static __m128i translateDecode(__m128i c, Alphabet alphabet, bool& valid) {
+        char c62 = alphabet == Alphabet::Url ? '-' : '+';
+        char c63 = alphabet == Alphabet::Url ? '_' : '/';
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+        __m128i is62 = _mm_cmpeq_epi8(c, _mm_set1_epi8(c62));
+        __m128i is63 = _mm_cmpeq_epi8(c, _mm_set1_epi8(c63));
+
+        __m128i any = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(is62, is63)));
+        valid = _mm_movemask_epi8(any) == 0xFFFF;
+
+        __m128i offset = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+            _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                         _mm_or_si128(_mm_and_si128(is62, _mm_set1_epi8((char)(62 - c62))),
+                                      _mm_and_si128(is63, _mm_set1_epi8((char)(63 - c63))))));
+        return _mm_add_epi8(c, offset);
+    }
+
+    ARHINT_TARGET("ssse3")
+    static size_t decodeSsse3(const char* text, size_t length, uint8_t* out, Alphabet alphabet) {
+        size_t i = 0;
+        // 16 characters -> 12 bytes per step, stored as 16; the margin keeps the
+        // extra 4 bytes inside the output of the following characters
+        for (; i + 24 <= length; i += 16, out += 12) {
+            bool valid;
+            __m128i values = translateDecode(_mm_loadu_si128((const __m128i*)(text + i)), alphabet, valid);
+            if (!valid) break;
+            __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+            __m128i packed = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+            packed = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            _mm_storeu_si128((__m128i*)out, packed);
+        }
+        return i;
+    }
+
+    ARHINT_TARGET("avx2")
+    static size_t decodeAvx2(const char* text, size_t length, uint8_t* out, Alphabet alphabet) {
+        char c62 = alphabet == Alphabet::Url ? '-' : '+';
+        char c63 = alphabet == Alphabet::Url ? '_' : '/';
+        size_t i = 0;
+        // 32 characters -> 24 bytes per step, stored as 32
+        for (; i + 48 <= length; i += 32, out += 24) {
+            __m256i c = _mm256_loadu_si256((const __m256i*)(text + i));
+            __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+            __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+            __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+            __m256i is62 = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(c62));
+            __m256i is63 = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(c63));
+
+            __m256i any = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(is62, is63)));
+            if (_mm256_movemask_epi8(any) != -1) break;
+
+            __m256i offset = _mm256_or_si256(
+                _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')),
+                                _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+                _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+                                _mm256_or_si256(_mm256_and_si256(is62, _mm256_set1_epi8((char)(62 - c62))),
+                                                _mm256_and_si256(is63, _mm256_set1_epi8((char)(63 - c63))))));
+            __m256i values = _mm256_add_epi8(c, offset);
+
+            __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+            __m256i packed = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+            packed = _mm256_shuffle_epi8(packed, _mm256_setr_epi8(
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+            _mm256_storeu_si256((__m256i*)out, packed);
+        }
+        return i;
+    }
+#endif
+};
+
+} // namespace Crypto
+} // namespace ArhintSigner
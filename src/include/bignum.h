@@ -0,0 +1,302 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace ArhintSigner {
+namespace Crypto {
+namespace Bignum {
+
+/** Largest modulus a Montgomery context holds (RSA-8192) */
+constexpr size_t MAX_BITS = 8192;
+
+using Limb = uint64_t;
+constexpr size_t MAX_LIMBS = MAX_BITS / 64;
+constexpr size_t WINDOW_BITS = 4;
+constexpr size_t WINDOW_SIZE = 1 << WINDOW_BITS;
+
+/** a * b + c + d as (hi, returned lo); cannot overflow */
+inline Limb mulAdd(Limb a, Limb b, Limb c, Limb d, Limb& hi) {
+#if defined(_MSC_VER) && !defined(__clang__)
+#if defined(_M_ARM64)
+    Limb low = a * b;
+    Limb high = __umulh(a, b);
+#else
+    Limb high;
+    Limb low = _umul128(a, b, &high);
+#endif
+    low += c;
+    high += low < c;
+    low += d;
+    high += low < d;
+    hi = high;
+    return low;
+#else
+    unsigned __int128 product = (unsigned __int128)a * b + c + d;
+    hi = (Limb)(product >> 64);
+    return (Limb)product;
+#endif
+}
+
+/** x - y - borrow into diff; returns the new borrow */
+inline Limb subBorrow(Limb x, Limb y, Limb borrow, Limb& diff) {
+    Limb d = x - y;
+    Limb out = x < y;
+    diff = d - borrow;
+    return out | (d < borrow);
+}
+
+/**
+ * Little-endian limbs (count of them) from a big-endian unsigned integer;
+ * false if it does not fit
+ */
+inline bool fromBytes(std::string_view bytes, Limb* limbs, size_t count) {
+    size_t start = 0;
+    while (start < bytes.size() && bytes[start] == 0) start++;
+    if (bytes.size() - start > count * 8) return false;
+    memset(limbs, 0, count * sizeof(Limb));
+    for (size_t i = 0; i < bytes.size() - start; i++) {
+        uint8_t byte = (uint8_t)bytes[bytes.size() - 1 - i];
+        limbs[i / 8] |= (Limb)byte << (8 * (i % 8));
+    }
+    return true;
+}
+
+/** Big-endian bytes (length of them) of little-endian limbs */
+inline void toBytes(const Limb* limbs, size_t count, uint8_t* bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        size_t limb = i / 8;
+        bytes[length - 1 - i] = limb < count ? (uint8_t)(limbs[limb] >> (8 * (i % 8))) : 0;
+    }
+}
+
+/** Limbs used by a value (at least 1) */
+inline size_t usedLimbs(const Limb* limbs, size_t count) {
+    while (count > 1 && limbs[count - 1] == 0) count--;
+    return count;
+}
+
+/** Significant bits of a value */
+inline size_t bitLength(const Limb* limbs, size_t count) {
+    count = usedLimbs(limbs, count);
+    size_t bits = count * 64;
+    for (Limb top = limbs[count - 1]; bits > 0 && (top & ((Limb)1 << 63)) == 0; top <<= 1) bits--;
+    return bits;
+}
+
+/** a < b over count limbs; only used on public values */
+inline bool less(const Limb* a, const Limb* b, size_t count) {
+    for (size_t i = count; i > 0; i--) {
+        if (a[i - 1] != b[i - 1]) return a[i - 1] < b[i - 1];
+    }
+    return false;
+}
+
+/** Overwrite secret material; not optimized away */
+inline void wipe(void* data, size_t length) {
+    volatile uint8_t* bytes = (volatile uint8_t*)data;
+    for (size_t i = 0; i < length; i++) bytes[i] = 0;
+}
+
+/**
+ * Arithmetic modulo an odd modulus in Montgomery form (R = 2^(64 n))
+ *
+ * Multiplication is CIOS with a branch-free final subtraction, and
+ * exponentiation uses a fixed window with a full table scan, so neither
+ * depends on the secret exponent's bits. RSA (rsa.h) sizes it for its
+ * primes and modulus, the NIST curves (ec.h) for their field and order.
+ */
+class Montgomery {
+private:
+    size_t n = 0;
+    Limb modulus[MAX_LIMBS] = {};
+    Limb inverse = 0;               // -modulus^-1 mod 2^64
+    Limb rr[MAX_LIMBS] = {};        // R^2 mod modulus
+    size_t wideLength = 0;          // input limbs reduce() is prepared for
+    Limb wideFactor[MAX_LIMBS] = {};
+
+    /** 2^bits mod modulus by repeated doubling; setup only */
+    void powerOfTwo(size_t bits, Limb* out) const {
+        memset(out, 0, n * sizeof(Limb));
+        out[0] = 1;
+        for (size_t i = 0; i < bits; i++) {
+            Limb carry = 0;
+            for (size_t j = 0; j < n; j++) {
+                Limb next = out[j] >> 63;
+                out[j] = (out[j] << 1) | carry;
+                carry = next;
+            }
+            if (carry || !less(out, modulus, n)) {
+                Limb borrow = 0;
+                for (size_t j = 0; j < n; j++) borrow = subBorrow(out[j], modulus[j], borrow, out[j]);
+            }
+        }
+    }
+
+    /** out = value - modulus if that does not go negative (or extra is set), else value */
+    void subtractIfAbove(const Limb* value, Limb extra, Limb* out) const {
+        Limb diff[MAX_LIMBS];
+        Limb borrow = 0;
+        for (size_t j = 0; j < n; j++) borrow = subBorrow(value[j], modulus[j], borrow, diff[j]);
+        Limb mask = (Limb)0 - (Limb)((extra != 0) | (borrow == 0));
+        for (size_t j = 0; j < n; j++) out[j] = (diff[j] & mask) | (value[j] & ~mask);
+    }
+
+public:
+    ~Montgomery() {
+        wipe(modulus, sizeof(modulus));
+        wipe(rr, sizeof(rr));
+        wipe(wideFactor, sizeof(wideFactor));
+    }
+
+    /** Set up for an odd modulus of count limbs */
+    void init(const Limb* value, size_t count) {
+        n = usedLimbs(value, count);
+        memcpy(modulus, value, n * sizeof(Limb));
+        // Newton iteration for modulus[0]^-1 mod 2^64, doubling the correct bits each step
+        Limb x = 1;
+        for (int i = 0; i < 6; i++) x *= 2 - modulus[0] * x;
+        inverse = (Limb)0 - x;
+        powerOfTwo(128 * n, rr);
+    }
+
+    /**
+     * Prepare reduce() for inputs of length limbs (at least the modulus' own)
+     */
+    void prepareReduce(size_t length) {
+        wideLength = length;
+        // reduce() divides by 2^(64 (length - n + 1)); the factor restores it and converts to Montgomery form
+        powerOfTwo(64 * (length - n + 1) + 128 * n, wideFactor);
+    }
+
+    size_t limbs() const { return n; }
+    const Limb* value() const { return modulus; }
+
+    /** out = a * b / R mod modulus, for a, b < modulus; out may alias either */
+    void multiply(const Limb* a, const Limb* b, Limb* out) const {
+        Limb t[MAX_LIMBS + 2];
+        memset(t, 0, (n + 2) * sizeof(Limb));
+        for (size_t i = 0; i < n; i++) {
+            Limb carry = 0;
+            for (size_t j = 0; j < n; j++) t[j] = mulAdd(a[j], b[i], t[j], carry, carry);
+            Limb sum = t[n] + carry;
+            t[n + 1] = sum < carry;
+            t[n] = sum;
+
+            Limb m = t[0] * inverse;
+            mulAdd(m, modulus[0], t[0], 0, carry);  // low limb becomes zero
+            for (size_t j = 1; j < n; j++) t[j - 1] = mulAdd(m, modulus[j], t[j], carry, carry);
+            sum = t[n] + carry;
+            t[n - 1] = sum;
+            t[n] = t[n + 1] + (sum < carry);
+        }
+        subtractIfAbove(t, t[n], out);
+    }
+
+    /** Montgomery form of a value below the modulus */
+    void toMontgomery(const Limb* a, Limb* out) const { multiply(a, rr, out); }
+
+    void fromMontgomery(const Limb* a, Limb* out) const {
+        Limb one[MAX_LIMBS] = { 1 };
+        multiply(a, one, out);
+    }
+
+    /**
+     * Montgomery form of an arbitrary value of the length given to
+     * prepareReduce(), e.g. a message modulo one prime
+     */
+    void reduce(const Limb* value, Limb* out) const {
+        size_t length = wideLength;
+        size_t steps = length - n + 1;
+        Limb work[2 * MAX_LIMBS + 2];
+        memcpy(work, value, length * sizeof(Limb));
+        work[length] = 0;
+        work[length + 1] = 0;
+        // Each step clears the lowest remaining limb (divides by 2^64 mod modulus)
+        for (size_t i = 0; i < steps; i++) {
+            Limb m = work[i] * inverse;
+            Limb carry = 0;
+            for (size_t j = 0; j < n; j++) work[i + j] = mulAdd(m, modulus[j], work[i + j], carry, carry);
+            for (size_t j = i + n; j < length + 2; j++) {
+                work[j] += carry;
+                carry = work[j] < carry;
+            }
+        }
+        // Below twice the modulus now
+        Limb reduced[MAX_LIMBS];
+        subtractIfAbove(work + steps, work[steps + n], reduced);
+        multiply(reduced, wideFactor, out);
+        wipe(work, sizeof(work));
+    }
+
+    /** out = a - b mod modulus, for a, b < modulus */
+    void subtract(const Limb* a, const Limb* b, Limb* out) const {
+        Limb borrow = 0;
+        for (size_t j = 0; j < n; j++) borrow = subBorrow(a[j], b[j], borrow, out[j]);
+        Limb mask = (Limb)0 - borrow;
+        Limb carry = 0;
+        for (size_t j = 0; j < n; j++) out[j] = mulAdd(modulus[j] & mask, 1, out[j], carry, carry);
+    }
+
+    /** out = a + b mod modulus, for a, b < modulus */
+    void add(const Limb* a, const Limb* b, Limb* out) const {
+        Limb sum[MAX_LIMBS];
+        Limb carry = 0;
+        for (size_t j = 0; j < n; j++) sum[j] = mulAdd(a[j], 1, b[j], carry, carry);
+        subtractIfAbove(sum, carry, out);
+    }
+
+    /** out = base^exponent in Montgomery form; the exponent's bits are not branched on */
+    void power(const Limb* base, const Limb* exponent, size_t exponentBits, Limb* out) const {
+        Limb table[WINDOW_SIZE * MAX_LIMBS];
+        Limb one[MAX_LIMBS] = { 1 };
+        toMontgomery(one, table);
+        memcpy(table + n, base, n * sizeof(Limb));
+        for (size_t i = 2; i < WINDOW_SIZE; i++) multiply(table + (i - 1) * n, base, table + i * n);
+
+        Limb accumulator[MAX_LIMBS];
+        Limb selected[MAX_LIMBS];
+        memcpy(accumulator, table, n * sizeof(Limb));
+        size_t windows = (exponentBits + WINDOW_BITS - 1) / WINDOW_BITS;
+        for (size_t w = windows; w > 0; w--) {
+            if (w != windows) {
+                for (size_t s = 0; s < WINDOW_BITS; s++) multiply(accumulator, accumulator, accumulator);
+            }
+            size_t bit = (w - 1) * WINDOW_BITS;
+            Limb digit = (exponent[bit / 64] >> (bit % 64)) & (WINDOW_SIZE - 1);
+
+            // Read every entry so the memory access pattern does not reveal the digit
+            memset(selected, 0, n * sizeof(Limb));
+            for (Limb k = 0; k < WINDOW_SIZE; k++) {
+                Limb mask = (Limb)0 - (Limb)(k == digit);
+                for (size_t j = 0; j < n; j++) selected[j] |= table[k * n + j] & mask;
+            }
+            multiply(accumulator, selected, accumulator);
+        }
+        memcpy(out, accumulator, n * sizeof(Limb));
+        wipe(table, sizeof(table));
+        wipe(accumulator, sizeof(accumulator));
+        wipe(selected, sizeof(selected));
+    }
+
+    /** out = base^exponent in Montgomery form, for a public exponent */
+    void powerPublic(const Limb* base, uint64_t exponent, Limb* out) const {
+        Limb accumulator[MAX_LIMBS];
+        memcpy(accumulator, base, n * sizeof(Limb));
+        int top = 63;
+        while (top > 0 && ((exponent >> top) & 1) == 0) top--;
+        for (int bit = top - 1; bit >= 0; bit--) {
+            multiply(accumulator, accumulator, accumulator);
+            if ((exponent >> bit) & 1) multiply(accumulator, base, accumulator);
+        }
+        memcpy(out, accumulator, n * sizeof(Limb));
+    }
+};
+
+} // namespace Bignum
+} // namespace Crypto
+} // namespace ArhintSigner
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+namespace ArhintSigner {
+namespace Memory {
+
+/**
+ * Counters reported by BufferPool
+ */
+struct BufferPoolStats {
+    uint64_t acquired = 0;
+    uint64_t reused = 0;      // served from the free list without reallocating
+    uint64_t allocated = 0;   // new or regrown buffers
+    uint64_t oversized = 0;   // requests that did not fit the buffer they were given
+    size_t bufferSize = 0;    // current target size
+    size_t pooled = 0;
+};
+
+/**
+ * Recycled receive buffers, sized from the requests actually seen
+ *
+ * The target size follows the largest request of the recent window (rounded
+ * up to a power of two): it grows as soon as a request does not fit and
+ * shrinks again when a window passes with only smaller requests, so one odd
+ * large request does not pin memory in every buffer for good.
+ */
+class BufferPool {
+private:
+    static constexpr size_t WINDOW = 1024;  // requests per sizing window
+
+    std::mutex mutex;
+    std::vector<std::vector<uint8_t>> available;
+    size_t minimumSize;
+    size_t maximumSize;
+    size_t maxPooled;
+    std::atomic<size_t> targetSize;
+
+    std::mutex windowMutex;
+    size_t windowLargest = 0;
+    size_t windowCount = 0;
+
+    std::atomic<uint64_t> acquiredCount{ 0 };
+    std::atomic<uint64_t> reusedCount{ 0 };
+    std::atomic<uint64_t> allocatedCount{ 0 };
+    std::atomic<uint64_t> oversizedCount{ 0 };
+
+    size_t roundUp(size_t size) const {
+        size_t rounded = minimumSize;
+        while (rounded < size && rounded < maximumSize) rounded *= 2;
+        return rounded;
+    }
+
+public:
+    BufferPool(size_t minimum, size_t maximum, size_t poolLimit = 64)
+        : minimumSize(minimum)
+        , maximumSize(maximum)
+        , maxPooled(poolLimit)
+        , targetSize(minimum) {
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /** A buffer of at least the current target size */
+    std::vector<uint8_t> acquire() {
+        acquiredCount++;
+        std::vector<uint8_t> buffer;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!available.empty()) {
+                buffer = std::move(available.back());
+                available.pop_back();
+            }
+        }
+        fit(buffer);
+        return buffer;
+    }
+
+    /**
+     * Bring a buffer the caller keeps (e.g. one per outstanding receive) to
+     * the target size. Returns true if it had to be reallocated.
+     */
+    bool fit(std::vector<uint8_t>& buffer) {
+        size_t target = targetSize.load(std::memory_order_relaxed);
+        if (buffer.size() >= target && buffer.size() <= target * 4) {
+            reusedCount++;
+            return false;
+        }
+        std::vector<uint8_t>(target).swap(buffer);
+        allocatedCount++;
+        return true;
+    }
+
+    /** Give a buffer back for reuse */
+    void release(std::vector<uint8_t>&& buffer) {
+        if (buffer.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (available.size() < maxPooled) available.push_back(std::move(buffer));
+    }
+
+    /**
+     * Record the size one request needed; fitted says whether it fitted
+     * the buffer it was received into
+     */
+    void observe(size_t size, bool fitted = true) {
+        if (!fitted) oversizedCount++;
+        size_t target = targetSize.load(std::memory_order_relaxed);
+        if (size > target) targetSize = roundUp(size);
+
+        std::lock_guard<std::mutex> lock(windowMutex);
+        if (size > windowLargest) windowLargest = size;
+        if (++windowCount >= WINDOW) {
+            targetSize = roundUp(windowLargest);
+            windowLargest = 0;
+            windowCount = 0;
+        }
+    }
+
+    size_t bufferSize() const { return targetSize.load(std::memory_order_relaxed); }
+
+    BufferPoolStats stats() {
+        BufferPoolStats result;
+        result.acquired = acquiredCount;
+        result.reused = reusedCount;
+        result.allocated = allocatedCount;
+        result.oversized = oversizedCount;
+        result.bufferSize = bufferSize();
+        std::lock_guard<std::mutex> lock(mutex);
+        result.pooled = available.size();
+        return result;
+    }
+};
+
+/**
+ * Pool for HTTP.sys request buffers (HTTP_REQUEST plus headers)
+ */
+inline BufferPool& receiveBuffers() {
+    static BufferPool pool(4096, 1048576);
+    return pool;
+}
+
+} // namespace Memory
+} // namespace ArhintSigner
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <windows.h>
+#include <wincrypt.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <unordered_map>
+#include "logger.h"
+#include "metrics.h"
+#include "x509.h"
+#include "string_utils.h"
+#include "key_store.h"
+
+#pragma comment(lib, "crypt32.lib")
+
+namespace ArhintSigner {
+namespace Certificate {
+
+/**
+ * Certificate from the MY store together with its lookup keys
+ */
+struct IndexedCertificate : Keys::StoredCertificate {
+    PCCERT_CONTEXT context;
+    std::string subjectKeyId;  // upper-case hex subject key identifier
+
+    explicit IndexedCertificate(PCCERT_CONTEXT cert)
+        : context(CertDuplicateCertificateContext(cert)) {
+    }
+
+    ~IndexedCertificate() override {
+        if (context) CertFreeCertificateContext(context);
+    }
+};
+
+using CertificatePtr = std::shared_ptr<const IndexedCertificate>;
+
+/**
+ * Immutable lookup tables built from one enumeration of the store
+ */
+struct IndexSnapshot {
+    uint64_t generation = 0;
+    std::vector<CertificatePtr> certificates;
+    std::unordered_map<std::string, CertificatePtr> bySha1;
+    std::unordered_map<std::string, CertificatePtr> bySha256;
+    std::unordered_map<std::string, CertificatePtr> bySubjectKeyId;
+};
+
+/**
+ * Counters reported by CertificateIndex
+ */
+struct IndexStats {
+    uint64_t generation = 0;
+    uint64_t rebuilds = 0;
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    size_t size = 0;
+};
+
+/**
+ * Read a binary certificate property as hex, or "" if absent
+ */
+inline std::string certificatePropertyHex(PCCERT_CONTEXT cert, DWORD propertyId) {
+    BYTE buffer[64];
+    DWORD size = sizeof(buffer);
+    if (!CertGetCertificateContextProperty(cert, propertyId, buffer, &size)) {
+        return "";
+    }
+    return Utils::bytesToHex(buffer, size);
+}
+
+/**
+ * Long-lived, thumbprint-indexed view of the MY store
+ *
+ * The store stays open for the life of the process. A background thread
+ * waits for the store's change notification and publishes a freshly built
+ * snapshot; lookups only read the current snapshot, so the sign hot path is
+ * a single hash lookup, for unknown thumbprints too, and takes no lock.
+ */
+class CertificateIndex {
+public:
+    using RebuildListener = std::function<void(const IndexSnapshot&)>;
+
+private:
+    HCERTSTORE hStore;
+    HANDLE hChangeEvent;
+    HANDLE hStopEvent;
+    std::thread watcher;
+
+    std::shared_ptr<const IndexSnapshot> snapshot;
+    std::mutex listenersMutex;
+    std::vector<RebuildListener> listeners;
+
+    std::atomic<uint64_t> rebuilds;
+    std::atomic<uint64_t> lookups;
+    std::atomic<uint64_t> hits;
+
+    void rebuild() {
+        Metrics::Stopwatch stopwatch;
+        auto next = std::make_shared<IndexSnapshot>();
+        auto previous = std::atomic_load(&snapshot);
+        next->generation = previous ? previous->generation + 1 : 1;
+
+        PCCERT_CONTEXT certContext = nullptr;
+        while ((certContext = CertEnumCertificatesInStore(hStore, certContext)) != nullptr) {
+            auto entry = std::make_shared<IndexedCertificate>(certContext);
+            entry->sha1 = certificatePropertyHex(certContext, CERT_HASH_PROP_ID);
+            entry->sha256 = certificatePropertyHex(certContext, CERT_SHA256_HASH_PROP_ID);
+            entry->subjectKeyId = certificatePropertyHex(certContext, CERT_KEY_IDENTIFIER_PROP_ID);
+            if (entry->sha1.empty()) continue;
+            try {
+                Der::Certificate parsed;
+                Der::parse(std::string_view((const char*)certContext->pbCertEncoded, certContext->cbCertEncoded), parsed);
+                entry->keyAlgorithm = parsed.keyAlgorithm;
+                entry->keyBits = parsed.keyBits;
+            }
+            catch (const Der::ParseError&) {
+                // Unknown key type: signatures of this certificate are never cached
+            }
+
+            CertificatePtr cert = entry;
+            next->certificates.push_back(cert);
+            next->bySha1[cert->sha1] = cert;
+            if (!cert->sha256.empty()) next->bySha256[cert->sha256] = cert;
+            if (!cert->subjectKeyId.empty()) next->bySubjectKeyId.emplace(cert->subjectKeyId, cert);
+        }
+
+        std::atomic_store(&snapshot, std::shared_ptr<const IndexSnapshot>(next));
+        rebuilds++;
+        Metrics::recordStoreEnumeration(stopwatch.elapsedMicros());
+
+        Log::info("Certificate index rebuilt: ", next->certificates.size(), " certificates (generation ", next->generation, ")");
+
+        std::lock_guard<std::mutex> lock(listenersMutex);
+        for (const auto& listener : listeners) {
+            listener(*next);
+        }
+    }
+
+    void watch() {
+        HANDLE handles[2] = { hStopEvent, hChangeEvent };
+        while (true) {
+            DWORD waitResult = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+            if (waitResult != WAIT_OBJECT_0 + 1) break;
+
+            // Re-arm the notification before enumerating so no change is missed
+            CertControlStore(hStore, 0, CERT_STORE_CTRL_RESYNC, &hChangeEvent);
+            rebuild();
+        }
+    }
+
+    CertificatePtr find(const std::unordered_map<std::string, CertificatePtr> IndexSnapshot::*table,
+                        std::string_view hex) {
+        lookups++;
+        // Per-thread scratch key: a lookup does not allocate once it has grown to thumbprint size
+        thread_local std::string key;
+        if (!Utils::normalizeHex(hex, key)) return nullptr;
+
+        auto current = std::atomic_load(&snapshot);
+        if (current) {
+            const auto& map = (*current).*table;
+            auto it = map.find(key);
+            if (it != map.end()) {
+                hits++;
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    CertificateIndex()
+        : hStore(nullptr)
+        , hChangeEvent(nullptr)
+        , hStopEvent(nullptr)
+        , rebuilds(0)
+        , lookups(0)
+        , hits(0) {
+        hStore = CertOpenSystemStoreA(0, "MY");
+        if (!hStore) {
+            Log::error("Failed to open certificate store");
+            std::atomic_store(&snapshot, std::make_shared<const IndexSnapshot>());
+            return;
+        }
+
+        hChangeEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        hStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        bool notify = hChangeEvent && hStopEvent &&
+                      CertControlStore(hStore, 0, CERT_STORE_CTRL_NOTIFY_CHANGE, &hChangeEvent);
+
+        rebuild();
+
+        if (notify) {
+            watcher = std::thread([this]() { watch(); });
+        } else {
+            Log::warn("Certificate store change notification unavailable");
+        }
+    }
+
+public:
+    ~CertificateIndex() {
+        if (hStopEvent) SetEvent(hStopEvent);
+        if (watcher.joinable()) watcher.join();
+
+        std::atomic_store(&snapshot, std::shared_ptr<const IndexSnapshot>());
+        if (hStore) CertCloseStore(hStore, 0);
+        if (hChangeEvent) CloseHandle(hChangeEvent);
+        if (hStopEvent) CloseHandle(hStopEvent);
+    }
+
+    CertificateIndex(const CertificateIndex&) = delete;
+    CertificateIndex& operator=(const CertificateIndex&) = delete;
+
+    static CertificateIndex& instance() {
+        static CertificateIndex index;
+        return index;
+    }
+
+    /** Find by SHA-1 thumbprint (40 hex characters) */
+    CertificatePtr findBySha1(std::string_view hex) {
+        return find(&IndexSnapshot::bySha1, hex);
+    }
+
+    /** Find by SHA-256 thumbprint (64 hex characters) */
+    CertificatePtr findBySha256(std::string_view hex) {
+        return find(&IndexSnapshot::bySha256, hex);
+    }
+
+    /** Find by subject key identifier */
+    CertificatePtr findBySubjectKeyId(std::string_view hex) {
+        return find(&IndexSnapshot::bySubjectKeyId, hex);
+    }
+
+    /** Find by SHA-1 or SHA-256 thumbprint depending on its length */
+    CertificatePtr findByThumbprint(std::string_view hex) {
+        return hex.length() == 64 ? findBySha256(hex) : findBySha1(hex);
+    }
+
+    /** Current snapshot; stays valid while the caller holds it */
+    std::shared_ptr<const IndexSnapshot> current() const {
+        return std::atomic_load(&snapshot);
+    }
+
+    /**
+     * Register a callback run on the watcher thread after every rebuild
+     */
+    void onRebuild(RebuildListener listener) {
+        std::lock_guard<std::mutex> lock(listenersMutex);
+        listeners.push_back(std::move(listener));
+    }
+
+    IndexStats stats() const {
+        IndexStats result;
+        auto current = std::atomic_load(&snapshot);
+        result.generation = current ? current->generation : 0;
+        result.size = current ? current->certificates.size() : 0;
+        result.rebuilds = rebuilds;
+        result.lookups = lookups;
+        result.hits = hits;
+        return result;
+    }
+};
+
+} // namespace Certificate
+} // namespace ArhintSigner
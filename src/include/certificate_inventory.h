@@ -0,0 +1,325 @@
+#pragma once
+
+#include <windows.h>
+#include <wincrypt.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include "logger.h"
+#include "certificate_index.h"
+#include "certificate_manager.h"
+#include "key_probe.h"
+#include "json_utils.h"
+
+namespace ArhintSigner {
+namespace Certificate {
+
+/**
+ * One certificate as listed by /listCerts, processed once when it appears in the store
+ */
+struct InventoryEntry {
+    std::string sha1;
+    KeyStatus keyStatus = KeyStatus::Absent;
+    ULONGLONG notBefore = 0;
+    ULONGLONG notAfter = 0;
+    std::string json;  // serialized certificate object
+};
+
+using InventoryEntryPtr = std::shared_ptr<const InventoryEntry>;
+
+/**
+ * Immutable inventory built from one index generation
+ */
+struct InventorySnapshot {
+    uint64_t generation = 0;
+    std::vector<InventoryEntryPtr> entries;  // store enumeration order
+    std::unordered_map<std::string, InventoryEntryPtr> bySha1;
+};
+
+/**
+ * Serialized /listCerts response and the time until which it stays correct
+ *
+ * The body references the cached certificate fragments instead of copying
+ * them; source keeps them alive for as long as the response is in use.
+ */
+struct InventoryResponse {
+    uint64_t generation = 0;
+    ULONGLONG expiresAt = 0;  // next notBefore/notAfter crossing, as FILETIME ticks
+    std::shared_ptr<const InventorySnapshot> source;
+    Json::Writer body;
+};
+
+/**
+ * Counters reported by CertificateInventory
+ */
+struct InventoryStats {
+    uint64_t generation = 0;
+    uint64_t updates = 0;
+    uint64_t processed = 0;       // certificates probed and serialized
+    uint64_t reused = 0;          // certificates carried over unchanged
+    uint64_t serializations = 0;  // response bodies assembled
+    size_t certificates = 0;
+    size_t withPrivateKey = 0;
+    size_t keyTimeouts = 0;  // listed with keyStatus "timeout"
+    ProbeStats probes;
+};
+
+inline ULONGLONG fileTimeTicks(const FILETIME& ft) {
+    return ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+inline ULONGLONG currentFileTimeTicks() {
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return fileTimeTicks(now);
+}
+
+/**
+ * Cached certificate inventory for /listCerts
+ *
+ * Every CertificateIndex rebuild (store change notification) updates the
+ * inventory incrementally: certificates already known by thumbprint are
+ * carried over, so only added certificates are probed and serialized and
+ * removed ones simply drop out. Readers load the published response with a
+ * single atomic shared_ptr read and never wait for the refresher. The
+ * response is re-assembled from the cached fragments (without reprocessing)
+ * when a listed certificate expires or a pending one becomes valid.
+ *
+ * New certificates are probed for a private key in parallel (KeyProber).
+ * Certificates whose token does not answer in time are listed with
+ * keyStatus "timeout"; they are re-probed on the next update, and a late
+ * probe result is patched into the inventory as soon as it arrives.
+ */
+class CertificateInventory {
+private:
+    std::mutex updateMutex;  // serializes refreshers only
+    std::shared_ptr<const InventorySnapshot> snapshot;
+    std::shared_ptr<const InventoryResponse> response;
+    KeyProber prober;
+
+    std::atomic<uint64_t> updates;
+    std::atomic<uint64_t> processed;
+    std::atomic<uint64_t> reused;
+    std::atomic<uint64_t> serializations;
+
+    static std::atomic<unsigned>& probeTimeoutMs() {
+        static std::atomic<unsigned> timeout(2000);
+        return timeout;
+    }
+
+    static InventoryEntryPtr buildEntry(const IndexedCertificate& cert, KeyStatus keyStatus) {
+        auto entry = std::make_shared<InventoryEntry>();
+        entry->sha1 = cert.sha1;
+        entry->notBefore = fileTimeTicks(cert.context->pCertInfo->NotBefore);
+        entry->notAfter = fileTimeTicks(cert.context->pCertInfo->NotAfter);
+        entry->keyStatus = keyStatus;
+
+        if (entry->keyStatus != KeyStatus::Absent) {
+            try {
+                entry->json = certificateToJson(cert.context, keyStatus);
+            }
+            catch (...) {
+                Log::warn("Error processing certificate");
+                entry->keyStatus = KeyStatus::Absent;
+            }
+        }
+        return entry;
+    }
+
+    /**
+     * Assemble {"result":[...]} from the cached fragments of currently valid certificates
+     */
+    std::shared_ptr<const InventoryResponse> serialize(const std::shared_ptr<const InventorySnapshot>& inventory,
+                                                       size_t* listed = nullptr) {
+        static constexpr Json::StaticKey resultKey("result");
+
+        ULONGLONG now = currentFileTimeTicks();
+        auto result = std::make_shared<InventoryResponse>();
+        result->generation = inventory->generation;
+        result->expiresAt = ~0ULL;
+        result->source = inventory;
+        result->body.reserve(16 + inventory->entries.size(), inventory->entries.size());
+        result->body.beginObject().key(resultKey).beginArray();
+
+        size_t count = 0;
+        for (const auto& entry : inventory->entries) {
+            if (entry->keyStatus == KeyStatus::Absent) continue;
+            if (entry->notBefore >= now) {
+                // Not yet valid - the response changes when it becomes valid
+                if (entry->notBefore < result->expiresAt) result->expiresAt = entry->notBefore;
+                continue;
+            }
+            if (entry->notAfter <= now) continue;
+            if (entry->notAfter < result->expiresAt) result->expiresAt = entry->notAfter;
+
+            result->body.fragment(entry->json);
+            count++;
+        }
+        result->body.endArray().endObject();
+
+        serializations++;
+        if (listed) *listed = count;
+        return result;
+    }
+
+    void update(const IndexSnapshot& index) {
+        std::lock_guard<std::mutex> lock(updateMutex);
+
+        auto previous = std::atomic_load(&snapshot);
+        if (previous && previous->generation >= index.generation) {
+            return;
+        }
+
+        // Carry known certificates over; probe new ones and earlier timeouts together
+        std::vector<InventoryEntryPtr> entries(index.certificates.size());
+        std::vector<CertificatePtr> pending;
+        std::vector<size_t> pendingSlots;
+        for (size_t i = 0; i < index.certificates.size(); i++) {
+            const CertificatePtr& cert = index.certificates[i];
+            if (previous) {
+                auto it = previous->bySha1.find(cert->sha1);
+                if (it != previous->bySha1.end() && it->second->keyStatus != KeyStatus::Timeout) {
+                    entries[i] = it->second;
+                    reused++;
+                    continue;
+                }
+            }
+            pending.push_back(cert);
+            pendingSlots.push_back(i);
+        }
+
+        std::vector<KeyStatus> statuses = prober.probeAll(pending, std::chrono::milliseconds(probeTimeoutMs().load()));
+        for (size_t i = 0; i < pending.size(); i++) {
+            entries[pendingSlots[i]] = buildEntry(*pending[i], statuses[i]);
+            processed++;
+        }
+
+        auto next = std::make_shared<InventorySnapshot>();
+        next->generation = index.generation;
+        next->entries = std::move(entries);
+        for (const auto& entry : next->entries) {
+            next->bySha1[entry->sha1] = entry;
+        }
+
+        publish(next);
+    }
+
+    void publish(const std::shared_ptr<InventorySnapshot>& next) {
+        size_t listed = 0;
+        auto body = serialize(next, &listed);
+        std::atomic_store(&snapshot, std::shared_ptr<const InventorySnapshot>(next));
+        std::atomic_store(&response, body);
+        updates++;
+
+        Log::info("Certificate inventory updated: ", listed, " signing certificates (generation ", next->generation, ")");
+    }
+
+    /**
+     * Patch in the result of a probe that finished after its deadline
+     */
+    void applyLateResult(const CertificatePtr& cert, KeyStatus keyStatus) {
+        std::lock_guard<std::mutex> lock(updateMutex);
+
+        auto current = std::atomic_load(&snapshot);
+        if (!current) return;
+        auto it = current->bySha1.find(cert->sha1);
+        if (it == current->bySha1.end() || it->second->keyStatus != KeyStatus::Timeout) return;
+
+        auto entry = buildEntry(*cert, keyStatus);
+        processed++;
+
+        auto next = std::make_shared<InventorySnapshot>(*current);
+        for (auto& existing : next->entries) {
+            if (existing->sha1 == entry->sha1) existing = entry;
+        }
+        next->bySha1[entry->sha1] = entry;
+        publish(next);
+    }
+
+    CertificateInventory()
+        : updates(0)
+        , processed(0)
+        , reused(0)
+        , serializations(0) {
+        prober.onLateResult([this](const CertificatePtr& cert, KeyStatus keyStatus) {
+            applyLateResult(cert, keyStatus);
+        });
+
+        CertificateIndex& index = CertificateIndex::instance();
+        index.onRebuild([this](const IndexSnapshot& rebuilt) { update(rebuilt); });
+
+        auto current = index.current();
+        if (current) {
+            update(*current);
+        }
+    }
+
+public:
+    CertificateInventory(const CertificateInventory&) = delete;
+    CertificateInventory& operator=(const CertificateInventory&) = delete;
+
+    static CertificateInventory& instance() {
+        // Never destroyed: the index watcher thread may call update() until process exit
+        static CertificateInventory* inventory = new CertificateInventory();
+        return *inventory;
+    }
+
+    /**
+     * Per-certificate deadline for private key probes; applies to the next update
+     */
+    static void setProbeTimeout(std::chrono::milliseconds timeout) {
+        probeTimeoutMs() = (unsigned)timeout.count();
+    }
+
+    /**
+     * Ready-to-send /listCerts response body
+     */
+    std::shared_ptr<const InventoryResponse> currentResponse() {
+        auto published = std::atomic_load(&response);
+        if (published && currentFileTimeTicks() < published->expiresAt) {
+            return published;
+        }
+
+        // A validity boundary was crossed - re-assemble from the cached fragments
+        auto inventory = std::atomic_load(&snapshot);
+        if (!inventory) {
+            auto empty = std::make_shared<InventoryResponse>();
+            empty->body.raw("{\"result\":[]}");
+            empty->expiresAt = 0;
+            return empty;
+        }
+
+        auto rebuilt = serialize(inventory);
+        // Publish unless a refresher already replaced the inventory
+        if (!published || published->generation == rebuilt->generation) {
+            std::atomic_compare_exchange_strong(&response, &published,
+                                                std::shared_ptr<const InventoryResponse>(rebuilt));
+        }
+        return rebuilt;
+    }
+
+    InventoryStats stats() const {
+        InventoryStats result;
+        auto inventory = std::atomic_load(&snapshot);
+        if (inventory) {
+            result.generation = inventory->generation;
+            result.certificates = inventory->entries.size();
+            for (const auto& entry : inventory->entries) {
+                if (entry->keyStatus == KeyStatus::Present) result.withPrivateKey++;
+                if (entry->keyStatus == KeyStatus::Timeout) result.keyTimeouts++;
+            }
+        }
+        result.updates = updates;
+        result.processed = processed;
+        result.reused = reused;
+        result.serializations = serializations;
+        result.probes = prober.stats();
+        return result;
+    }
+};
+
+} // namespace Certificate
+} // namespace ArhintSigner
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "x509.h"
+#include "base64.h"
+#include "json_utils.h"
+
+namespace ArhintSigner {
+namespace Certificate {
+
+/**
+ * Name shown for a certificate subject: "Given Surname" or the common name,
+ * followed by the organization if there is one
+ */
+inline std::string displayName(const Der::Certificate& cert) {
+    std::string displayName;
+    std::string givenName = cert.subject.get(Der::Oid::givenName);
+    std::string surname = cert.subject.get(Der::Oid::surname);
+
+    if (!givenName.empty() && !surname.empty()) {
+        displayName = givenName + " " + surname;
+    } else {
+        std::string cn = cert.subject.get(Der::Oid::commonName);
+        displayName = !cn.empty() ? cn : cert.subject.simpleDisplayName();
+    }
+
+    std::string org = cert.subject.get(Der::Oid::organization);
+    if (!org.empty()) {
+        displayName += " (" + org + ")";
+    }
+    return displayName;
+}
+
+/**
+ * Serialize one certificate as a /listCerts JSON object
+ * Portable: everything but the thumbprint comes from the DER encoding.
+ */
+inline std::string listingJson(const Der::Certificate& cert, const std::string& thumbprint,
+                               bool hasPrivateKey, const char* keyStatus) {
+    std::string subject = cert.subject.toString();
+    std::string issuer = cert.issuer.simpleDisplayName();
+    std::string label = "Issued for: " + displayName(cert) + " | Issuer: " + issuer +
+                        " (expires " + cert.notAfter.toShortDate() + ")";
+
+    static constexpr Json::StaticKey labelKey("label");
+    static constexpr Json::StaticKey thumbprintKey("thumbprint");
+    static constexpr Json::StaticKey subjectKey("subject");
+    static constexpr Json::StaticKey issuerKey("issuer");
+    static constexpr Json::StaticKey notBeforeKey("notBefore");
+    static constexpr Json::StaticKey notAfterKey("notAfter");
+    static constexpr Json::StaticKey hasPrivateKeyKey("hasPrivateKey");
+    static constexpr Json::StaticKey keyStatusKey("keyStatus");
+    static constexpr Json::StaticKey certKey("cert");
+
+    // One buffer sized up front
+    Json::Writer certJson(Crypto::Base64::encodedLength(cert.der.size()) + label.size() + subject.size() +
+                          issuer.size() + 256);
+    certJson.beginObject();
+    certJson.key(labelKey).string(label);
+    certJson.key(thumbprintKey).string(thumbprint);
+    certJson.key(subjectKey).string(subject);
+    certJson.key(issuerKey).string(issuer);
+    certJson.key(notBeforeKey).string(cert.notBefore.toIso());
+    certJson.key(notAfterKey).string(cert.notAfter.toIso());
+    certJson.key(hasPrivateKeyKey).boolean(hasPrivateKey);
+    certJson.key(keyStatusKey).string(keyStatus);
+    certJson.key(certKey).string(Crypto::Base64::encode(cert.der.data(), cert.der.size()));
+    certJson.endObject();
+    return certJson.take();
+}
+
+/**
+ * Certificate as listed by a key store without a certificate inventory:
+ * its /listCerts object and validity
+ */
+struct ListingEntry {
+    Der::Time notBefore;
+    Der::Time notAfter;
+    std::string json;
+};
+
+/**
+ * /listCerts body over a fixed set of certificates
+ *
+ * Lists the entries that are valid now, as fragments referencing their
+ * json, and is rebuilt only when one of them expires or becomes valid.
+ * Entries must outlive the listing and every body it hands out.
+ */
+class CertificateListing {
+private:
+    struct Body {
+        bool expires = false;
+        Der::Time expiresAt;  // next notBefore/notAfter crossing
+        Json::Writer writer;
+    };
+
+    std::vector<const ListingEntry*> entries;
+    std::mutex mutex;
+    std::shared_ptr<const Body> cached;
+
+    std::shared_ptr<const Body> build(const Der::Time& now) const {
+        static constexpr Json::StaticKey resultKey("result");
+
+        auto body = std::make_shared<Body>();
+        body->writer.reserve(16 + entries.size(), entries.size());
+        body->writer.beginObject().key(resultKey).beginArray();
+        auto expireAt = [&body](const Der::Time& time) {
+            if (!body->expires || time < body->expiresAt) {
+                body->expires = true;
+                body->expiresAt = time;
+            }
+        };
+        for (const ListingEntry* entry : entries) {
+            if (now < entry->notBefore) {
+                // Not yet valid - the response changes when it becomes valid
+                expireAt(entry->notBefore);
+                continue;
+            }
+            if (!(now < entry->notAfter)) continue;
+            expireAt(entry->notAfter);
+            body->writer.fragment(entry->json);
+        }
+        body->writer.endArray().endObject();
+        return body;
+    }
+
+public:
+    /** Add a certificate to list; call before the first current() */
+    void add(const ListingEntry& entry) {
+        entries.push_back(&entry);
+    }
+
+    size_t size() const { return entries.size(); }
+
+    /** The body for the current time */
+    std::shared_ptr<const Json::Writer> current() {
+        Der::Time now = Der::Time::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!cached || (cached->expires && !(now < cached->expiresAt))) {
+            cached = build(now);
+        }
+        return std::shared_ptr<const Json::Writer>(cached, &cached->writer);
+    }
+};
+
+} // namespace Certificate
+} // namespace ArhintSigner
@@ -4,14 +4,18 @@
 #include <wincrypt.h>
 #include <ncrypt.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
-#include <regex>
 #include <algorithm>
-#include <iostream>
-#include "crypto_utils.h"
-#include "string_utils.h"
-#include "json_utils.h"
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <cstring>
+#include "logger.h"
+#include "metrics.h"
+#include "key_store.h"
+#include "certificate_listing.h"
 
 #pragma comment(lib, "crypt32.lib")
 #pragma comment(lib, "ncrypt.lib")
@@ -20,228 +24,197 @@ namespace ArhintSigner {
 namespace Certificate {
 
 /**
- * Get certificate name as a string
+ * Result of checking a certificate for a private key
  */
-inline std::string getCertNameString(PCCERT_CONTEXT certContext, DWORD type, DWORD flags = 0) {
-    DWORD size = CertGetNameStringA(certContext, type, flags, nullptr, nullptr, 0);
-    if (size <= 1) return "";
-    
-    std::vector<char> name(size);
-    CertGetNameStringA(certContext, type, flags, nullptr, name.data(), size);
-    return std::string(name.data());
+enum class KeyStatus {
+    Absent,   // no key, or the key is not usable
+    Present,
+    Timeout   // the token or CSP did not answer in time
+};
+
+inline const char* keyStatusName(KeyStatus status) {
+    switch (status) {
+        case KeyStatus::Present: return "present";
+        case KeyStatus::Timeout: return "timeout";
+        default: return "absent";
+    }
 }
 
 /**
- * List all valid certificates with private keys from the MY store
+ * Cheap check for a private key link: reads certificate properties only and
+ * never touches the token. A certificate without key provider info, a key
+ * context or a CNG key handle has no private key and needs no probe.
  */
-inline std::string listCertificates() {
-    std::ostringstream arrayBuilder;
-    arrayBuilder << "[";
-    bool firstCert = true;
-
-    HCERTSTORE hStore = CertOpenSystemStoreA(0, "MY");
-    if (!hStore) {
-        std::cerr << "Failed to open certificate store" << std::endl;
-        return "[]";
+inline bool hasKeyProperty(PCCERT_CONTEXT certContext) {
+    static const DWORD properties[] = {
+        CERT_KEY_PROV_INFO_PROP_ID,
+        CERT_KEY_CONTEXT_PROP_ID,
+        CERT_NCRYPT_KEY_HANDLE_PROP_ID
+    };
+    for (DWORD propertyId : properties) {
+        DWORD size = 0;
+        if (CertGetCertificateContextProperty(certContext, propertyId, nullptr, &size)) {
+            return true;
+        }
     }
+    return false;
+}
 
-    PCCERT_CONTEXT certContext = nullptr;
-    SYSTEMTIME currentTime;
-    GetSystemTime(&currentTime);
-    FILETIME currentFileTime;
-    SystemTimeToFileTime(&currentTime, &currentFileTime);
-
-    while ((certContext = CertEnumCertificatesInStore(hStore, certContext)) != nullptr) {
-        // Check if certificate has private key
-        DWORD keySpec = 0;
-        BOOL hasPrivateKey = FALSE;
-        BOOL freeProvOrKey = FALSE;
-        HCRYPTPROV_OR_NCRYPT_KEY_HANDLE hCryptProvOrNCryptKey = 0;
-
-        hasPrivateKey = CryptAcquireCertificatePrivateKey(
-            certContext, 
-            CRYPT_ACQUIRE_SILENT_FLAG | CRYPT_ACQUIRE_COMPARE_KEY_FLAG,
-            nullptr, 
-            &hCryptProvOrNCryptKey, 
-            &keySpec, 
-            &freeProvOrKey);
-
-        // Release cryptographic provider/key if acquired
-        if (freeProvOrKey && hCryptProvOrNCryptKey) {
-            if (keySpec == CERT_NCRYPT_KEY_SPEC) {
-                NCryptFreeObject(hCryptProvOrNCryptKey);
-            } else {
-                CryptReleaseContext(hCryptProvOrNCryptKey, 0);
-            }
-        }
+/**
+ * Check whether a certificate has a usable private key
+ * May touch the token or CSP that holds the key, and can therefore block.
+ */
+inline bool probePrivateKey(PCCERT_CONTEXT certContext) {
+    DWORD keySpec = 0;
+    BOOL hasPrivateKey = FALSE;
+    BOOL freeProvOrKey = FALSE;
+    HCRYPTPROV_OR_NCRYPT_KEY_HANDLE hCryptProvOrNCryptKey = 0;
 
-        // Skip certificates without private keys or that are not currently valid
-        if (!hasPrivateKey) continue;
-        if (CompareFileTime(&certContext->pCertInfo->NotAfter, &currentFileTime) <= 0) continue;
-        if (CompareFileTime(&certContext->pCertInfo->NotBefore, &currentFileTime) >= 0) continue;
-
-        try {
-            // Get subject and issuer
-            std::string subject = getCertNameString(certContext, CERT_NAME_SIMPLE_DISPLAY_TYPE);
-            std::string issuer = getCertNameString(certContext, CERT_NAME_SIMPLE_DISPLAY_TYPE, CERT_NAME_ISSUER_FLAG);
-            
-            // Get full DN string for parsing
-            DWORD subjectSize = CertNameToStrA(X509_ASN_ENCODING, &certContext->pCertInfo->Subject,
-                                               CERT_X500_NAME_STR, nullptr, 0);
-            std::vector<char> subjectDN(subjectSize);
-            CertNameToStrA(X509_ASN_ENCODING, &certContext->pCertInfo->Subject,
-                          CERT_X500_NAME_STR, subjectDN.data(), subjectSize);
-            
-            std::string subjectStr(subjectDN.data());
-            
-            // Parse subject for display name
-            std::string displayName;
-            std::string givenName = Utils::extractDNField(subjectStr, "G");
-            std::string surname = Utils::extractDNField(subjectStr, "SN");
-            
-            if (!givenName.empty() && !surname.empty()) {
-                displayName = givenName + " " + surname;
-            } else {
-                std::string cn = Utils::extractDNField(subjectStr, "CN");
-                displayName = !cn.empty() ? cn : subject;
-            }
-            
-            // Add organization if present
-            std::string org = Utils::extractDNField(subjectStr, "O");
-            if (!org.empty()) {
-                displayName += " (" + org + ")";
-            }
+    hasPrivateKey = CryptAcquireCertificatePrivateKey(
+        certContext, 
+        CRYPT_ACQUIRE_SILENT_FLAG | CRYPT_ACQUIRE_COMPARE_KEY_FLAG,
+        nullptr, 
+        &hCryptProvOrNCryptKey, 
+        &keySpec, 
+        &freeProvOrKey);
 
-            // Get thumbprint
-            BYTE thumbprint[20];
-            DWORD thumbprintSize = sizeof(thumbprint);
-            CertGetCertificateContextProperty(certContext, CERT_HASH_PROP_ID, 
-                                             thumbprint, &thumbprintSize);
-            
-            char thumbprintHex[41];
-            for (DWORD i = 0; i < thumbprintSize; i++) {
-                sprintf_s(thumbprintHex + (i * 2), 3, "%02X", thumbprint[i]);
-            }
-            std::string thumbprintStr(thumbprintHex);
-
-            // Get dates
-            std::string notBefore = Utils::fileTimeToISO(certContext->pCertInfo->NotBefore);
-            std::string notAfter = Utils::fileTimeToISO(certContext->pCertInfo->NotAfter);
-            std::string expiry = Utils::fileTimeToShortDate(certContext->pCertInfo->NotAfter);
-
-            // Encode certificate
-            std::string certB64 = Crypto::base64Encode(certContext->pbCertEncoded, 
-                                                       certContext->cbCertEncoded);
-
-            // Build label
-            std::string label = "Issued for: " + displayName + " | Issuer: " + issuer + 
-                              " (expires " + expiry + ")";
-
-            // Build JSON object for this certificate
-            Json::Builder certJson;
-            certJson.addString("label", label);
-            certJson.addString("thumbprint", thumbprintStr);
-            certJson.addString("subject", subjectStr);
-            certJson.addString("issuer", issuer);
-            certJson.addString("notBefore", notBefore);
-            certJson.addString("notAfter", notAfter);
-            certJson.addBool("hasPrivateKey", true);
-            certJson.addString("cert", certB64);
-
-            if (!firstCert) arrayBuilder << ",";
-            arrayBuilder << certJson.toString();
-            firstCert = false;
-        }
-        catch (...) {
-            std::cerr << "Error processing certificate" << std::endl;
+    // Release cryptographic provider/key if acquired
+    if (freeProvOrKey && hCryptProvOrNCryptKey) {
+        if (keySpec == CERT_NCRYPT_KEY_SPEC) {
+            NCryptFreeObject(hCryptProvOrNCryptKey);
+        } else {
+            CryptReleaseContext(hCryptProvOrNCryptKey, 0);
         }
     }
 
-    CertCloseStore(hStore, 0);
-    arrayBuilder << "]";
-    return arrayBuilder.str();
+    return hasPrivateKey != FALSE;
 }
 
 /**
- * Sign a hash using a certificate identified by thumbprint
+ * Serialize one certificate as a /listCerts JSON object
  */
-inline std::string signHash(const std::string& hashB64Input, const std::string& thumbprintInput) {
-    // Trim whitespace from inputs
-    std::string hashB64 = Utils::trim(hashB64Input);
-    std::string thumbprint = Utils::trim(thumbprintInput);
+inline std::string certificateToJson(PCCERT_CONTEXT certContext, KeyStatus keyStatus = KeyStatus::Present) {
+    Der::Certificate cert;
+    Der::parse(std::string_view((const char*)certContext->pbCertEncoded, certContext->cbCertEncoded), cert);
+
+    // Get thumbprint
+    BYTE thumbprint[20];
+    DWORD thumbprintSize = sizeof(thumbprint);
+    CertGetCertificateContextProperty(certContext, CERT_HASH_PROP_ID, 
+                                     thumbprint, &thumbprintSize);
     
-    // Validate inputs
-    if (hashB64.empty()) {
-        throw std::runtime_error("Hash is required and must be a string");
-    }
-    if (thumbprint.empty()) {
-        throw std::runtime_error("Thumbprint is required and must be a string");
+    char thumbprintHex[41];
+    for (DWORD i = 0; i < thumbprintSize; i++) {
+        sprintf_s(thumbprintHex + (i * 2), 3, "%02X", thumbprint[i]);
     }
+    std::string thumbprintStr(thumbprintHex);
 
-    // Validate base64 format
-    std::regex base64Regex("^[A-Za-z0-9+/]*={0,2}$");
-    if (!std::regex_match(hashB64, base64Regex)) {
-        std::string error = "Hash must be valid base64 encoded string. Received: '" + hashB64 + 
-                          "' (length: " + std::to_string(hashB64.length()) + ")";
-        std::cerr << error << std::endl;
-        throw std::runtime_error(error);
-    }
+    return listingJson(cert, thumbprintStr, keyStatus == KeyStatus::Present, keyStatusName(keyStatus));
+}
 
-    // Decode hash
-    std::vector<BYTE> hashBytes = Crypto::base64Decode(hashB64);
-    if (hashBytes.empty()) {
-        throw std::runtime_error("Invalid base64 hash - unable to decode");
-    }
-    
-    // Validate hash length (SHA-256 = 32 bytes, SHA-1 = 20 bytes, SHA-512 = 64 bytes)
-    if (hashBytes.size() != 32 && hashBytes.size() != 20 && hashBytes.size() != 64) {
-        std::string error = "Invalid hash length: " + std::to_string(hashBytes.size()) + 
-                          " bytes. Expected 20 (SHA-1), 32 (SHA-256), or 64 (SHA-512) bytes";
-        throw std::runtime_error(error);
+/**
+ * Look up the device of an acquired key from its provider's properties
+ */
+inline Keys::KeyDevice describeKeyDevice(HCRYPTPROV_OR_NCRYPT_KEY_HANDLE handle, DWORD keySpec) {
+    Keys::KeyDevice device;
+    DWORD implType = 0;
+    DWORD size = 0;
+
+    if (keySpec == CERT_NCRYPT_KEY_SPEC) {
+        if (NCryptGetProperty(handle, NCRYPT_IMPL_TYPE_PROPERTY, (PBYTE)&implType, sizeof(implType), &size, 0) == 0) {
+            device.hardware = (implType & (NCRYPT_IMPL_HARDWARE_FLAG | NCRYPT_IMPL_REMOVABLE_FLAG)) != 0;
+        }
+        wchar_t reader[256];
+        if (NCryptGetProperty(handle, NCRYPT_READER_PROPERTY, (PBYTE)reader, sizeof(reader), &size, 0) == 0) {
+            // Reader names are ASCII in practice; the name is only an identifier
+            for (size_t i = 0; i < size / sizeof(wchar_t) && reader[i]; i++) {
+                device.name += reader[i] < 0x80 ? (char)reader[i] : '?';
+            }
+        }
+    } else {
+        size = sizeof(implType);
+        if (CryptGetProvParam(handle, PP_IMPTYPE, (BYTE*)&implType, &size, 0)) {
+            device.hardware = (implType & (CRYPT_IMPL_HARDWARE | CRYPT_IMPL_REMOVABLE)) != 0;
+        }
+        char reader[256];
+        size = sizeof(reader);
+        if (CryptGetProvParam(handle, PP_SMARTCARD_READER, (BYTE*)reader, &size, 0) && size > 0) {
+            device.name.assign(reader, strnlen(reader, size));
+        }
     }
+    return device;
+}
 
-    // Open certificate store
-    HCERTSTORE hStore = CertOpenSystemStoreA(0, "MY");
-    if (!hStore) {
-        throw std::runtime_error("Failed to open certificate store");
+/**
+ * Private key acquired for a certificate
+ * Owns a duplicate of the certificate context and, when CryptoAPI hands over
+ * ownership, the CNG key or legacy CSP handle.
+ */
+class AcquiredKey : public Keys::SigningKey {
+private:
+    PCCERT_CONTEXT certContext;
+    HCRYPTPROV_OR_NCRYPT_KEY_HANDLE handle;
+    DWORD keySpec;
+    BOOL freeHandle;
+
+public:
+    AcquiredKey(PCCERT_CONTEXT cert, HCRYPTPROV_OR_NCRYPT_KEY_HANDLE keyHandle, DWORD spec, BOOL ownsHandle)
+        : certContext(CertDuplicateCertificateContext(cert))
+        , handle(keyHandle)
+        , keySpec(spec)
+        , freeHandle(ownsHandle) {
     }
 
-    // Find certificate by thumbprint
-    CRYPT_HASH_BLOB hashBlob;
-    BYTE thumbprintBytes[20];
-    
-    // Security: Validate thumbprint length before conversion
-    if (thumbprint.length() != 40) {
-        CertCloseStore(hStore, 0);
-        throw std::runtime_error("Invalid thumbprint length (expected 40 hex characters)");
-    }
-    
-    // Convert hex string to bytes with bounds checking
-    for (size_t i = 0; i < 20; i++) {
-        int result = sscanf_s(thumbprint.c_str() + (i * 2), "%2hhx", &thumbprintBytes[i]);
-        if (result != 1) {
-            CertCloseStore(hStore, 0);
-            throw std::runtime_error("Invalid thumbprint format (must be hex)");
+    ~AcquiredKey() override {
+        if (freeHandle && handle) {
+            if (keySpec == CERT_NCRYPT_KEY_SPEC) {
+                NCryptFreeObject(handle);
+            } else {
+                CryptReleaseContext(handle, 0);
+            }
+        }
+        if (certContext) {
+            CertFreeCertificateContext(certContext);
         }
     }
-    
-    hashBlob.cbData = 20;
-    hashBlob.pbData = thumbprintBytes;
-
-    PCCERT_CONTEXT certContext = CertFindCertificateInStore(
-        hStore,
-        X509_ASN_ENCODING | PKCS_7_ASN_ENCODING,
-        0,
-        CERT_FIND_HASH,
-        &hashBlob,
-        nullptr);
-
-    if (!certContext) {
-        CertCloseStore(hStore, 0);
-        throw std::runtime_error("Certificate not found");
+
+    HCRYPTPROV_OR_NCRYPT_KEY_HANDLE getHandle() const { return handle; }
+    DWORD getKeySpec() const { return keySpec; }
+    bool isCng() const { return keySpec == CERT_NCRYPT_KEY_SPEC; }
+    PCCERT_CONTEXT getCertificate() const { return certContext; }
+
+    Metrics::SignApi api() const override {
+        return isCng() ? Metrics::SignApi::Cng : Metrics::SignApi::Legacy;
+    }
+
+    size_t sign(const Crypto::SignatureAlgorithm& algorithm, const uint8_t* hash, size_t hashLength,
+                uint8_t* out, size_t capacity) const override;
+};
+
+/**
+ * Check whether a CNG/CryptoAPI error means the key or its token went away
+ */
+inline bool isKeyUnavailableError(DWORD status) {
+    switch (status) {
+        case (DWORD)NTE_BAD_KEYSET:
+        case (DWORD)NTE_BAD_KEY:
+        case (DWORD)NTE_INVALID_HANDLE:
+        case (DWORD)NTE_DEVICE_NOT_READY:
+        case (DWORD)SCARD_W_REMOVED_CARD:
+        case (DWORD)SCARD_W_RESET_CARD:
+        case (DWORD)SCARD_E_NO_SMARTCARD:
+        case (DWORD)SCARD_E_READER_UNAVAILABLE:
+            return true;
+        default:
+            return false;
     }
+}
 
-    // Get private key
+/**
+ * Acquire the private key of a certificate
+ * thumbprint names the key's device when it is not on a smartcard.
+ */
+inline std::shared_ptr<AcquiredKey> loadKey(PCCERT_CONTEXT certContext, const std::string& thumbprint) {
     DWORD keySpec = 0;
     BOOL freeProvOrKey = FALSE;
     HCRYPTPROV_OR_NCRYPT_KEY_HANDLE hCryptProvOrNCryptKey = 0;
@@ -255,129 +228,175 @@ inline std::string signHash(const std::string& hashB64Input, const std::string&
         &freeProvOrKey);
 
     if (!hasPrivateKey) {
-        CertFreeCertificateContext(certContext);
-        CertCloseStore(hStore, 0);
         throw std::runtime_error("Certificate has no private key");
     }
-    
-    std::cout << "Key spec: " << (keySpec == CERT_NCRYPT_KEY_SPEC ? "CNG" : "Legacy") 
-              << " (" << keySpec << ")" << std::endl;
 
-    std::string signatureB64;
-    
-    try {
-        if (keySpec == CERT_NCRYPT_KEY_SPEC) {
-            // Use CNG (Cryptography Next Generation) API
-            std::cout << "Using CNG API for signing" << std::endl;
-            BCRYPT_PKCS1_PADDING_INFO paddingInfo;
-            paddingInfo.pszAlgId = BCRYPT_SHA256_ALGORITHM;
-
-            DWORD signatureSize = 0;
-            NTSTATUS status = NCryptSignHash(
-                hCryptProvOrNCryptKey,
-                &paddingInfo,
-                hashBytes.data(),
-                (DWORD)hashBytes.size(),
-                nullptr,
-                0,
-                &signatureSize,
-                BCRYPT_PAD_PKCS1);
-
-            if (status != 0) {
-                std::cerr << "NCryptSignHash (get size) failed with status: 0x" 
-                         << std::hex << status << std::dec << std::endl;
-                if (status == 0x80090027) { // NTE_BAD_DATA
-                    throw std::runtime_error("Invalid hash data - hash may be corrupted or wrong length for algorithm");
-                }
-                throw std::runtime_error("Failed to get signature size (status: 0x" + 
-                                       std::to_string(status) + ")");
-            }
+    auto key = std::make_shared<AcquiredKey>(certContext, hCryptProvOrNCryptKey, keySpec, freeProvOrKey);
+    Keys::KeyDevice device = describeKeyDevice(hCryptProvOrNCryptKey, keySpec);
+    if (device.name.empty()) device.name = thumbprint;
+    key->setDevice(std::move(device));
+    return key;
+}
 
-            std::vector<BYTE> signature(signatureSize);
-            status = NCryptSignHash(
-                hCryptProvOrNCryptKey,
-                &paddingInfo,
-                hashBytes.data(),
-                (DWORD)hashBytes.size(),
-                signature.data(),
-                signatureSize,
-                &signatureSize,
-                BCRYPT_PAD_PKCS1);
-
-            if (status != 0) {
-                std::cerr << "NCryptSignHash failed with status: 0x" 
-                         << std::hex << status << std::dec << std::endl;
-                if (status == 0x80090027) { // NTE_BAD_DATA
-                    throw std::runtime_error("Invalid hash data - hash may be corrupted or wrong length for algorithm");
-                }
-                throw std::runtime_error("Failed to sign hash (status: 0x" + 
-                                       std::to_string(status) + ")");
-            }
+/**
+ * CNG and CryptoAPI identifiers of a hash
+ */
+inline LPCWSTR cngHashAlgorithm(Crypto::HashAlgorithm hash) {
+    switch (hash) {
+        case Crypto::HashAlgorithm::Sha1: return BCRYPT_SHA1_ALGORITHM;
+        case Crypto::HashAlgorithm::Sha384: return BCRYPT_SHA384_ALGORITHM;
+        case Crypto::HashAlgorithm::Sha512: return BCRYPT_SHA512_ALGORITHM;
+        default: return BCRYPT_SHA256_ALGORITHM;
+    }
+}
+
+inline ALG_ID legacyHashAlgorithm(Crypto::HashAlgorithm hash) {
+    switch (hash) {
+        case Crypto::HashAlgorithm::Sha1: return CALG_SHA1;
+        case Crypto::HashAlgorithm::Sha384: return CALG_SHA_384;
+        case Crypto::HashAlgorithm::Sha512: return CALG_SHA_512;
+        default: return CALG_SHA_256;
+    }
+}
 
-            signatureB64 = Crypto::base64Encode(signature.data(), signatureSize);
+/**
+ * Sign a raw hash with an acquired key into signature (capacity bytes),
+ * returning the signature length. CNG keys sign every algorithm (ECDSA
+ * signatures come back as raw r || s); legacy CryptoAPI keys only sign
+ * with RSA PKCS#1 v1.5.
+ */
+inline DWORD signWithKey(const AcquiredKey& key, const Crypto::SignatureAlgorithm& algorithm,
+                         const BYTE* hashBytes, DWORD hashLength, BYTE* signature, DWORD capacity) {
+    HCRYPTPROV_OR_NCRYPT_KEY_HANDLE hCryptProvOrNCryptKey = key.getHandle();
+    DWORD keySpec = key.getKeySpec();
+
+    Log::debug("Key spec: ", (keySpec == CERT_NCRYPT_KEY_SPEC ? "CNG" : "Legacy"), " (", keySpec, ")");
+
+    if (keySpec == CERT_NCRYPT_KEY_SPEC) {
+        // Use CNG (Cryptography Next Generation) API
+        Log::debug("Using CNG API for signing");
+        BCRYPT_PKCS1_PADDING_INFO pkcs1Info;
+        pkcs1Info.pszAlgId = cngHashAlgorithm(algorithm.hash);
+        BCRYPT_PSS_PADDING_INFO pssInfo;
+        pssInfo.pszAlgId = pkcs1Info.pszAlgId;
+        pssInfo.cbSalt = (ULONG)algorithm.hashInfo().length;
+        void* paddingInfo = nullptr;
+        DWORD flags = 0;
+        if (algorithm.scheme == Crypto::Scheme::RsaPkcs1) {
+            paddingInfo = &pkcs1Info;
+            flags = BCRYPT_PAD_PKCS1;
+        } else if (algorithm.scheme == Crypto::Scheme::RsaPss) {
+            paddingInfo = &pssInfo;
+            flags = BCRYPT_PAD_PSS;
         }
-        else {
-            // Use legacy CryptoAPI
-            std::cout << "Using legacy CryptoAPI for signing" << std::endl;
-            HCRYPTHASH hHash;
-            if (!CryptCreateHash(hCryptProvOrNCryptKey, CALG_SHA_256, 0, 0, &hHash)) {
-                DWORD error = GetLastError();
-                std::cerr << "CryptCreateHash failed with error: " << error << std::endl;
-                throw std::runtime_error("Failed to create hash object. Error: " + 
-                                       std::to_string(error));
-            }
 
-            if (!CryptSetHashParam(hHash, HP_HASHVAL, hashBytes.data(), 0)) {
-                DWORD error = GetLastError();
-                CryptDestroyHash(hHash);
-                std::cerr << "CryptSetHashParam failed with error: " << error << std::endl;
-                throw std::runtime_error("Failed to set hash value");
+        DWORD signatureSize = 0;
+        NTSTATUS status = NCryptSignHash(
+            hCryptProvOrNCryptKey,
+            paddingInfo,
+            (PBYTE)hashBytes,
+            hashLength,
+            nullptr,
+            0,
+            &signatureSize,
+            flags);
+
+        if (status != 0) {
+            Log::error("NCryptSignHash (get size) failed with status: ", Log::hex((uint32_t)status));
+            if (isKeyUnavailableError((DWORD)status)) {
+                throw Keys::KeyUnavailableError("Private key is no longer available");
             }
-
-            DWORD signatureSize = 0;
-            if (!CryptSignHashA(hHash, keySpec, nullptr, 0, nullptr, &signatureSize)) {
-                CryptDestroyHash(hHash);
-                throw std::runtime_error("Failed to get signature size");
+            if (status == 0x80090027) { // NTE_BAD_DATA
+                throw std::runtime_error("Invalid hash data - hash may be corrupted or wrong length for algorithm");
             }
+            throw std::runtime_error("Failed to get signature size (status: 0x" + 
+                                   std::to_string(status) + ")");
+        }
+        if (signatureSize > capacity) {
+            throw std::runtime_error("Signature too large (" + std::to_string(signatureSize) + " bytes)");
+        }
 
-            std::vector<BYTE> signature(signatureSize);
-            if (!CryptSignHashA(hHash, keySpec, nullptr, 0, signature.data(), &signatureSize)) {
-                CryptDestroyHash(hHash);
-                throw std::runtime_error("Failed to sign hash");
+        status = NCryptSignHash(
+            hCryptProvOrNCryptKey,
+            paddingInfo,
+            (PBYTE)hashBytes,
+            hashLength,
+            signature,
+            signatureSize,
+            &signatureSize,
+            flags);
+
+        if (status != 0) {
+            Log::error("NCryptSignHash failed with status: ", Log::hex((uint32_t)status));
+            if (isKeyUnavailableError((DWORD)status)) {
+                throw Keys::KeyUnavailableError("Private key is no longer available");
+            }
+            if (status == 0x80090027) { // NTE_BAD_DATA
+                throw std::runtime_error("Invalid hash data - hash may be corrupted or wrong length for algorithm");
             }
+            throw std::runtime_error("Failed to sign hash (status: 0x" + 
+                                   std::to_string(status) + ")");
+        }
 
-            CryptDestroyHash(hHash);
+        return signatureSize;
+    }
 
-            // Reverse byte order (CryptoAPI returns little-endian)
-            std::reverse(signature.begin(), signature.end());
-            signatureB64 = Crypto::base64Encode(signature.data(), signatureSize);
+    // Use legacy CryptoAPI
+    Log::debug("Using legacy CryptoAPI for signing");
+    if (algorithm.scheme != Crypto::Scheme::RsaPkcs1) {
+        throw std::runtime_error("Invalid algorithm: legacy CryptoAPI keys only sign with RSA PKCS#1 v1.5");
+    }
+    HCRYPTHASH hHash;
+    if (!CryptCreateHash(hCryptProvOrNCryptKey, legacyHashAlgorithm(algorithm.hash), 0, 0, &hHash)) {
+        DWORD error = GetLastError();
+        Log::error("CryptCreateHash failed with error: ", error);
+        if (isKeyUnavailableError(error)) {
+            throw Keys::KeyUnavailableError("Private key is no longer available");
         }
+        throw std::runtime_error("Failed to create hash object. Error: " + 
+                               std::to_string(error));
     }
-    catch (...) {
-        if (freeProvOrKey && hCryptProvOrNCryptKey) {
-            if (keySpec == CERT_NCRYPT_KEY_SPEC) {
-                NCryptFreeObject(hCryptProvOrNCryptKey);
-            } else {
-                CryptReleaseContext(hCryptProvOrNCryptKey, 0);
-            }
+
+    if (!CryptSetHashParam(hHash, HP_HASHVAL, hashBytes, 0)) {
+        DWORD error = GetLastError();
+        CryptDestroyHash(hHash);
+        Log::error("CryptSetHashParam failed with error: ", error);
+        throw std::runtime_error("Failed to set hash value");
+    }
+
+    DWORD signatureSize = 0;
+    if (!CryptSignHashA(hHash, keySpec, nullptr, 0, nullptr, &signatureSize)) {
+        DWORD error = GetLastError();
+        CryptDestroyHash(hHash);
+        if (isKeyUnavailableError(error)) {
+            throw Keys::KeyUnavailableError("Private key is no longer available");
         }
-        CertFreeCertificateContext(certContext);
-        CertCloseStore(hStore, 0);
-        throw;
+        throw std::runtime_error("Failed to get signature size");
+    }
+    if (signatureSize > capacity) {
+        CryptDestroyHash(hHash);
+        throw std::runtime_error("Signature too large (" + std::to_string(signatureSize) + " bytes)");
     }
 
-    if (freeProvOrKey && hCryptProvOrNCryptKey) {
-        if (keySpec == CERT_NCRYPT_KEY_SPEC) {
-            NCryptFreeObject(hCryptProvOrNCryptKey);
-        } else {
-            CryptReleaseContext(hCryptProvOrNCryptKey, 0);
+    if (!CryptSignHashA(hHash, keySpec, nullptr, 0, signature, &signatureSize)) {
+        DWORD error = GetLastError();
+        CryptDestroyHash(hHash);
+        if (isKeyUnavailableError(error)) {
+            throw Keys::KeyUnavailableError("Private key is no longer available");
         }
+        throw std::runtime_error("Failed to sign hash");
     }
 
-    CertFreeCertificateContext(certContext);
-    CertCloseStore(hStore, 0);
+    CryptDestroyHash(hHash);
+
+    // Reverse byte order (CryptoAPI returns little-endian)
+    std::reverse(signature, signature + signatureSize);
+    return signatureSize;
+}
 
-    return signatureB64;
+inline size_t AcquiredKey::sign(const Crypto::SignatureAlgorithm& algorithm, const uint8_t* hash,
+                                size_t hashLength, uint8_t* out, size_t capacity) const {
+    return signWithKey(*this, algorithm, hash, (DWORD)hashLength, out, (DWORD)capacity);
 }
 
 } // namespace Certificate
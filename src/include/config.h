@@ -0,0 +1,223 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+
+namespace ArhintSigner {
+namespace Config {
+
+/**
+ * Runtime options parsed from the command line
+ *
+ * Usage: arhint-signer.exe [port] [--workers N] [--receives N] [--request-workers N]
+ *                          [--key-cache-size N] [--key-cache-ttl SECONDS]
+ *                          [--key-probe-timeout MS] [--batch-max-bytes N]
+ *                          [--merkle-max-items N] [--merkle-max-wait MS]
+ *                          [--log-level LEVEL] [--log-file PATH] [--log-rate N]
+ *                          [--signature-cache-size N] [--signature-cache-ttl MS]
+ *                          [--token-concurrency N] [--software-key-concurrency N]
+ *                          [--sign-concurrency N] [--key-queue-limit N]
+ *                          [--max-queue-delay MS] [--target-queue-delay MS]
+ *                          [--key-dir PATH] [--pkcs11-module PATH]
+ *                          [--pkcs11-pin PIN] [--pkcs11-sessions N]
+ *                          [--presign-depth N] [--presign-rate N]
+ *                          [--document-max-bytes N]
+ */
+struct Options {
+    int port = 8082;
+    unsigned workers = 0;             // 0 = process requests inline on the receive thread
+    unsigned outstandingReceives = 0; // 0 = two per worker
+    unsigned requestWorkers = 0;      // epoll: threads for signing, listing and uploads, 0 = two per worker, at least 4
+    unsigned keyCacheSize = 32;       // acquired private keys kept open, 0 = disabled
+    unsigned keyCacheTtlSeconds = 300;
+    unsigned keyProbeTimeoutMs = 2000; // deadline for all private key probes of one update
+    unsigned batchMaxBytes = 1048576;  // /signBatch and /signMerkle request body limit
+    unsigned documentMaxBytes = 1073741824; // /signDocument upload limit (streamed, not buffered)
+    unsigned merkleMaxItems = 256;     // hashes per Merkle root signature
+    unsigned merkleMaxWaitMs = 50;     // longest wait for a Merkle batch to fill
+    std::string logLevel = "info";     // trace, debug, info, warn, error or off
+    std::string logFile;               // empty = console
+    unsigned logRate = 1000;           // messages per thread and second, 0 = unlimited
+    unsigned signatureCacheSize = 0;   // recent /sign results kept, 0 = disabled (also disables coalescing)
+    unsigned signatureCacheTtlMs = 10000;
+    unsigned tokenConcurrency = 1;       // operations at once per smartcard / hardware token
+    unsigned softwareKeyConcurrency = 4; // operations at once per software key
+    unsigned signConcurrency = 0;        // operations at once across all keys, 0 = unlimited
+    unsigned keyQueueLimit = 0;          // waiting operations per key, 0 = half the threads signing requests run on
+    unsigned maxQueueDelayMs = 1000;     // reject requests that waited longer for a worker, 0 = no admission control
+    unsigned targetQueueDelayMs = 50;    // lower the concurrency limit when requests wait longer on average
+    std::string keyDirectory;            // PEM certificates and keys to sign with instead of the system store
+    std::string pkcs11Module;            // PKCS#11 library to sign with instead of the system store
+    std::string pkcs11Pin;               // user PIN for its tokens, default ARHINT_PKCS11_PIN
+    unsigned pkcs11Sessions = 4;         // logged-in sessions (parallel signatures) per token
+    unsigned presignDepth = 32;          // ECDSA presignatures kept per software EC key, 0 = disabled
+    unsigned presignRate = 500;          // presignatures produced per second, 0 = unlimited
+};
+
+/**
+ * Default worker count: one per logical CPU, capped to keep the footprint small
+ */
+inline unsigned defaultWorkerCount() {
+    unsigned cpus = std::thread::hardware_concurrency();
+    if (cpus == 0) cpus = 2;
+    return cpus > 16 ? 16 : cpus;
+}
+
+/**
+ * Parse an unsigned option value, returning fallback when invalid or out of range
+ */
+inline unsigned parseCount(const std::string& value, unsigned fallback, unsigned maxValue) {
+    char* end = nullptr;
+    long parsed = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || parsed < 0 || parsed > (long)maxValue) {
+        return fallback;
+    }
+    return (unsigned)parsed;
+}
+
+/**
+ * Split a raw Windows command line (WinMain lpCmdLine) into arguments
+ */
+inline std::vector<std::string> splitCommandLine(const char* cmdLine) {
+    std::vector<std::string> args;
+    if (!cmdLine) return args;
+
+    std::string current;
+    bool inQuotes = false;
+    bool hasToken = false;
+    for (const char* p = cmdLine; *p; ++p) {
+        char c = *p;
+        if (c == '"') {
+            inQuotes = !inQuotes;
+            hasToken = true;
+        } else if ((c == ' ' || c == '\t') && !inQuotes) {
+            if (hasToken) {
+                args.push_back(current);
+                current.clear();
+                hasToken = false;
+            }
+        } else {
+            current += c;
+            hasToken = true;
+        }
+    }
+    if (hasToken) args.push_back(current);
+    return args;
+}
+
+/**
+ * Parse command line arguments (program name excluded)
+ * Accepts both "--name value" and "--name=value"
+ */
+inline Options parseArguments(const std::vector<std::string>& args) {
+    Options options;
+    options.workers = defaultWorkerCount();
+
+    for (size_t i = 0; i < args.size(); i++) {
+        std::string arg = args[i];
+        std::string value;
+
+        if (arg.rfind("--", 0) == 0) {
+            size_t eq = arg.find('=');
+            if (eq != std::string::npos) {
+                value = arg.substr(eq + 1);
+                arg = arg.substr(0, eq);
+            } else if (i + 1 < args.size()) {
+                value = args[++i];
+            }
+
+            if (arg == "--workers") {
+                options.workers = parseCount(value, options.workers, 256);
+            } else if (arg == "--receives") {
+                options.outstandingReceives = parseCount(value, options.outstandingReceives, 1024);
+            } else if (arg == "--request-workers") {
+                options.requestWorkers = parseCount(value, options.requestWorkers, 1024);
+            } else if (arg == "--key-cache-size") {
+                options.keyCacheSize = parseCount(value, options.keyCacheSize, 4096);
+            } else if (arg == "--key-cache-ttl") {
+                options.keyCacheTtlSeconds = parseCount(value, options.keyCacheTtlSeconds, 86400);
+            } else if (arg == "--key-probe-timeout") {
+                options.keyProbeTimeoutMs = parseCount(value, options.keyProbeTimeoutMs, 60000);
+            } else if (arg == "--batch-max-bytes") {
+                options.batchMaxBytes = parseCount(value, options.batchMaxBytes, 16777216);
+            } else if (arg == "--document-max-bytes") {
+                options.documentMaxBytes = parseCount(value, options.documentMaxBytes, 2147483647);
+            } else if (arg == "--merkle-max-items") {
+                options.merkleMaxItems = parseCount(value, options.merkleMaxItems, 65536);
+                if (options.merkleMaxItems == 0) options.merkleMaxItems = 1;
+            } else if (arg == "--merkle-max-wait") {
+                options.merkleMaxWaitMs = parseCount(value, options.merkleMaxWaitMs, 10000);
+            } else if (arg == "--log-level") {
+                options.logLevel = value;
+            } else if (arg == "--log-file") {
+                options.logFile = value;
+            } else if (arg == "--key-dir") {
+                options.keyDirectory = value;
+            } else if (arg == "--pkcs11-module") {
+                options.pkcs11Module = value;
+            } else if (arg == "--pkcs11-pin") {
+                options.pkcs11Pin = value;
+            } else if (arg == "--pkcs11-sessions") {
+                options.pkcs11Sessions = parseCount(value, options.pkcs11Sessions, 256);
+                if (options.pkcs11Sessions == 0) options.pkcs11Sessions = 1;
+            } else if (arg == "--presign-depth") {
+                options.presignDepth = parseCount(value, options.presignDepth, 65536);
+            } else if (arg == "--presign-rate") {
+                options.presignRate = parseCount(value, options.presignRate, 1000000);
+            } else if (arg == "--log-rate") {
+                options.logRate = parseCount(value, options.logRate, 1000000);
+            } else if (arg == "--signature-cache-size") {
+                options.signatureCacheSize = parseCount(value, options.signatureCacheSize, 1000000);
+            } else if (arg == "--signature-cache-ttl") {
+                options.signatureCacheTtlMs = parseCount(value, options.signatureCacheTtlMs, 3600000);
+            } else if (arg == "--token-concurrency") {
+                options.tokenConcurrency = parseCount(value, options.tokenConcurrency, 64);
+                if (options.tokenConcurrency == 0) options.tokenConcurrency = 1;
+            } else if (arg == "--software-key-concurrency") {
+                options.softwareKeyConcurrency = parseCount(value, options.softwareKeyConcurrency, 256);
+                if (options.softwareKeyConcurrency == 0) options.softwareKeyConcurrency = 1;
+            } else if (arg == "--sign-concurrency") {
+                options.signConcurrency = parseCount(value, options.signConcurrency, 256);
+            } else if (arg == "--key-queue-limit") {
+                options.keyQueueLimit = parseCount(value, options.keyQueueLimit, 4096);
+            } else if (arg == "--max-queue-delay") {
+                options.maxQueueDelayMs = parseCount(value, options.maxQueueDelayMs, 600000);
+            } else if (arg == "--target-queue-delay") {
+                options.targetQueueDelayMs = parseCount(value, options.targetQueueDelayMs, 60000);
+            }
+            continue;
+        }
+
+        // Positional argument: port
+        int port = atoi(arg.c_str());
+        options.port = (port <= 0 || port > 65535) ? 8082 : port;
+    }
+
+    if (options.outstandingReceives == 0) {
+        options.outstandingReceives = options.workers > 0 ? options.workers * 2 : 1;
+    }
+    if (options.pkcs11Pin.empty()) {
+        // Keeps the PIN out of the process command line
+        const char* pin = std::getenv("ARHINT_PKCS11_PIN");
+        if (pin) options.pkcs11Pin = pin;
+    }
+    if (options.requestWorkers == 0) {
+        options.requestWorkers = options.workers > 2 ? options.workers * 2 : 4;
+    }
+    if (options.keyQueueLimit == 0) {
+        // Waiters hold the thread their request runs on: an HTTP.sys worker, or an
+        // epoll request worker (reactors never wait); leave the rest for other keys
+#ifdef _WIN32
+        unsigned signingThreads = options.workers;
+#else
+        unsigned signingThreads = options.requestWorkers;
+#endif
+        options.keyQueueLimit = signingThreads > 2 ? signingThreads / 2 : 1;
+    }
+    return options;
+}
+
+} // namespace Config
+} // namespace ArhintSigner
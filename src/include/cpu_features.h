@@ -0,0 +1,63 @@
+#pragma once
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define ARHINT_CPU_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace ArhintSigner {
+namespace Cpu {
+
+/**
+ * Instruction set extensions usable by this process
+ */
+struct Features {
+    bool ssse3 = false;
+    bool avx2 = false;  // also requires the OS to save YMM state
+    bool sha = false;   // SHA-NI (SHA-1 / SHA-256 rounds), together with SSE4.1
+};
+
+inline Features detectFeatures() {
+    Features result;
+#ifdef ARHINT_CPU_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    result.ssse3 = (info[2] & (1 << 9)) != 0;
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        result.avx2 = osSavesYmm && (info[1] & (1 << 5)) != 0;
+        result.sha = sse41 && (info[1] & (1 << 29)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    result.ssse3 = __builtin_cpu_supports("ssse3") != 0;
+    result.avx2 = __builtin_cpu_supports("avx2") != 0;
+    result.sha = __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#endif
+#endif
+    return result;
+}
+
+/** Features of the current CPU, detected once */
+inline const Features& features() {
+    static const Features detected = detectFeatures();
+    return detected;
+}
+
+} // namespace Cpu
+} // namespace ArhintSigner
+
+// Lets a function use instructions beyond the compiler's baseline (GCC/Clang);
+// MSVC allows the intrinsics without it. Callers check Cpu::features() first.
+#if defined(ARHINT_CPU_X86) && !defined(_MSC_VER)
+#define ARHINT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ARHINT_TARGET(isa)
+#endif
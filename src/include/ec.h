@@ -0,0 +1,629 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "x509.h"
+#include "bignum.h"
+#include "sha2.h"
+#include "random.h"
+#include "signature_algorithm.h"
+
+namespace ArhintSigner {
+namespace Crypto {
+namespace Ec {
+
+using Bignum::Limb;
+
+/** Largest curve (P-384) in limbs and bytes */
+constexpr size_t MAX_LIMBS = 6;
+constexpr size_t MAX_BYTES = 48;
+
+/** Projective point (X:Y:Z) with coordinates in Montgomery form; the identity is (0:1:0) */
+struct Point {
+    Limb x[MAX_LIMBS];
+    Limb y[MAX_LIMBS];
+    Limb z[MAX_LIMBS];
+};
+
+/**
+ * Message-independent half of an ECDSA signature: r, and k^-1 and r d
+ * modulo the order in Montgomery form. Good for one signature only - a
+ * nonce used for two messages gives away the private key.
+ */
+struct Presignature {
+    Limb r[MAX_LIMBS];
+    Limb nonceInverse[MAX_LIMBS];
+    Limb rd[MAX_LIMBS];
+};
+
+namespace Detail {
+
+/** Little-endian limbs of a big-endian hex constant */
+inline void fromHex(const char* hex, Limb* limbs, size_t count) {
+    uint8_t bytes[MAX_BYTES];
+    size_t length = strlen(hex) / 2;
+    for (size_t i = 0; i < length; i++) {
+        auto nibble = [](char c) { return (uint8_t)(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10); };
+        bytes[i] = (uint8_t)(nibble(hex[2 * i]) << 4 | nibble(hex[2 * i + 1]));
+    }
+    Bignum::fromBytes(std::string_view((const char*)bytes, length), limbs, count);
+}
+
+/** value - 2 for an odd value > 2; setup only */
+inline void minusTwo(const Limb* value, size_t count, Limb* out) {
+    Limb borrow = Bignum::subBorrow(value[0], 2, 0, out[0]);
+    for (size_t j = 1; j < count; j++) borrow = Bignum::subBorrow(value[j], 0, borrow, out[j]);
+}
+
+inline bool isZero(const Limb* value, size_t count) {
+    Limb bits = 0;
+    for (size_t j = 0; j < count; j++) bits |= value[j];
+    return bits == 0;
+}
+
+/**
+ * Nonce candidates of RFC 6979 section 3.2 (HMAC_DRBG over the private key
+ * and a message representative); Hash is the HMAC hash, as wide as the order
+ */
+template <class Hash>
+class NonceGenerator {
+private:
+    static_assert(Hash::DIGEST_SIZE <= MAX_BYTES, "one HMAC block per nonce candidate");
+
+    typename Hash::Digest v;
+    typename Hash::Digest k;
+    size_t bytes;
+    bool started = false;
+
+    void step(uint8_t separator, const uint8_t* key, const uint8_t* data) {
+        Hmac<Hash> mac(k.data(), k.size());
+        mac.update(v.data(), v.size());
+        mac.update(&separator, 1);
+        if (key) {
+            mac.update(key, bytes);
+            mac.update(data, bytes);
+        }
+        k = mac.finish();
+        Hmac<Hash> next(k.data(), k.size());
+        next.update(v.data(), v.size());
+        v = next.finish();
+    }
+
+public:
+    /** key and data are both `length` bytes, big-endian */
+    NonceGenerator(const uint8_t* key, const uint8_t* data, size_t length)
+        : bytes(length) {
+        v.fill(0x01);
+        k.fill(0x00);
+        step(0x00, key, data);
+        step(0x01, key, data);
+    }
+
+    ~NonceGenerator() {
+        Bignum::wipe(k.data(), k.size());
+        Bignum::wipe(v.data(), v.size());
+    }
+
+    /** Next candidate in [1, order - 1]; call again if the caller rejects it */
+    void next(const Limb* order, size_t limbs, Limb* nonce) {
+        while (true) {
+            if (started) step(0x00, nullptr, nullptr);
+            started = true;
+            Hmac<Hash> mac(k.data(), k.size());
+            mac.update(v.data(), v.size());
+            v = mac.finish();
+            Bignum::fromBytes(std::string_view((const char*)v.data(), bytes), nonce, limbs);
+            if (!isZero(nonce, limbs) && Bignum::less(nonce, order, limbs)) return;
+        }
+    }
+};
+
+} // namespace Detail
+
+/**
+ * NIST prime curve y^2 = x^3 - 3x + b (P-256 or P-384)
+ *
+ * Points are added with the complete formulas of Renes, Costello and Batina
+ * (2016, algorithm 4), which have no special cases for doubling or the
+ * identity, so scalar multiplication never branches on the scalar. The
+ * generator's multiples are precomputed per 4-bit window (digit * 16^w * G),
+ * so k*G is one table scan and one addition per window with no doublings.
+ */
+class Curve {
+public:
+    static constexpr size_t WINDOW_BITS = 4;
+    static constexpr size_t WINDOW_SIZE = 1 << WINDOW_BITS;
+
+private:
+    KeyType curveType;
+    size_t byteLength;
+    size_t limbCount;
+    Bignum::Montgomery field;
+    Bignum::Montgomery orderContext;
+    Limb b[MAX_LIMBS] = {};              // Montgomery form
+    Limb oneField[MAX_LIMBS] = {};       // 1 in Montgomery form
+    Limb fieldExponent[MAX_LIMBS] = {};  // p - 2, for inversion
+    Limb orderExponent[MAX_LIMBS] = {};  // n - 2
+    std::vector<Point> generatorTable;   // [window * WINDOW_SIZE + digit]
+
+    void identity(Point& out) const {
+        memset(&out, 0, sizeof(out));
+        memcpy(out.y, oneField, sizeof(oneField));
+    }
+
+    /** p^2 == p^3 - 3p + b for an affine point in Montgomery form; setup only */
+    bool onCurve(const Limb* x, const Limb* y) const {
+        Limb left[MAX_LIMBS];
+        Limb right[MAX_LIMBS];
+        Limb threeX[MAX_LIMBS];
+        field.multiply(y, y, left);
+        field.multiply(x, x, right);
+        field.multiply(right, x, right);
+        field.add(x, x, threeX);
+        field.add(threeX, x, threeX);
+        field.subtract(right, threeX, right);
+        field.add(right, b, right);
+        return memcmp(left, right, limbCount * sizeof(Limb)) == 0;
+    }
+
+public:
+    Curve(KeyType type, size_t bytes, const char* p, const char* n, const char* bHex, const char* gx, const char* gy)
+        : curveType(type), byteLength(bytes), limbCount(bytes / 8) {
+        Limb value[MAX_LIMBS];
+        Detail::fromHex(p, value, limbCount);
+        field.init(value, limbCount);
+        Detail::minusTwo(value, limbCount, fieldExponent);
+        Detail::fromHex(n, value, limbCount);
+        orderContext.init(value, limbCount);
+        Detail::minusTwo(value, limbCount, orderExponent);
+
+        Limb one[MAX_LIMBS] = { 1 };
+        field.toMontgomery(one, oneField);
+        Detail::fromHex(bHex, value, limbCount);
+        field.toMontgomery(value, b);
+
+        Point base;
+        memset(&base, 0, sizeof(base));
+        Detail::fromHex(gx, value, limbCount);
+        field.toMontgomery(value, base.x);
+        Detail::fromHex(gy, value, limbCount);
+        field.toMontgomery(value, base.y);
+        memcpy(base.z, oneField, sizeof(oneField));
+        if (!onCurve(base.x, base.y)) throw std::logic_error("EC generator is not on its curve");
+
+        size_t windows = byteLength * 8 / WINDOW_BITS;
+        generatorTable.resize(windows * WINDOW_SIZE);
+        for (size_t w = 0; w < windows; w++) {
+            Point* row = &generatorTable[w * WINDOW_SIZE];
+            identity(row[0]);
+            row[1] = base;
+            for (size_t digit = 2; digit < WINDOW_SIZE; digit++) add(row[digit - 1], base, row[digit]);
+            add(row[WINDOW_SIZE - 1], base, base);  // 16^(w+1) * G
+        }
+    }
+
+    static const Curve& p256() {
+        static const Curve curve(KeyType::EcP256, 32,
+            "ffffffff00000001000000000000000000000000ffffffffffffffffffffffff",
+            "ffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632551",
+            "5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b",
+            "6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296",
+            "4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5");
+        return curve;
+    }
+
+    static const Curve& p384() {
+        static const Curve curve(KeyType::EcP384, 48,
+            "fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff",
+            "ffffffffffffffffffffffffffffffffffffffffffffffffc7634d81f4372ddf581a0db248b0a77aecec196accc52973",
+            "b3312fa7e23ee7e4988e056be3f82d19181d9c6efe8141120314088f5013875ac656398d8a2ed19d2a85c8edd3ec2aef",
+            "aa87ca22be8b05378eb1c71ef320ad746e1d3b628ba79b9859f741e082542a385502f25dbf55296c3a545e3872760ab7",
+            "3617de4a96262c6f5d9e98bf9292dc29f8f41dbd289a147ce9da3113b5f0b8c00a60b1ce1d7e819d7a431d7c90ea0e5f");
+        return curve;
+    }
+
+    /** Curve by named-curve OID, or null */
+    static const Curve* named(std::string_view oid) {
+        if (oid == Der::Oid::p256) return &p256();
+        if (oid == Der::Oid::p384) return &p384();
+        return nullptr;
+    }
+
+    KeyType type() const { return curveType; }
+    size_t bytes() const { return byteLength; }
+    size_t limbs() const { return limbCount; }
+    const Bignum::Montgomery& order() const { return orderContext; }
+
+    /** out = x^-1 mod n in Montgomery form, for x in Montgomery form */
+    void invertModOrder(const Limb* x, Limb* out) const {
+        orderContext.power(x, orderExponent, byteLength * 8, out);
+    }
+
+    /** out = p + q; complete, so any inputs (equal, identity) take the same steps. out may alias either */
+    void add(const Point& p, const Point& q, Point& out) const {
+        const Bignum::Montgomery& f = field;
+        Limb t0[MAX_LIMBS] = {}, t1[MAX_LIMBS] = {}, t2[MAX_LIMBS] = {}, t3[MAX_LIMBS] = {}, t4[MAX_LIMBS] = {};
+        Limb x3[MAX_LIMBS] = {}, y3[MAX_LIMBS] = {}, z3[MAX_LIMBS] = {};
+        f.multiply(p.x, q.x, t0);
+        f.multiply(p.y, q.y, t1);
+        f.multiply(p.z, q.z, t2);
+        f.add(p.x, p.y, t3);
+        f.add(q.x, q.y, t4);
+        f.multiply(t3, t4, t3);
+        f.add(t0, t1, t4);
+        f.subtract(t3, t4, t3);
+        f.add(p.y, p.z, t4);
+        f.add(q.y, q.z, x3);
+        f.multiply(t4, x3, t4);
+        f.add(t1, t2, x3);
+        f.subtract(t4, x3, t4);
+        f.add(p.x, p.z, x3);
+        f.add(q.x, q.z, y3);
+        f.multiply(x3, y3, x3);
+        f.add(t0, t2, y3);
+        f.subtract(x3, y3, y3);
+        f.multiply(b, t2, z3);
+        f.subtract(y3, z3, x3);
+        f.add(x3, x3, z3);
+        f.add(x3, z3, x3);
+        f.subtract(t1, x3, z3);
+        f.add(t1, x3, x3);
+        f.multiply(b, y3, y3);
+        f.add(t2, t2, t1);
+        f.add(t1, t2, t2);
+        f.subtract(y3, t2, y3);
+        f.subtract(y3, t0, y3);
+        f.add(y3, y3, t1);
+        f.add(t1, y3, y3);
+        f.add(t0, t0, t1);
+        f.add(t1, t0, t0);
+        f.subtract(t0, t2, t0);
+        f.multiply(t4, y3, t1);
+        f.multiply(t0, y3, t2);
+        f.multiply(x3, z3, y3);
+        f.add(y3, t2, y3);
+        f.multiply(x3, t3, x3);
+        f.subtract(x3, t1, x3);
+        f.multiply(z3, t4, z3);
+        f.multiply(t3, t0, t1);
+        f.add(z3, t1, z3);
+        memcpy(out.x, x3, sizeof(x3));
+        memcpy(out.y, y3, sizeof(y3));
+        memcpy(out.z, z3, sizeof(z3));
+    }
+
+    /** out = scalar * G for a scalar below the order; the scalar's bits are not branched on */
+    void multiplyGenerator(const Limb* scalar, Point& out) const {
+        Point accumulator;
+        Point selected;
+        identity(accumulator);
+        size_t windows = byteLength * 8 / WINDOW_BITS;
+        for (size_t w = 0; w < windows; w++) {
+            size_t bit = w * WINDOW_BITS;
+            Limb digit = (scalar[bit / 64] >> (bit % 64)) & (WINDOW_SIZE - 1);
+
+            // Read every entry so the memory access pattern does not reveal the digit
+            memset(&selected, 0, sizeof(selected));
+            const Point* row = &generatorTable[w * WINDOW_SIZE];
+            for (Limb k = 0; k < WINDOW_SIZE; k++) {
+                Limb mask = (Limb)0 - (Limb)(k == digit);
+                for (size_t j = 0; j < limbCount; j++) {
+                    selected.x[j] |= row[k].x[j] & mask;
+                    selected.y[j] |= row[k].y[j] & mask;
+                    selected.z[j] |= row[k].z[j] & mask;
+                }
+            }
+            add(accumulator, selected, accumulator);
+        }
+        out = accumulator;
+        Bignum::wipe(&accumulator, sizeof(accumulator));
+        Bignum::wipe(&selected, sizeof(selected));
+    }
+
+    /** Affine coordinates (normal form limbs) of a point other than the identity */
+    void toAffine(const Point& point, Limb* x, Limb* y) const {
+        Limb zInverse[MAX_LIMBS];
+        field.power(point.z, fieldExponent, byteLength * 8, zInverse);
+        field.multiply(point.x, zInverse, x);
+        field.fromMontgomery(x, x);
+        if (y) {
+            field.multiply(point.y, zInverse, y);
+            field.fromMontgomery(y, y);
+        }
+    }
+};
+
+/**
+ * Curve private key held in memory, ready for ECDSA signing
+ *
+ * Nonces are derived deterministically from the key and the hash
+ * (RFC 6979, HMAC with the curve's own hash), so signing needs no random
+ * source and a weak one can never leak the key. sign() uses no heap and is
+ * safe to call from several threads.
+ */
+class PrivateKey {
+private:
+    const Curve* curve = nullptr;
+    Limb scalar[MAX_LIMBS] = {};
+    Limb scalarMontgomery[MAX_LIMBS] = {};  // modulo the order
+    std::string publicPoint;                // 04 || x || y
+
+    /** bits2int(hash) mod n (RFC 6979 section 2.3): the hash's leftmost bits as wide as the order */
+    void messageRepresentative(const uint8_t* hash, size_t hashLength, Limb* out) const {
+        size_t used = hashLength < curve->bytes() ? hashLength : curve->bytes();
+        Bignum::fromBytes(std::string_view((const char*)hash, used), out, curve->limbs());
+        if (!Bignum::less(out, curve->order().value(), curve->limbs())) {
+            Limb borrow = 0;
+            for (size_t j = 0; j < curve->limbs(); j++) {
+                borrow = Bignum::subBorrow(out[j], curve->order().value()[j], borrow, out[j]);
+            }
+        }
+    }
+
+    /** Presignature for a nonce; false if r is zero and another nonce is needed */
+    bool presignWith(const Limb* nonce, Presignature& out) const {
+        const size_t limbs = curve->limbs();
+        const Bignum::Montgomery& order = curve->order();
+
+        // r = x(k G) mod n; x < p < 2n, so one subtraction reduces it
+        Point point;
+        curve->multiplyGenerator(nonce, point);
+        curve->toAffine(point, out.r, nullptr);
+        Bignum::wipe(&point, sizeof(point));
+        if (!Bignum::less(out.r, order.value(), limbs)) {
+            Limb borrow = 0;
+            for (size_t j = 0; j < limbs; j++) borrow = Bignum::subBorrow(out.r[j], order.value()[j], borrow, out.r[j]);
+        }
+        order.toMontgomery(nonce, out.nonceInverse);
+        curve->invertModOrder(out.nonceInverse, out.nonceInverse);
+        order.toMontgomery(out.r, out.rd);
+        order.multiply(out.rd, scalarMontgomery, out.rd);
+        return !Detail::isZero(out.r, limbs);
+    }
+
+    /** r || s into out with s = k^-1 (e + r d) mod n; false if s is zero and another nonce is needed */
+    bool finish(const Presignature& presignature, const Limb* e, uint8_t* out) const {
+        const size_t bytes = curve->bytes();
+        const size_t limbs = curve->limbs();
+        const Bignum::Montgomery& order = curve->order();
+        Limb s[MAX_LIMBS];
+        order.toMontgomery(e, s);
+        order.add(presignature.rd, s, s);
+        order.multiply(s, presignature.nonceInverse, s);
+        order.fromMontgomery(s, s);
+        if (Detail::isZero(s, limbs)) return false;
+        Bignum::toBytes(presignature.r, limbs, out, bytes);
+        Bignum::toBytes(s, limbs, out + bytes, bytes);
+        return true;
+    }
+
+    /** ECDSA with the RFC 6979 section 3.2 nonce; Hash is the HMAC hash, as wide as the order */
+    template <class Hash>
+    size_t signWith(const uint8_t* hash, size_t hashLength, uint8_t* out) const {
+        const size_t bytes = curve->bytes();
+        const size_t limbs = curve->limbs();
+
+        Limb e[MAX_LIMBS];
+        messageRepresentative(hash, hashLength, e);
+        uint8_t keyBytes[MAX_BYTES];
+        uint8_t hashBytes[MAX_BYTES];
+        Bignum::toBytes(scalar, limbs, keyBytes, bytes);
+        Bignum::toBytes(e, limbs, hashBytes, bytes);
+        Detail::NonceGenerator<Hash> nonces(keyBytes, hashBytes, bytes);
+        Bignum::wipe(keyBytes, sizeof(keyBytes));
+
+        Limb nonce[MAX_LIMBS];
+        Presignature presignature;
+        do {
+            nonces.next(curve->order().value(), limbs, nonce);
+        } while (!presignWith(nonce, presignature) || !finish(presignature, e, out));
+        Bignum::wipe(nonce, sizeof(nonce));
+        Bignum::wipe(&presignature, sizeof(presignature));
+        return 2 * bytes;
+    }
+
+    /**
+     * Presignature with a fresh nonce: RFC 6979 generation over the private
+     * key and random bytes in place of the message, so a weak random source
+     * alone does not expose the key
+     */
+    template <class Hash>
+    void presignWith(Presignature& out) const {
+        const size_t bytes = curve->bytes();
+        uint8_t keyBytes[MAX_BYTES];
+        uint8_t seed[MAX_BYTES];
+        Bignum::toBytes(scalar, curve->limbs(), keyBytes, bytes);
+        Random::fill(seed, bytes);
+        Detail::NonceGenerator<Hash> nonces(keyBytes, seed, bytes);
+        Bignum::wipe(keyBytes, sizeof(keyBytes));
+        Bignum::wipe(seed, sizeof(seed));
+
+        Limb nonce[MAX_LIMBS];
+        do {
+            nonces.next(curve->order().value(), curve->limbs(), nonce);
+        } while (!presignWith(nonce, out));
+        Bignum::wipe(nonce, sizeof(nonce));
+    }
+
+    void load(std::string_view sec1, const Curve* outerCurve) {
+        Der::Reader outer(sec1);
+        Der::Reader key(outer.read(Der::Tag::SEQUENCE).contents);
+        std::string_view version = key.read(Der::Tag::INTEGER).contents;
+        if (version.size() != 1 || version[0] != 1) throw std::runtime_error("Unsupported EC key version");
+        std::string_view privateValue = key.read(Der::Tag::OCTET_STRING).contents;
+        Der::Element parameters;
+        std::string_view embeddedPoint;
+        curve = outerCurve;
+        if (key.readOptional(0xA0, parameters)) {
+            Der::Reader inner(parameters.contents);
+            const Curve* named = Curve::named(inner.read(Der::Tag::OID).contents);
+            if (!named) throw std::runtime_error("Unsupported EC curve (only P-256 and P-384 keys can be loaded)");
+            if (curve && curve != named) throw std::runtime_error("Invalid EC key: conflicting curves");
+            curve = named;
+        }
+        Der::Element publicKey;
+        if (key.readOptional(0xA1, publicKey)) {
+            Der::Reader inner(publicKey.contents);
+            std::string_view bits = inner.read(Der::Tag::BIT_STRING).contents;
+            if (bits.empty() || bits[0] != 0) throw std::runtime_error("Invalid EC key: public key");
+            embeddedPoint = bits.substr(1);
+        }
+        if (!curve) throw std::runtime_error("Invalid EC key: no curve");
+
+        size_t limbs = curve->limbs();
+        if (privateValue.size() > curve->bytes() || !Bignum::fromBytes(privateValue, scalar, limbs) ||
+            Detail::isZero(scalar, limbs) || !Bignum::less(scalar, curve->order().value(), limbs)) {
+            throw std::runtime_error("Invalid EC key: private value out of range");
+        }
+        curve->order().toMontgomery(scalar, scalarMontgomery);
+
+        // Derive the public key; it pairs the key with its certificate
+        Point point;
+        Limb x[MAX_LIMBS];
+        Limb y[MAX_LIMBS];
+        curve->multiplyGenerator(scalar, point);
+        curve->toAffine(point, x, y);
+        publicPoint.assign(1 + 2 * curve->bytes(), '\x04');
+        Bignum::toBytes(x, limbs, (uint8_t*)&publicPoint[1], curve->bytes());
+        Bignum::toBytes(y, limbs, (uint8_t*)&publicPoint[1 + curve->bytes()], curve->bytes());
+        Bignum::wipe(&point, sizeof(point));
+        if (!embeddedPoint.empty() && embeddedPoint != publicPoint) {
+            throw std::runtime_error("Invalid EC key: public key does not match the private key");
+        }
+    }
+
+public:
+    PrivateKey() = default;
+    PrivateKey(const PrivateKey&) = delete;
+    PrivateKey& operator=(const PrivateKey&) = delete;
+
+    ~PrivateKey() {
+        Bignum::wipe(scalar, sizeof(scalar));
+        Bignum::wipe(scalarMontgomery, sizeof(scalarMontgomery));
+    }
+
+    /**
+     * Load an unencrypted ECPrivateKey (SEC1) or an EC PrivateKeyInfo
+     * (PKCS#8) on P-256 or P-384; throws on malformed or unsupported keys
+     */
+    static std::unique_ptr<PrivateKey> fromDer(std::string_view der) {
+        auto key = std::make_unique<PrivateKey>();
+        try {
+            Der::Reader outer(der);
+            Der::Reader body(outer.read(Der::Tag::SEQUENCE).contents);
+            body.read(Der::Tag::INTEGER);
+            if (body.peek(Der::Tag::SEQUENCE)) {
+                // PrivateKeyInfo: version, algorithm with the curve, OCTET STRING holding the SEC1 key
+                Der::Reader algorithm(body.read(Der::Tag::SEQUENCE).contents);
+                if (algorithm.read(Der::Tag::OID).contents != Der::Oid::ecPublicKey) {
+                    throw std::runtime_error("Unsupported private key algorithm (not an EC key)");
+                }
+                const Curve* curve = Curve::named(algorithm.read(Der::Tag::OID).contents);
+                if (!curve) throw std::runtime_error("Unsupported EC curve (only P-256 and P-384 keys can be loaded)");
+                key->load(body.read(Der::Tag::OCTET_STRING).contents, curve);
+            } else {
+                key->load(der, nullptr);
+            }
+        }
+        catch (const Der::ParseError&) {
+            throw std::runtime_error("Invalid EC private key encoding");
+        }
+        return key;
+    }
+
+    /** Whether a PKCS#8 PrivateKeyInfo holds an EC key (so fromDer, not the RSA loader, applies) */
+    static bool isEcPrivateKeyInfo(std::string_view der) {
+        try {
+            Der::Reader outer(der);
+            Der::Reader body(outer.read(Der::Tag::SEQUENCE).contents);
+            body.read(Der::Tag::INTEGER);
+            if (!body.peek(Der::Tag::SEQUENCE)) return false;
+            Der::Reader algorithm(body.read(Der::Tag::SEQUENCE).contents);
+            return algorithm.read(Der::Tag::OID).contents == Der::Oid::ecPublicKey;
+        }
+        catch (const Der::ParseError&) {
+            return false;
+        }
+    }
+
+    KeyType type() const { return curve->type(); }
+
+    /** Uncompressed public point; matches the certificate's subjectPublicKey */
+    std::string_view publicKey() const { return publicPoint; }
+
+    /** Raw signature length in bytes (r || s) */
+    size_t size() const { return 2 * curve->bytes(); }
+
+    /**
+     * ECDSA signature of a hash into out as r || s, each as wide as the
+     * curve; a hash longer than the curve is truncated (FIPS 186-5).
+     * Returns its length.
+     */
+    size_t sign(const uint8_t* hash, size_t hashLength, uint8_t* out, size_t capacity) const {
+        if (capacity < size()) throw std::runtime_error("Signature too large");
+        if (curve->type() == KeyType::EcP256) return signWith<Sha256>(hash, hashLength, out);
+        return signWith<Sha384>(hash, hashLength, out);
+    }
+
+    /**
+     * Precompute the nonce-dependent part of a future signature (a scalar
+     * multiplication and an inversion), off the request path
+     */
+    void presign(Presignature& out) const {
+        if (curve->type() == KeyType::EcP256) {
+            presignWith<Sha256>(out);
+        } else {
+            presignWith<Sha384>(out);
+        }
+    }
+
+    /**
+     * Like sign(), but finishes a presignature of this key: one modular
+     * multiply-add. The caller must discard the presignature afterwards.
+     * Returns 0 in the negligible case that it cannot be used (s = 0).
+     */
+    size_t sign(const Presignature& presignature, const uint8_t* hash, size_t hashLength, uint8_t* out,
+                size_t capacity) const {
+        if (capacity < size()) throw std::runtime_error("Signature too large");
+        Limb e[MAX_LIMBS];
+        messageRepresentative(hash, hashLength, e);
+        return finish(presignature, e, out) ? size() : 0;
+    }
+};
+
+/**
+ * DER form (SEQUENCE of two INTEGERs, RFC 3279) of a raw r || s ECDSA
+ * signature, into out (which may be raw itself); returns its length
+ */
+inline size_t rawToDer(const uint8_t* raw, size_t length, uint8_t* out, size_t capacity) {
+    size_t half = length / 2;
+    if (length % 2 != 0 || half == 0 || half > MAX_BYTES) throw std::runtime_error("Invalid ECDSA signature length");
+    // Two INTEGERs of at most MAX_BYTES + 1 bytes keep every length below 128 (short form)
+    uint8_t body[2 * (MAX_BYTES + 3)];
+    size_t bodyLength = 0;
+    for (const uint8_t* integer : { raw, raw + half }) {
+        size_t skip = 0;
+        while (skip + 1 < half && integer[skip] == 0) skip++;
+        bool pad = (integer[skip] & 0x80) != 0;
+        body[bodyLength++] = Der::Tag::INTEGER;
+        body[bodyLength++] = (uint8_t)(half - skip + pad);
+        if (pad) body[bodyLength++] = 0x00;
+        memcpy(body + bodyLength, integer + skip, half - skip);
+        bodyLength += half - skip;
+    }
+    if (capacity < 2 + bodyLength) throw std::runtime_error("Signature too large");
+    out[0] = Der::Tag::SEQUENCE;
+    out[1] = (uint8_t)bodyLength;
+    memcpy(out + 2, body, bodyLength);
+    return 2 + bodyLength;
+}
+
+} // namespace Ec
+} // namespace Crypto
+} // namespace ArhintSigner
@@ -0,0 +1,1156 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstdio>
+#include <chrono>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <array>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include "logger.h"
+#include "http_exchange.h"
+#include "worker_pool.h"
+
+// Forward declare global running flag
+extern std::atomic<bool> g_running;
+
+namespace ArhintSigner {
+namespace Server {
+
+/**
+ * Portable HTTP/1.1 server backend built on non-blocking sockets and epoll
+ *
+ * Runs one reactor per worker, each with its own epoll instance and its own
+ * SO_REUSEPORT listening socket, so the kernel spreads connections across
+ * reactors without any shared state. Connections are persistent (keep-alive)
+ * and pipelined requests are answered in order. Handlers see the same
+ * Http::Exchange interface as on HTTP.sys. Only requests the caller marks as
+ * served inline, which never wait on anything, run on the reactor thread;
+ * all others, and every request whose body is streamed from the socket, are
+ * handed to a pool of request workers, since a slow signing device or a slow
+ * upload would otherwise stall every other connection on the reactor. The
+ * connection comes back to its reactor once the response is ready.
+ */
+class EpollHttpServer {
+public:
+    /**
+     * Whether a request with a buffered body may run on the reactor thread,
+     * given its method and path. nullptr runs them all there.
+     */
+    using InlinePredicate = bool (*)(std::string_view method, std::string_view path);
+
+private:
+    // Security: limits on what a single connection may buffer
+    static constexpr size_t MAX_HEADER_SIZE = 16384;
+    static constexpr size_t MAX_BUFFERED_BODY = 65536;
+    static constexpr size_t MAX_PENDING_OUTPUT = 1048576;
+    static constexpr int IDLE_TIMEOUT_SECONDS = 60;
+    static constexpr int BODY_READ_TIMEOUT_MS = 30000;
+    static constexpr size_t MAX_DRAIN_BYTES = 4194304;   // unread body discarded before closing
+    static constexpr int DRAIN_TIMEOUT_SECONDS = 2;
+    static constexpr size_t MAX_HEADERS = 64;
+    static constexpr size_t MAX_SPARE_CONNECTIONS = 64;
+    static constexpr size_t MAX_RETAINED_BUFFER = 65536;  // larger connection buffers are not recycled
+    static constexpr std::string_view CONTINUE_RESPONSE = "HTTP/1.1 100 Continue\r\n\r\n";
+
+    /**
+     * Per-connection state owned by one reactor
+     */
+    struct Connection {
+        int fd;
+        std::string input;
+        std::string output;
+        size_t outputOffset;
+        bool closeAfterWrite;
+        bool peerClosed;       // client shut down its side; what it sent before is still answered
+        bool drainAfterWrite;  // the client may still be sending a body nobody reads
+        bool draining;         // response sent and write side shut down; discarding input until EOF
+        size_t drained;
+        bool writeInterest;
+        bool continueSent;  // 100 Continue already sent for the current request
+        std::chrono::steady_clock::time_point lastActivity;
+        std::chrono::steady_clock::time_point lastRead;
+        std::chrono::steady_clock::time_point requestArrival;  // read of the first bytes of the request at the front of input
+
+        explicit Connection(int socket) {
+            reset(socket);
+        }
+
+        /** Reuse for a new socket, keeping the buffer capacity */
+        void reset(int socket) {
+            fd = socket;
+            input.clear();
+            output.clear();
+            outputOffset = 0;
+            closeAfterWrite = false;
+            peerClosed = false;
+            drainAfterWrite = false;
+            draining = false;
+            drained = 0;
+            writeInterest = false;
+            continueSent = false;
+            lastActivity = std::chrono::steady_clock::now();
+            lastRead = lastActivity;
+            requestArrival = lastActivity;
+        }
+    };
+
+    struct Header {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    /**
+     * Parsed request line and headers, as views into the connection's input
+     * buffer; they stay valid while the request is handled because only the
+     * body after the head is ever erased in the meantime
+     */
+    struct RequestHead {
+        std::string_view method;
+        std::string_view url;
+        std::string_view version;
+        std::array<Header, MAX_HEADERS> headers;
+        size_t headerCount = 0;
+        size_t headerLength = 0;
+        size_t contentLength = 0;
+        bool keepAlive = true;
+        bool expectContinue = false;  // client waits for 100 Continue before sending the body
+        bool chunked = false;         // body sent with Transfer-Encoding: chunked, length unknown
+    };
+
+    /**
+     * Exchange for one request on a connection. The body is served from the
+     * connection's input buffer; bodies larger than MAX_BUFFERED_BODY and
+     * chunked bodies are streamed directly from the socket.
+     */
+    class EpollExchange : public Http::Exchange {
+    private:
+        Connection& connection;
+        const RequestHead& head;
+        size_t bodyRemaining;
+        bool responded;
+        bool failed;
+        bool streaming;
+        bool writeFailed;
+        bool halfClosed;  // client shut down its side before this request was handled
+
+        // Chunked body decoding. Framing is read into its own buffer so the
+        // connection's input, which the request head points into, never grows.
+        std::string chunkInput;
+        size_t chunkRemaining;
+        bool chunkDataEnded;  // a chunk's data was read and its CRLF is still to come
+        bool chunksDone;
+
+        // Set for exchanges served on a request worker, which may suspend. A
+        // suspended exchange is finished by whichever of the handler's return
+        // and resume() comes last.
+        std::function<void()> onFinish;
+        std::atomic<int> holders;
+
+        static constexpr size_t MAX_CHUNK_LINE = 1024;
+
+        void appendHead(int statusCode, std::string_view contentType, const size_t* contentLength) {
+            std::string& out = connection.output;
+            out.reserve(out.size() + (contentLength ? *contentLength : 0) + 256);
+            out += "HTTP/1.1 ";
+            out += std::to_string(statusCode);
+            out += ' ';
+            out += Http::reasonPhrase(statusCode);
+            out += "\r\nContent-Type: ";
+            out += contentType;
+            if (contentLength) {
+                out += "\r\nContent-Length: ";
+                out += std::to_string(*contentLength);
+            } else {
+                out += "\r\nTransfer-Encoding: chunked";
+            }
+            out += "\r\nAccess-Control-Allow-Origin: *"
+                   "\r\nAccess-Control-Allow-Methods: GET, POST, OPTIONS"
+                   "\r\nAccess-Control-Allow-Headers: Content-Type, X-Deadline-Ms, X-Priority"
+                   "\r\nAccess-Control-Expose-Headers: Server-Timing"
+                   "\r\nTiming-Allow-Origin: *";
+            char timing[256];
+            size_t timingLength = serverTiming(timing, sizeof(timing));
+            if (timingLength > 0) {
+                out += "\r\nServer-Timing: ";
+                out.append(timing, timingLength);
+            }
+            if (retryAfterSeconds > 0) {
+                out += "\r\nRetry-After: ";
+                out += std::to_string(retryAfterSeconds);
+            }
+            // Answering before the whole body arrived ends the connection (see Reactor::startDraining)
+            bool keepAlive = head.keepAlive && !failed && !bodyLeftOnSocket();
+            out += keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+        }
+
+        /**
+         * Push all pending output to the socket now, waiting for it to drain.
+         * Used by streamed responses, whose chunks must not wait for the handler to return.
+         */
+        bool writeThrough() {
+            while (!writeFailed && connection.outputOffset < connection.output.size()) {
+                ssize_t sent = ::send(connection.fd, connection.output.data() + connection.outputOffset,
+                                      connection.output.size() - connection.outputOffset, MSG_NOSIGNAL);
+                if (sent > 0) {
+                    connection.outputOffset += (size_t)sent;
+                    continue;
+                }
+                if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                    pollfd pfd = { connection.fd, POLLOUT, 0 };
+                    if (poll(&pfd, 1, BODY_READ_TIMEOUT_MS) > 0) continue;
+                }
+                writeFailed = true;
+            }
+            if (!writeFailed) {
+                connection.output.clear();
+                connection.outputOffset = 0;
+            }
+            return !writeFailed;
+        }
+
+        /**
+         * Read body bytes from the socket, waiting up to BODY_READ_TIMEOUT_MS
+         * for each. Returns 0 (and marks the body failed) on error or timeout.
+         */
+        size_t receive(char* buffer, size_t length) {
+            // A client that sent "Expect: 100-continue" holds the body back until told to go on
+            if (head.expectContinue && !connection.continueSent) {
+                connection.continueSent = true;
+                connection.output += CONTINUE_RESPONSE;
+                if (!writeThrough()) {
+                    failed = true;
+                    return 0;
+                }
+            }
+
+            while (true) {
+                ssize_t received = recv(connection.fd, buffer, length, 0);
+                if (received > 0) return (size_t)received;
+                if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                    pollfd pfd = { connection.fd, POLLIN, 0 };
+                    if (poll(&pfd, 1, BODY_READ_TIMEOUT_MS) > 0) continue;
+                }
+                failed = true;
+                return 0;
+            }
+        }
+
+        /** Take the next CRLF-terminated framing line out of chunkInput */
+        bool takeChunkLine(std::string& line) {
+            size_t end;
+            while ((end = chunkInput.find("\r\n")) == std::string::npos) {
+                if (chunkInput.size() > MAX_CHUNK_LINE) return false;
+                char buffer[4096];
+                size_t received = receive(buffer, sizeof(buffer));
+                if (received == 0) return false;
+                chunkInput.append(buffer, received);
+            }
+            line.assign(chunkInput, 0, end);
+            chunkInput.erase(0, end + 2);
+            return true;
+        }
+
+        /** Read the next chunk-size line; the last chunk and its trailers end the body */
+        bool nextChunk() {
+            std::string line;
+            if (chunkDataEnded) {
+                if (!takeChunkLine(line) || !line.empty()) return false;
+                chunkDataEnded = false;
+            }
+            if (!takeChunkLine(line)) return false;
+
+            // Chunk extensions after ';' are ignored
+            size_t sizeEnd = line.find_first_of("; \t");
+            if (sizeEnd == std::string::npos) sizeEnd = line.size();
+            unsigned long long size = 0;
+            auto result = std::from_chars(line.data(), line.data() + sizeEnd, size, 16);
+            if (sizeEnd == 0 || result.ec != std::errc() || result.ptr != line.data() + sizeEnd) return false;
+
+            if (size == 0) {
+                do {
+                    if (!takeChunkLine(line)) return false;
+                } while (!line.empty());
+                chunksDone = true;
+                return true;
+            }
+            chunkRemaining = (size_t)size;
+            chunkDataEnded = true;
+            return true;
+        }
+
+        size_t readChunked(char* buffer, size_t length) {
+            if (length == 0 || failed) return 0;
+            if (chunkInput.empty() && connection.input.size() > head.headerLength) {
+                // Move what arrived with the head into the framing buffer
+                chunkInput.assign(connection.input, head.headerLength, std::string::npos);
+                connection.input.resize(head.headerLength);
+            }
+            while (chunkRemaining == 0) {
+                if (chunksDone) return 0;
+                if (!nextChunk()) {
+                    failed = true;
+                    return 0;
+                }
+            }
+
+            if (length > chunkRemaining) length = chunkRemaining;
+            size_t count;
+            if (!chunkInput.empty()) {
+                count = chunkInput.size() < length ? chunkInput.size() : length;
+                memcpy(buffer, chunkInput.data(), count);
+                chunkInput.erase(0, count);
+            } else {
+                count = receive(buffer, length);
+            }
+            chunkRemaining -= count;
+            return count;
+        }
+
+    public:
+        EpollExchange(Connection& conn, const RequestHead& requestHead)
+            : connection(conn)
+            , head(requestHead)
+            , bodyRemaining(requestHead.contentLength)
+            , responded(false)
+            , failed(false)
+            , streaming(false)
+            , writeFailed(false)
+            , halfClosed(conn.peerClosed)
+            , chunkRemaining(0)
+            , chunkDataEnded(false)
+            , chunksDone(false)
+            , holders(0) {
+            requestMethod = requestHead.method;
+            requestUrl = requestHead.url;
+        }
+
+        std::string_view header(std::string_view name) const override {
+            for (size_t i = 0; i < head.headerCount; i++) {
+                if (Http::equalsIgnoreCase(head.headers[i].name, name)) return head.headers[i].value;
+            }
+            return std::string_view();
+        }
+
+        bool clientGone() override {
+            // A client that half-closed on purpose still expects its answer
+            if (halfClosed) return false;
+            pollfd pfd = { connection.fd, POLLRDHUP, 0 };
+            return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR)) != 0;
+        }
+
+        size_t readBody(char* buffer, size_t length) override {
+            if (head.chunked) return readChunked(buffer, length);
+            if (bodyRemaining == 0 || length == 0 || failed) return 0;
+            if (length > bodyRemaining) length = bodyRemaining;
+
+            // Body bytes already buffered right after the request head
+            size_t buffered = connection.input.size() > head.headerLength
+                ? connection.input.size() - head.headerLength : 0;
+            if (buffered > 0) {
+                size_t count = buffered < length ? buffered : length;
+                memcpy(buffer, connection.input.data() + head.headerLength, count);
+                connection.input.erase(head.headerLength, count);
+                bodyRemaining -= count;
+                return count;
+            }
+
+            size_t received = receive(buffer, length);
+            bodyRemaining -= received;
+            return received;
+        }
+
+        void send(int statusCode, std::string_view contentType, std::string_view body) override {
+            if (responded) return;
+            responded = true;
+            responseStatus = statusCode;
+            size_t length = body.size();
+            appendHead(statusCode, contentType, &length);
+            connection.output += body;
+        }
+
+        void sendGather(int statusCode, std::string_view contentType,
+                        const std::vector<std::string_view>& slices) override {
+            if (responded) return;
+            responded = true;
+            responseStatus = statusCode;
+            size_t length = 0;
+            for (std::string_view slice : slices) length += slice.size();
+            appendHead(statusCode, contentType, &length);
+            for (std::string_view slice : slices) connection.output.append(slice.data(), slice.size());
+        }
+
+        void beginStream(int statusCode, std::string_view contentType) override {
+            if (responded) return;
+            responded = true;
+            responseStatus = statusCode;
+            streaming = true;
+            appendHead(statusCode, contentType, nullptr);
+            writeThrough();
+        }
+
+        bool writeChunk(std::string_view data) override {
+            if (!streaming || writeFailed) return false;
+            if (data.empty()) return true;
+
+            char size[20];
+            snprintf(size, sizeof(size), "%zx\r\n", data.size());
+            connection.output += size;
+            connection.output += data;
+            connection.output += "\r\n";
+            return writeThrough();
+        }
+
+        void endStream() override {
+            if (!streaming) return;
+            streaming = false;
+            // The terminating chunk is flushed by the reactor like any other response
+            if (!writeFailed) connection.output += "0\r\n\r\n";
+        }
+
+        bool suspend() override {
+            if (!onFinish || responded || isSuspended) return false;
+            isSuspended = true;
+            // The handler's thread reuses its phase timings for its next request
+            phases = nullptr;
+            holders.store(2, std::memory_order_relaxed);
+            return true;
+        }
+
+        void resume() override { release(); }
+
+        /** Allow suspend(); finish runs once the request is done and destroys the exchange */
+        void allowSuspend(std::function<void()> finish) { onFinish = std::move(finish); }
+
+        /** Drop the handler's or resume()'s hold on a suspended exchange */
+        void release() {
+            if (holders.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            std::function<void()> finish = std::move(onFinish);
+            finish();
+        }
+
+        /** Whether part of the body is still to come from the client */
+        bool bodyLeftOnSocket() const {
+            if (head.chunked) return !chunksDone;
+            size_t buffered = connection.input.size() > head.headerLength
+                ? connection.input.size() - head.headerLength : 0;
+            return bodyRemaining > buffered;
+        }
+
+        bool hasResponded() const { return responded; }
+        bool streamIncomplete() const { return streaming || writeFailed; }
+        bool bodyFailed() const { return failed; }
+
+        /**
+         * Remove this request from the connection's input, keeping any
+         * pipelined requests behind it. Returns false when part of the body
+         * never arrived; the input is then cleared and the connection must close.
+         */
+        bool consumeRequest() {
+            if (bodyLeftOnSocket()) {
+                connection.input.clear();
+                return false;
+            }
+            if (head.chunked) {
+                // Bytes read past the last chunk belong to the next request
+                connection.input.swap(chunkInput);
+            } else {
+                connection.input.erase(0, head.headerLength + bodyRemaining);
+            }
+            return true;
+        }
+    };
+
+    int port;
+    unsigned reactorCount;
+    unsigned requestWorkerCount;
+    bool initialized;
+    std::vector<int> listenSockets;
+
+    static void closeSocket(int fd) {
+        if (fd >= 0) close(fd);
+    }
+
+    static int createListenSocket(int port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons((uint16_t)port);
+
+        if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /**
+     * Parse the request head at the start of the input buffer.
+     * Returns 1 when complete, 0 when more data is needed, or an HTTP error status.
+     */
+    static int parseHead(std::string_view input, RequestHead& head) {
+        size_t end = input.find("\r\n\r\n");
+        if (end == std::string_view::npos) {
+            return input.size() > MAX_HEADER_SIZE ? 431 : 0;
+        }
+        if (end > MAX_HEADER_SIZE) return 431;
+        head.headerLength = end + 4;
+
+        size_t lineEnd = input.find("\r\n");
+        size_t firstSpace = input.find(' ');
+        size_t secondSpace = firstSpace == std::string_view::npos ? std::string_view::npos : input.find(' ', firstSpace + 1);
+        if (secondSpace == std::string_view::npos || secondSpace > lineEnd) return 400;
+
+        head.method = input.substr(0, firstSpace);
+        head.url = input.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+        head.version = input.substr(secondSpace + 1, lineEnd - secondSpace - 1);
+        if (head.version != "HTTP/1.1" && head.version != "HTTP/1.0") return 400;
+        head.keepAlive = head.version == "HTTP/1.1";
+
+        size_t pos = lineEnd + 2;
+        while (pos < end) {
+            size_t next = input.find("\r\n", pos);
+            size_t colon = input.find(':', pos);
+            if (colon == std::string_view::npos || colon > next) return 400;
+            if (head.headerCount >= MAX_HEADERS) return 431;
+
+            std::string_view name = input.substr(pos, colon - pos);
+            size_t valueStart = input.find_first_not_of(" \t", colon + 1);
+            std::string_view value = valueStart < next ? input.substr(valueStart, next - valueStart) : std::string_view();
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+
+            if (Http::equalsIgnoreCase(name, "Content-Length")) {
+                unsigned long long length = 0;
+                auto result = std::from_chars(value.data(), value.data() + value.size(), length);
+                if (value.empty() || result.ec != std::errc() || result.ptr != value.data() + value.size()) return 400;
+                head.contentLength = (size_t)length;
+            } else if (Http::equalsIgnoreCase(name, "Transfer-Encoding")) {
+                // Streaming clients upload without knowing the length; other codings are not supported
+                if (!Http::equalsIgnoreCase(value, "chunked")) return 501;
+                head.chunked = true;
+            } else if (Http::equalsIgnoreCase(name, "Expect")) {
+                if (Http::equalsIgnoreCase(value, "100-continue")) head.expectContinue = true;
+            } else if (Http::equalsIgnoreCase(name, "Connection")) {
+                if (Http::equalsIgnoreCase(value, "close")) head.keepAlive = false;
+                if (Http::equalsIgnoreCase(value, "keep-alive")) head.keepAlive = true;
+            }
+
+            head.headers[head.headerCount++] = Header{ name, value };
+            pos = next + 2;
+        }
+        // A body framed both ways is ambiguous (request smuggling)
+        if (head.chunked && head.contentLength > 0) return 400;
+        return 1;
+    }
+
+    /**
+     * One event loop with its own epoll instance and listening socket
+     */
+    template<typename RequestHandler>
+    class Reactor {
+    private:
+        int listenFd;
+        int epollFd;
+        int wakeFd;  // eventfd signalled when request workers return connections
+        RequestHandler handler;
+        InlinePredicate servedInline;
+        Concurrency::WorkStealingPool& requestWorkers;
+        std::unordered_map<int, std::unique_ptr<Connection>> connections;
+        std::vector<std::unique_ptr<Connection>> spareConnections;  // closed connections kept for reuse
+        std::mutex returnedMutex;
+        std::vector<std::unique_ptr<Connection>> returned;  // handed back by request workers
+        std::atomic<size_t> away;  // connections whose request is being served off the reactor
+
+        /**
+         * Register the events a connection waits for: input until the client
+         * shuts down its side (the end of input would otherwise be reported
+         * again on every wait), output while a response is held back
+         */
+        bool watch(Connection& conn, int operation) {
+            epoll_event event = {};
+            event.events = (conn.peerClosed ? 0u : (uint32_t)(EPOLLIN | EPOLLRDHUP)) |
+                           (conn.writeInterest ? (uint32_t)EPOLLOUT : 0u);
+            event.data.fd = conn.fd;
+            return epoll_ctl(epollFd, operation, conn.fd, &event) == 0;
+        }
+
+        void updateInterest(Connection& conn, bool wantWrite) {
+            if (conn.writeInterest == wantWrite) return;
+            conn.writeInterest = wantWrite;
+            watch(conn, EPOLL_CTL_MOD);
+        }
+
+        void closeConnection(int fd) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            auto it = connections.find(fd);
+            if (it == connections.end()) return;
+
+            // Keep the object and its buffers for the next connection unless a large request inflated them
+            std::unique_ptr<Connection> conn = std::move(it->second);
+            connections.erase(it);
+            if (spareConnections.size() < MAX_SPARE_CONNECTIONS &&
+                conn->input.capacity() <= MAX_RETAINED_BUFFER && conn->output.capacity() <= MAX_RETAINED_BUFFER) {
+                spareConnections.push_back(std::move(conn));
+            }
+        }
+
+        void acceptConnections() {
+            while (true) {
+                int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                epoll_event event = {};
+                event.events = EPOLLIN | EPOLLRDHUP;
+                event.data.fd = fd;
+                if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                    close(fd);
+                    continue;
+                }
+                if (spareConnections.empty()) {
+                    connections[fd] = std::make_unique<Connection>(fd);
+                } else {
+                    spareConnections.back()->reset(fd);
+                    connections[fd] = std::move(spareConnections.back());
+                    spareConnections.pop_back();
+                }
+            }
+        }
+
+        /**
+         * Write as much pending output as the socket accepts.
+         * Returns false if the connection should be closed.
+         */
+        bool flush(Connection& conn) {
+            while (conn.outputOffset < conn.output.size()) {
+                ssize_t sent = ::send(conn.fd, conn.output.data() + conn.outputOffset,
+                                      conn.output.size() - conn.outputOffset, MSG_NOSIGNAL);
+                if (sent > 0) {
+                    conn.outputOffset += (size_t)sent;
+                    continue;
+                }
+                if (sent < 0 && errno == EINTR) continue;
+                if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    updateInterest(conn, true);
+                    return true;
+                }
+                return false;
+            }
+
+            conn.output.clear();
+            conn.outputOffset = 0;
+            updateInterest(conn, false);
+            if (!conn.closeAfterWrite) return true;
+            // A client that shut down its side sends nothing left to drain
+            if (!conn.drainAfterWrite || conn.peerClosed) return false;
+            startDraining(conn);
+            return true;
+        }
+
+        /**
+         * Close a connection whose client may still be sending a request body.
+         * Closing with unread input makes the kernel send a reset, which can
+         * destroy the response before the client reads it; instead the write
+         * side is shut down (the client sees the end of the response) and up
+         * to MAX_DRAIN_BYTES are read and discarded for DRAIN_TIMEOUT_SECONDS
+         * before the socket is closed.
+         */
+        void startDraining(Connection& conn) {
+            if (conn.draining) return;
+            ::shutdown(conn.fd, SHUT_WR);
+            conn.draining = true;
+            conn.drained = 0;
+            conn.input.clear();
+            conn.lastActivity = std::chrono::steady_clock::now();
+        }
+
+        void drainInput(Connection& conn) {
+            char buffer[16384];
+            while (true) {
+                ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+                if (received > 0) {
+                    conn.drained += (size_t)received;
+                    if (conn.drained <= MAX_DRAIN_BYTES) continue;
+                } else if (received < 0 && errno == EINTR) {
+                    continue;
+                } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                }
+                // End of the client's data, an error or too much of it
+                closeConnection(conn.fd);
+                return;
+            }
+        }
+
+        /**
+         * A request served on a request worker, with the connection it came on
+         */
+        struct Handoff {
+            std::unique_ptr<Connection> connection;
+            RequestHead head;
+            std::unique_ptr<EpollExchange> exchange;
+        };
+
+        void sendError(Connection& conn, int statusCode) {
+            RequestHead head;
+            head.keepAlive = false;
+            EpollExchange exchange(conn, head);
+            exchange.send(statusCode, "application/json",
+                          std::string("{\"error\":\"") + Http::reasonPhrase(statusCode) + "\"}");
+            conn.closeAfterWrite = true;
+            conn.drainAfterWrite = true;
+        }
+
+        /**
+         * Run the handler for one request and remove it from the input buffer.
+         * The request arrived when its first bytes were read, so the time it
+         * spent buffered behind other work counts as queueing delay.
+         */
+        void serve(Connection& conn, const RequestHead& head, std::chrono::steady_clock::time_point arrival) {
+            EpollExchange exchange(conn, head);
+            exchange.setArrival(arrival);
+            runHandler(exchange);
+            finishRequest(conn, head, exchange);
+        }
+
+        void runHandler(EpollExchange& exchange) {
+            try {
+                handler(exchange);
+            }
+            catch (...) {
+                Log::error("Unhandled exception in request handler");
+            }
+        }
+
+        /**
+         * After the response: answer a request the handler left unanswered and
+         * remove it from the input buffer
+         */
+        void finishRequest(Connection& conn, const RequestHead& head, EpollExchange& exchange) {
+            conn.continueSent = false;
+            if (!exchange.hasResponded()) {
+                exchange.send(500, "application/json", "{\"error\":\"No response\"}");
+            }
+
+            // A stream the handler did not finish cannot be followed by another response
+            if (!head.keepAlive || exchange.bodyFailed() || exchange.streamIncomplete()) {
+                conn.closeAfterWrite = true;
+            }
+
+            // Discard whatever body the handler did not consume
+            if (!exchange.consumeRequest()) {
+                conn.closeAfterWrite = true;
+                conn.drainAfterWrite = true;
+            }
+            // A pipelined request behind this one was read, at the latest, by the last read before dispatch
+            conn.requestArrival = conn.lastRead;
+        }
+
+        /**
+         * Serve a request on a request worker. The connection leaves this
+         * reactor's epoll set and map until the request is finished; the
+         * request head stays valid because its buffer moves with it. The
+         * handler may suspend the exchange and return, freeing the worker;
+         * the request is then finished on the thread that resumes it.
+         */
+        void handOff(Connection& conn, const RequestHead& head) {
+            int fd = conn.fd;
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            conn.writeInterest = false;
+            auto it = connections.find(fd);
+            Handoff* task = new Handoff{ std::unique_ptr<Connection>(it->second.release()), head, nullptr };
+            connections.erase(it);
+            away.fetch_add(1, std::memory_order_relaxed);
+
+            auto arrival = conn.requestArrival;
+            requestWorkers.submit([this, task, arrival]() {
+                task->exchange.reset(new EpollExchange(*task->connection, task->head));
+                EpollExchange& exchange = *task->exchange;
+                exchange.setArrival(arrival);
+                exchange.allowSuspend([this, task]() { complete(task); });
+                runHandler(exchange);
+                if (exchange.suspended()) {
+                    exchange.release();
+                    return;
+                }
+                complete(task);
+            });
+        }
+
+        /** Finish a request served away from the reactor and hand its connection back */
+        void complete(Handoff* task) {
+            std::unique_ptr<Handoff> owned(task);
+            finishRequest(*owned->connection, owned->head, *owned->exchange);
+            owned->exchange.reset();
+            {
+                std::lock_guard<std::mutex> lock(returnedMutex);
+                returned.push_back(std::move(owned->connection));
+            }
+            uint64_t one = 1;
+            ssize_t written = write(wakeFd, &one, sizeof(one));
+            (void)written;
+            away.fetch_sub(1, std::memory_order_release);
+        }
+
+        /**
+         * Take back connections whose request a worker has served
+         */
+        void resumeReturned() {
+            uint64_t count;
+            ssize_t got = read(wakeFd, &count, sizeof(count));
+            (void)got;
+
+            std::vector<std::unique_ptr<Connection>> batch;
+            {
+                std::lock_guard<std::mutex> lock(returnedMutex);
+                batch.swap(returned);
+            }
+            for (auto& owned : batch) {
+                int fd = owned->fd;
+                owned->lastActivity = std::chrono::steady_clock::now();
+                connections[fd] = std::move(owned);
+
+                if (!watch(*connections[fd], EPOLL_CTL_ADD)) {
+                    closeConnection(fd);
+                    continue;
+                }
+                resume(*connections[fd]);
+            }
+        }
+
+        /**
+         * Wait for the rest of a request, unless the client already shut down
+         * its side: then none can come, and the connection closes once the
+         * responses to what it did send are written
+         */
+        bool awaitInput(Connection& conn) {
+            if (conn.peerClosed) conn.closeAfterWrite = true;
+            return true;
+        }
+
+        /**
+         * Handle every complete request in the input buffer, in order (pipelining).
+         * Returns false when the connection was handed to a request worker; it
+         * must not be touched until it comes back.
+         */
+        bool processInput(Connection& conn) {
+            while (!conn.closeAfterWrite && conn.output.size() < MAX_PENDING_OUTPUT) {
+                RequestHead head;
+                int status = parseHead(conn.input, head);
+                if (status == 0) return awaitInput(conn);
+                if (status != 1) {
+                    sendError(conn, status);
+                    return true;
+                }
+
+                // Small bodies are buffered completely before dispatch; large ones are streamed
+                bool streamed = head.chunked || head.contentLength > MAX_BUFFERED_BODY;
+                if (streamed) {
+                    handOff(conn, head);
+                    return false;
+                }
+                if (conn.input.size() < head.headerLength + head.contentLength) {
+                    if (head.expectContinue && !conn.continueSent) {
+                        conn.continueSent = true;
+                        conn.output += CONTINUE_RESPONSE;
+                    }
+                    return awaitInput(conn);
+                }
+
+                // Anything that may wait (signing devices, key queues, batch windows) leaves the reactor
+                if (servedInline && servedInline(head.method, head.url.substr(0, head.url.find('?')))) {
+                    serve(conn, head, conn.requestArrival);
+                    continue;
+                }
+                handOff(conn, head);
+                return false;
+            }
+            return true;
+        }
+
+        void onReadable(Connection& conn) {
+            if (conn.draining) {
+                drainInput(conn);
+                return;
+            }
+            char buffer[16384];
+            auto now = std::chrono::steady_clock::now();
+            while (true) {
+                ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+                if (received > 0) {
+                    if (conn.input.empty()) conn.requestArrival = now;
+                    conn.lastRead = now;
+                    conn.input.append(buffer, (size_t)received);
+                    if (conn.input.size() > MAX_HEADER_SIZE + MAX_BUFFERED_BODY + sizeof(buffer)) break;
+                    continue;
+                }
+                if (received < 0 && errno == EINTR) continue;
+                if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                if (received < 0) {
+                    closeConnection(conn.fd);
+                    return;
+                }
+                // Peer shut down its side - answer what was already received, then close
+                conn.peerClosed = true;
+                watch(conn, EPOLL_CTL_MOD);
+                break;
+            }
+
+            conn.lastActivity = now;
+            if (!processInput(conn)) return;
+            if (!flush(conn)) closeConnection(conn.fd);
+        }
+
+        /**
+         * Send pending output, then carry on with pipelined requests held
+         * back by backpressure or by a request worker
+         */
+        void resume(Connection& conn) {
+            if (!flush(conn)) {
+                closeConnection(conn.fd);
+                return;
+            }
+            if (conn.output.empty() && (!conn.input.empty() || conn.peerClosed)) {
+                if (!processInput(conn)) return;
+                if (!flush(conn)) closeConnection(conn.fd);
+            }
+        }
+
+        void closeIdleConnections() {
+            auto now = std::chrono::steady_clock::now();
+            std::vector<int> idle;
+            for (const auto& entry : connections) {
+                auto timeout = std::chrono::seconds(entry.second->draining ? DRAIN_TIMEOUT_SECONDS : IDLE_TIMEOUT_SECONDS);
+                if (now - entry.second->lastActivity > timeout) {
+                    idle.push_back(entry.first);
+                }
+            }
+            for (int fd : idle) closeConnection(fd);
+        }
+
+    public:
+        Reactor(int listenSocket, RequestHandler requestHandler, InlinePredicate inlinePredicate,
+                Concurrency::WorkStealingPool& workers)
+            : listenFd(listenSocket)
+            , epollFd(epoll_create1(EPOLL_CLOEXEC))
+            , wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+            , handler(requestHandler)
+            , servedInline(inlinePredicate)
+            , requestWorkers(workers)
+            , away(0) {
+        }
+
+        /** Wait for the requests still served off the reactor, suspended ones included */
+        void waitForAway() {
+            while (away.load(std::memory_order_acquire) > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+
+        /** Requests served off the reactor must be finished before it is destroyed (waitForAway) */
+        ~Reactor() {
+            for (auto& entry : connections) close(entry.first);
+            for (auto& conn : returned) close(conn->fd);
+            if (wakeFd >= 0) close(wakeFd);
+            if (epollFd >= 0) close(epollFd);
+        }
+
+        void run() {
+            if (epollFd < 0 || wakeFd < 0) return;
+
+            epoll_event listenEvent = {};
+            listenEvent.events = EPOLLIN;
+            listenEvent.data.fd = listenFd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &listenEvent) != 0) return;
+
+            epoll_event wakeEvent = {};
+            wakeEvent.events = EPOLLIN;
+            wakeEvent.data.fd = wakeFd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wakeEvent) != 0) return;
+
+            epoll_event events[128];
+            auto lastSweep = std::chrono::steady_clock::now();
+
+            while (g_running) {
+                int count = epoll_wait(epollFd, events, 128, 250);
+                if (count < 0 && errno != EINTR) break;
+
+                for (int i = 0; i < count; i++) {
+                    int fd = events[i].data.fd;
+                    if (fd == listenFd) {
+                        acceptConnections();
+                        continue;
+                    }
+                    if (fd == wakeFd) {
+                        resumeReturned();
+                        continue;
+                    }
+
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) continue;
+                    Connection& conn = *it->second;
+
+                    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                        closeConnection(fd);
+                        continue;
+                    }
+                    if (events[i].events & EPOLLOUT) {
+                        resume(conn);
+                        if (connections.find(fd) == connections.end()) continue;
+                    }
+                    if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                        onReadable(conn);
+                    }
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                if (now - lastSweep > std::chrono::seconds(1)) {
+                    closeIdleConnections();
+                    lastSweep = now;
+                }
+            }
+        }
+    };
+
+public:
+    /**
+     * serverPort = port to listen on (0 = any free port, see getPort() after initialize());
+     * reactors = number of event loops (0 = a single loop on the calling thread);
+     * the receives argument exists for parity with the HTTP.sys backend
+     */
+    EpollHttpServer(int serverPort = 8082, unsigned reactors = 0, unsigned receives = 0)
+        : port(serverPort)
+        , reactorCount(reactors > 0 ? reactors : 1)
+        , requestWorkerCount(reactorCount > 4 ? reactorCount : 4)
+        , initialized(false) {
+        (void)receives;
+    }
+
+    /**
+     * Threads for the requests that may wait (0 keeps the default, one per
+     * reactor and at least 4). Signing waits on key queues and devices there,
+     * so as many signatures can be in progress as there are request workers.
+     */
+    void setRequestWorkers(unsigned count) {
+        if (count > 0) requestWorkerCount = count;
+    }
+
+    ~EpollHttpServer() {
+        shutdown();
+    }
+
+    /**
+     * Create one listening socket per reactor
+     */
+    bool initialize() {
+        if (initialized) return true;
+
+        for (unsigned i = 0; i < reactorCount; i++) {
+            int fd = createListenSocket(port);
+            if (fd < 0) {
+                Log::error("Failed to listen on port ", port, ": ", strerror(errno));
+                for (int socket : listenSockets) closeSocket(socket);
+                listenSockets.clear();
+                return false;
+            }
+            listenSockets.push_back(fd);
+
+            // Port 0 takes any free port; the other reactors share the one the first was given
+            if (port == 0) {
+                sockaddr_in address = {};
+                socklen_t length = sizeof(address);
+                if (getsockname(fd, (sockaddr*)&address, &length) == 0) port = ntohs(address.sin_port);
+            }
+        }
+
+        Log::info("Listening on http://+:", port, "/ (", reactorCount, " epoll reactors, ", requestWorkerCount, " request workers)");
+        initialized = true;
+        return true;
+    }
+
+    /**
+     * Process incoming requests (blocking call)
+     * The handler is called as handler(Http::Exchange&) on the reactor thread
+     * for requests servedInline accepts, and on a request worker for the
+     * others and for requests with a streamed body
+     */
+    template<typename RequestHandler>
+    void processRequests(RequestHandler handler, InlinePredicate servedInline = nullptr) {
+        if (!initialized) {
+            return;
+        }
+
+        Concurrency::WorkStealingPool requestWorkers(getRequestWorkerCount());
+        std::vector<std::unique_ptr<Reactor<RequestHandler>>> reactors;
+        for (int fd : listenSockets) {
+            reactors.push_back(std::make_unique<Reactor<RequestHandler>>(fd, handler, servedInline, requestWorkers));
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < reactors.size(); i++) {
+            Reactor<RequestHandler>* reactor = reactors[i].get();
+            threads.emplace_back([reactor]() { reactor->run(); });
+        }
+        reactors[0]->run();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        // Let requests still on request workers, or suspended, finish while their reactors exist
+        requestWorkers.shutdown();
+        for (auto& reactor : reactors) reactor->waitForAway();
+    }
+
+    /**
+     * Shutdown the server and close the listening sockets
+     */
+    void shutdown() {
+        if (!initialized) return;
+
+        for (int fd : listenSockets) closeSocket(fd);
+        listenSockets.clear();
+        initialized = false;
+    }
+
+    int getPort() const { return port; }
+    unsigned getWorkerCount() const { return reactorCount; }
+
+    /** Threads serving the requests that may wait, so one slow device or upload does not hold up the next */
+    unsigned getRequestWorkerCount() const { return requestWorkerCount; }
+
+    /** Requests handled at once: one per reactor plus the request workers */
+    unsigned getConcurrency() const { return reactorCount + getRequestWorkerCount(); }
+    bool isInitialized() const { return initialized; }
+};
+
+} // namespace Server
+} // namespace ArhintSigner
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <charconv>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstring>
+#include "arena.h"
+#include "metrics.h"
+
+namespace ArhintSigner {
+namespace Http {
+
+/**
+ * Standard reason phrase for a status code
+ */
+inline const char* reasonPhrase(int statusCode) {
+    switch (statusCode) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 499: return "Client Closed Request";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return "Error";
+    }
+}
+
+/**
+ * Case-insensitive ASCII comparison for header names
+ */
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.length() != b.length()) return false;
+    for (size_t i = 0; i < a.length(); i++) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x = (char)(x - 'A' + 'a');
+        if (y >= 'A' && y <= 'Z') y = (char)(y - 'A' + 'a');
+        if (x != y) return false;
+    }
+    return true;
+}
+
+/**
+ * One HTTP request/response exchange, independent of the server backend.
+ *
+ * HTTP.sys (http_utils.h) and the epoll server (epoll_server.h) both
+ * implement this interface, so the routing in request_handler.h runs
+ * unchanged on either.
+ *
+ * Request data is exposed as views into the backend's receive buffer and
+ * responses are taken as views, so an exchange by itself never allocates;
+ * the views are valid until the handler returns.
+ */
+class Exchange {
+protected:
+    std::string_view requestMethod;
+    std::string_view requestUrl;
+    int responseStatus = 0;
+    const Metrics::RequestPhases* phases = nullptr;
+    std::chrono::steady_clock::time_point arrivalTime = std::chrono::steady_clock::now();
+    unsigned retryAfterSeconds = 0;
+    bool isSuspended = false;
+
+    /** Server-Timing header value for the response, empty without phases */
+    size_t serverTiming(char* out, size_t capacity) const {
+        return phases ? phases->format(out, capacity) : 0;
+    }
+
+    /** Retry-After header value for the response, empty when not set */
+    std::string_view retryAfter(char* out, size_t capacity) const {
+        if (retryAfterSeconds == 0) return std::string_view();
+        char* end = std::to_chars(out, out + capacity, retryAfterSeconds).ptr;
+        return std::string_view(out, (size_t)(end - out));
+    }
+
+public:
+    virtual ~Exchange() = default;
+
+    /** Request method, e.g. "GET" */
+    std::string_view method() const { return requestMethod; }
+
+    /** Raw request URL including the query string */
+    std::string_view url() const { return requestUrl; }
+
+    /** Request path without the query string */
+    std::string_view path() const {
+        return requestUrl.substr(0, requestUrl.find('?'));
+    }
+
+    /** Status code of the response sent or started, 0 before that */
+    int status() const { return responseStatus; }
+
+    /**
+     * When the backend received the request; handling may start later when
+     * all workers are busy
+     */
+    std::chrono::steady_clock::time_point arrival() const { return arrivalTime; }
+    void setArrival(std::chrono::steady_clock::time_point time) { arrivalTime = time; }
+
+    /** Send a Retry-After header with the response (0 = none) */
+    void setRetryAfter(unsigned seconds) { retryAfterSeconds = seconds; }
+
+    /** Report these phase timings in the response's Server-Timing header */
+    void setPhases(const Metrics::RequestPhases* requestPhases) { phases = requestPhases; }
+
+    /** Request header value, or an empty view if absent */
+    virtual std::string_view header(std::string_view name) const = 0;
+
+    /**
+     * Whether the client has closed the connection while the request is
+     * being handled. Best effort: false when the backend cannot tell.
+     */
+    virtual bool clientGone() { return false; }
+
+    /**
+     * Read up to length bytes of the request entity body.
+     * Returns 0 once the body has been consumed.
+     */
+    virtual size_t readBody(char* buffer, size_t length) = 0;
+
+    /** Send a complete response with CORS headers */
+    virtual void send(int statusCode, std::string_view contentType, std::string_view body) = 0;
+
+    /**
+     * Send a complete response whose body is the concatenation of slices,
+     * without assembling it first where the backend can gather
+     */
+    virtual void sendGather(int statusCode, std::string_view contentType, const std::vector<std::string_view>& slices) {
+        std::string body;
+        size_t total = 0;
+        for (std::string_view slice : slices) total += slice.size();
+        body.reserve(total);
+        for (std::string_view slice : slices) body.append(slice.data(), slice.size());
+        send(statusCode, contentType, body);
+    }
+
+    /**
+     * Start a streamed response of unknown length (chunked transfer encoding).
+     * Replaces send(); follow with writeChunk() calls and one endStream().
+     */
+    virtual void beginStream(int statusCode, std::string_view contentType) = 0;
+
+    /**
+     * Send one piece of a streamed response right away.
+     * Returns false once the client is gone; later chunks are discarded.
+     */
+    virtual bool writeChunk(std::string_view data) = 0;
+
+    /** Finish a streamed response */
+    virtual void endStream() = 0;
+
+    /**
+     * Let the handler return before its response is ready, so that waiting
+     * for it (e.g. for a Merkle batch window) does not hold the thread the
+     * handler runs on. The backend keeps the exchange and its connection
+     * until resume(); in between, send() may be called once from any thread.
+     * Request headers and body must not be read after suspend(), and the
+     * response has no Server-Timing header. Returns false when the backend
+     * cannot suspend: the handler must then respond before it returns.
+     */
+    virtual bool suspend() { return false; }
+
+    /** Release a suspended exchange once its response was sent; call exactly once */
+    virtual void resume() {}
+
+    /** Whether suspend() succeeded; the exchange belongs to whoever will call resume() */
+    bool suspended() const { return isSuspended; }
+};
+
+/**
+ * Read the request body from an exchange.
+ * Security: reads at most maxBytes + 1 bytes, so callers can reject
+ * oversized bodies by checking length() > maxBytes.
+ */
+inline std::string readRequestBody(Exchange& exchange, size_t maxBytes) {
+    std::string requestBody;
+    const size_t CHUNK_SIZE = 4096;
+    std::vector<char> buffer(CHUNK_SIZE);
+
+    while (requestBody.length() <= maxBytes) {
+        size_t wanted = maxBytes + 1 - requestBody.length();
+        size_t bytesRead = exchange.readBody(buffer.data(), wanted < CHUNK_SIZE ? wanted : CHUNK_SIZE);
+        if (bytesRead == 0) break;
+        requestBody.append(buffer.data(), bytesRead);
+    }
+
+    return requestBody;
+}
+
+/**
+ * Read the request body into the request arena, straight from the backend
+ * without an intermediate buffer. Same size contract as readRequestBody(),
+ * with the size returned in length; the text is mutable (for in-place
+ * parsing) and lives until the arena is reset at the end of the request.
+ */
+inline char* readRequestBody(Exchange& exchange, size_t maxBytes, Memory::Arena& arena, size_t& length) {
+    char* body = arena.allocateArray<char>(maxBytes + 1);
+    length = 0;
+
+    while (length <= maxBytes) {
+        size_t bytesRead = exchange.readBody(body + length, maxBytes + 1 - length);
+        if (bytesRead == 0) break;
+        length += bytesRead;
+    }
+
+    return body;
+}
+
+/**
+ * Pass the request body to consume() piece by piece as it arrives, without
+ * collecting it. Returns the number of bytes read; like readRequestBody()
+ * it stops after maxBytes + 1, so a result > maxBytes means "too large".
+ */
+inline size_t streamRequestBody(Exchange& exchange, size_t maxBytes,
+                                const std::function<void(const char* data, size_t length)>& consume) {
+    char buffer[4096];
+    size_t total = 0;
+
+    while (total <= maxBytes) {
+        size_t wanted = maxBytes + 1 - total;
+        size_t bytesRead = exchange.readBody(buffer, wanted < sizeof(buffer) ? wanted : sizeof(buffer));
+        if (bytesRead == 0) break;
+        total += bytesRead;
+        if (total > maxBytes) break;
+        consume(buffer, bytesRead);
+    }
+
+    return total;
+}
+
+/**
+ * Value of a query string parameter (?name=value&...), percent-decoded into
+ * the request arena; empty when it is absent. Malformed escapes are kept
+ * as they are.
+ */
+inline std::string_view queryParameter(const Exchange& exchange, std::string_view name, Memory::Arena& arena) {
+    std::string_view url = exchange.url();
+    size_t question = url.find('?');
+    if (question == std::string_view::npos) return std::string_view();
+    std::string_view query = url.substr(question + 1);
+
+    auto hexValue = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        size_t eq = pair.find('=');
+        if (pair.substr(0, eq) != name) continue;
+        if (eq == std::string_view::npos) return std::string_view();
+
+        std::string_view encoded = pair.substr(eq + 1);
+        char* decoded = arena.allocateArray<char>(encoded.size() + 1);
+        size_t length = 0;
+        for (size_t i = 0; i < encoded.size(); i++) {
+            char c = encoded[i];
+            if (c == '+') {
+                c = ' ';
+            } else if (c == '%' && i + 2 < encoded.size()) {
+                int high = hexValue(encoded[i + 1]);
+                int low = hexValue(encoded[i + 2]);
+                if (high >= 0 && low >= 0) {
+                    c = (char)(high * 16 + low);
+                    i += 2;
+                }
+            }
+            decoded[length++] = c;
+        }
+        return std::string_view(decoded, length);
+    }
+    return std::string_view();
+}
+
+} // namespace Http
+} // namespace ArhintSigner
@@ -4,8 +4,13 @@
 #include <http.h>
 #include <string>
 #include <vector>
-#include <iostream>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include "logger.h"
+#include "worker_pool.h"
+#include "http_utils.h"
+#include "buffer_pool.h"
 
 #pragma comment(lib, "httpapi.lib")
 
@@ -25,16 +30,165 @@ private:
     HTTP_URL_GROUP_ID urlGroupId;
     HANDLE hReqQueue;
     int port;
+    unsigned workerCount;
+    unsigned receiveCount;
     bool initialized;
+    HANDLE receiveEvent;  // reused by processOneRequest
+
+    /**
+     * One outstanding HttpReceiveHttpRequest call and the buffer it fills
+     */
+    struct ReceiveContext {
+        OVERLAPPED overlapped;
+        std::vector<uint8_t> buffer;
+    };
+
+    /**
+     * Run the handler for one received request
+     * received is when the request came off the queue, for admission control
+     */
+    template<typename RequestHandler>
+    void dispatch(RequestHandler& handler, PHTTP_REQUEST pRequest,
+                  std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now()) {
+        Http::HttpSysExchange exchange(hReqQueue, pRequest);
+        exchange.setArrival(received);
+        handler(exchange);
+    }
+
+    /**
+     * Post an asynchronous receive; completion is delivered to the I/O completion port
+     */
+    bool postReceive(ReceiveContext* context) {
+        // Follow the request sizes seen so far: regrow after oversized requests, shrink after outliers
+        Memory::receiveBuffers().fit(context->buffer);
+        ZeroMemory(&context->overlapped, sizeof(context->overlapped));
+        RtlZeroMemory(context->buffer.data(), sizeof(HTTP_REQUEST));
+
+        ULONG result = HttpReceiveHttpRequest(hReqQueue, HTTP_NULL_ID, 0,
+                                              (PHTTP_REQUEST)context->buffer.data(),
+                                              (ULONG)context->buffer.size(), nullptr,
+                                              &context->overlapped);
+
+        // ERROR_MORE_DATA is a warning status, so a completion packet is still queued
+        return result == ERROR_IO_PENDING || result == NO_ERROR || result == ERROR_MORE_DATA;
+    }
+
+    /**
+     * Receive loop that hands each request to a work-stealing worker pool.
+     * Several receives are kept outstanding so HTTP.sys can complete requests
+     * while the workers are busy signing.
+     */
+    template<typename RequestHandler>
+    void processRequestsPooled(RequestHandler handler) {
+        HANDLE completionPort = CreateIoCompletionPort(hReqQueue, nullptr, 0, 1);
+        if (!completionPort) {
+            Log::error("CreateIoCompletionPort failed with error ", GetLastError());
+            return;
+        }
+
+        Log::info("Dispatching requests on ", workerCount, " workers with ", receiveCount, " outstanding receives");
+
+        std::vector<std::unique_ptr<ReceiveContext>> contexts;
+        std::atomic<unsigned> postedReceives(0);
+
+        auto repost = [&](ReceiveContext* context) {
+            if (g_running && postReceive(context)) return;
+            postedReceives--;
+        };
+
+        for (unsigned i = 0; i < receiveCount; i++) {
+            auto context = std::make_unique<ReceiveContext>();
+            postedReceives++;
+            if (!postReceive(context.get())) {
+                postedReceives--;
+            }
+            contexts.push_back(std::move(context));
+        }
+
+        {
+            Concurrency::WorkStealingPool pool(workerCount);
+
+            while (g_running && postedReceives > 0) {
+                DWORD bytesTransferred = 0;
+                ULONG_PTR completionKey = 0;
+                LPOVERLAPPED overlapped = nullptr;
+
+                BOOL ok = GetQueuedCompletionStatus(completionPort, &bytesTransferred, &completionKey,
+                                                    &overlapped, 250);
+                if (!overlapped) {
+                    // Timeout - loop around to re-check g_running
+                    continue;
+                }
+
+                ReceiveContext* context = CONTAINING_RECORD(overlapped, ReceiveContext, overlapped);
+                ULONG result = ok ? NO_ERROR : GetLastError();
+
+                if (result == ERROR_MORE_DATA) {
+                    // Request buffer too small, resize and fetch the same request synchronously
+                    HTTP_REQUEST_ID requestId = ((PHTTP_REQUEST)context->buffer.data())->RequestId;
+                    context->buffer.resize(bytesTransferred);
+                    ULONG bytesRead = 0;
+                    result = HttpReceiveHttpRequest(hReqQueue, requestId, 0,
+                                                    (PHTTP_REQUEST)context->buffer.data(),
+                                                    (ULONG)context->buffer.size(), &bytesRead, nullptr);
+                    Memory::receiveBuffers().observe(bytesTransferred, false);
+                } else if (result == NO_ERROR) {
+                    Memory::receiveBuffers().observe(bytesTransferred);
+                }
+
+                if (result == NO_ERROR) {
+                    auto received = std::chrono::steady_clock::now();
+                    pool.submit([this, &handler, &repost, context, received]() {
+                        try {
+                            dispatch(handler, (PHTTP_REQUEST)context->buffer.data(), received);
+                        }
+                        catch (...) {
+                            Log::error("Unhandled exception in request handler");
+                        }
+                        repost(context);
+                    });
+                }
+                else if (result == ERROR_OPERATION_ABORTED) {
+                    postedReceives--;
+                }
+                else {
+                    // ERROR_CONNECTION_INVALID or a transient error - keep the slot alive
+                    repost(context);
+                }
+            }
+
+            // Pool destructor runs the handlers still queued; they stop reposting once g_running is false
+        }
+
+        // Cancel the receives still pending in HTTP.sys before their buffers are released
+        CancelIoEx(hReqQueue, nullptr);
+        while (postedReceives > 0) {
+            DWORD bytesTransferred = 0;
+            ULONG_PTR completionKey = 0;
+            LPOVERLAPPED overlapped = nullptr;
+            GetQueuedCompletionStatus(completionPort, &bytesTransferred, &completionKey, &overlapped, 1000);
+            if (!overlapped) break;
+            postedReceives--;
+        }
+
+        CloseHandle(completionPort);
+    }
 
 public:
-    HttpServer(int serverPort = 8082) 
+    /**
+     * workers = 0 processes requests inline on the receive thread;
+     * receives = number of HttpReceiveHttpRequest calls kept outstanding
+     */
+    HttpServer(int serverPort = 8082, unsigned workers = 0, unsigned receives = 0) 
         : httpApiVersion(HTTPAPI_VERSION_2)
         , sessionId(0)
         , urlGroupId(0)
         , hReqQueue(nullptr)
         , port(serverPort)
-        , initialized(false) {
+        , workerCount(workers)
+        , receiveCount(receives > 0 ? receives : (workers > 0 ? workers * 2 : 1))
+        , initialized(false)
+        , receiveEvent(nullptr) {
     }
 
     ~HttpServer() {
@@ -56,7 +210,7 @@ public:
         // Create server session
         result = HttpCreateServerSession(httpApiVersion, &sessionId, 0);
         if (result != NO_ERROR) {
-            std::cerr << "HttpCreateServerSession failed with error " << result << std::endl;
+            Log::error("HttpCreateServerSession failed with error ", result);
             HttpTerminate(HTTP_INITIALIZE_SERVER, nullptr);
             return false;
         }
@@ -64,7 +218,7 @@ public:
         // Create URL group
         result = HttpCreateUrlGroup(sessionId, &urlGroupId, 0);
         if (result != NO_ERROR) {
-            std::cerr << "HttpCreateUrlGroup failed with error " << result << std::endl;
+            Log::error("HttpCreateUrlGroup failed with error ", result);
             HttpCloseServerSession(sessionId);
             HttpTerminate(HTTP_INITIALIZE_SERVER, nullptr);
             return false;
@@ -73,7 +227,7 @@ public:
         // Create request queue
         result = HttpCreateRequestQueue(httpApiVersion, nullptr, nullptr, 0, &hReqQueue);
         if (result != NO_ERROR) {
-            std::cerr << "HttpCreateRequestQueue failed with error " << result << std::endl;
+            Log::error("HttpCreateRequestQueue failed with error ", result);
             HttpCloseUrlGroup(urlGroupId);
             HttpCloseServerSession(sessionId);
             HttpTerminate(HTTP_INITIALIZE_SERVER, nullptr);
@@ -88,7 +242,7 @@ public:
         result = HttpSetUrlGroupProperty(urlGroupId, HttpServerBindingProperty, 
                                          &bindingInfo, sizeof(bindingInfo));
         if (result != NO_ERROR) {
-            std::cerr << "HttpSetUrlGroupProperty failed with error " << result << std::endl;
+            Log::error("HttpSetUrlGroupProperty failed with error ", result);
             HttpCloseRequestQueue(hReqQueue);
             HttpCloseUrlGroup(urlGroupId);
             HttpCloseServerSession(sessionId);
@@ -100,8 +254,8 @@ public:
         std::wstring urlPrefix = L"http://+:" + std::to_wstring(port) + L"/";
         result = HttpAddUrlToUrlGroup(urlGroupId, urlPrefix.c_str(), 0, 0);
         if (result != NO_ERROR) {
-            std::cerr << "HttpAddUrlToUrlGroup failed with error " << result << std::endl;
-            std::wcerr << L"Failed to add URL: " << urlPrefix << std::endl;
+            Log::error("HttpAddUrlToUrlGroup failed with error ", result);
+            Log::error("Failed to add URL: http://+:", port, "/");
             HttpCloseRequestQueue(hReqQueue);
             HttpCloseUrlGroup(urlGroupId);
             HttpCloseServerSession(sessionId);
@@ -109,7 +263,7 @@ public:
             return false;
         }
         
-        std::wcout << L"Listening on " << urlPrefix << std::endl;
+        Log::info("Listening on http://+:", port, "/");
 
         initialized = true;
         return true;
@@ -117,37 +271,49 @@ public:
 
     /**
      * Process incoming requests (blocking call)
+     * The handler is called as handler(Http::Exchange&); the servedInline
+     * argument exists for parity with the epoll backend
      */
     template<typename RequestHandler>
-    void processRequests(RequestHandler handler) {
+    void processRequests(RequestHandler handler, bool (*servedInline)(std::string_view, std::string_view) = nullptr) {
+        (void)servedInline;
         if (!initialized) {
             return;
         }
 
-        ULONG requestBufferSize = sizeof(HTTP_REQUEST) + 2048;
-        std::vector<BYTE> requestBuffer(requestBufferSize);
-        PHTTP_REQUEST pRequest = (PHTTP_REQUEST)requestBuffer.data();
+        if (workerCount > 0) {
+            processRequestsPooled(handler);
+            return;
+        }
+
+        Memory::BufferPool& buffers = Memory::receiveBuffers();
+        std::vector<uint8_t> requestBuffer = buffers.acquire();
 
         while (g_running) {
-            RtlZeroMemory(pRequest, requestBufferSize);
+            buffers.fit(requestBuffer);
+            ULONG requestBufferSize = (ULONG)requestBuffer.size();
+            PHTTP_REQUEST pRequest = (PHTTP_REQUEST)requestBuffer.data();
+            RtlZeroMemory(pRequest, sizeof(HTTP_REQUEST));
             ULONG bytesRead;
 
             ULONG result = HttpReceiveHttpRequest(hReqQueue, HTTP_NULL_ID, 0, pRequest, 
                                                   requestBufferSize, &bytesRead, nullptr);
 
             if (result == NO_ERROR) {
-                handler(hReqQueue, pRequest);
+                buffers.observe(bytesRead);
+                dispatch(handler, pRequest);
             }
             else if (result == ERROR_MORE_DATA) {
                 // Request buffer too small, resize and retry
-                requestBufferSize = bytesRead;
-                requestBuffer.resize(requestBufferSize);
+                HTTP_REQUEST_ID requestId = pRequest->RequestId;
+                buffers.observe(bytesRead, false);
+                requestBuffer.resize(bytesRead);
                 pRequest = (PHTTP_REQUEST)requestBuffer.data();
 
-                result = HttpReceiveHttpRequest(hReqQueue, pRequest->RequestId, 0, pRequest,
-                                               requestBufferSize, &bytesRead, nullptr);
+                result = HttpReceiveHttpRequest(hReqQueue, requestId, 0, pRequest,
+                                               bytesRead, &bytesRead, nullptr);
                 if (result == NO_ERROR) {
-                    handler(hReqQueue, pRequest);
+                    dispatch(handler, pRequest);
                 }
             }
             else if (result == ERROR_CONNECTION_INVALID) {
@@ -159,6 +325,7 @@ public:
                 break;
             }
         }
+        buffers.release(std::move(requestBuffer));
     }
 
     /**
@@ -171,55 +338,62 @@ public:
             return false;
         }
 
-        ULONG requestBufferSize = sizeof(HTTP_REQUEST) + 2048;
-        std::vector<BYTE> requestBuffer(requestBufferSize);
+        if (!receiveEvent) {
+            receiveEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+            if (!receiveEvent) return false;
+        }
+
+        Memory::BufferPool& buffers = Memory::receiveBuffers();
+        std::vector<uint8_t> requestBuffer = buffers.acquire();
+        ULONG requestBufferSize = (ULONG)requestBuffer.size();
         PHTTP_REQUEST pRequest = (PHTTP_REQUEST)requestBuffer.data();
 
-        RtlZeroMemory(pRequest, requestBufferSize);
-        ULONG bytesRead;
+        RtlZeroMemory(pRequest, sizeof(HTTP_REQUEST));
+        ULONG bytesRead = 0;
 
         // Use overlapped I/O for non-blocking operation
         OVERLAPPED overlapped = { 0 };
-        overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        ResetEvent(receiveEvent);
+        overlapped.hEvent = receiveEvent;
 
         ULONG result = HttpReceiveHttpRequest(hReqQueue, HTTP_NULL_ID, 
                                               HTTP_RECEIVE_REQUEST_FLAG_COPY_BODY,
                                               pRequest, requestBufferSize, &bytesRead, &overlapped);
 
-        bool processed = false;
-
         if (result == ERROR_IO_PENDING) {
-            // Wait for request with timeout
-            DWORD waitResult = WaitForSingleObject(overlapped.hEvent, timeoutMs);
-            if (waitResult == WAIT_OBJECT_0) {
-                // Get the result of the overlapped operation
-                DWORD bytesTransferred = 0;
-                if (GetOverlappedResult(hReqQueue, &overlapped, &bytesTransferred, FALSE)) {
-                    // Request received successfully
-                    handler(hReqQueue, pRequest);
-                    processed = true;
-                }
+            // Wait for request with timeout; a receive still pending is cancelled
+            // before its buffer goes back to the pool
+            DWORD bytesTransferred = 0;
+            if (WaitForSingleObject(receiveEvent, timeoutMs) != WAIT_OBJECT_0) {
+                CancelIoEx(hReqQueue, &overlapped);
             }
+            result = GetOverlappedResult(hReqQueue, &overlapped, &bytesTransferred, TRUE) ? NO_ERROR : GetLastError();
+            bytesRead = bytesTransferred;
         }
-        else if (result == NO_ERROR) {
-            handler(hReqQueue, pRequest);
+
+        bool processed = false;
+
+        if (result == NO_ERROR) {
+            buffers.observe(bytesRead);
+            dispatch(handler, pRequest);
             processed = true;
         }
         else if (result == ERROR_MORE_DATA) {
             // Request buffer too small, resize and retry
-            requestBufferSize = bytesRead;
-            requestBuffer.resize(requestBufferSize);
+            HTTP_REQUEST_ID requestId = pRequest->RequestId;
+            buffers.observe(bytesRead, false);
+            requestBuffer.resize(bytesRead);
             pRequest = (PHTTP_REQUEST)requestBuffer.data();
 
-            result = HttpReceiveHttpRequest(hReqQueue, pRequest->RequestId, 0, pRequest,
-                                           requestBufferSize, &bytesRead, nullptr);
+            result = HttpReceiveHttpRequest(hReqQueue, requestId, HTTP_RECEIVE_REQUEST_FLAG_COPY_BODY, pRequest,
+                                           bytesRead, &bytesRead, nullptr);
             if (result == NO_ERROR) {
-                handler(hReqQueue, pRequest);
+                dispatch(handler, pRequest);
                 processed = true;
             }
         }
 
-        CloseHandle(overlapped.hEvent);
+        buffers.release(std::move(requestBuffer));
         return processed;
     }
 
@@ -242,11 +416,19 @@ public:
             HttpCloseServerSession(sessionId);
         }
         HttpTerminate(HTTP_INITIALIZE_SERVER, nullptr);
+        if (receiveEvent) {
+            CloseHandle(receiveEvent);
+            receiveEvent = nullptr;
+        }
 
         initialized = false;
     }
 
     int getPort() const { return port; }
+    unsigned getWorkerCount() const { return workerCount; }
+
+    /** Requests handled at once: the pool's workers, or one on the receive thread */
+    unsigned getConcurrency() const { return workerCount > 0 ? workerCount : 1; }
     bool isInitialized() const { return initialized; }
 };
 
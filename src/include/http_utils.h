@@ -3,7 +3,10 @@
 #include <windows.h>
 #include <http.h>
 #include <string>
-#include <iostream>
+#include <string_view>
+#include <vector>
+#include "logger.h"
+#include "http_exchange.h"
 
 #pragma comment(lib, "httpapi.lib")
 
@@ -11,45 +14,54 @@ namespace ArhintSigner {
 namespace Http {
 
 /**
- * Send an HTTP response with optional CORS headers
+ * Send an HTTP response whose body is gathered from the given data chunks
+ * With HTTP_SEND_RESPONSE_FLAG_MORE_DATA the entity body follows in
+ * sendEntityChunk() calls and HTTP.sys uses chunked transfer encoding.
+ * A non-empty serverTiming is sent as the Server-Timing header, a non-empty
+ * retryAfter as Retry-After.
  */
-inline void sendResponse(HANDLE hReqQueue, HTTP_REQUEST_ID requestId, USHORT statusCode, 
-                        const std::string& contentType, const std::string& body,
-                        bool includeCors = true) {
+inline bool sendResponseChunks(HANDLE hReqQueue, HTTP_REQUEST_ID requestId, USHORT statusCode,
+                               std::string_view contentType, HTTP_DATA_CHUNK* chunks, USHORT chunkCount,
+                               bool includeCors = true, ULONG flags = 0, std::string_view serverTiming = {},
+                               std::string_view retryAfter = {}) {
     // Static CORS headers to ensure they persist during the HTTP API call
     static const char* corsOriginHeader = "Access-Control-Allow-Origin";
     static const char* corsOriginValue = "*";
     static const char* corsMethodsHeader = "Access-Control-Allow-Methods";
     static const char* corsMethodsValue = "GET, POST, OPTIONS";
     static const char* corsHeadersHeader = "Access-Control-Allow-Headers";
-    static const char* corsHeadersValue = "Content-Type";
+    static const char* corsHeadersValue = "Content-Type, X-Deadline-Ms, X-Priority";
+    static const char* corsExposeHeader = "Access-Control-Expose-Headers";
+    static const char* timingAllowHeader = "Timing-Allow-Origin";
+    static const char* serverTimingHeader = "Server-Timing";
+    static const char* serverTimingValue = "Server-Timing";
     
     HTTP_RESPONSE response;
-    HTTP_DATA_CHUNK dataChunk;
-    HTTP_UNKNOWN_HEADER unknownHeaders[3];
+    HTTP_UNKNOWN_HEADER unknownHeaders[6];
+    USHORT unknownHeaderCount = 0;
     
     ZeroMemory(&response, sizeof(response));
-    ZeroMemory(&dataChunk, sizeof(dataChunk));
     
     // Set HTTP version
     response.Version.MajorVersion = 1;
     response.Version.MinorVersion = 1;
     
     response.StatusCode = statusCode;
-    response.pReason = (statusCode == 200) ? "OK" : 
-                       (statusCode == 400) ? "Bad Request" :
-                       (statusCode == 404) ? "Not Found" :
-                       (statusCode == 500) ? "Internal Server Error" : "Error";
+    response.pReason = reasonPhrase(statusCode);
     response.ReasonLength = (USHORT)strlen(response.pReason);
 
     // Add content-type header
-    response.Headers.KnownHeaders[HttpHeaderContentType].pRawValue = contentType.c_str();
+    response.Headers.KnownHeaders[HttpHeaderContentType].pRawValue = contentType.data();
     response.Headers.KnownHeaders[HttpHeaderContentType].RawValueLength = (USHORT)contentType.length();
+    if (!retryAfter.empty()) {
+        response.Headers.KnownHeaders[HttpHeaderRetryAfter].pRawValue = retryAfter.data();
+        response.Headers.KnownHeaders[HttpHeaderRetryAfter].RawValueLength = (USHORT)retryAfter.length();
+    }
+
+    ZeroMemory(unknownHeaders, sizeof(unknownHeaders));
 
     // Add CORS headers
     if (includeCors) {
-        ZeroMemory(unknownHeaders, sizeof(unknownHeaders));
-        
         unknownHeaders[0].pName = corsOriginHeader;
         unknownHeaders[0].NameLength = (USHORT)strlen(corsOriginHeader);
         unknownHeaders[0].pRawValue = corsOriginValue;
@@ -65,81 +77,306 @@ inline void sendResponse(HANDLE hReqQueue, HTTP_REQUEST_ID requestId, USHORT sta
         unknownHeaders[2].pRawValue = corsHeadersValue;
         unknownHeaders[2].RawValueLength = (USHORT)strlen(corsHeadersValue);
 
+        // Let browser RUM read Server-Timing cross-origin
+        unknownHeaders[3].pName = corsExposeHeader;
+        unknownHeaders[3].NameLength = (USHORT)strlen(corsExposeHeader);
+        unknownHeaders[3].pRawValue = serverTimingValue;
+        unknownHeaders[3].RawValueLength = (USHORT)strlen(serverTimingValue);
+
+        unknownHeaders[4].pName = timingAllowHeader;
+        unknownHeaders[4].NameLength = (USHORT)strlen(timingAllowHeader);
+        unknownHeaders[4].pRawValue = corsOriginValue;
+        unknownHeaders[4].RawValueLength = (USHORT)strlen(corsOriginValue);
+
+        unknownHeaderCount = 5;
+    }
+
+    // Add phase timings
+    if (!serverTiming.empty()) {
+        unknownHeaders[unknownHeaderCount].pName = serverTimingHeader;
+        unknownHeaders[unknownHeaderCount].NameLength = (USHORT)strlen(serverTimingHeader);
+        unknownHeaders[unknownHeaderCount].pRawValue = serverTiming.data();
+        unknownHeaders[unknownHeaderCount].RawValueLength = (USHORT)serverTiming.length();
+        unknownHeaderCount++;
+    }
+
+    if (unknownHeaderCount > 0) {
         response.Headers.pUnknownHeaders = unknownHeaders;
-        response.Headers.UnknownHeaderCount = 3;
+        response.Headers.UnknownHeaderCount = unknownHeaderCount;
     }
 
     // Set response body
-    if (!body.empty()) {
-        dataChunk.DataChunkType = HttpDataChunkFromMemory;
-        dataChunk.FromMemory.pBuffer = (PVOID)body.c_str();
-        dataChunk.FromMemory.BufferLength = (ULONG)body.length();
-
-        response.EntityChunkCount = 1;
-        response.pEntityChunks = &dataChunk;
+    if (chunkCount > 0) {
+        response.EntityChunkCount = chunkCount;
+        response.pEntityChunks = chunks;
     }
 
     ULONG bytesSent;
-    ULONG result = HttpSendHttpResponse(hReqQueue, requestId, 0, &response, nullptr, 
+    ULONG result = HttpSendHttpResponse(hReqQueue, requestId, flags, &response, nullptr, 
                                        &bytesSent, nullptr, 0, nullptr, nullptr);
     
     if (result != NO_ERROR) {
-        std::cerr << "HttpSendHttpResponse failed with error: " << result << std::endl;
-    } else {
-        std::cout << "Response sent: " << statusCode << " (" << bytesSent << " bytes)" << std::endl;
+        Log::error("HttpSendHttpResponse failed with error: ", result);
+        return false;
     }
+    Log::debug("Response sent: ", statusCode, " (", bytesSent, " bytes)");
+    return true;
 }
 
 /**
- * Read the request body from an HTTP request
+ * Send an HTTP response with optional CORS headers
  */
-inline std::string readRequestBody(HANDLE hReqQueue, PHTTP_REQUEST pRequest) {
-    std::string requestBody;
-    
-    // First, try to get body from entity chunks if available
-    if (pRequest->EntityChunkCount > 0 && pRequest->pEntityChunks) {
-        HTTP_DATA_CHUNK* chunk = &pRequest->pEntityChunks[0];
-        if (chunk->DataChunkType == HttpDataChunkFromMemory) {
-            requestBody = std::string((char*)chunk->FromMemory.pBuffer, 
-                                    chunk->FromMemory.BufferLength);
+inline bool sendResponse(HANDLE hReqQueue, HTTP_REQUEST_ID requestId, USHORT statusCode, 
+                        std::string_view contentType, std::string_view body,
+                        bool includeCors = true, ULONG flags = 0, std::string_view serverTiming = {},
+                        std::string_view retryAfter = {}) {
+    HTTP_DATA_CHUNK dataChunk;
+    ZeroMemory(&dataChunk, sizeof(dataChunk));
+    dataChunk.DataChunkType = HttpDataChunkFromMemory;
+    dataChunk.FromMemory.pBuffer = (PVOID)body.data();
+    dataChunk.FromMemory.BufferLength = (ULONG)body.length();
+    return sendResponseChunks(hReqQueue, requestId, statusCode, contentType,
+                              &dataChunk, body.empty() ? 0 : 1, includeCors, flags, serverTiming, retryAfter);
+}
+
+/**
+ * Send part of a response body started with HTTP_SEND_RESPONSE_FLAG_MORE_DATA
+ * Pass moreData = false with the last piece (which may be empty).
+ */
+inline bool sendEntityChunk(HANDLE hReqQueue, HTTP_REQUEST_ID requestId, std::string_view data, bool moreData) {
+    HTTP_DATA_CHUNK dataChunk;
+    ZeroMemory(&dataChunk, sizeof(dataChunk));
+    dataChunk.DataChunkType = HttpDataChunkFromMemory;
+    dataChunk.FromMemory.pBuffer = (PVOID)data.data();
+    dataChunk.FromMemory.BufferLength = (ULONG)data.length();
+
+    ULONG bytesSent = 0;
+    ULONG result = HttpSendResponseEntityBody(hReqQueue, requestId,
+                                              moreData ? HTTP_SEND_RESPONSE_FLAG_MORE_DATA : 0,
+                                              data.empty() ? 0 : 1, data.empty() ? nullptr : &dataChunk,
+                                              &bytesSent, nullptr, 0, nullptr, nullptr);
+    if (result != NO_ERROR) {
+        Log::error("HttpSendResponseEntityBody failed with error: ", result);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Exchange backed by an HTTP.sys request
+ */
+class HttpSysExchange : public Exchange {
+private:
+    HANDLE hReqQueue;
+    PHTTP_REQUEST pRequest;
+    USHORT chunkIndex;
+    ULONG chunkOffset;
+    bool bodyComplete;
+    bool responded;
+    bool streaming;
+    bool streamFailed;
+    enum class DisconnectWatch { Idle, Armed, Unavailable } disconnectWatch;
+    OVERLAPPED disconnect;
+    HANDLE disconnectEvent;
+
+    static const char* verbName(const HTTP_REQUEST* request) {
+        switch (request->Verb) {
+            case HttpVerbGET: return "GET";
+            case HttpVerbPOST: return "POST";
+            case HttpVerbOPTIONS: return "OPTIONS";
+            case HttpVerbHEAD: return "HEAD";
+            case HttpVerbPUT: return "PUT";
+            case HttpVerbDELETE: return "DELETE";
+            default: return "UNKNOWN";
         }
     }
-    
-    // If not available, read the entity body
-    if (requestBody.empty()) {
-        // Security: Limit total body size to prevent excessive memory allocation
-        const ULONG MAX_REQUEST_SIZE = 10240; // 10KB max
-        const ULONG CHUNK_SIZE = 4096;
-        std::vector<char> buffer(CHUNK_SIZE);
-        ULONG bytesRead = 0;
-        ULONG totalRead = 0;
-        
-        ULONG result;
-        do {
-            bytesRead = 0;
-            result = HttpReceiveRequestEntityBody(
-                hReqQueue,
-                pRequest->RequestId,
-                0,
-                buffer.data(),
-                CHUNK_SIZE,
-                &bytesRead,
-                nullptr);
-            
-            if (bytesRead > 0 && bytesRead <= CHUNK_SIZE) {
-                if (totalRead + bytesRead > MAX_REQUEST_SIZE) {
-                    // Body exceeds size limit - truncate and stop
-                    requestBody.append(buffer.data(), MAX_REQUEST_SIZE - totalRead);
-                    break;
-                }
-                requestBody.append(buffer.data(), bytesRead);
-                totalRead += bytesRead;
+
+public:
+    HttpSysExchange(HANDLE queue, PHTTP_REQUEST request)
+        : hReqQueue(queue)
+        , pRequest(request)
+        , chunkIndex(0)
+        , chunkOffset(0)
+        , bodyComplete(false)
+        , responded(false)
+        , streaming(false)
+        , streamFailed(false)
+        , disconnectWatch(DisconnectWatch::Idle)
+        , disconnect()
+        , disconnectEvent(nullptr) {
+        requestMethod = verbName(request);
+        requestUrl = request->pRawUrl ? std::string_view(request->pRawUrl, request->RawUrlLength) : "/";
+    }
+
+    ~HttpSysExchange() {
+        // A handler that failed mid-stream still has to complete the response
+        endStream();
+        if (disconnectWatch == DisconnectWatch::Armed) {
+            // The OVERLAPPED lives in this object - wait for the cancelled wait to finish
+            CancelIoEx(hReqQueue, &disconnect);
+            WaitForSingleObject(disconnectEvent, INFINITE);
+        }
+        if (disconnectEvent) {
+            CloseHandle(disconnectEvent);
+        }
+    }
+
+    bool clientGone() override {
+        if (disconnectWatch == DisconnectWatch::Unavailable) return false;
+        if (disconnectWatch == DisconnectWatch::Idle) {
+            // Start watching on first use; most requests never ask
+            disconnectEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+            if (!disconnectEvent) {
+                disconnectWatch = DisconnectWatch::Unavailable;
+                return false;
+            }
+            // Low bit set: signal the event only, not the queue's completion port
+            disconnect.hEvent = (HANDLE)((ULONG_PTR)disconnectEvent | 1);
+            ULONG result = HttpWaitForDisconnect(hReqQueue, pRequest->ConnectionId, &disconnect);
+            if (result != NO_ERROR && result != ERROR_IO_PENDING) {
+                disconnectWatch = DisconnectWatch::Unavailable;
+                return false;
             }
-        } while (result == NO_ERROR);
+            disconnectWatch = DisconnectWatch::Armed;
+        }
+        return WaitForSingleObject(disconnectEvent, 0) == WAIT_OBJECT_0;
     }
-    
-    return requestBody;
-}
+
+    std::string_view header(std::string_view name) const override {
+        // Request headers HTTP.sys parses into KnownHeaders
+        static const struct { const char* name; HTTP_HEADER_ID id; } knownHeaders[] = {
+            { "Connection", HttpHeaderConnection },
+            { "Content-Length", HttpHeaderContentLength },
+            { "Content-Type", HttpHeaderContentType },
+            { "Accept", HttpHeaderAccept },
+            { "Host", HttpHeaderHost },
+            { "Referer", HttpHeaderReferer },
+            { "User-Agent", HttpHeaderUserAgent },
+        };
+
+        for (const auto& known : knownHeaders) {
+            if (equalsIgnoreCase(name, known.name)) {
+                const HTTP_KNOWN_HEADER& value = pRequest->Headers.KnownHeaders[known.id];
+                return value.pRawValue ? std::string_view(value.pRawValue, value.RawValueLength) : std::string_view();
+            }
+        }
+
+        for (USHORT i = 0; i < pRequest->Headers.UnknownHeaderCount; i++) {
+            const HTTP_UNKNOWN_HEADER& unknown = pRequest->Headers.pUnknownHeaders[i];
+            if (equalsIgnoreCase(std::string_view(unknown.pName, unknown.NameLength), name)) {
+                return std::string_view(unknown.pRawValue, unknown.RawValueLength);
+            }
+        }
+        return std::string_view();
+    }
+
+    size_t readBody(char* buffer, size_t length) override {
+        // First, drain entity chunks that arrived with the request headers
+        while (chunkIndex < pRequest->EntityChunkCount && pRequest->pEntityChunks) {
+            const HTTP_DATA_CHUNK& chunk = pRequest->pEntityChunks[chunkIndex];
+            if (chunk.DataChunkType != HttpDataChunkFromMemory ||
+                chunkOffset >= chunk.FromMemory.BufferLength) {
+                chunkIndex++;
+                chunkOffset = 0;
+                continue;
+            }
+            size_t available = chunk.FromMemory.BufferLength - chunkOffset;
+            size_t count = available < length ? available : length;
+            memcpy(buffer, (const char*)chunk.FromMemory.pBuffer + chunkOffset, count);
+            chunkOffset += (ULONG)count;
+            return count;
+        }
+
+        // Then read the rest of the entity body from the request queue
+        if (bodyComplete || length == 0) {
+            return 0;
+        }
+
+        ULONG bytesRead = 0;
+        ULONG result = HttpReceiveRequestEntityBody(
+            hReqQueue,
+            pRequest->RequestId,
+            0,
+            buffer,
+            length > MAXULONG ? MAXULONG : (ULONG)length,
+            &bytesRead,
+            nullptr);
+
+        if (result != NO_ERROR || bytesRead == 0) {
+            bodyComplete = true;
+        }
+        return bytesRead;
+    }
+
+    void send(int statusCode, std::string_view contentType, std::string_view body) override {
+        if (responded) return;
+        responded = true;
+        responseStatus = statusCode;
+        char timing[256];
+        size_t timingLength = serverTiming(timing, sizeof(timing));
+        char retry[12];
+        sendResponse(hReqQueue, pRequest->RequestId, (USHORT)statusCode, contentType, body,
+                     true, 0, std::string_view(timing, timingLength), retryAfter(retry, sizeof(retry)));
+    }
+
+    void sendGather(int statusCode, std::string_view contentType,
+                    const std::vector<std::string_view>& slices) override {
+        if (slices.size() > 0xFFFF) {
+            // More slices than one response can carry - assemble instead
+            Exchange::sendGather(statusCode, contentType, slices);
+            return;
+        }
+        if (responded) return;
+        responded = true;
+        responseStatus = statusCode;
+
+        std::vector<HTTP_DATA_CHUNK> chunks;
+        chunks.reserve(slices.size());
+        for (std::string_view slice : slices) {
+            if (slice.empty()) continue;
+            HTTP_DATA_CHUNK chunk;
+            ZeroMemory(&chunk, sizeof(chunk));
+            chunk.DataChunkType = HttpDataChunkFromMemory;
+            chunk.FromMemory.pBuffer = (PVOID)slice.data();
+            chunk.FromMemory.BufferLength = (ULONG)slice.size();
+            chunks.push_back(chunk);
+        }
+        char timing[256];
+        size_t timingLength = serverTiming(timing, sizeof(timing));
+        char retry[12];
+        sendResponseChunks(hReqQueue, pRequest->RequestId, (USHORT)statusCode, contentType,
+                           chunks.data(), (USHORT)chunks.size(), true, 0, std::string_view(timing, timingLength),
+                           retryAfter(retry, sizeof(retry)));
+    }
+
+    void beginStream(int statusCode, std::string_view contentType) override {
+        if (responded) return;
+        responded = true;
+        responseStatus = statusCode;
+        streaming = true;
+        char timing[256];
+        size_t timingLength = serverTiming(timing, sizeof(timing));
+        char retry[12];
+        streamFailed = !sendResponse(hReqQueue, pRequest->RequestId, (USHORT)statusCode, contentType, "",
+                                     true, HTTP_SEND_RESPONSE_FLAG_MORE_DATA, std::string_view(timing, timingLength),
+                                     retryAfter(retry, sizeof(retry)));
+    }
+
+    bool writeChunk(std::string_view data) override {
+        if (!streaming || streamFailed) return false;
+        if (data.empty()) return true;
+        streamFailed = !sendEntityChunk(hReqQueue, pRequest->RequestId, data, true);
+        return !streamFailed;
+    }
+
+    void endStream() override {
+        if (!streaming) return;
+        streaming = false;
+        if (!streamFailed) {
+            sendEntityChunk(hReqQueue, pRequest->RequestId, "", false);
+        }
+    }
+};
 
 } // namespace Http
 } // namespace ArhintSigner
@@ -1,100 +1,1030 @@
 #pragma once
 
 #include <string>
-#include <sstream>
-#include <iomanip>
-#include <map>
-#include <regex>
+#include <string_view>
+#include <array>
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ARHINT_JSON_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 namespace ArhintSigner {
 namespace Json {
 
+/**
+ * True for characters that must be escaped inside a JSON string
+ */
+inline bool needsEscape(char c) {
+    return c == '"' || c == '\\' || (unsigned char)c < 0x20;
+}
+
+/**
+ * First character in [p, end) that must be escaped, or end
+ * Scans 16 bytes per step with SSE2 where available.
+ */
+inline const char* findEscape(const char* p, const char* end) {
+#ifdef ARHINT_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                    _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));  // c <= 0x1F
+        unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+        if (mask != 0) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return p + index;
+#else
+            return p + __builtin_ctz(mask);
+#endif
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && !needsEscape(*p)) p++;
+    return p;
+}
+
+/**
+ * Append s to out as the contents of a JSON string; runs without special
+ * characters are copied in bulk
+ */
+inline void appendEscaped(std::string& out, std::string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    const char* p = s.data();
+    const char* end = p + s.size();
+    while (p < end) {
+        const char* special = findEscape(p, end);
+        out.append(p, (size_t)(special - p));
+        if (special == end) break;
+
+        char c = *special;
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                char escape[6] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0x1], hex[c & 0xF] };
+                out.append(escape, sizeof(escape));
+            }
+        }
+        p = special + 1;
+    }
+}
+
 /**
  * Simple JSON builder for creating JSON responses
  */
 class Builder {
 private:
-    std::ostringstream ss;
+    std::string out;
     bool first;
 
-    std::string escapeJson(const std::string& s) {
-        std::ostringstream o;
-        for (char c : s) {
-            switch (c) {
-                case '"': o << "\\\""; break;
-                case '\\': o << "\\\\"; break;
-                case '\b': o << "\\b"; break;
-                case '\f': o << "\\f"; break;
-                case '\n': o << "\\n"; break;
-                case '\r': o << "\\r"; break;
-                case '\t': o << "\\t"; break;
-                default:
-                    if ('\x00' <= c && c <= '\x1f') {
-                        o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c;
-                    } else {
-                        o << c;
-                    }
-            }
-        }
-        return o.str();
+    void appendKey(const std::string& key) {
+        out += first ? "\"" : ",\"";
+        appendEscaped(out, key);
+        out += "\":";
+        first = false;
     }
 
 public:
     Builder() : first(true) {
-        ss << "{";
+        out.reserve(128);
+        out += "{";
     }
 
     void addString(const std::string& key, const std::string& value) {
-        if (!first) ss << ",";
-        ss << "\"" << escapeJson(key) << "\":\"" << escapeJson(value) << "\"";
-        first = false;
+        appendKey(key);
+        out += "\"";
+        appendEscaped(out, value);
+        out += "\"";
     }
 
     void addBool(const std::string& key, bool value) {
-        if (!first) ss << ",";
-        ss << "\"" << escapeJson(key) << "\":" << (value ? "true" : "false");
-        first = false;
+        appendKey(key);
+        out += value ? "true" : "false";
+    }
+
+    void addNumber(const std::string& key, long long value) {
+        appendKey(key);
+        out += std::to_string(value);
     }
 
     void addArray(const std::string& key, const std::string& arrayContent) {
-        if (!first) ss << ",";
-        ss << "\"" << escapeJson(key) << "\":" << arrayContent;
-        first = false;
+        appendKey(key);
+        out += arrayContent;
     }
 
     void addObject(const std::string& key, const std::string& objectContent) {
-        if (!first) ss << ",";
-        ss << "\"" << escapeJson(key) << "\":" << objectContent;
-        first = false;
+        appendKey(key);
+        out += objectContent;
     }
 
     std::string toString() {
-        return ss.str() + "}";
+        return out + "}";
+    }
+};
+
+/**
+ * Member name written verbatim: quoted, escaped and followed by the colon,
+ * all at compile time. StaticKey("label") holds "\"label\":"; a name that
+ * would need escaping does not compile.
+ */
+template <size_t N>
+class StaticKey {
+private:
+    char text[N + 2];  // N - 1 characters, two quotes and a colon
+
+public:
+    constexpr StaticKey(const char (&name)[N])
+        : text{} {
+        text[0] = '"';
+        for (size_t i = 0; i + 1 < N; i++) {
+            if (name[i] == '"' || name[i] == '\\' || (unsigned char)name[i] < 0x20) {
+                throw std::logic_error("JSON key must not need escaping");
+            }
+            text[i + 1] = name[i];
+        }
+        text[N] = '"';
+        text[N + 1] = ':';
+    }
+
+    constexpr std::string_view quoted() const { return std::string_view(text, N + 2); }
+};
+
+/**
+ * Streaming JSON writer appending into one reusable buffer
+ *
+ * Reserve the expected size up front; clear() keeps the capacity for the
+ * next document. Pre-serialized values can be copied in (raw) or only
+ * referenced (fragment); with fragments the document is emitted as a
+ * scatter/gather list by slices(), and referenced data must outlive it.
+ */
+class Writer {
+private:
+    struct Segment {
+        const char* external;  // nullptr: bytes [offset, offset + length) of out
+        size_t offset;
+        size_t length;
+    };
+
+    static constexpr size_t MAX_DEPTH = 64;
+
+    std::string out;
+    std::vector<Segment> segments;
+    size_t flushed = 0;         // bytes of out already covered by segments
+    uint64_t hasElements = 0;   // bit per nesting level
+    size_t depth = 0;
+    bool afterKey = false;
+
+    void separator() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (depth == 0) return;
+        uint64_t bit = 1ULL << (depth - 1);
+        if (hasElements & bit) out += ',';
+        hasElements |= bit;
+    }
+
+    void open(char bracket) {
+        separator();
+        if (depth >= MAX_DEPTH) throw std::logic_error("JSON writer nesting too deep");
+        out += bracket;
+        depth++;
+        hasElements &= ~(1ULL << (depth - 1));
+    }
+
+    void close(char bracket) {
+        depth--;
+        out += bracket;
+    }
+
+public:
+    explicit Writer(size_t estimate = 256) {
+        out.reserve(estimate);
+    }
+
+    /** Start a new document, keeping the buffer */
+    void clear() {
+        out.clear();
+        segments.clear();
+        flushed = 0;
+        hasElements = 0;
+        depth = 0;
+        afterKey = false;
+    }
+
+    /** Expected document size, and number of fragment() calls if any */
+    void reserve(size_t estimate, size_t fragments = 0) {
+        out.reserve(estimate);
+        if (fragments > 0) segments.reserve(fragments * 2 + 1);
+    }
+
+    Writer& beginObject() { open('{'); return *this; }
+    Writer& endObject() { close('}'); return *this; }
+    Writer& beginArray() { open('['); return *this; }
+    Writer& endArray() { close(']'); return *this; }
+
+    template <size_t N>
+    Writer& key(const StaticKey<N>& name) {
+        separator();
+        out.append(name.quoted().data(), name.quoted().size());
+        afterKey = true;
+        return *this;
+    }
+
+    Writer& key(std::string_view name) {
+        separator();
+        out += '"';
+        appendEscaped(out, name);
+        out += "\":";
+        afterKey = true;
+        return *this;
+    }
+
+    Writer& string(std::string_view value) {
+        separator();
+        out += '"';
+        appendEscaped(out, value);
+        out += '"';
+        return *this;
+    }
+
+    Writer& number(long long value) {
+        separator();
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, (size_t)(result.ptr - digits));
+        return *this;
+    }
+
+    Writer& boolean(bool value) {
+        separator();
+        out += value ? "true" : "false";
+        return *this;
+    }
+
+    Writer& null() {
+        separator();
+        out += "null";
+        return *this;
+    }
+
+    /** Pre-serialized JSON value, copied */
+    Writer& raw(std::string_view json) {
+        separator();
+        out.append(json.data(), json.size());
+        return *this;
+    }
+
+    /** Pre-serialized JSON value, referenced rather than copied */
+    Writer& fragment(std::string_view json) {
+        separator();
+        if (json.empty()) return *this;
+        if (out.size() > flushed) segments.push_back(Segment{ nullptr, flushed, out.size() - flushed });
+        segments.push_back(Segment{ json.data(), 0, json.size() });
+        flushed = out.size();
+        return *this;
+    }
+
+    /** Document size in bytes, including fragments */
+    size_t size() const {
+        size_t total = out.size() - flushed;
+        for (const auto& segment : segments) total += segment.length;
+        return total;
+    }
+
+    /** The document as a list of slices, in order; valid until the writer changes */
+    std::vector<std::string_view> slices() const {
+        std::vector<std::string_view> result;
+        result.reserve(segments.size() + 1);
+        for (const auto& segment : segments) {
+            result.emplace_back(segment.external ? segment.external : out.data() + segment.offset, segment.length);
+        }
+        if (out.size() > flushed) result.emplace_back(out.data() + flushed, out.size() - flushed);
+        return result;
+    }
+
+    /**
+     * The document in place, for writers that used no fragment(); valid
+     * until the writer changes. Lets a long-lived writer serve as a
+     * reusable response buffer.
+     */
+    std::string_view view() const {
+        if (!segments.empty()) throw std::logic_error("JSON writer holds fragments; use slices()");
+        return std::string_view(out);
+    }
+
+    /** The document as one string (fragments are copied in) */
+    std::string toString() const {
+        if (segments.empty()) return out;
+        std::string result;
+        result.reserve(size());
+        for (std::string_view slice : slices()) result.append(slice.data(), slice.size());
+        return result;
+    }
+
+    /** Move the document out; the writer is empty afterwards */
+    std::string take() {
+        std::string result = segments.empty() ? std::move(out) : toString();
+        clear();
+        return result;
+    }
+};
+
+/**
+ * Receives parse events from StreamParser (SAX)
+ *
+ * Strings and member names arrive raw, as they appear between the quotes;
+ * escaped is true when they contain backslash escapes, which unescape()
+ * decodes. Views are only valid during the callback.
+ */
+class Handler {
+public:
+    virtual ~Handler() {}
+    virtual void startObject() {}
+    virtual void endObject() {}
+    virtual void startArray() {}
+    virtual void endArray() {}
+    virtual void key(std::string_view raw, bool escaped) { (void)raw; (void)escaped; }
+    virtual void string(std::string_view raw, bool escaped) { (void)raw; (void)escaped; }
+    virtual void number(std::string_view literal) { (void)literal; }
+    virtual void boolean(bool value) { (void)value; }
+    virtual void null() {}
+};
+
+/**
+ * Incremental, single-pass JSON tokenizer
+ *
+ * Input may be fed in chunks of any size, split anywhere. Tokens that lie
+ * within one chunk are reported as views into that chunk; only a string or
+ * number split across chunks is copied, into a reusable scratch buffer.
+ * Validates the complete grammar (RFC 8259) including escapes, surrogate
+ * pairs and number syntax; errors report the absolute byte offset.
+ */
+class StreamParser {
+public:
+    static constexpr size_t MAX_DEPTH = 64;
+
+private:
+    enum class State : uint8_t {
+        Value,        // a value is expected
+        FirstValue,   // after '[': a value or ']'
+        FirstKey,     // after '{': a member name or '}'
+        Key,          // after ',' in an object: a member name
+        Colon,
+        AfterValue,   // ',' or the closing bracket
+        String,
+        Escape,       // after a backslash
+        Unicode,      // inside \uXXXX
+        Number,
+        Literal,      // true, false or null
+        Done,         // the document value is complete; only whitespace may follow
+        Failed
+    };
+
+    // Position within a number, following the RFC 8259 grammar
+    enum class NumberState : uint8_t { Minus, Zero, Integer, Dot, Fraction, Exponent, ExponentSign, ExponentDigits };
+
+    Handler& handler;
+    size_t maxDepth;
+    std::array<char, MAX_DEPTH> stack;  // '{' or '[' per open container
+    size_t depth = 0;
+    State state = State::Value;
+    NumberState numberState = NumberState::Minus;
+    bool stringIsKey = false;
+    bool stringEscaped = false;
+    bool highSurrogate = false;         // a low surrogate escape must follow
+    unsigned unicodeValue = 0;
+    int hexLeft = 0;
+    const char* literal = nullptr;
+    size_t literalPos = 0;
+    const char* tokenStart = nullptr;   // start of the current string or number in this chunk
+    bool buffered = false;              // the current token began in an earlier chunk
+    std::string pending;                // its earlier part
+    size_t consumed = 0;                // bytes fed before the current chunk
+
+    [[noreturn]] void fail(const char* message, size_t offset) {
+        state = State::Failed;
+        throw std::runtime_error(std::string("Invalid JSON: ") + message + " at offset " + std::to_string(offset));
+    }
+
+    std::string_view token(const char* tokenEnd) {
+        if (!buffered) return std::string_view(tokenStart, (size_t)(tokenEnd - tokenStart));
+        if (tokenEnd != tokenStart) pending.append(tokenStart, (size_t)(tokenEnd - tokenStart));
+        return std::string_view(pending);
+    }
+
+    void tokenDone() {
+        if (buffered) {
+            pending.clear();
+            buffered = false;
+        }
+    }
+
+    void valueDone() {
+        state = depth == 0 ? State::Done : State::AfterValue;
+    }
+
+    void open(char bracket, size_t offset) {
+        if (depth >= maxDepth) fail("nesting too deep", offset);
+        stack[depth++] = bracket;
+        if (bracket == '{') {
+            state = State::FirstKey;
+            handler.startObject();
+        } else {
+            state = State::FirstValue;
+            handler.startArray();
+        }
+    }
+
+    void close(char bracket, size_t offset) {
+        char expected = stack[depth - 1] == '{' ? '}' : ']';
+        if (bracket != expected) fail(expected == '}' ? "expected ',' or '}'" : "expected ',' or ']'", offset);
+        depth--;
+        valueDone();
+        if (bracket == '}') handler.endObject();
+        else handler.endArray();
+    }
+
+    void beginString(const char* p, bool isKey) {
+        stringIsKey = isKey;
+        stringEscaped = false;
+        tokenStart = p + 1;
+        state = State::String;
+    }
+
+    void beginValue(const char* p, size_t offset) {
+        char c = *p;
+        switch (c) {
+            case '{':
+            case '[':
+                open(c, offset);
+                return;
+            case '"':
+                beginString(p, false);
+                return;
+            case 't': literal = "true"; break;
+            case 'f': literal = "false"; break;
+            case 'n': literal = "null"; break;
+            default:
+                if (c == '-' || (c >= '0' && c <= '9')) {
+                    numberState = c == '-' ? NumberState::Minus : c == '0' ? NumberState::Zero : NumberState::Integer;
+                    tokenStart = p;
+                    state = State::Number;
+                    return;
+                }
+                fail("unexpected character", offset);
+        }
+        literalPos = 1;
+        state = State::Literal;
+    }
+
+    /** Advance the number grammar by one character; false if c does not continue the number */
+    bool numberStep(char c) {
+        bool digit = c >= '0' && c <= '9';
+        switch (numberState) {
+            case NumberState::Minus:
+                if (!digit) return false;
+                numberState = c == '0' ? NumberState::Zero : NumberState::Integer;
+                return true;
+            case NumberState::Integer:
+                if (digit) return true;
+                // fall through
+            case NumberState::Zero:
+                if (c == '.') { numberState = NumberState::Dot; return true; }
+                if (c == 'e' || c == 'E') { numberState = NumberState::Exponent; return true; }
+                return false;
+            case NumberState::Dot:
+                if (!digit) return false;
+                numberState = NumberState::Fraction;
+                return true;
+            case NumberState::Fraction:
+                if (digit) return true;
+                if (c == 'e' || c == 'E') { numberState = NumberState::Exponent; return true; }
+                return false;
+            case NumberState::Exponent:
+                if (c == '+' || c == '-') { numberState = NumberState::ExponentSign; return true; }
+                // fall through
+            case NumberState::ExponentSign:
+                if (!digit) return false;
+                numberState = NumberState::ExponentDigits;
+                return true;
+            case NumberState::ExponentDigits:
+                return digit;
+        }
+        return false;
+    }
+
+    bool numberComplete() const {
+        return numberState == NumberState::Zero || numberState == NumberState::Integer ||
+               numberState == NumberState::Fraction || numberState == NumberState::ExponentDigits;
+    }
+
+    void endNumber(const char* p, size_t offset) {
+        if (!numberComplete()) fail("invalid number", offset);
+        std::string_view text = token(p);
+        valueDone();
+        handler.number(text);
+        tokenDone();
+    }
+
+    void endString(const char* p) {
+        std::string_view text = token(p);
+        if (stringIsKey) {
+            state = State::Colon;
+            handler.key(text, stringEscaped);
+        } else {
+            valueDone();
+            handler.string(text, stringEscaped);
+        }
+        tokenDone();
+    }
+
+    static bool isWhitespace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+public:
+    explicit StreamParser(Handler& eventHandler, size_t depthLimit = 16)
+        : handler(eventHandler)
+        , maxDepth(depthLimit < MAX_DEPTH ? depthLimit : MAX_DEPTH) {
+    }
+
+    /** Bytes fed so far */
+    size_t offset() const { return consumed; }
+
+    /**
+     * Parse the next piece of the document. Handler callbacks run before
+     * feed() returns; an exception from a callback stops the parse.
+     */
+    void feed(const char* data, size_t length) {
+        if (state == State::Failed) throw std::runtime_error("Invalid JSON: parser already failed");
+
+        const char* p = data;
+        const char* end = data + length;
+        if (buffered) tokenStart = data;
+
+        while (p < end) {
+            size_t at = consumed + (size_t)(p - data);
+            switch (state) {
+                case State::String: {
+                    // Fast path: run to the next quote, backslash or control character
+                    while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) p++;
+                    if (p == end) break;
+                    at = consumed + (size_t)(p - data);
+                    if (highSurrogate && *p != '\\') fail("unpaired surrogate", at);
+                    if (*p == '"') {
+                        endString(p);
+                    } else if (*p == '\\') {
+                        stringEscaped = true;
+                        state = State::Escape;
+                    } else {
+                        fail("control character in string", at);
+                    }
+                    p++;
+                    break;
+                }
+                case State::Escape: {
+                    char c = *p++;
+                    if (highSurrogate && c != 'u') fail("unpaired surrogate", at);
+                    if (c == 'u') {
+                        unicodeValue = 0;
+                        hexLeft = 4;
+                        state = State::Unicode;
+                    } else if (c == '"' || c == '\\' || c == '/' || c == 'b' || c == 'f' || c == 'n' || c == 'r' || c == 't') {
+                        state = State::String;
+                    } else {
+                        fail("invalid escape", at);
+                    }
+                    break;
+                }
+                case State::Unicode: {
+                    int digit = hexValue(*p++);
+                    if (digit < 0) fail("invalid \\u escape", at);
+                    unicodeValue = (unicodeValue << 4) | (unsigned)digit;
+                    if (--hexLeft > 0) break;
+                    bool high = unicodeValue >= 0xD800 && unicodeValue <= 0xDBFF;
+                    bool low = unicodeValue >= 0xDC00 && unicodeValue <= 0xDFFF;
+                    if (highSurrogate ? !low : low) fail("unpaired surrogate", at);
+                    highSurrogate = !highSurrogate && high;
+                    state = State::String;
+                    break;
+                }
+                case State::Number: {
+                    while (p < end && numberStep(*p)) p++;
+                    if (p == end) break;
+                    endNumber(p, consumed + (size_t)(p - data));
+                    break;  // the terminating character is handled by the next state
+                }
+                case State::Literal: {
+                    if (*p != literal[literalPos]) fail("unexpected token", at);
+                    p++;
+                    if (literal[++literalPos] != '\0') break;
+                    valueDone();
+                    if (literal[0] == 'n') handler.null();
+                    else handler.boolean(literal[0] == 't');
+                    break;
+                }
+                case State::Failed:
+                    throw std::runtime_error("Invalid JSON: parser already failed");
+                default: {
+                    char c = *p;
+                    if (isWhitespace(c)) {
+                        p++;
+                        break;
+                    }
+                    switch (state) {
+                        case State::Value:
+                            beginValue(p, at);
+                            break;
+                        case State::FirstValue:
+                            if (c == ']') close(c, at);
+                            else beginValue(p, at);
+                            break;
+                        case State::FirstKey:
+                            if (c == '}') close(c, at);
+                            else if (c == '"') beginString(p, true);
+                            else fail("expected member name", at);
+                            break;
+                        case State::Key:
+                            if (c != '"') fail("expected member name", at);
+                            beginString(p, true);
+                            break;
+                        case State::Colon:
+                            if (c != ':') fail("expected ':'", at);
+                            state = State::Value;
+                            break;
+                        case State::AfterValue:
+                            if (c == ',') state = stack[depth - 1] == '{' ? State::Key : State::Value;
+                            else close(c, at);
+                            break;
+                        default:
+                            fail("trailing characters", at);
+                    }
+                    p++;
+                }
+            }
+        }
+
+        // Keep the unfinished part of a token that continues in the next chunk
+        if (state == State::String || state == State::Escape || state == State::Unicode || state == State::Number) {
+            pending.append(tokenStart, (size_t)(end - tokenStart));
+            buffered = true;
+        }
+        consumed += length;
+    }
+
+    /** Signal the end of input; throws unless exactly one complete value was fed */
+    void finish() {
+        if (state == State::Number) {
+            tokenStart = nullptr;  // the whole number is in pending
+            endNumber(nullptr, consumed);
+        }
+        if (state == State::Done) return;
+        if (state == State::String || state == State::Escape || state == State::Unicode) {
+            fail("unterminated string", consumed);
+        }
+        fail("unexpected end of input", consumed);
     }
 };
 
 /**
- * Simple JSON parser (basic implementation for our needs)
+ * Decode the escapes of a raw JSON string in place (the result is never
+ * longer than the input). Expects text already validated by StreamParser.
+ * Returns the decoded length.
  */
-inline std::map<std::string, std::string> parse(const std::string& json) {
-    std::map<std::string, std::string> result;
-    
-    // Security: Prevent regex DoS with input size limit
-    if (json.length() > 10240) {
-        throw std::runtime_error("JSON input too large (max 10KB)");
-    }
-    
-    std::regex keyValueRegex("\"([^\"]+)\"\\s*:\\s*\"([^\"]+)\"");
-    auto begin = std::sregex_iterator(json.begin(), json.end(), keyValueRegex);
-    auto end = std::sregex_iterator();
-    
-    for (auto i = begin; i != end; ++i) {
-        std::smatch match = *i;
-        result[match[1].str()] = match[2].str();
-    }
-    
+inline size_t unescapeInPlace(char* text, size_t length) {
+    auto hex4 = [](const char* p) {
+        unsigned value = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = p[i];
+            value = (value << 4) | (unsigned)(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+        return value;
+    };
+
+    size_t in = 0;
+    size_t out = 0;
+    while (in < length) {
+        char c = text[in++];
+        if (c != '\\') {
+            text[out++] = c;
+            continue;
+        }
+        char escape = text[in++];
+        switch (escape) {
+            case 'b': text[out++] = '\b'; break;
+            case 'f': text[out++] = '\f'; break;
+            case 'n': text[out++] = '\n'; break;
+            case 'r': text[out++] = '\r'; break;
+            case 't': text[out++] = '\t'; break;
+            case 'u': {
+                unsigned codePoint = hex4(text + in);
+                in += 4;
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF && in + 6 <= length) {
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (hex4(text + in + 2) - 0xDC00);
+                    in += 6;
+                }
+                if (codePoint < 0x80) {
+                    text[out++] = (char)codePoint;
+                } else if (codePoint < 0x800) {
+                    text[out++] = (char)(0xC0 | (codePoint >> 6));
+                    text[out++] = (char)(0x80 | (codePoint & 0x3F));
+                } else if (codePoint < 0x10000) {
+                    text[out++] = (char)(0xE0 | (codePoint >> 12));
+                    text[out++] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                    text[out++] = (char)(0x80 | (codePoint & 0x3F));
+                } else {
+                    text[out++] = (char)(0xF0 | (codePoint >> 18));
+                    text[out++] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+                    text[out++] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                    text[out++] = (char)(0x80 | (codePoint & 0x3F));
+                }
+                break;
+            }
+            default: text[out++] = escape; break;  // '"', '\\' and '/'
+        }
+    }
+    return out;
+}
+
+/** Decoded copy of a raw JSON string */
+inline std::string unescape(std::string_view raw) {
+    std::string result(raw);
+    result.resize(unescapeInPlace(&result[0], result.size()));
     return result;
 }
 
+/**
+ * Text of a string event: raw itself when unescaped, otherwise decoded into scratch
+ */
+inline std::string_view decoded(std::string_view raw, bool escaped, std::string& scratch) {
+    if (!escaped) return raw;
+    scratch = unescape(raw);
+    return scratch;
+}
+
+/**
+ * Node of a parsed Document, stored in document order (a "tape")
+ *
+ * Containers are followed by their contents; object members are a String
+ * node for the name followed by the value. end is the index just past the
+ * node's subtree, so siblings are skipped without walking children.
+ */
+struct Node {
+    enum class Type : uint8_t { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    uint32_t end = 0;
+    uint32_t size = 0;       // elements of an Array, members of an Object
+    std::string_view text;   // String: decoded text; Number: literal; Bool: "true" / "false"
+};
+
+/**
+ * Read-only view of one value in a Document; default-constructed (or
+ * returned by find() for a missing member) it refers to nothing.
+ */
+class Value {
+private:
+    const Node* nodes = nullptr;
+    uint32_t index = 0;
+
+    const Node& node() const { return nodes[index]; }
+
+public:
+    Value() {}
+    Value(const Node* documentNodes, uint32_t nodeIndex)
+        : nodes(documentNodes)
+        , index(nodeIndex) {
+    }
+
+    bool exists() const { return nodes != nullptr; }
+    Node::Type type() const { return nodes ? node().type : Node::Type::Null; }
+    bool isNull() const { return type() == Node::Type::Null; }
+    bool isBool() const { return exists() && type() == Node::Type::Bool; }
+    bool isNumber() const { return exists() && type() == Node::Type::Number; }
+    bool isString() const { return exists() && type() == Node::Type::String; }
+    bool isArray() const { return exists() && type() == Node::Type::Array; }
+    bool isObject() const { return exists() && type() == Node::Type::Object; }
+
+    /** Text of a string, empty for other types */
+    std::string_view asString() const { return isString() ? node().text : std::string_view(); }
+    bool asBool() const { return isBool() && node().text[0] == 't'; }
+    double asNumber() const {
+        if (!isNumber()) return 0;
+        std::string literal(node().text);
+        return std::strtod(literal.c_str(), nullptr);
+    }
+
+    /** Elements of an array or members of an object */
+    size_t size() const { return isArray() || isObject() ? node().size : 0; }
+
+    /** Array element by position, or nothing if out of range */
+    Value operator[](size_t position) const {
+        if (!isArray() || position >= node().size) return Value();
+        uint32_t i = index + 1;
+        while (position-- > 0) i = nodes[i].end;
+        return Value(nodes, i);
+    }
+
+    /** Object member by name (first match), or nothing if absent */
+    Value find(std::string_view key) const {
+        if (!isObject()) return Value();
+        for (uint32_t i = index + 1; i < node().end; i = nodes[i + 1].end) {
+            if (nodes[i].text == key) return Value(nodes, i + 1);
+        }
+        return Value();
+    }
+
+    /** String member by name, or fallback if absent or not a string */
+    std::string_view getString(std::string_view key, std::string_view fallback = std::string_view()) const {
+        Value value = find(key);
+        return value.isString() ? value.asString() : fallback;
+    }
+
+    /** Forward iteration over array elements */
+    class Iterator {
+    private:
+        const Node* nodes;
+        uint32_t index;
+
+    public:
+        Iterator(const Node* documentNodes, uint32_t nodeIndex) : nodes(documentNodes), index(nodeIndex) {}
+        Value operator*() const { return Value(nodes, index); }
+        Iterator& operator++() { index = nodes[index].end; return *this; }
+        bool operator!=(const Iterator& other) const { return index != other.index; }
+    };
+
+    Iterator begin() const { return isArray() ? Iterator(nodes, index + 1) : Iterator(nodes, 0); }
+    Iterator end() const { return isArray() ? Iterator(nodes, node().end) : Iterator(nodes, 0); }
+};
+
+/**
+ * Zero-copy DOM over a request buffer
+ *
+ * parse() decodes string escapes in place in the buffer and records views
+ * into it, so the buffer must outlive the Document and is modified. Nodes
+ * live in caller-supplied storage (see FixedDocument) or, by default, in
+ * one allocation sized from the input.
+ */
+class Document {
+private:
+    std::vector<Node> owned;
+    Node* nodes;
+    size_t capacity;
+    size_t count = 0;
+
+    class TapeWriter : public Handler {
+    private:
+        Document& document;
+        char* base;                  // start of the mutable buffer being parsed
+        const char* view;            // the same bytes as seen by the parser
+        std::array<uint32_t, StreamParser::MAX_DEPTH> open;
+        size_t depth = 0;
+
+        uint32_t add(Node::Type type, std::string_view text) {
+            if (document.count >= document.capacity) {
+                throw std::runtime_error("Invalid JSON: too many values (max " + std::to_string(document.capacity) + ")");
+            }
+            uint32_t index = (uint32_t)document.count++;
+            Node& node = document.nodes[index];
+            node.type = type;
+            node.end = index + 1;
+            node.size = 0;
+            node.text = text;
+            return index;
+        }
+
+        void value(Node::Type type, std::string_view text = std::string_view()) {
+            // Member counts are kept when the name is seen
+            if (depth > 0 && document.nodes[open[depth - 1]].type == Node::Type::Array) {
+                document.nodes[open[depth - 1]].size++;
+            }
+            add(type, text);
+        }
+
+        std::string_view text(std::string_view raw, bool escaped) {
+            if (!escaped) return raw;
+            char* start = base + (raw.data() - view);
+            return std::string_view(start, unescapeInPlace(start, raw.size()));
+        }
+
+        void start(Node::Type type) {
+            value(type);
+            open[depth++] = (uint32_t)(document.count - 1);
+        }
+
+        void finish() {
+            uint32_t index = open[--depth];
+            document.nodes[index].end = (uint32_t)document.count;
+        }
+
+    public:
+        TapeWriter(Document& target, char* buffer)
+            : document(target)
+            , base(buffer)
+            , view(buffer) {
+        }
+
+        void startObject() override { start(Node::Type::Object); }
+        void endObject() override { finish(); }
+        void startArray() override { start(Node::Type::Array); }
+        void endArray() override { finish(); }
+        void key(std::string_view raw, bool escaped) override {
+            document.nodes[open[depth - 1]].size++;
+            add(Node::Type::String, text(raw, escaped));
+        }
+        void string(std::string_view raw, bool escaped) override { value(Node::Type::String, text(raw, escaped)); }
+        void number(std::string_view literal) override { value(Node::Type::Number, literal); }
+        void boolean(bool flag) override { value(Node::Type::Bool, flag ? "true" : "false"); }
+        void null() override { value(Node::Type::Null); }
+    };
+
+public:
+    /** Node storage allocated by parse(), once per document */
+    Document()
+        : nodes(nullptr)
+        , capacity(0) {
+    }
+
+    /** Caller-supplied node storage; parse() fails if the document needs more nodes */
+    Document(Node* storage, size_t nodeCapacity)
+        : nodes(storage)
+        , capacity(nodeCapacity) {
+    }
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    /**
+     * Parse a complete document held in json (modified in place)
+     * Security: nesting is limited to maxDepth; callers bound the input size.
+     */
+    void parse(std::string& json, size_t maxDepth = 16) {
+        parse(&json[0], json.size(), maxDepth);
+    }
+
+    /** Same, for a document in a caller-owned buffer such as the request arena */
+    void parse(char* json, size_t length, size_t maxDepth = 16) {
+        if (length > 0 && (nodes == nullptr || nodes == owned.data())) {
+            // Every value but the last takes at least two bytes, e.g. "0,"
+            owned.resize(length / 2 + 1);
+            nodes = owned.data();
+            capacity = owned.size();
+        }
+        count = 0;
+        TapeWriter writer(*this, json);
+        StreamParser parser(writer, maxDepth);
+        parser.feed(json, length);
+        parser.finish();
+    }
+
+    Value root() const { return count > 0 ? Value(nodes, 0) : Value(); }
+
+    size_t nodeCount() const { return count; }
+};
+
+/**
+ * Document with inline node storage for small, fixed-shape requests;
+ * parsing into it performs no allocation
+ */
+template <size_t Capacity>
+class FixedDocument : public Document {
+private:
+    std::array<Node, Capacity> storage;
+
+public:
+    FixedDocument()
+        : Document(storage.data(), Capacity) {
+    }
+};
+
 } // namespace Json
 } // namespace ArhintSigner
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ArhintSigner {
+namespace Keys {
+
+/**
+ * Counters reported by KeyHandleCache
+ */
+struct KeyCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;      // dropped for capacity or TTL
+    uint64_t invalidations = 0;  // dropped because the certificate or token went away
+    size_t size = 0;
+    size_t capacity = 0;
+    long long ttlSeconds = 0;
+};
+
+/**
+ * Bounded, TTL-based cache of acquired private key handles keyed by thumbprint
+ *
+ * KeyT is whatever owns the platform handle (e.g. an NCRYPT_KEY_HANDLE
+ * wrapper on Windows, or an in-memory stand-in). Entries are handed out as
+ * shared_ptr, so a key evicted while a signature is in progress is released
+ * only after that signature completes. Least recently used entries are
+ * evicted first; entries older than the TTL are re-acquired, so a token
+ * that was swapped is picked up even without an error.
+ */
+template<typename KeyT>
+class KeyHandleCache {
+public:
+    using KeyPtr = std::shared_ptr<KeyT>;
+    using Loader = std::function<KeyPtr(const std::string& thumbprint)>;
+
+private:
+    struct Entry {
+        std::string thumbprint;
+        KeyPtr key;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    mutable std::mutex mutex;
+    std::list<Entry> lru;  // most recently used first
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> index;
+    size_t capacity;
+    std::chrono::seconds ttl;
+    KeyCacheStats counters;
+
+    void evictOverflow() {
+        while (lru.size() > capacity) {
+            index.erase(lru.back().thumbprint);
+            lru.pop_back();
+            counters.evictions++;
+        }
+    }
+
+public:
+    explicit KeyHandleCache(size_t maxEntries = 32, std::chrono::seconds timeToLive = std::chrono::seconds(300))
+        : capacity(maxEntries)
+        , ttl(timeToLive) {
+    }
+
+    /**
+     * Change the limits; capacity 0 disables caching
+     */
+    void setLimits(size_t maxEntries, std::chrono::seconds timeToLive) {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity = maxEntries;
+        ttl = timeToLive;
+        evictOverflow();
+    }
+
+    /**
+     * Return the cached key for a thumbprint, or call load() and cache its result.
+     * The loader runs without the cache lock held and may throw; failures are not cached.
+     */
+    KeyPtr acquire(const std::string& thumbprint, const Loader& load) {
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(thumbprint);
+            if (it != index.end()) {
+                if (it->second->expires > now) {
+                    lru.splice(lru.begin(), lru, it->second);
+                    counters.hits++;
+                    return it->second->key;
+                }
+                lru.erase(it->second);
+                index.erase(it);
+                counters.evictions++;
+            }
+            counters.misses++;
+        }
+
+        KeyPtr key = load(thumbprint);
+        if (!key) return key;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (capacity == 0) return key;
+
+        auto it = index.find(thumbprint);
+        if (it != index.end()) {
+            // Another thread loaded the same key meanwhile - keep the newest
+            lru.erase(it->second);
+            index.erase(it);
+        }
+        lru.push_front(Entry{ thumbprint, key, now + ttl });
+        index[thumbprint] = lru.begin();
+        evictOverflow();
+        return key;
+    }
+
+    /**
+     * Drop one key, e.g. after the token reported it is no longer available
+     */
+    void invalidate(const std::string& thumbprint) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(thumbprint);
+        if (it == index.end()) return;
+        lru.erase(it->second);
+        index.erase(it);
+        counters.invalidations++;
+    }
+
+    /**
+     * Drop every key for which keep(thumbprint) returns false
+     */
+    void retainOnly(const std::function<bool(const std::string&)>& keep) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = lru.begin(); it != lru.end();) {
+            if (keep(it->thumbprint)) {
+                ++it;
+                continue;
+            }
+            index.erase(it->thumbprint);
+            it = lru.erase(it);
+            counters.invalidations++;
+        }
+    }
+
+    void invalidateAll() {
+        retainOnly([](const std::string&) { return false; });
+    }
+
+    KeyCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        KeyCacheStats result = counters;
+        result.size = lru.size();
+        result.capacity = capacity;
+        result.ttlSeconds = (long long)ttl.count();
+        return result;
+    }
+};
+
+} // namespace Keys
+} // namespace ArhintSigner
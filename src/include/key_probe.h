@@ -0,0 +1,217 @@
+#pragma once
+
+#include <windows.h>
+#include <wincrypt.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <unordered_set>
+#include <atomic>
+#include <system_error>
+#include "logger.h"
+#include "certificate_index.h"
+#include "certificate_manager.h"
+
+namespace ArhintSigner {
+namespace Certificate {
+
+/**
+ * Counters reported by KeyProber
+ */
+struct ProbeStats {
+    uint64_t skipped = 0;   // answered from certificate properties alone
+    uint64_t probed = 0;    // probes that touched the token or CSP
+    uint64_t timeouts = 0;
+    uint64_t late = 0;      // timed-out probes that finished afterwards
+    size_t inFlight = 0;
+};
+
+/**
+ * Parallel, deadline-bounded private key probing
+ *
+ * Certificates without key properties are answered immediately. The rest
+ * are probed by a pool of at most MAX_PARALLEL_PROBES threads that take the
+ * next certificate as soon as they finish one, and the whole call has a
+ * single deadline, so it takes about as long as its slowest probes and
+ * never longer than the timeout. A probe still running at the deadline is
+ * reported as KeyStatus::Timeout and left to finish in the background; its
+ * late result is handed to a callback, and the same certificate is not
+ * probed again while that probe is outstanding. Probes not yet started at
+ * the deadline are dropped and reported as timed out too.
+ */
+class KeyProber {
+public:
+    using LateResult = std::function<void(const CertificatePtr& cert, KeyStatus status)>;
+
+private:
+    static constexpr size_t MAX_PARALLEL_PROBES = 16;
+
+    struct Probe {
+        size_t index;  // position in the caller's results
+        CertificatePtr cert;
+        bool finished = false;
+        KeyStatus status = KeyStatus::Absent;
+    };
+
+    // One probeAll() call; its pool threads take probes in order
+    struct Batch {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<Probe> probes;
+        size_t next = 0;          // first probe not yet taken by a thread
+        size_t finished = 0;
+        bool abandoned = false;   // the caller gave up waiting
+    };
+
+    struct Shared {
+        std::mutex mutex;
+        std::unordered_set<std::string> inFlight;  // thumbprints with a pending probe
+        LateResult late;
+        std::atomic<uint64_t> skipped{0};
+        std::atomic<uint64_t> probed{0};
+        std::atomic<uint64_t> timeouts{0};
+        std::atomic<uint64_t> lateResults{0};
+    };
+
+    // Shared with detached pool threads, which may outlive a wait
+    std::shared_ptr<Shared> shared;
+
+    static void run(std::shared_ptr<Shared> state, std::shared_ptr<Batch> batch) {
+        while (true) {
+            size_t taken;
+            CertificatePtr cert;
+            {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if (batch->abandoned || batch->next == batch->probes.size()) return;
+                taken = batch->next++;
+                cert = batch->probes[taken].cert;
+            }
+            state->probed++;
+            KeyStatus status = probePrivateKey(cert->context) ? KeyStatus::Present : KeyStatus::Absent;
+
+            bool abandoned;
+            {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->probes[taken].status = status;
+                batch->probes[taken].finished = true;
+                batch->finished++;
+                abandoned = batch->abandoned;
+            }
+            batch->changed.notify_all();
+
+            LateResult late;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->inFlight.erase(cert->sha1);
+                late = state->late;
+            }
+            if (abandoned) {
+                state->lateResults++;
+                if (late) late(cert, status);
+            }
+        }
+    }
+
+public:
+    KeyProber()
+        : shared(std::make_shared<Shared>()) {
+    }
+
+    /**
+     * Register the callback that receives results of probes that timed out
+     */
+    void onLateResult(LateResult callback) {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->late = std::move(callback);
+    }
+
+    /**
+     * Determine the key status of each certificate, waiting at most timeout
+     * for all of them together. Results are in the order of certs.
+     */
+    std::vector<KeyStatus> probeAll(const std::vector<CertificatePtr>& certs, std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        std::vector<KeyStatus> results(certs.size(), KeyStatus::Absent);
+        auto batch = std::make_shared<Batch>();
+
+        for (size_t i = 0; i < certs.size(); i++) {
+            const CertificatePtr& cert = certs[i];
+            if (!hasKeyProperty(cert->context)) {
+                shared->skipped++;
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (!shared->inFlight.insert(cert->sha1).second) {
+                // An earlier probe is still hanging - don't pile up another one
+                results[i] = KeyStatus::Timeout;
+                continue;
+            }
+            batch->probes.push_back(Probe{ i, cert });
+        }
+        if (batch->probes.empty()) return results;
+
+        size_t threads = std::min(batch->probes.size(), MAX_PARALLEL_PROBES);
+        size_t started = 0;
+        for (; started < threads; started++) {
+            try {
+                std::thread(run, shared, batch).detach();
+            }
+            catch (const std::system_error&) {
+                break;
+            }
+        }
+        if (started == 0) {
+            // No thread available - probe inline
+            run(shared, batch);
+        }
+
+        std::vector<std::string> dropped;
+        {
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->changed.wait_until(lock, deadline, [&batch]() { return batch->finished == batch->probes.size(); });
+            batch->abandoned = true;
+            for (size_t i = 0; i < batch->probes.size(); i++) {
+                const Probe& probe = batch->probes[i];
+                if (probe.finished) {
+                    results[probe.index] = probe.status;
+                    continue;
+                }
+                results[probe.index] = KeyStatus::Timeout;
+                shared->timeouts++;
+                if (i >= batch->next) {
+                    dropped.push_back(probe.cert->sha1);
+                    continue;
+                }
+                Log::warn("Private key probe timed out for ", probe.cert->sha1);
+            }
+        }
+
+        if (!dropped.empty()) {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            for (const std::string& thumbprint : dropped) shared->inFlight.erase(thumbprint);
+            Log::warn("Private key probes not started before the deadline: ", dropped.size());
+        }
+        return results;
+    }
+
+    ProbeStats stats() const {
+        ProbeStats result;
+        result.skipped = shared->skipped;
+        result.probed = shared->probed;
+        result.timeouts = shared->timeouts;
+        result.late = shared->lateResults;
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        result.inFlight = shared->inFlight.size();
+        return result;
+    }
+};
+
+} // namespace Certificate
+} // namespace ArhintSigner
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ArhintSigner {
+namespace Keys {
+
+/**
+ * Thrown when a key already has as many waiting operations as allowed
+ */
+class QueueFullError : public std::runtime_error {
+public:
+    explicit QueueFullError(const std::string& message) : std::runtime_error(message) {}
+};
+
+/**
+ * Thrown when a request's deadline passed before its key operation started
+ */
+class DeadlineExceededError : public std::runtime_error {
+public:
+    explicit DeadlineExceededError(const std::string& message) : std::runtime_error(message) {}
+};
+
+/**
+ * Thrown when a request's client went away before its key operation started
+ */
+class RequestCancelledError : public std::runtime_error {
+public:
+    explicit RequestCancelledError(const std::string& message) : std::runtime_error(message) {}
+};
+
+/**
+ * Priority lane of a request. Waiting interactive operations are always
+ * granted before bulk ones.
+ */
+enum class Lane : uint8_t { Interactive, Bulk };
+
+inline const char* laneName(Lane lane) {
+    return lane == Lane::Bulk ? "bulk" : "interactive";
+}
+
+/**
+ * Scheduling terms of a request: its lane, its deadline and a way to tell
+ * whether its client is still waiting. clientGone(context) may be called
+ * from the request's own thread only.
+ */
+struct RequestTerms {
+    using Clock = std::chrono::steady_clock;
+
+    Lane lane = Lane::Interactive;
+    Clock::time_point arrival;
+    Clock::time_point deadline = Clock::time_point::max();
+    bool (*clientGone)(void* context) = nullptr;
+    void* context = nullptr;
+
+    bool expired(Clock::time_point now = Clock::now()) const { return now >= deadline; }
+
+    bool abandoned() const { return clientGone && clientGone(context); }
+
+    /** Throw if the request should no longer be worked on */
+    void check() const {
+        if (expired()) throw DeadlineExceededError("Request deadline exceeded");
+        if (abandoned()) throw RequestCancelledError("Client closed the connection");
+    }
+};
+
+/**
+ * Terms of the request the calling thread is handling; default terms
+ * (interactive, no deadline) outside a request
+ */
+inline RequestTerms& requestTerms() {
+    thread_local RequestTerms terms;
+    return terms;
+}
+
+/**
+ * Replaces the calling thread's request terms for a scope, e.g. for work
+ * done on behalf of several requests
+ */
+class ScopedRequestTerms {
+private:
+    RequestTerms saved;
+
+public:
+    explicit ScopedRequestTerms(const RequestTerms& terms) : saved(requestTerms()) { requestTerms() = terms; }
+    ~ScopedRequestTerms() { requestTerms() = saved; }
+
+    ScopedRequestTerms(const ScopedRequestTerms&) = delete;
+    ScopedRequestTerms& operator=(const ScopedRequestTerms&) = delete;
+};
+
+/**
+ * Queue state of one key (device), reported in /stats and /metrics
+ */
+struct KeyQueueStats {
+    std::string device;
+    bool hardware = false;
+    size_t limit = 0;          // operations allowed at once
+    size_t active = 0;         // operations running
+    size_t depth = 0;          // operations waiting
+    uint64_t granted = 0;
+    uint64_t waited = 0;       // granted after waiting in the queue
+    uint64_t rejected = 0;     // queue was full
+    uint64_t expired = 0;      // deadline passed while waiting
+    uint64_t cancelled = 0;    // client went away while waiting
+    uint64_t waitMicros = 0;   // total time spent waiting
+    uint64_t maxWaitMicros = 0;
+};
+
+/**
+ * Settings of a KeyScheduler
+ */
+struct KeySchedulerLimits {
+    size_t hardwareConcurrency = 1;  // smartcards and USB tokens do one operation at a time
+    size_t softwareConcurrency = 4;
+    size_t maxQueued = 8;            // waiting operations per key before QueueFullError
+    size_t totalConcurrency = 0;     // operations across all keys, 0 = unlimited
+};
+
+/**
+ * Fair scheduling of private key operations across keys
+ *
+ * Every key (in practice every token: certificates on the same smartcard
+ * share one device name) has a queue and a concurrency limit. A caller
+ * holds a Permit for the duration of its key operation; the operation runs
+ * on the caller's own thread. Each queue serves the interactive lane before
+ * the bulk lane, earliest deadline first within a lane and in arrival order
+ * among equal deadlines. Waiters whose deadline passes or whose client goes
+ * away leave the queue without touching the key.
+ *
+ * When totalConcurrency caps the operations across keys, freed slots go to
+ * the keys with interactive waiters first, round-robin among keys in the
+ * same lane, so a key with a long queue cannot starve the others. Bounding
+ * each queue keeps one busy token from tying up every request worker.
+ */
+class KeyScheduler {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // How often a waiter checks whether its client is still connected
+    static constexpr std::chrono::milliseconds CANCEL_POLL{ 50 };
+
+    struct Waiter {
+        std::condition_variable granted;
+        bool isGranted = false;
+        Lane lane;
+        Clock::time_point deadline;
+        uint64_t sequence;
+    };
+
+    struct WaiterOrder {
+        bool operator()(const Waiter* a, const Waiter* b) const {
+            if (a->lane != b->lane) return a->lane < b->lane;
+            if (a->deadline != b->deadline) return a->deadline < b->deadline;
+            return a->sequence < b->sequence;
+        }
+    };
+
+    struct KeyQueue {
+        KeyQueueStats stats;
+        size_t capacity = 0;  // the device's own limit, 0 = by kind
+        std::set<Waiter*, WaiterOrder> waiting;
+        bool inRotation = false;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<KeyQueue>> queues;
+    std::deque<KeyQueue*> rotation;  // keys with waiters and a free slot, served round-robin
+    KeySchedulerLimits limits;
+    size_t totalActive = 0;
+    uint64_t arrivals = 0;
+
+    bool totalAvailable() const {
+        return limits.totalConcurrency == 0 || totalActive < limits.totalConcurrency;
+    }
+
+    size_t limitOf(const KeyQueue& queue) const {
+        if (queue.capacity > 0) return queue.capacity;
+        return queue.stats.hardware ? limits.hardwareConcurrency : limits.softwareConcurrency;
+    }
+
+    KeyQueue& queueFor(const std::string& device, bool hardware, size_t capacity) {
+        auto it = queues.find(device);
+        if (it != queues.end()) return *it->second;
+        auto queue = std::make_unique<KeyQueue>();
+        queue->stats.device = device;
+        queue->stats.hardware = hardware;
+        queue->capacity = capacity;
+        queue->stats.limit = limitOf(*queue);
+        return *queues.emplace(device, std::move(queue)).first->second;
+    }
+
+    void enterRotation(KeyQueue& queue) {
+        if (!queue.inRotation && !queue.waiting.empty() && queue.stats.active < queue.stats.limit) {
+            queue.inRotation = true;
+            rotation.push_back(&queue);
+        }
+    }
+
+    /** Next key to serve: the first in rotation whose best waiter is in the best lane */
+    std::deque<KeyQueue*>::iterator nextInRotation() {
+        auto chosen = rotation.begin();
+        for (auto it = rotation.begin(); it != rotation.end(); ++it) {
+            if ((*it)->waiting.empty()) continue;
+            if ((*chosen)->waiting.empty() ||
+                (*(*it)->waiting.begin())->lane < (*(*chosen)->waiting.begin())->lane) {
+                chosen = it;
+            }
+        }
+        return chosen;
+    }
+
+    /** Grant free slots to waiters, one key at a time in rotation order */
+    void dispatch() {
+        while (!rotation.empty() && totalAvailable()) {
+            auto next = limits.totalConcurrency == 0 ? rotation.begin() : nextInRotation();
+            KeyQueue& queue = **next;
+            rotation.erase(next);
+            queue.inRotation = false;
+            if (queue.waiting.empty() || queue.stats.active >= queue.stats.limit) continue;
+
+            Waiter* waiter = *queue.waiting.begin();
+            queue.waiting.erase(queue.waiting.begin());
+            queue.stats.active++;
+            totalActive++;
+            waiter->isGranted = true;
+            waiter->granted.notify_one();
+            enterRotation(queue);  // back of the line
+        }
+    }
+
+    void release(KeyQueue& queue) {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.stats.active--;
+        totalActive--;
+        enterRotation(queue);
+        dispatch();
+    }
+
+public:
+    /**
+     * Right to run one operation on a key; released on destruction
+     */
+    class Permit {
+    private:
+        KeyScheduler* scheduler;
+        KeyQueue* queue;
+        uint64_t waited;
+
+    public:
+        Permit(KeyScheduler* owner, KeyQueue* keyQueue, uint64_t waitedMicros)
+            : scheduler(owner), queue(keyQueue), waited(waitedMicros) {}
+
+        Permit(Permit&& other) noexcept : scheduler(other.scheduler), queue(other.queue), waited(other.waited) {
+            other.scheduler = nullptr;
+        }
+
+        Permit(const Permit&) = delete;
+        Permit& operator=(const Permit&) = delete;
+        Permit& operator=(Permit&&) = delete;
+
+        ~Permit() {
+            if (scheduler) scheduler->release(*queue);
+        }
+
+        /** Time spent in the queue before the permit was granted */
+        uint64_t waitedMicros() const { return waited; }
+    };
+
+    void setLimits(const KeySchedulerLimits& newLimits) {
+        std::lock_guard<std::mutex> lock(mutex);
+        limits = newLimits;
+        for (auto& entry : queues) {
+            entry.second->stats.limit = limitOf(*entry.second);
+            enterRotation(*entry.second);
+        }
+        dispatch();
+    }
+
+    /**
+     * Wait for a turn on device under the given terms, blocking the calling
+     * thread; on epoll that is a request worker, never a reactor. When the device is
+     * first seen, capacity (operations the device itself can run at once)
+     * sets its limit, or hardware selects the default. Throws QueueFullError
+     * instead of waiting behind maxQueued others, and DeadlineExceededError
+     * or RequestCancelledError when the request is dropped while waiting.
+     */
+    Permit acquire(const std::string& device, bool hardware, const RequestTerms& terms = RequestTerms(),
+                   size_t capacity = 0) {
+        std::unique_lock<std::mutex> lock(mutex);
+        KeyQueue& queue = queueFor(device, hardware, capacity);
+
+        // Run at once if nobody is ahead, on this key or (under a total limit) on others
+        if (queue.waiting.empty() && queue.stats.active < queue.stats.limit &&
+            totalAvailable() && (limits.totalConcurrency == 0 || rotation.empty())) {
+            queue.stats.active++;
+            totalActive++;
+            queue.stats.granted++;
+            return Permit(this, &queue, 0);
+        }
+
+        if (queue.waiting.size() >= limits.maxQueued) {
+            queue.stats.rejected++;
+            throw QueueFullError("Signing device is busy, try again later");
+        }
+
+        Waiter waiter;
+        waiter.lane = terms.lane;
+        waiter.deadline = terms.deadline;
+        waiter.sequence = arrivals++;
+        Clock::time_point start = Clock::now();
+        queue.waiting.insert(&waiter);
+        enterRotation(queue);
+        dispatch();
+
+        while (!waiter.isGranted) {
+            Clock::time_point wake = terms.clientGone ? Clock::now() + CANCEL_POLL : terms.deadline;
+            if (terms.deadline < wake) wake = terms.deadline;
+            if (wake == Clock::time_point::max()) {
+                waiter.granted.wait(lock);
+            } else {
+                waiter.granted.wait_until(lock, wake);
+            }
+            if (waiter.isGranted) break;
+
+            bool expired = terms.expired();
+            bool abandoned = false;
+            if (!expired && terms.clientGone) {
+                // Connection check is a system call; don't hold up the other waiters
+                lock.unlock();
+                abandoned = terms.abandoned();
+                lock.lock();
+                if (waiter.isGranted) break;
+            }
+            if (expired || abandoned) {
+                queue.waiting.erase(&waiter);
+                if (expired) {
+                    queue.stats.expired++;
+                    throw DeadlineExceededError("Request deadline exceeded while waiting for the signing device");
+                }
+                queue.stats.cancelled++;
+                throw RequestCancelledError("Client closed the connection while waiting for the signing device");
+            }
+        }
+
+        uint64_t waited = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        queue.stats.granted++;
+        queue.stats.waited++;
+        queue.stats.waitMicros += waited;
+        if (waited > queue.stats.maxWaitMicros) queue.stats.maxWaitMicros = waited;
+        return Permit(this, &queue, waited);
+    }
+
+    std::vector<KeyQueueStats> stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<KeyQueueStats> result;
+        result.reserve(queues.size());
+        for (const auto& entry : queues) {
+            result.push_back(entry.second->stats);
+            result.back().depth = entry.second->waiting.size();
+        }
+        return result;
+    }
+};
+
+} // namespace Keys
+} // namespace ArhintSigner
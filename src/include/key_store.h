@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "x509.h"
+#include "signature_algorithm.h"
+#include "metrics.h"
+#include "json_utils.h"
+
+namespace ArhintSigner {
+namespace Keys {
+
+/**
+ * Device a private key lives on: the smartcard reader for tokens, otherwise
+ * the key's own certificate (software keys do not share a device)
+ */
+struct KeyDevice {
+    std::string name;
+    bool hardware = false;
+    size_t concurrency = 0;  // operations the device can run at once, 0 = scheduler default
+};
+
+/**
+ * Thrown when a key is no longer usable (token removed, card reset, ...)
+ */
+class KeyUnavailableError : public std::runtime_error {
+public:
+    explicit KeyUnavailableError(const std::string& message) : std::runtime_error(message) {}
+};
+
+/**
+ * Certificate held by a KeyStore, with its lookup keys
+ * Backends derive from it to keep their own handle to the certificate.
+ */
+struct StoredCertificate {
+    std::string sha1;          // upper-case hex thumbprint
+    std::string sha256;        // upper-case hex SHA-256 thumbprint
+    Der::KeyAlgorithm keyAlgorithm = Der::KeyAlgorithm::Unknown;
+    size_t keyBits = 0;        // RSA modulus or curve size, from the certificate
+
+    StoredCertificate() = default;
+    StoredCertificate(const StoredCertificate&) = delete;
+    StoredCertificate& operator=(const StoredCertificate&) = delete;
+    virtual ~StoredCertificate() = default;
+};
+
+using CertificatePtr = std::shared_ptr<const StoredCertificate>;
+
+/**
+ * Private key of a certificate, opened and ready to sign
+ */
+class SigningKey {
+private:
+    KeyDevice keyDevice;
+
+public:
+    SigningKey() = default;
+    SigningKey(const SigningKey&) = delete;
+    SigningKey& operator=(const SigningKey&) = delete;
+    virtual ~SigningKey() = default;
+
+    const KeyDevice& device() const { return keyDevice; }
+    void setDevice(KeyDevice value) { keyDevice = std::move(value); }
+
+    /** API that signs with this key, for metrics */
+    virtual Metrics::SignApi api() const = 0;
+
+    /**
+     * Sign a raw hash with one of Crypto::SIGNATURE_ALGORITHMS (already
+     * matched to this key and the hash length) into out (capacity bytes),
+     * returning the signature length; ECDSA signatures are raw r || s.
+     * May be called from several threads at once; the KeyScheduler bounds
+     * how many. Throws KeyUnavailableError when the key went away.
+     */
+    virtual size_t sign(const Crypto::SignatureAlgorithm& algorithm, const uint8_t* hash, size_t hashLength,
+                        uint8_t* out, size_t capacity) const = 0;
+};
+
+/**
+ * Source of signing certificates and their private keys
+ *
+ * The request handler only talks to this interface; the Windows certificate
+ * store, the software (PEM directory) store and the PKCS#11 store implement
+ * it. Methods may be called from any worker thread.
+ */
+class KeyStore {
+public:
+    using ChangeListener = std::function<void()>;
+
+    KeyStore() = default;
+    KeyStore(const KeyStore&) = delete;
+    KeyStore& operator=(const KeyStore&) = delete;
+    virtual ~KeyStore() = default;
+
+    /** Backend name for logs and /stats */
+    virtual const char* name() const = 0;
+
+    /** Certificate by SHA-1 or SHA-256 thumbprint (hex, any case), or null */
+    virtual CertificatePtr findByThumbprint(std::string_view hex) = 0;
+
+    /** Whether a certificate (upper-case SHA-1 thumbprint) is still in the store */
+    virtual bool contains(const std::string& sha1) const = 0;
+
+    /**
+     * Open the private key of a certificate from this store; may block on
+     * a token. Throws if the certificate has no usable key.
+     */
+    virtual std::shared_ptr<SigningKey> loadKey(const StoredCertificate& cert) = 0;
+
+    /** Ready-to-send /listCerts body, {"result":[...]} */
+    virtual std::shared_ptr<const Json::Writer> listing() = 0;
+
+    /** Call listener whenever the store's certificates change */
+    virtual void onChange(ChangeListener listener) { (void)listener; }
+
+    /** Add the backend's own sections to the /stats response */
+    virtual void addStats(Json::Builder& response) { (void)response; }
+};
+
+/**
+ * Store used where no backend is configured (no certificate store on this
+ * platform, no --key-dir or --pkcs11-module): lists nothing and refuses to sign
+ */
+class UnavailableKeyStore : public KeyStore {
+public:
+    const char* name() const override { return "none"; }
+
+    CertificatePtr findByThumbprint(std::string_view) override {
+        throw std::runtime_error("Certificate store is not available on this platform");
+    }
+
+    bool contains(const std::string&) const override { return false; }
+
+    std::shared_ptr<SigningKey> loadKey(const StoredCertificate&) override {
+        throw std::runtime_error("Certificate store is not available on this platform");
+    }
+
+    std::shared_ptr<const Json::Writer> listing() override {
+        static const std::shared_ptr<const Json::Writer> empty = []() {
+            auto body = std::make_shared<Json::Writer>();
+            body->raw("{\"result\":[]}");
+            return body;
+        }();
+        return empty;
+    }
+};
+
+} // namespace Keys
+} // namespace ArhintSigner
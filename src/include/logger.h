@@ -0,0 +1,479 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+
+namespace ArhintSigner {
+namespace Log {
+
+/**
+ * Message severity, in increasing order; Off disables logging
+ */
+enum class Level : uint8_t { Trace, Debug, Info, Warn, Error, Off };
+
+inline const char* levelName(Level level) {
+    switch (level) {
+        case Level::Trace: return "TRACE";
+        case Level::Debug: return "DEBUG";
+        case Level::Info: return "INFO ";
+        case Level::Warn: return "WARN ";
+        case Level::Error: return "ERROR";
+        default: return "OFF  ";
+    }
+}
+
+/**
+ * Parse "trace", "debug", "info", "warn", "error" or "off"
+ */
+inline bool parseLevel(std::string_view name, Level& level) {
+    static const struct { const char* name; Level level; } levels[] = {
+        { "trace", Level::Trace }, { "debug", Level::Debug }, { "info", Level::Info },
+        { "warn", Level::Warn }, { "error", Level::Error }, { "off", Level::Off },
+    };
+    for (const auto& entry : levels) {
+        if (name == entry.name) {
+            level = entry.level;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Integer formatted as 0x-prefixed hex, e.g. Log::error("status ", Log::hex(status))
+ */
+struct Hex {
+    uint64_t value;
+};
+
+inline Hex hex(uint64_t value) {
+    return Hex{ value };
+}
+
+/**
+ * Counters reported by the logger
+ */
+struct LogStats {
+    uint64_t written = 0;     // records handed to the sink
+    uint64_t dropped = 0;     // lost because a thread's ring was full
+    uint64_t suppressed = 0;  // over the per-thread rate limit
+};
+
+namespace Detail {
+
+/**
+ * One log line as queued by the writing thread; text is truncated to fit
+ */
+struct Record {
+    static constexpr size_t TEXT_CAPACITY = 240;
+    int64_t timestamp;  // nanoseconds since the Unix epoch
+    uint32_t thread;
+    Level level;
+    uint16_t length;
+    char text[TEXT_CAPACITY];
+};
+
+/**
+ * Single-producer single-consumer ring of records owned by one thread
+ *
+ * The owning thread only ever claims and publishes; the drain thread only
+ * pops. A full ring drops the new record instead of waiting.
+ */
+class Ring {
+public:
+    static constexpr size_t CAPACITY = 256;  // power of two
+
+private:
+    Record records[CAPACITY];
+    alignas(64) std::atomic<size_t> head{ 0 };  // next slot to publish (producer)
+    alignas(64) std::atomic<size_t> tail{ 0 };  // next slot to pop (consumer)
+
+    // Producer-only rate window
+    int64_t windowStart = 0;
+    uint32_t windowCount = 0;
+
+public:
+    const uint32_t thread;
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> suppressed{ 0 };
+    std::atomic<bool> abandoned{ false };  // owning thread has exited
+
+    explicit Ring(uint32_t threadId) : thread(threadId) {}
+
+    /** Whether a message at time now fits the per-second limit (0 = unlimited) */
+    bool admit(int64_t now, unsigned limit) {
+        if (limit == 0) return true;
+        if (now - windowStart >= 1000000000LL) {
+            windowStart = now;
+            windowCount = 0;
+        }
+        if (windowCount >= limit) {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        windowCount++;
+        return true;
+    }
+
+    /** Slot for the next record, or nullptr if the ring is full */
+    Record* claim() {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) >= CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &records[position & (CAPACITY - 1)];
+    }
+
+    void publish() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** Move all published records to out; returns how many */
+    size_t popAll(std::vector<Record>& out) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        size_t end = head.load(std::memory_order_acquire);
+        for (size_t i = position; i != end; i++) {
+            out.push_back(records[i & (CAPACITY - 1)]);
+        }
+        tail.store(end, std::memory_order_release);
+        return end - position;
+    }
+
+    bool empty() const {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * Append one argument to a record's text, truncating at end
+ */
+inline void append(char*& p, char* end, std::string_view text) {
+    size_t count = std::min((size_t)(end - p), text.size());
+    memcpy(p, text.data(), count);
+    p += count;
+}
+
+inline void append(char*& p, char* end, const char* text) {
+    append(p, end, std::string_view(text ? text : "(null)"));
+}
+
+inline void append(char*& p, char* end, const std::string& text) {
+    append(p, end, std::string_view(text));
+}
+
+inline void append(char*& p, char* end, char c) {
+    if (p < end) *p++ = c;
+}
+
+inline void append(char*& p, char* end, bool value) {
+    append(p, end, std::string_view(value ? "true" : "false"));
+}
+
+inline void append(char*& p, char* end, Hex value) {
+    char digits[24] = { '0', 'x' };
+    auto result = std::to_chars(digits + 2, digits + sizeof(digits), value.value, 16);
+    append(p, end, std::string_view(digits, (size_t)(result.ptr - digits)));
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value>::type append(char*& p, char* end, T value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    append(p, end, std::string_view(digits, (size_t)(result.ptr - digits)));
+}
+
+inline void append(char*& p, char* end, double value) {
+    char digits[32];
+    int length = snprintf(digits, sizeof(digits), "%g", value);
+    if (length > 0) append(p, end, std::string_view(digits, (size_t)length));
+}
+
+/**
+ * Format a timestamp as 2026-01-31T12:34:56.789Z
+ */
+inline void appendTimestamp(std::string& out, int64_t nanoseconds) {
+    int64_t milliseconds = nanoseconds / 1000000;
+    int64_t seconds = milliseconds / 1000;
+    int64_t days = seconds / 86400;
+    int64_t secondOfDay = seconds % 86400;
+
+    // Civil date from days since 1970-01-01 (Howard Hinnant's algorithm)
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t dayOfEra = z - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t mp = (5 * dayOfYear + 2) / 153;
+    int64_t day = dayOfYear - (153 * mp + 2) / 5 + 1;
+    int64_t month = mp < 10 ? mp + 3 : mp - 9;
+    int64_t year = yearOfEra + era * 400 + (month <= 2);
+
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                          (int)year, (int)month, (int)day, (int)(secondOfDay / 3600),
+                          (int)(secondOfDay / 60 % 60), (int)(secondOfDay % 60), (int)(milliseconds % 1000));
+    out.append(text, (size_t)length);
+}
+
+} // namespace Detail
+
+/**
+ * Lowest level that is logged; checked before any formatting
+ */
+inline std::atomic<Level> minimumLevel{ Level::Info };
+
+inline bool enabled(Level level) {
+    return level >= minimumLevel.load(std::memory_order_relaxed);
+}
+
+/**
+ * Asynchronous logger: threads write into their own lock-free ring and a
+ * background thread drains all rings to the sink (console or file), merging
+ * them in timestamp order. Writers never wait for the sink; when a ring is
+ * full the record is dropped and counted instead.
+ */
+class Logger {
+private:
+    static constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(20);
+
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<Detail::Ring>> rings;
+    std::atomic<uint32_t> nextThread{ 1 };
+    std::atomic<unsigned> ratePerSecond{ 0 };
+
+    std::mutex sinkMutex;  // serializes drain passes and sink changes
+    FILE* sink = stdout;
+    bool ownsSink = false;
+    std::vector<Detail::Record> pending;
+    std::string output;
+
+    std::atomic<uint64_t> written{ 0 };
+    std::atomic<uint64_t> droppedTotal{ 0 };
+    std::atomic<uint64_t> suppressedTotal{ 0 };
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread drainer;
+
+    struct Registration {
+        std::shared_ptr<Detail::Ring> ring;
+        ~Registration() {
+            if (ring) ring->abandoned = true;
+        }
+    };
+
+    Logger() {
+        drainer = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            while (!stopping) {
+                wake.wait_for(lock, DRAIN_INTERVAL);
+                lock.unlock();
+                drain();
+                lock.lock();
+            }
+        });
+    }
+
+    std::shared_ptr<Detail::Ring> registerThread() {
+        auto ring = std::make_shared<Detail::Ring>(nextThread.fetch_add(1));
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(ring);
+        return ring;
+    }
+
+public:
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (drainer.joinable()) drainer.join();
+        drain();
+        if (ownsSink) fclose(sink);
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    /** Ring of the calling thread, created on its first message */
+    Detail::Ring& ring() {
+        thread_local Registration registration{ registerThread() };
+        return *registration.ring;
+    }
+
+    /** Messages per thread and second beyond which messages are suppressed (0 = unlimited) */
+    void setRateLimit(unsigned messagesPerSecond) { ratePerSecond = messagesPerSecond; }
+    unsigned rateLimit() const { return ratePerSecond.load(std::memory_order_relaxed); }
+
+    /**
+     * Append to a file instead of the console; an empty path selects the console.
+     * Returns false (keeping the current sink) if the file cannot be opened.
+     */
+    bool setFile(const std::string& path) {
+        FILE* next = stdout;
+        if (!path.empty()) {
+#ifdef _WIN32
+            if (fopen_s(&next, path.c_str(), "a") != 0) next = nullptr;
+#else
+            next = fopen(path.c_str(), "a");
+#endif
+            if (!next) return false;
+        }
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        if (ownsSink) fclose(sink);
+        sink = next;
+        ownsSink = !path.empty();
+        return true;
+    }
+
+    /**
+     * Write everything queued so far to the sink (runs on the drain thread;
+     * callable anywhere to flush synchronously)
+     */
+    void drain() {
+        std::lock_guard<std::mutex> sinkLock(sinkMutex);
+        pending.clear();
+        output.clear();
+
+        uint64_t dropped = 0;
+        uint64_t suppressed = 0;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            for (const auto& ring : rings) {
+                ring->popAll(pending);
+                dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+                suppressed += ring->suppressed.exchange(0, std::memory_order_relaxed);
+            }
+            // Rings of exited threads go once they are drained
+            rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<Detail::Ring>& ring) {
+                return ring->abandoned && ring->empty();
+            }), rings.end());
+        }
+
+        std::stable_sort(pending.begin(), pending.end(), [](const Detail::Record& a, const Detail::Record& b) {
+            return a.timestamp < b.timestamp;
+        });
+
+        for (const auto& record : pending) {
+            Detail::appendTimestamp(output, record.timestamp);
+            output += ' ';
+            output += levelName(record.level);
+            output += " [";
+            output += std::to_string(record.thread);
+            output += "] ";
+            output.append(record.text, record.length);
+            output += '\n';
+        }
+        if (dropped > 0 || suppressed > 0) {
+            Detail::appendTimestamp(output, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+            output += " WARN  [log] ";
+            output += std::to_string(dropped) + " messages dropped (ring full), " +
+                      std::to_string(suppressed) + " suppressed (rate limit)\n";
+            droppedTotal += dropped;
+            suppressedTotal += suppressed;
+        }
+
+        if (!output.empty() && sink) {
+            fwrite(output.data(), 1, output.size(), sink);
+            fflush(sink);
+        }
+        written += pending.size();
+    }
+
+    LogStats stats() {
+        LogStats result;
+        result.written = written;
+        result.dropped = droppedTotal;
+        result.suppressed = suppressedTotal;
+        return result;
+    }
+};
+
+/**
+ * Queue one message made of the arguments concatenated, e.g.
+ * Log::info("Response sent: ", status, " (", bytes, " bytes)")
+ * Costs one relaxed load when the level is disabled; never blocks.
+ */
+template <typename... Args>
+inline void write(Level level, const Args&... args) {
+    if (!enabled(level)) return;
+
+    Logger& logger = Logger::instance();
+    Detail::Ring& ring = logger.ring();
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (!ring.admit(now, logger.rateLimit())) return;
+
+    Detail::Record* record = ring.claim();
+    if (!record) return;
+
+    char* p = record->text;
+    char* end = record->text + Detail::Record::TEXT_CAPACITY;
+    (Detail::append(p, end, args), ...);
+    if (p == end) {
+        // Mark truncation
+        memcpy(end - 3, "...", 3);
+    }
+
+    record->timestamp = now;
+    record->thread = ring.thread;
+    record->level = level;
+    record->length = (uint16_t)(p - record->text);
+    ring.publish();
+}
+
+template <typename... Args>
+inline void trace(const Args&... args) { write(Level::Trace, args...); }
+
+template <typename... Args>
+inline void debug(const Args&... args) { write(Level::Debug, args...); }
+
+template <typename... Args>
+inline void info(const Args&... args) { write(Level::Info, args...); }
+
+template <typename... Args>
+inline void warn(const Args&... args) { write(Level::Warn, args...); }
+
+template <typename... Args>
+inline void error(const Args&... args) { write(Level::Error, args...); }
+
+/**
+ * Apply the logging options: level, sink (empty = console) and per-thread rate limit
+ */
+inline bool configure(Level level, const std::string& file, unsigned messagesPerSecond) {
+    minimumLevel = level;
+    Logger::instance().setRateLimit(messagesPerSecond);
+    return Logger::instance().setFile(file);
+}
+
+/**
+ * Write out everything queued so far, e.g. before exiting on an error
+ */
+inline void flush() {
+    Logger::instance().drain();
+}
+
+} // namespace Log
+} // namespace ArhintSigner
@@ -0,0 +1,509 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <thread>
+#include "sha2.h"
+#include "json_utils.h"
+#include "signing.h"
+
+namespace ArhintSigner {
+namespace Merkle {
+
+using Digest = Crypto::Sha256::Digest;
+
+/** Most hashes accepted in one /signMerkle submission */
+constexpr size_t MAX_SUBMISSION_HASHES = 16384;
+
+/**
+ * Leaf hash: SHA-256(0x00 || submitted hash), as in RFC 6962 / RFC 9162
+ */
+inline Digest leafHash(const uint8_t* data, size_t length) {
+    static const uint8_t prefix = 0x00;
+    Crypto::Sha256 sha;
+    sha.update(&prefix, 1);
+    sha.update(data, length);
+    return sha.finish();
+}
+
+/**
+ * Interior node hash: SHA-256(0x01 || left || right)
+ */
+inline Digest nodeHash(const Digest& left, const Digest& right) {
+    static const uint8_t prefix = 0x01;
+    Crypto::Sha256 sha;
+    sha.update(&prefix, 1);
+    sha.update(left.data(), left.size());
+    sha.update(right.data(), right.size());
+    return sha.finish();
+}
+
+/**
+ * Proof that one leaf is included in a tree with a given root
+ */
+struct InclusionProof {
+    size_t leafIndex = 0;
+    size_t treeSize = 0;
+    std::vector<Digest> path;  // sibling hashes, leaf level first
+};
+
+/**
+ * Merkle tree over submitted hashes (RFC 9162 section 2.1.1)
+ *
+ * Levels are built bottom-up; a node without a sibling is promoted to the
+ * next level unchanged, which yields the same root as the RFC's recursive
+ * definition for any number of leaves.
+ */
+class Tree {
+private:
+    std::vector<std::vector<Digest>> levels;  // levels[0] = leaf hashes, back() = { root }
+
+public:
+    explicit Tree(const std::vector<Digest>& leaves) {
+        if (leaves.empty()) {
+            throw std::runtime_error("Merkle tree needs at least one leaf");
+        }
+
+        std::vector<Digest> level;
+        level.reserve(leaves.size());
+        for (const auto& leaf : leaves) {
+            level.push_back(leafHash(leaf.data(), leaf.size()));
+        }
+        levels.push_back(std::move(level));
+
+        while (levels.back().size() > 1) {
+            const std::vector<Digest>& below = levels.back();
+            std::vector<Digest> next;
+            next.reserve((below.size() + 1) / 2);
+            for (size_t i = 0; i + 1 < below.size(); i += 2) {
+                next.push_back(nodeHash(below[i], below[i + 1]));
+            }
+            if (below.size() % 2 == 1) next.push_back(below.back());
+            levels.push_back(std::move(next));
+        }
+    }
+
+    const Digest& root() const { return levels.back().front(); }
+
+    size_t size() const { return levels.front().size(); }
+
+    InclusionProof proof(size_t leafIndex) const {
+        if (leafIndex >= size()) {
+            throw std::out_of_range("Merkle leaf index out of range");
+        }
+
+        InclusionProof result;
+        result.leafIndex = leafIndex;
+        result.treeSize = size();
+        size_t index = leafIndex;
+        for (size_t level = 0; level + 1 < levels.size(); level++) {
+            size_t sibling = index ^ 1;
+            if (sibling < levels[level].size()) {
+                result.path.push_back(levels[level][sibling]);
+            }
+            index >>= 1;
+        }
+        return result;
+    }
+};
+
+/**
+ * Recompute the root from a submitted hash and its inclusion proof
+ * (RFC 9162 section 2.1.3.2). Returns false if the proof is malformed.
+ */
+inline bool rootFromInclusionProof(const uint8_t* data, size_t length, const InclusionProof& proof, Digest& root) {
+    if (proof.leafIndex >= proof.treeSize) return false;
+
+    size_t fn = proof.leafIndex;
+    size_t sn = proof.treeSize - 1;
+    Digest r = leafHash(data, length);
+    for (const Digest& p : proof.path) {
+        if (sn == 0) return false;
+        if ((fn & 1) || fn == sn) {
+            r = nodeHash(p, r);
+            while (!(fn & 1) && fn != 0) {
+                fn >>= 1;
+                sn >>= 1;
+            }
+        } else {
+            r = nodeHash(r, p);
+        }
+        fn >>= 1;
+        sn >>= 1;
+    }
+    if (sn != 0) return false;
+    root = r;
+    return true;
+}
+
+/**
+ * Check that a submitted hash is included under the given (signed) root
+ */
+inline bool verifyInclusion(const uint8_t* data, size_t length, const InclusionProof& proof, const Digest& root) {
+    Digest computed;
+    return rootFromInclusionProof(data, length, proof, computed) && computed == root;
+}
+
+/**
+ * Streaming reader for a /signMerkle request body
+ *
+ * {"thumbprint": "...", "hashes": ["<base64>", ...]}  or  {"thumbprint": "...", "hash": "<base64>"}
+ *
+ * "hashes" takes precedence over "hash". Fed by Json::StreamParser as the
+ * body arrives; stops with an error as soon as the submission grows past
+ * MAX_SUBMISSION_HASHES.
+ */
+class SubmissionReader : public Json::Handler {
+private:
+    enum class Field { Other, Thumbprint, Hash, Hashes };
+
+    std::vector<std::string> list;
+    std::string single;
+    std::string certThumbprint;
+    std::string scratch;
+    size_t depth = 0;
+    Field field = Field::Other;
+    bool hasList = false;
+    bool inList = false;
+
+    void otherValue() {
+        if (depth == 0) throw std::runtime_error("Invalid request: expected a JSON object");
+        if (inList && depth == 2) throw std::runtime_error("Invalid hashes: expected base64 strings");
+    }
+
+public:
+    void startObject() override {
+        if (depth > 0) otherValue();
+        depth++;
+    }
+    void endObject() override { depth--; }
+    void startArray() override {
+        if (depth == 1 && field == Field::Hashes) {
+            hasList = true;
+            inList = true;
+        } else {
+            otherValue();
+        }
+        depth++;
+    }
+    void endArray() override {
+        if (--depth == 1) inList = false;
+    }
+
+    void key(std::string_view raw, bool escaped) override {
+        if (depth != 1) return;
+        std::string_view name = Json::decoded(raw, escaped, scratch);
+        field = name == "thumbprint" ? Field::Thumbprint
+              : name == "hash" ? Field::Hash
+              : name == "hashes" ? Field::Hashes
+              : Field::Other;
+    }
+
+    void string(std::string_view raw, bool escaped) override {
+        if (depth == 2 && inList) {
+            if (list.size() >= MAX_SUBMISSION_HASHES) {
+                throw std::runtime_error("Too many hashes (max " + std::to_string(MAX_SUBMISSION_HASHES) + ")");
+            }
+            list.emplace_back(Json::decoded(raw, escaped, scratch));
+        } else if (depth == 1 && field == Field::Thumbprint) {
+            certThumbprint = Json::decoded(raw, escaped, scratch);
+        } else if (depth == 1 && field == Field::Hash) {
+            single = Json::decoded(raw, escaped, scratch);
+        } else if (depth == 0) {
+            otherValue();
+        }
+    }
+
+    void number(std::string_view) override { otherValue(); }
+    void boolean(bool) override { otherValue(); }
+    void null() override { otherValue(); }
+
+    const std::string& thumbprint() const { return certThumbprint; }
+
+    /** Submitted hashes in order (base64, not yet decoded) */
+    std::vector<std::string> hashes() {
+        if (hasList) return std::move(list);
+        std::vector<std::string> result;
+        if (!single.empty()) result.push_back(std::move(single));
+        return result;
+    }
+};
+
+/**
+ * Signed root and the proofs for one submission
+ */
+struct SignedBatch {
+    Digest root;
+    std::string signature;
+    size_t treeSize = 0;
+    std::vector<InclusionProof> proofs;  // one per submitted hash, in submission order
+};
+
+/**
+ * Counters reported by Coalescer
+ */
+struct CoalescerStats {
+    uint64_t submissions = 0;
+    uint64_t leaves = 0;
+    uint64_t batches = 0;         // signed roots
+    uint64_t fullBatches = 0;     // sealed by maxItems rather than maxWait
+    uint64_t failedBatches = 0;
+    size_t maxItems = 0;
+    long long maxWaitMs = 0;
+};
+
+/**
+ * Collects hashes submitted for the same key into one Merkle tree and signs
+ * only its root
+ *
+ * Submissions are added to the open batch for their key and return at once.
+ * A dedicated coalescer thread owns the batch windows: it seals a batch
+ * when it holds maxItems hashes or maxWait has elapsed since it opened,
+ * whichever comes first, then builds the tree, signs the root once and
+ * completes every submission with the signature plus inclusion proofs for
+ * its own hashes. A submission never straddles two batches. Nothing but the
+ * coalescer thread waits for the window, so a batch can hold more
+ * submissions than the server has threads.
+ */
+class Coalescer {
+public:
+    using RootSigner = std::function<std::string(const std::string& key, const Digest& root)>;
+
+    /**
+     * Called on the coalescer thread once a submission's batch is signed:
+     * with the result, or with nullptr and the reason signing failed
+     */
+    using Completion = std::function<void(const SignedBatch* batch, const std::string& error)>;
+
+private:
+    struct Submission {
+        size_t offset;  // index of its first leaf in the batch
+        size_t count;
+        Completion done;
+    };
+
+    struct Batch {
+        std::string key;
+        std::vector<Digest> leaves;
+        std::vector<Submission> submissions;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    RootSigner signRoot;
+    std::mutex mutex;
+    std::condition_variable changed;  // a batch opened or was sealed, or stopping
+    std::unordered_map<std::string, std::unique_ptr<Batch>> open;  // key -> batch accepting hashes
+    std::deque<std::unique_ptr<Batch>> sealed;                      // waiting to be signed, in order
+    size_t maxItems;
+    std::chrono::milliseconds maxWait;
+    CoalescerStats counters;
+    bool stopping = false;
+    std::thread worker;  // started with the first submission
+
+    void seal(std::unordered_map<std::string, std::unique_ptr<Batch>>::iterator it) {
+        sealed.push_back(std::move(it->second));
+        open.erase(it);
+        changed.notify_all();
+    }
+
+    /** Build and sign one sealed batch, then complete its submissions (without the lock) */
+    void sign(Batch& batch, bool shuttingDown) {
+        std::unique_ptr<Tree> tree;
+        SignedBatch signedBatch;
+        std::string error;
+        try {
+            tree.reset(new Tree(batch.leaves));
+            signedBatch.root = tree->root();
+            signedBatch.treeSize = tree->size();
+            if (shuttingDown) throw std::runtime_error("Server is shutting down");
+            signedBatch.signature = signRoot(batch.key, signedBatch.root);
+        }
+        catch (const std::exception& ex) {
+            error = ex.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.batches++;
+            if (!error.empty()) counters.failedBatches++;
+        }
+
+        for (Submission& submission : batch.submissions) {
+            try {
+                if (!error.empty()) {
+                    submission.done(nullptr, error);
+                    continue;
+                }
+                signedBatch.proofs.clear();
+                signedBatch.proofs.reserve(submission.count);
+                for (size_t i = 0; i < submission.count; i++) {
+                    signedBatch.proofs.push_back(tree->proof(submission.offset + i));
+                }
+                submission.done(&signedBatch, error);
+            }
+            catch (const std::exception& ex) {
+                Log::error("Merkle submission completion failed: ", ex.what());
+            }
+        }
+    }
+
+    /** Coalescer thread: seal batches as their windows close and sign them */
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            auto now = std::chrono::steady_clock::now();
+            auto nextDeadline = std::chrono::steady_clock::time_point::max();
+            for (auto it = open.begin(); it != open.end();) {
+                auto current = it++;
+                if (stopping || current->second->deadline <= now) {
+                    seal(current);
+                } else if (current->second->deadline < nextDeadline) {
+                    nextDeadline = current->second->deadline;
+                }
+            }
+
+            if (!sealed.empty()) {
+                std::unique_ptr<Batch> batch = std::move(sealed.front());
+                sealed.pop_front();
+                bool shuttingDown = stopping;
+                lock.unlock();
+                sign(*batch, shuttingDown);
+                batch.reset();
+                lock.lock();
+                continue;
+            }
+            if (stopping) return;
+            if (nextDeadline == std::chrono::steady_clock::time_point::max()) {
+                changed.wait(lock);
+            } else {
+                changed.wait_until(lock, nextDeadline);
+            }
+        }
+    }
+
+public:
+    explicit Coalescer(RootSigner signer, size_t maxBatchItems = 256,
+                       std::chrono::milliseconds maxBatchWait = std::chrono::milliseconds(50))
+        : signRoot(std::move(signer))
+        , maxItems(maxBatchItems)
+        , maxWait(maxBatchWait) {
+    }
+
+    /** Fails the submissions still waiting and stops the coalescer thread */
+    ~Coalescer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    Coalescer(const Coalescer&) = delete;
+    Coalescer& operator=(const Coalescer&) = delete;
+
+    /**
+     * Change the coalescing window; applies to batches opened afterwards
+     */
+    void setWindow(size_t maxBatchItems, std::chrono::milliseconds maxBatchWait) {
+        std::lock_guard<std::mutex> lock(mutex);
+        maxItems = maxBatchItems > 0 ? maxBatchItems : 1;
+        maxWait = maxBatchWait;
+    }
+
+    /**
+     * Add hashes to the open batch for key without waiting; done is called
+     * on the coalescer thread once the batch's root is signed or failed
+     */
+    void submit(const std::string& key, const std::vector<Digest>& hashes, Completion done) {
+        if (hashes.empty()) {
+            throw std::runtime_error("At least one hash is required");
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) throw std::runtime_error("Server is shutting down");
+        if (!worker.joinable()) worker = std::thread([this]() { run(); });
+        counters.submissions++;
+        counters.leaves += hashes.size();
+
+        auto it = open.find(key);
+        if (it != open.end() && it->second->leaves.size() + hashes.size() > maxItems) {
+            // Doesn't fit - let the current batch go and start a new one
+            counters.fullBatches++;
+            seal(it);
+            it = open.end();
+        }
+        if (it == open.end()) {
+            std::unique_ptr<Batch> batch(new Batch());
+            batch->key = key;
+            batch->deadline = std::chrono::steady_clock::now() + maxWait;
+            it = open.emplace(key, std::move(batch)).first;
+            changed.notify_all();
+        }
+
+        Batch& batch = *it->second;
+        batch.submissions.push_back(Submission{ batch.leaves.size(), hashes.size(), std::move(done) });
+        batch.leaves.insert(batch.leaves.end(), hashes.begin(), hashes.end());
+        if (batch.leaves.size() >= maxItems) {
+            counters.fullBatches++;
+            seal(it);
+        }
+    }
+
+    /**
+     * Add hashes to the open batch for key and wait until its root is signed,
+     * for callers that cannot be completed later. Throws if signing the root failed.
+     */
+    SignedBatch submit(const std::string& key, const std::vector<Digest>& hashes) {
+        auto promise = std::make_shared<std::promise<SignedBatch>>();
+        std::future<SignedBatch> result = promise->get_future();
+        submit(key, hashes, [promise](const SignedBatch* batch, const std::string& error) {
+            if (batch) {
+                promise->set_value(*batch);
+            } else {
+                promise->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+            }
+        });
+        return result.get();
+    }
+
+    CoalescerStats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        CoalescerStats result = counters;
+        result.maxItems = maxItems;
+        result.maxWaitMs = (long long)maxWait.count();
+        return result;
+    }
+};
+
+/**
+ * Process-wide coalescer; roots are signed on the same key path as /sign
+ * (key = canonical SHA-1 thumbprint of the certificate)
+ */
+inline Coalescer& coalescer() {
+    static Coalescer instance([](const std::string& thumbprint, const Digest& root) {
+        // The root covers other requests' hashes too, so the signing request's
+        // deadline and connection must not decide its fate
+        Keys::RequestTerms shared;
+        shared.lane = Keys::Lane::Bulk;
+        Keys::ScopedRequestTerms terms(shared);
+        Keys::CertificatePtr cert = Signing::findCertificate(thumbprint);
+        std::shared_ptr<Keys::SigningKey> key = Signing::acquireKey(cert);
+        std::vector<uint8_t> rootBytes(root.begin(), root.end());
+        return Signing::signWithCertificate(cert, key, Signing::resolveAlgorithm(*cert, rootBytes.size(), "", ""),
+                                            rootBytes);
+    });
+    return instance;
+}
+
+} // namespace Merkle
+} // namespace ArhintSigner
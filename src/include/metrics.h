@@ -0,0 +1,534 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+namespace ArhintSigner {
+namespace Metrics {
+
+/**
+ * Add to a counter owned by the calling thread. Only the owner writes, so a
+ * plain load and store suffices (no locked read-modify-write); scrapes read
+ * the cells with relaxed loads.
+ */
+inline void bump(std::atomic<uint64_t>& cell, uint64_t amount = 1) {
+    cell.store(cell.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline uint64_t valueOf(const std::atomic<uint64_t>& cell) {
+    return cell.load(std::memory_order_relaxed);
+}
+
+inline uint64_t valueOf(uint64_t cell) {
+    return cell;
+}
+
+/**
+ * HDR-style log-linear buckets over microseconds: four linear sub-buckets per
+ * power of two, so any recorded value is within 25% of its bucket bound.
+ * Covers 1 us to about 18 minutes; longer values land in the last bucket.
+ */
+constexpr unsigned SUB_BUCKET_BITS = 2;
+constexpr uint64_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+constexpr uint64_t MAX_MICROS = (1ull << 30) - 1;
+constexpr size_t BUCKETS = (size_t)((30 - SUB_BUCKET_BITS) * SUB_BUCKETS + SUB_BUCKETS);
+
+inline size_t bucketOf(uint64_t micros) {
+    if (micros > MAX_MICROS) micros = MAX_MICROS;
+    if (micros < SUB_BUCKETS) return (size_t)micros;
+    unsigned msb = 63;
+    while (!(micros >> msb)) msb--;
+    unsigned shift = msb - SUB_BUCKET_BITS;
+    return (size_t)((micros >> shift) + SUB_BUCKETS * shift);
+}
+
+/** Exclusive upper bound of a bucket in microseconds */
+inline uint64_t bucketUpperBound(size_t bucket) {
+    uint64_t shift = bucket < 2 * SUB_BUCKETS ? 0 : bucket / SUB_BUCKETS - 1;
+    uint64_t mantissa = bucket - SUB_BUCKETS * shift;
+    return (mantissa + 1) << shift;
+}
+
+/**
+ * Latency histogram; Cell is an atomic in per-thread shards and a plain
+ * integer in scrape totals
+ */
+template <typename Cell>
+struct Histogram {
+    Cell buckets[BUCKETS] = {};
+    Cell count = {};
+    Cell sumMicros = {};
+
+    template <typename Other>
+    void add(const Histogram<Other>& other) {
+        for (size_t i = 0; i < BUCKETS; i++) buckets[i] += valueOf(other.buckets[i]);
+        count += valueOf(other.count);
+        sumMicros += valueOf(other.sumMicros);
+    }
+};
+
+inline void record(Histogram<std::atomic<uint64_t>>& histogram, uint64_t micros) {
+    bump(histogram.buckets[bucketOf(micros)]);
+    bump(histogram.count);
+    bump(histogram.sumMicros, micros);
+}
+
+/**
+ * Response status codes tracked individually; the rest share "other"
+ */
+constexpr int TRACKED_STATUSES[] = { 200, 204, 400, 404, 405, 408, 413, 431, 499, 500, 501, 503, 504 };
+constexpr size_t STATUS_SLOTS = sizeof(TRACKED_STATUSES) / sizeof(TRACKED_STATUSES[0]) + 1;
+
+inline size_t statusSlot(int status) {
+    for (size_t i = 0; i + 1 < STATUS_SLOTS; i++) {
+        if (TRACKED_STATUSES[i] == status) return i;
+    }
+    return STATUS_SLOTS - 1;
+}
+
+inline std::string statusLabel(size_t slot) {
+    return slot + 1 < STATUS_SLOTS ? std::to_string(TRACKED_STATUSES[slot]) : "other";
+}
+
+/**
+ * Signing API of a key: CNG or legacy CryptoAPI for the Windows store,
+ * in-process for the software key store, Cryptoki for PKCS#11 tokens
+ */
+enum class SignApi { Cng, Legacy, Software, Pkcs11, Count };
+
+inline const char* signApiName(SignApi api) {
+    switch (api) {
+        case SignApi::Cng: return "cng";
+        case SignApi::Software: return "software";
+        case SignApi::Pkcs11: return "pkcs11";
+        default: return "legacy";
+    }
+}
+
+constexpr size_t MAX_ROUTES = 16;
+constexpr size_t MAX_CERTIFICATES = 32;  // further certificates share "other"
+
+/**
+ * Every metric the service records. One instance per thread (atomic cells)
+ * plus the scrape totals (plain cells).
+ */
+template <typename Cell>
+struct Layout {
+    Histogram<Cell> requests[MAX_ROUTES][STATUS_SLOTS];
+    Cell inFlight[MAX_ROUTES] = {};  // wraps below zero per thread; only the sum is meaningful
+    Histogram<Cell> signByApi[(size_t)SignApi::Count];
+    Histogram<Cell> signByCertificate[MAX_CERTIFICATES + 1];
+    Histogram<Cell> keyAcquire[(size_t)SignApi::Count];
+    Histogram<Cell> storeEnumeration;
+    Histogram<Cell> keyQueueWait;
+    Histogram<Cell> queueDelay;
+
+    template <typename Other>
+    void add(const Layout<Other>& other) {
+        for (size_t route = 0; route < MAX_ROUTES; route++) {
+            for (size_t status = 0; status < STATUS_SLOTS; status++) {
+                requests[route][status].add(other.requests[route][status]);
+            }
+            inFlight[route] += valueOf(other.inFlight[route]);
+        }
+        for (size_t api = 0; api < (size_t)SignApi::Count; api++) {
+            signByApi[api].add(other.signByApi[api]);
+            keyAcquire[api].add(other.keyAcquire[api]);
+        }
+        for (size_t slot = 0; slot <= MAX_CERTIFICATES; slot++) {
+            signByCertificate[slot].add(other.signByCertificate[slot]);
+        }
+        storeEnumeration.add(other.storeEnumeration);
+        keyQueueWait.add(other.keyQueueWait);
+        queueDelay.add(other.queueDelay);
+    }
+};
+
+using Shard = Layout<std::atomic<uint64_t>>;
+using Totals = Layout<uint64_t>;
+
+/**
+ * Label slots for certificate thumbprints. Lookups of known thumbprints
+ * only read; a new thumbprint takes the next slot under a lock.
+ */
+class CertificateSlots {
+private:
+    std::array<std::array<char, 64>, MAX_CERTIFICATES> names{};
+    std::array<uint8_t, MAX_CERTIFICATES> lengths{};
+    std::atomic<size_t> used{ 0 };
+    std::mutex mutex;
+
+    size_t find(std::string_view thumbprint, size_t from, size_t to) const {
+        for (size_t i = from; i < to; i++) {
+            if (std::string_view(names[i].data(), lengths[i]) == thumbprint) return i;
+        }
+        return MAX_CERTIFICATES;
+    }
+
+public:
+    /** Slot of a thumbprint; MAX_CERTIFICATES ("other") once all are taken */
+    size_t slotOf(std::string_view thumbprint) {
+        size_t count = used.load(std::memory_order_acquire);
+        size_t slot = find(thumbprint, 0, count);
+        if (slot != MAX_CERTIFICATES) return slot;
+        if (count == MAX_CERTIFICATES || thumbprint.size() > names[0].size()) return MAX_CERTIFICATES;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t current = used.load(std::memory_order_relaxed);
+        slot = find(thumbprint, count, current);
+        if (slot != MAX_CERTIFICATES || current == MAX_CERTIFICATES) return slot;
+
+        std::copy(thumbprint.begin(), thumbprint.end(), names[current].begin());
+        lengths[current] = (uint8_t)thumbprint.size();
+        used.store(current + 1, std::memory_order_release);
+        return current;
+    }
+
+    size_t size() const { return used.load(std::memory_order_acquire); }
+
+    std::string_view name(size_t slot) const {
+        return slot < size() ? std::string_view(names[slot].data(), lengths[slot]) : "other";
+    }
+};
+
+/**
+ * Per-thread metric shards, summed only when /metrics is scraped.
+ * Recording touches nothing but the calling thread's shard.
+ */
+class Registry {
+private:
+    struct Registration {
+        std::shared_ptr<Shard> shard;
+        std::shared_ptr<std::atomic<bool>> exited;
+        ~Registration() {
+            if (exited) *exited = true;
+        }
+    };
+
+    struct Entry {
+        std::shared_ptr<Shard> shard;
+        std::shared_ptr<std::atomic<bool>> exited;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> shards;
+    std::unique_ptr<Totals> retired = std::make_unique<Totals>();  // shards of exited threads
+    CertificateSlots certificates;
+
+    Registration registerThread() {
+        Registration registration{ std::make_shared<Shard>(), std::make_shared<std::atomic<bool>>(false) };
+        std::lock_guard<std::mutex> lock(mutex);
+        shards.push_back(Entry{ registration.shard, registration.exited });
+        return registration;
+    }
+
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    /** The calling thread's shard, created on first use */
+    Shard& local() {
+        thread_local Registration registration = registerThread();
+        return *registration.shard;
+    }
+
+    CertificateSlots& certificateSlots() { return certificates; }
+
+    /** Sum of all shards; shards of exited threads are folded in once */
+    std::unique_ptr<Totals> collect() {
+        auto totals = std::make_unique<Totals>();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < shards.size();) {
+            if (*shards[i].exited) {
+                retired->add(*shards[i].shard);
+                shards[i] = shards.back();
+                shards.pop_back();
+                continue;
+            }
+            totals->add(*shards[i].shard);
+            i++;
+        }
+        totals->add(*retired);
+        return totals;
+    }
+};
+
+/**
+ * Elapsed time since construction
+ */
+class Stopwatch {
+private:
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+public:
+    uint64_t elapsedMicros() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+/**
+ * Tracks one request of a route as in flight until it is finished
+ */
+class RequestTimer {
+private:
+    size_t route;
+    Stopwatch stopwatch;
+
+public:
+    explicit RequestTimer(size_t routeIndex) : route(routeIndex < MAX_ROUTES ? routeIndex : MAX_ROUTES - 1) {
+        bump(Registry::instance().local().inFlight[route]);
+    }
+
+    /** Record the request's latency under its response status; returns the latency */
+    uint64_t finish(int status) {
+        uint64_t micros = stopwatch.elapsedMicros();
+        Shard& shard = Registry::instance().local();
+        record(shard.requests[route][statusSlot(status)], micros);
+        bump(shard.inFlight[route], ~0ull);  // -1
+        return micros;
+    }
+};
+
+/**
+ * Phases of a request, reported in the Server-Timing header
+ */
+enum class Phase { Read, Parse, Lookup, Key, Queue, Sign, Respond, Count };
+
+inline const char* phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::Read: return "read";        // request body
+        case Phase::Parse: return "parse";      // JSON and hash decoding
+        case Phase::Lookup: return "lookup";    // certificate index
+        case Phase::Key: return "key";          // private key acquire or cache hit
+        case Phase::Queue: return "queue";      // waiting for the key's device (KeyScheduler)
+        case Phase::Sign: return "sign";        // NCryptSignHash / CryptSignHash
+        default: return "respond";              // building and sending the response
+    }
+}
+
+/**
+ * Time spent in each phase of the current request: one clock read per
+ * phase boundary. mark(phase) charges the time since the previous mark to
+ * phase; marks outside a request are ignored.
+ */
+class RequestPhases {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point start;
+    Clock::time_point last;
+    uint64_t nanos[(size_t)Phase::Count] = {};
+    unsigned marked = 0;
+    bool active = false;
+
+public:
+    void begin() {
+        start = last = Clock::now();
+        for (uint64_t& value : nanos) value = 0;
+        marked = 0;
+        active = true;
+    }
+
+    void mark(Phase phase) {
+        if (!active) return;
+        Clock::time_point now = Clock::now();
+        nanos[(size_t)phase] += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+        marked |= 1u << (size_t)phase;
+        last = now;
+    }
+
+    void end() { active = false; }
+
+    /**
+     * Server-Timing header value, e.g. "read;dur=0.012, sign;dur=1.204, total;dur=1.250"
+     * (milliseconds; total runs up to now). Returns the length written.
+     */
+    size_t format(char* out, size_t capacity) const {
+        if (!active) return 0;
+        char* p = out;
+        char* end = out + capacity;
+        // "name;dur=<ms>.<3 digits>" with integer formatting; stops short when out is full
+        auto append = [&](const char* name, uint64_t value) {
+            char text[64];
+            char* t = text;
+            if (p != out) { *t++ = ','; *t++ = ' '; }
+            for (const char* c = name; *c; c++) *t++ = *c;
+            memcpy(t, ";dur=", 5);
+            t += 5;
+            uint64_t micros = value / 1000;
+            t = std::to_chars(t, text + sizeof(text), micros / 1000).ptr;
+            *t++ = '.';
+            uint64_t fraction = micros % 1000;
+            *t++ = (char)('0' + fraction / 100);
+            *t++ = (char)('0' + fraction / 10 % 10);
+            *t++ = (char)('0' + fraction % 10);
+            size_t length = (size_t)(t - text);
+            if (length > (size_t)(end - p)) return;
+            memcpy(p, text, length);
+            p += length;
+        };
+        for (size_t i = 0; i < (size_t)Phase::Count; i++) {
+            if (marked & (1u << i)) append(phaseName((Phase)i), nanos[i]);
+        }
+        append("total", (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        return (size_t)(p - out);
+    }
+};
+
+/**
+ * Phases of the request the calling thread is handling
+ */
+inline RequestPhases& requestPhases() {
+    thread_local RequestPhases phases;
+    return phases;
+}
+
+/**
+ * Record one signature: by API and by certificate thumbprint
+ */
+inline void recordSign(SignApi api, std::string_view thumbprint, uint64_t micros) {
+    Registry& registry = Registry::instance();
+    Shard& shard = registry.local();
+    record(shard.signByApi[(size_t)api], micros);
+    record(shard.signByCertificate[registry.certificateSlots().slotOf(thumbprint)], micros);
+}
+
+/** Record a private key acquisition (key cache miss) */
+inline void recordKeyAcquire(SignApi api, uint64_t micros) {
+    record(Registry::instance().local().keyAcquire[(size_t)api], micros);
+}
+
+/** Record one enumeration of the certificate store */
+inline void recordStoreEnumeration(uint64_t micros) {
+    record(Registry::instance().local().storeEnumeration, micros);
+}
+
+/** Record the time a request waited for a worker */
+inline void recordQueueDelay(uint64_t micros) {
+    record(Registry::instance().local().queueDelay, micros);
+}
+
+/** Record the time a key operation waited for its device */
+inline void recordKeyQueueWait(uint64_t micros) {
+    record(Registry::instance().local().keyQueueWait, micros);
+}
+
+/**
+ * Prometheus text exposition format (version 0.0.4)
+ */
+class Exposition {
+private:
+    std::string out;
+
+    static void appendSeconds(std::string& text, uint64_t micros) {
+        char value[32];
+        int length = snprintf(value, sizeof(value), "%.6f", micros / 1e6);
+        text.append(value, (size_t)length);
+    }
+
+public:
+    static constexpr const char* CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+    Exposition() { out.reserve(64 * 1024); }
+
+    /** # HELP and # TYPE lines introducing a metric family */
+    void family(const char* name, const char* type, const char* help) {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    }
+
+    /** One sample of a duration, in seconds */
+    void sampleSeconds(const char* name, std::string_view labels, uint64_t micros) {
+        out += name;
+        if (!labels.empty()) {
+            out += '{';
+            out += labels;
+            out += '}';
+        }
+        out += ' ';
+        appendSeconds(out, micros);
+        out += '\n';
+    }
+
+    /** One sample; labels is the inner part of {...}, e.g. route="sign" */
+    void sample(const char* name, std::string_view labels, uint64_t value) {
+        out += name;
+        if (!labels.empty()) {
+            out += '{';
+            out += labels;
+            out += '}';
+        }
+        out += ' ';
+        out += std::to_string(value);
+        out += '\n';
+    }
+
+    /**
+     * Histogram series in seconds. Buckets above the highest non-empty one
+     * are left out; +Inf always carries the total.
+     */
+    void histogram(const char* name, std::string_view labels, const Histogram<uint64_t>& histogram) {
+        std::string prefix = labels.empty() ? std::string() : std::string(labels) + ",";
+        size_t last = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            if (histogram.buckets[i]) last = i + 1;
+        }
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < last; i++) {
+            cumulative += histogram.buckets[i];
+            out += name;
+            out += "_bucket{";
+            out += prefix;
+            out += "le=\"";
+            appendSeconds(out, bucketUpperBound(i));
+            out += "\"} ";
+            out += std::to_string(cumulative);
+            out += '\n';
+        }
+        out += name;
+        out += "_bucket{";
+        out += prefix;
+        out += "le=\"+Inf\"} ";
+        out += std::to_string(histogram.count);
+        out += '\n';
+
+        out += name;
+        out += "_sum";
+        if (!labels.empty()) {
+            out += '{';
+            out += labels;
+            out += '}';
+        }
+        out += ' ';
+        appendSeconds(out, histogram.sumMicros);
+        out += '\n';
+
+        std::string countName = std::string(name) + "_count";
+        sample(countName.c_str(), labels, histogram.count);
+    }
+
+    const std::string& text() const { return out; }
+};
+
+} // namespace Metrics
+} // namespace ArhintSigner
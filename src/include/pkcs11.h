@@ -0,0 +1,391 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace ArhintSigner {
+namespace Pkcs11 {
+
+/*
+ * The part of the Cryptoki ABI (PKCS#11 v2.40) the key store uses. Modules
+ * are loaded at run time, so no vendor header or import library is needed.
+ * Names follow the specification; on Windows every structure is packed to
+ * one byte, as the specification requires for that platform.
+ */
+#ifdef _WIN32
+#pragma pack(push, 1)
+#endif
+
+using CK_BYTE = unsigned char;
+using CK_ULONG = unsigned long;
+using CK_RV = CK_ULONG;
+using CK_FLAGS = CK_ULONG;
+using CK_SLOT_ID = CK_ULONG;
+using CK_SESSION_HANDLE = CK_ULONG;
+using CK_OBJECT_HANDLE = CK_ULONG;
+using CK_OBJECT_CLASS = CK_ULONG;
+using CK_ATTRIBUTE_TYPE = CK_ULONG;
+using CK_MECHANISM_TYPE = CK_ULONG;
+using CK_KEY_TYPE = CK_ULONG;
+using CK_USER_TYPE = CK_ULONG;
+
+struct CK_VERSION {
+    CK_BYTE major;
+    CK_BYTE minor;
+};
+
+struct CK_INFO {
+    CK_VERSION cryptokiVersion;
+    CK_BYTE manufacturerID[32];
+    CK_FLAGS flags;
+    CK_BYTE libraryDescription[32];
+    CK_VERSION libraryVersion;
+};
+
+struct CK_SLOT_INFO {
+    CK_BYTE slotDescription[64];
+    CK_BYTE manufacturerID[32];
+    CK_FLAGS flags;
+    CK_VERSION hardwareVersion;
+    CK_VERSION firmwareVersion;
+};
+
+struct CK_TOKEN_INFO {
+    CK_BYTE label[32];
+    CK_BYTE manufacturerID[32];
+    CK_BYTE model[16];
+    CK_BYTE serialNumber[16];
+    CK_FLAGS flags;
+    CK_ULONG ulMaxSessionCount;
+    CK_ULONG ulSessionCount;
+    CK_ULONG ulMaxRwSessionCount;
+    CK_ULONG ulRwSessionCount;
+    CK_ULONG ulMaxPinLen;
+    CK_ULONG ulMinPinLen;
+    CK_ULONG ulTotalPublicMemory;
+    CK_ULONG ulFreePublicMemory;
+    CK_ULONG ulTotalPrivateMemory;
+    CK_ULONG ulFreePrivateMemory;
+    CK_VERSION hardwareVersion;
+    CK_VERSION firmwareVersion;
+    CK_BYTE utcTime[16];
+};
+
+struct CK_ATTRIBUTE {
+    CK_ATTRIBUTE_TYPE type;
+    void* pValue;
+    CK_ULONG ulValueLen;
+};
+
+struct CK_MECHANISM {
+    CK_MECHANISM_TYPE mechanism;
+    void* pParameter;
+    CK_ULONG ulParameterLen;
+};
+
+struct CK_RSA_PKCS_PSS_PARAMS {
+    CK_MECHANISM_TYPE hashAlg;
+    CK_ULONG mgf;
+    CK_ULONG sLen;
+};
+
+struct CK_C_INITIALIZE_ARGS {
+    void* createMutex;   // mutex callbacks are left to the library (CKF_OS_LOCKING_OK)
+    void* destroyMutex;
+    void* lockMutex;
+    void* unlockMutex;
+    CK_FLAGS flags;
+    void* pReserved;
+};
+
+using CK_NOTIFY = CK_RV (*)(CK_SESSION_HANDLE, CK_ULONG, void*);
+using Unused = CK_RV (*)();  // entry points neither the key store nor its tests call
+
+/** Entry points in specification order; only the called ones are typed */
+struct CK_FUNCTION_LIST {
+    CK_VERSION version;
+    CK_RV (*C_Initialize)(void* initArgs);
+    CK_RV (*C_Finalize)(void* reserved);
+    CK_RV (*C_GetInfo)(CK_INFO* info);
+    Unused C_GetFunctionList;
+    CK_RV (*C_GetSlotList)(CK_BYTE tokenPresent, CK_SLOT_ID* slotList, CK_ULONG* count);
+    CK_RV (*C_GetSlotInfo)(CK_SLOT_ID slot, CK_SLOT_INFO* info);
+    CK_RV (*C_GetTokenInfo)(CK_SLOT_ID slot, CK_TOKEN_INFO* info);
+    Unused C_GetMechanismList;
+    Unused C_GetMechanismInfo;
+    Unused C_InitToken;
+    Unused C_InitPIN;
+    Unused C_SetPIN;
+    CK_RV (*C_OpenSession)(CK_SLOT_ID slot, CK_FLAGS flags, void* application, CK_NOTIFY notify,
+                           CK_SESSION_HANDLE* session);
+    CK_RV (*C_CloseSession)(CK_SESSION_HANDLE session);
+    CK_RV (*C_CloseAllSessions)(CK_SLOT_ID slot);
+    Unused C_GetSessionInfo;
+    Unused C_GetOperationState;
+    Unused C_SetOperationState;
+    CK_RV (*C_Login)(CK_SESSION_HANDLE session, CK_USER_TYPE userType, CK_BYTE* pin, CK_ULONG pinLength);
+    Unused C_Logout;
+    CK_RV (*C_CreateObject)(CK_SESSION_HANDLE session, CK_ATTRIBUTE* templ, CK_ULONG count,
+                            CK_OBJECT_HANDLE* object);  // tests only
+    Unused C_CopyObject;
+    Unused C_DestroyObject;
+    Unused C_GetObjectSize;
+    CK_RV (*C_GetAttributeValue)(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE object,
+                                 CK_ATTRIBUTE* templ, CK_ULONG count);
+    Unused C_SetAttributeValue;
+    CK_RV (*C_FindObjectsInit)(CK_SESSION_HANDLE session, CK_ATTRIBUTE* templ, CK_ULONG count);
+    CK_RV (*C_FindObjects)(CK_SESSION_HANDLE session, CK_OBJECT_HANDLE* objects, CK_ULONG maxCount,
+                           CK_ULONG* count);
+    CK_RV (*C_FindObjectsFinal)(CK_SESSION_HANDLE session);
+    Unused C_EncryptInit;
+    Unused C_Encrypt;
+    Unused C_EncryptUpdate;
+    Unused C_EncryptFinal;
+    Unused C_DecryptInit;
+    Unused C_Decrypt;
+    Unused C_DecryptUpdate;
+    Unused C_DecryptFinal;
+    Unused C_DigestInit;
+    Unused C_Digest;
+    Unused C_DigestUpdate;
+    Unused C_DigestKey;
+    Unused C_DigestFinal;
+    CK_RV (*C_SignInit)(CK_SESSION_HANDLE session, CK_MECHANISM* mechanism, CK_OBJECT_HANDLE key);
+    CK_RV (*C_Sign)(CK_SESSION_HANDLE session, CK_BYTE* data, CK_ULONG dataLength,
+                    CK_BYTE* signature, CK_ULONG* signatureLength);
+    Unused C_SignUpdate;
+    Unused C_SignFinal;
+    Unused C_SignRecoverInit;
+    Unused C_SignRecover;
+    CK_RV (*C_VerifyInit)(CK_SESSION_HANDLE session, CK_MECHANISM* mechanism, CK_OBJECT_HANDLE key);  // tests only
+    CK_RV (*C_Verify)(CK_SESSION_HANDLE session, CK_BYTE* data, CK_ULONG dataLength,
+                      CK_BYTE* signature, CK_ULONG signatureLength);  // tests only
+    Unused C_VerifyUpdate;
+    Unused C_VerifyFinal;
+    Unused C_VerifyRecoverInit;
+    Unused C_VerifyRecover;
+    Unused C_DigestEncryptUpdate;
+    Unused C_DecryptDigestUpdate;
+    Unused C_SignEncryptUpdate;
+    Unused C_DecryptVerifyUpdate;
+    Unused C_GenerateKey;
+    Unused C_GenerateKeyPair;
+    Unused C_WrapKey;
+    Unused C_UnwrapKey;
+    Unused C_DeriveKey;
+    Unused C_SeedRandom;
+    Unused C_GenerateRandom;
+    Unused C_GetFunctionStatus;
+    Unused C_CancelFunction;
+    Unused C_WaitForSlotEvent;
+};
+
+#ifdef _WIN32
+#pragma pack(pop)
+#endif
+
+constexpr CK_BYTE CK_TRUE = 1;
+constexpr CK_ULONG CK_UNAVAILABLE_INFORMATION = ~0UL;
+constexpr CK_ULONG CK_EFFECTIVELY_INFINITE = 0;
+
+constexpr CK_RV CKR_OK = 0x000;
+constexpr CK_RV CKR_DEVICE_ERROR = 0x030;
+constexpr CK_RV CKR_DEVICE_MEMORY = 0x031;
+constexpr CK_RV CKR_DEVICE_REMOVED = 0x032;
+constexpr CK_RV CKR_KEY_HANDLE_INVALID = 0x060;
+constexpr CK_RV CKR_OBJECT_HANDLE_INVALID = 0x082;
+constexpr CK_RV CKR_PIN_INCORRECT = 0x0A0;
+constexpr CK_RV CKR_PIN_LOCKED = 0x0A4;
+constexpr CK_RV CKR_SESSION_CLOSED = 0x0B0;
+constexpr CK_RV CKR_SESSION_COUNT = 0x0B1;
+constexpr CK_RV CKR_SESSION_HANDLE_INVALID = 0x0B3;
+constexpr CK_RV CKR_TOKEN_NOT_PRESENT = 0x0E0;
+constexpr CK_RV CKR_TOKEN_NOT_RECOGNIZED = 0x0E1;
+constexpr CK_RV CKR_USER_ALREADY_LOGGED_IN = 0x100;
+constexpr CK_RV CKR_USER_NOT_LOGGED_IN = 0x101;
+constexpr CK_RV CKR_BUFFER_TOO_SMALL = 0x150;
+constexpr CK_RV CKR_CRYPTOKI_ALREADY_INITIALIZED = 0x191;
+
+constexpr CK_FLAGS CKF_HW_SLOT = 0x004;                       // CK_SLOT_INFO
+constexpr CK_FLAGS CKF_LOGIN_REQUIRED = 0x004;                // CK_TOKEN_INFO
+constexpr CK_FLAGS CKF_PROTECTED_AUTHENTICATION_PATH = 0x100; // CK_TOKEN_INFO
+constexpr CK_FLAGS CKF_SERIAL_SESSION = 0x004;                // C_OpenSession
+constexpr CK_FLAGS CKF_RW_SESSION = 0x002;                    // C_OpenSession
+constexpr CK_FLAGS CKF_OS_LOCKING_OK = 0x002;                 // CK_C_INITIALIZE_ARGS
+
+constexpr CK_USER_TYPE CKU_USER = 1;
+
+constexpr CK_OBJECT_CLASS CKO_CERTIFICATE = 1;
+constexpr CK_OBJECT_CLASS CKO_PUBLIC_KEY = 2;
+constexpr CK_OBJECT_CLASS CKO_PRIVATE_KEY = 3;
+constexpr CK_ULONG CKC_X_509 = 0;
+constexpr CK_KEY_TYPE CKK_RSA = 0;
+constexpr CK_KEY_TYPE CKK_EC = 3;
+
+constexpr CK_ATTRIBUTE_TYPE CKA_CLASS = 0x000;
+constexpr CK_ATTRIBUTE_TYPE CKA_TOKEN = 0x001;
+constexpr CK_ATTRIBUTE_TYPE CKA_LABEL = 0x003;
+constexpr CK_ATTRIBUTE_TYPE CKA_VALUE = 0x011;
+constexpr CK_ATTRIBUTE_TYPE CKA_CERTIFICATE_TYPE = 0x080;
+constexpr CK_ATTRIBUTE_TYPE CKA_KEY_TYPE = 0x100;
+constexpr CK_ATTRIBUTE_TYPE CKA_SUBJECT = 0x101;
+constexpr CK_ATTRIBUTE_TYPE CKA_ID = 0x102;
+constexpr CK_ATTRIBUTE_TYPE CKA_SIGN = 0x108;
+
+constexpr CK_MECHANISM_TYPE CKM_RSA_PKCS = 0x0001;
+constexpr CK_MECHANISM_TYPE CKM_RSA_PKCS_PSS = 0x000D;
+constexpr CK_MECHANISM_TYPE CKM_SHA_1 = 0x0220;
+constexpr CK_MECHANISM_TYPE CKM_SHA256 = 0x0250;
+constexpr CK_MECHANISM_TYPE CKM_SHA384 = 0x0260;
+constexpr CK_MECHANISM_TYPE CKM_SHA512 = 0x0270;
+constexpr CK_MECHANISM_TYPE CKM_ECDSA = 0x1041;
+
+constexpr CK_ULONG CKG_MGF1_SHA1 = 1;
+constexpr CK_ULONG CKG_MGF1_SHA256 = 2;
+constexpr CK_ULONG CKG_MGF1_SHA384 = 3;
+constexpr CK_ULONG CKG_MGF1_SHA512 = 4;
+
+/**
+ * Error from a Cryptoki call, carrying its CK_RV
+ */
+class Error : public std::runtime_error {
+private:
+    CK_RV code;
+
+public:
+    Error(const char* function, CK_RV rv)
+        : std::runtime_error(message(function, rv)), code(rv) {}
+
+    CK_RV rv() const { return code; }
+
+    static std::string message(const char* function, CK_RV rv) {
+        char hex[24];
+        snprintf(hex, sizeof(hex), "0x%08lX", (unsigned long)rv);
+        return std::string("PKCS#11 ") + function + " failed (" + hex + ")";
+    }
+};
+
+/**
+ * Whether a Cryptoki error means the token, its sessions or its login went
+ * away, so keys must be looked up again on fresh sessions
+ */
+inline bool isDeviceGone(CK_RV rv) {
+    switch (rv) {
+        case CKR_DEVICE_ERROR:
+        case CKR_DEVICE_REMOVED:
+        case CKR_KEY_HANDLE_INVALID:
+        case CKR_OBJECT_HANDLE_INVALID:
+        case CKR_SESSION_CLOSED:
+        case CKR_SESSION_HANDLE_INVALID:
+        case CKR_TOKEN_NOT_PRESENT:
+        case CKR_TOKEN_NOT_RECOGNIZED:
+        case CKR_USER_NOT_LOGGED_IN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/** Blank-padded Cryptoki text field as a string */
+inline std::string fieldText(const CK_BYTE* field, size_t size) {
+    while (size > 0 && (field[size - 1] == ' ' || field[size - 1] == 0)) size--;
+    return std::string((const char*)field, size);
+}
+
+/**
+ * A loaded PKCS#11 module, initialized for multi-threaded use
+ * Finalized and unloaded when the last owner lets go.
+ */
+class Module {
+private:
+#ifdef _WIN32
+    HMODULE library = nullptr;
+#else
+    void* library = nullptr;
+#endif
+    CK_FUNCTION_LIST* functions = nullptr;
+    bool initialized = false;
+    std::string modulePath;
+
+    void* symbol(const char* name) {
+#ifdef _WIN32
+        return (void*)GetProcAddress(library, name);
+#else
+        return dlsym(library, name);
+#endif
+    }
+
+    void unload() {
+        if (initialized) functions->C_Finalize(nullptr);
+        initialized = false;
+        if (!library) return;
+#ifdef _WIN32
+        FreeLibrary(library);
+#else
+        dlclose(library);
+#endif
+        library = nullptr;
+    }
+
+public:
+    /** Load and initialize the module at path; throws on failure */
+    explicit Module(const std::string& path) : modulePath(path) {
+#ifdef _WIN32
+        library = LoadLibraryA(path.c_str());
+#else
+        library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+        if (!library) throw std::runtime_error("library cannot be loaded");
+
+        using GetFunctionList = CK_RV (*)(CK_FUNCTION_LIST**);
+        auto getFunctionList = (GetFunctionList)symbol("C_GetFunctionList");
+        CK_RV rv = getFunctionList ? getFunctionList(&functions) : CKR_DEVICE_ERROR;
+        if (rv != CKR_OK || !functions) {
+            unload();
+            throw std::runtime_error("not a PKCS#11 module");
+        }
+        if (functions->version.major != 2) {
+            unload();
+            throw std::runtime_error("unsupported Cryptoki version " + std::to_string(functions->version.major));
+        }
+
+        // Sessions are used from many worker threads at once
+        CK_C_INITIALIZE_ARGS args = {};
+        args.flags = CKF_OS_LOCKING_OK;
+        rv = functions->C_Initialize(&args);
+        if (rv != CKR_OK && rv != CKR_CRYPTOKI_ALREADY_INITIALIZED) {
+            unload();
+            throw Error("C_Initialize", rv);
+        }
+        initialized = rv == CKR_OK;
+    }
+
+    ~Module() {
+        unload();
+    }
+
+    Module(const Module&) = delete;
+    Module& operator=(const Module&) = delete;
+
+    const CK_FUNCTION_LIST& api() const { return *functions; }
+    const std::string& path() const { return modulePath; }
+
+    /** Library description and manufacturer, for logs */
+    std::string description() const {
+        CK_INFO info = {};
+        if (functions->C_GetInfo(&info) != CKR_OK) return modulePath;
+        return fieldText(info.libraryDescription, sizeof(info.libraryDescription)) + " (" +
+               fieldText(info.manufacturerID, sizeof(info.manufacturerID)) + ")";
+    }
+};
+
+} // namespace Pkcs11
+} // namespace ArhintSigner
@@ -0,0 +1,623 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "logger.h"
+#include "x509.h"
+#include "rsa.h"
+#include "sha1.h"
+#include "sha2.h"
+#include "string_utils.h"
+#include "json_utils.h"
+#include "key_store.h"
+#include "certificate_listing.h"
+#include "pkcs11.h"
+
+namespace ArhintSigner {
+namespace Certificate {
+
+namespace Detail {
+
+/** Handles of the objects matching a template */
+inline std::vector<Pkcs11::CK_OBJECT_HANDLE> findObjects(const Pkcs11::CK_FUNCTION_LIST& api,
+                                                         Pkcs11::CK_SESSION_HANDLE session,
+                                                         Pkcs11::CK_ATTRIBUTE* templ, Pkcs11::CK_ULONG count) {
+    std::vector<Pkcs11::CK_OBJECT_HANDLE> objects;
+    Pkcs11::CK_RV rv = api.C_FindObjectsInit(session, templ, count);
+    if (rv != Pkcs11::CKR_OK) throw Pkcs11::Error("C_FindObjectsInit", rv);
+    Pkcs11::CK_OBJECT_HANDLE batch[64];
+    Pkcs11::CK_ULONG found = 0;
+    while ((rv = api.C_FindObjects(session, batch, 64, &found)) == Pkcs11::CKR_OK && found > 0) {
+        objects.insert(objects.end(), batch, batch + found);
+    }
+    api.C_FindObjectsFinal(session);
+    if (rv != Pkcs11::CKR_OK) throw Pkcs11::Error("C_FindObjects", rv);
+    return objects;
+}
+
+/** Value of a byte-array attribute, empty when the object has none */
+inline std::string attributeBytes(const Pkcs11::CK_FUNCTION_LIST& api, Pkcs11::CK_SESSION_HANDLE session,
+                                  Pkcs11::CK_OBJECT_HANDLE object, Pkcs11::CK_ATTRIBUTE_TYPE type) {
+    Pkcs11::CK_ATTRIBUTE attribute = { type, nullptr, 0 };
+    if (api.C_GetAttributeValue(session, object, &attribute, 1) != Pkcs11::CKR_OK ||
+        attribute.ulValueLen == Pkcs11::CK_UNAVAILABLE_INFORMATION) {
+        return std::string();
+    }
+    std::string value(attribute.ulValueLen, '\0');
+    attribute.pValue = &value[0];
+    if (api.C_GetAttributeValue(session, object, &attribute, 1) != Pkcs11::CKR_OK) return std::string();
+    value.resize(attribute.ulValueLen);
+    return value;
+}
+
+/** Value of a CK_ULONG attribute, or fallback */
+inline Pkcs11::CK_ULONG attributeNumber(const Pkcs11::CK_FUNCTION_LIST& api, Pkcs11::CK_SESSION_HANDLE session,
+                                        Pkcs11::CK_OBJECT_HANDLE object, Pkcs11::CK_ATTRIBUTE_TYPE type,
+                                        Pkcs11::CK_ULONG fallback) {
+    Pkcs11::CK_ULONG value = fallback;
+    Pkcs11::CK_ATTRIBUTE attribute = { type, &value, sizeof(value) };
+    if (api.C_GetAttributeValue(session, object, &attribute, 1) != Pkcs11::CKR_OK) return fallback;
+    return value;
+}
+
+} // namespace Detail
+
+/**
+ * Per-slot counters for /stats
+ */
+struct SlotStats {
+    std::string device;
+    size_t capacity = 0;
+    size_t open = 0;
+    size_t idle = 0;
+    uint64_t sessionsOpened = 0;
+    uint64_t resets = 0;
+    uint64_t handleHits = 0;
+    uint64_t handleMisses = 0;
+};
+
+/**
+ * Token slot of a PKCS#11 module with a pool of logged-in sessions
+ *
+ * Sessions are opened on demand up to capacity (--pkcs11-sessions, capped
+ * by the token's own session limit) and then reused, so a signature costs
+ * C_SignInit + C_Sign and nothing else. Private key handles are cached by
+ * CKA_ID. When the token reports that it, a session or the login went away,
+ * the pool and the handle cache are dropped and rebuilt on next use.
+ */
+class Pkcs11Slot {
+private:
+    std::shared_ptr<Pkcs11::Module> module;
+    Pkcs11::CK_SLOT_ID slot;
+    std::string deviceName;
+    bool hardwareSlot;
+    bool loginRequired;
+    bool protectedPath;
+    std::string pin;
+    size_t capacity;
+    std::atomic<bool> pinRejected{false};  // never retry a wrong PIN: the token would lock
+
+    mutable std::mutex mutex;
+    std::condition_variable available;
+    std::vector<Pkcs11::CK_SESSION_HANDLE> idle;
+    size_t open = 0;            // idle + leased
+    uint64_t generation = 0;    // bumped by reset(); older sessions are closed on return
+    std::unordered_map<std::string, Pkcs11::CK_OBJECT_HANDLE> keyHandles;  // CKA_ID -> private key
+    uint64_t sessionsOpened = 0;
+    uint64_t resets = 0;
+    uint64_t handleHits = 0;
+    uint64_t handleMisses = 0;
+
+    Pkcs11::CK_SESSION_HANDLE openSession() {
+        const Pkcs11::CK_FUNCTION_LIST& api = module->api();
+        Pkcs11::CK_SESSION_HANDLE session = 0;
+        Pkcs11::CK_RV rv = api.C_OpenSession(slot, Pkcs11::CKF_SERIAL_SESSION, nullptr, nullptr, &session);
+        if (rv != Pkcs11::CKR_OK) throw Pkcs11::Error("C_OpenSession", rv);
+
+        // Login is per token, so only the first session really logs in
+        if (loginRequired && (protectedPath || !pin.empty())) {
+            if (pinRejected) {
+                api.C_CloseSession(session);
+                throw Pkcs11::Error("C_Login", Pkcs11::CKR_PIN_INCORRECT);
+            }
+            rv = protectedPath
+                ? api.C_Login(session, Pkcs11::CKU_USER, nullptr, 0)
+                : api.C_Login(session, Pkcs11::CKU_USER, (Pkcs11::CK_BYTE*)&pin[0], (Pkcs11::CK_ULONG)pin.size());
+            if (rv != Pkcs11::CKR_OK && rv != Pkcs11::CKR_USER_ALREADY_LOGGED_IN) {
+                api.C_CloseSession(session);
+                if (rv == Pkcs11::CKR_PIN_INCORRECT || rv == Pkcs11::CKR_PIN_LOCKED) pinRejected = true;
+                throw Pkcs11::Error("C_Login", rv);
+            }
+        }
+        return session;
+    }
+
+    void release(Pkcs11::CK_SESSION_HANDLE session, uint64_t leasedGeneration, bool broken) {
+        if (!broken) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (leasedGeneration == generation) {
+                idle.push_back(session);
+                available.notify_one();
+                return;
+            }
+        }
+        module->api().C_CloseSession(session);
+        std::lock_guard<std::mutex> lock(mutex);
+        open--;
+        available.notify_one();
+    }
+
+public:
+    /**
+     * Session borrowed from the pool, returned when the lease ends
+     */
+    class Lease {
+    private:
+        Pkcs11Slot* owner;
+        Pkcs11::CK_SESSION_HANDLE handle;
+        uint64_t leasedGeneration;
+        bool broken = false;
+
+    public:
+        Lease(Pkcs11Slot* slot, Pkcs11::CK_SESSION_HANDLE session, uint64_t generation)
+            : owner(slot), handle(session), leasedGeneration(generation) {}
+        Lease(Lease&& other) noexcept
+            : owner(other.owner), handle(other.handle), leasedGeneration(other.leasedGeneration),
+              broken(other.broken) {
+            other.owner = nullptr;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease() {
+            if (owner) owner->release(handle, leasedGeneration, broken);
+        }
+
+        Pkcs11::CK_SESSION_HANDLE session() const { return handle; }
+        uint64_t generation() const { return leasedGeneration; }
+
+        /** Close the session instead of returning it to the pool */
+        void discard() { broken = true; }
+    };
+
+    Pkcs11Slot(std::shared_ptr<Pkcs11::Module> library, Pkcs11::CK_SLOT_ID id, std::string device,
+               bool hardware, const Pkcs11::CK_TOKEN_INFO& token, std::string userPin, size_t sessions)
+        : module(std::move(library)), slot(id), deviceName(std::move(device)), hardwareSlot(hardware),
+          loginRequired((token.flags & Pkcs11::CKF_LOGIN_REQUIRED) != 0),
+          protectedPath((token.flags & Pkcs11::CKF_PROTECTED_AUTHENTICATION_PATH) != 0),
+          pin(std::move(userPin)), capacity(sessions > 0 ? sessions : 1) {
+        Pkcs11::CK_ULONG tokenLimit = token.ulMaxSessionCount;
+        if (tokenLimit != Pkcs11::CK_EFFECTIVELY_INFINITE && tokenLimit != Pkcs11::CK_UNAVAILABLE_INFORMATION &&
+            tokenLimit < capacity) {
+            capacity = tokenLimit;
+        }
+    }
+
+    ~Pkcs11Slot() {
+        for (Pkcs11::CK_SESSION_HANDLE session : idle) module->api().C_CloseSession(session);
+    }
+
+    Pkcs11Slot(const Pkcs11Slot&) = delete;
+    Pkcs11Slot& operator=(const Pkcs11Slot&) = delete;
+
+    const Pkcs11::CK_FUNCTION_LIST& api() const { return module->api(); }
+    const std::string& device() const { return deviceName; }
+    bool hardware() const { return hardwareSlot; }
+    size_t sessionCapacity() const { return capacity; }
+    bool canLogin() const { return !loginRequired || protectedPath || !pin.empty(); }
+
+    /**
+     * Borrow a session, opening one if the pool is not full, otherwise
+     * waiting for one to come back. Throws Pkcs11::Error if a new session
+     * cannot be opened or logged in.
+     */
+    Lease lease() {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this]() { return !idle.empty() || open < capacity; });
+        if (!idle.empty()) {
+            Pkcs11::CK_SESSION_HANDLE session = idle.back();
+            idle.pop_back();
+            return Lease(this, session, generation);
+        }
+        open++;
+        uint64_t current = generation;
+        lock.unlock();
+        try {
+            Pkcs11::CK_SESSION_HANDLE session = openSession();
+            lock.lock();
+            sessionsOpened++;
+            return Lease(this, session, current);
+        }
+        catch (...) {
+            if (!lock.owns_lock()) lock.lock();
+            open--;
+            available.notify_one();
+            throw;
+        }
+    }
+
+    /**
+     * Forget every session and key handle after the token went away; sessions
+     * still leased are closed when they come back
+     */
+    void reset() {
+        std::vector<Pkcs11::CK_SESSION_HANDLE> stale;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            generation++;
+            resets++;
+            keyHandles.clear();
+            stale.swap(idle);
+        }
+        for (Pkcs11::CK_SESSION_HANDLE session : stale) module->api().C_CloseSession(session);
+        std::lock_guard<std::mutex> lock(mutex);
+        open -= stale.size();
+        available.notify_all();
+    }
+
+    /**
+     * Handle of the private key with the given CKA_ID, from the cache or
+     * found on the token through the leased session
+     */
+    Pkcs11::CK_OBJECT_HANDLE keyHandle(const Lease& lease, const std::string& id) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = keyHandles.find(id);
+            if (it != keyHandles.end()) {
+                handleHits++;
+                return it->second;
+            }
+            handleMisses++;
+        }
+
+        Pkcs11::CK_OBJECT_CLASS keyClass = Pkcs11::CKO_PRIVATE_KEY;
+        Pkcs11::CK_ATTRIBUTE templ[] = {
+            { Pkcs11::CKA_CLASS, &keyClass, sizeof(keyClass) },
+            { Pkcs11::CKA_ID, (void*)id.data(), (Pkcs11::CK_ULONG)id.size() },
+        };
+        std::vector<Pkcs11::CK_OBJECT_HANDLE> keys = Detail::findObjects(api(), lease.session(), templ, 2);
+        if (keys.empty()) throw Keys::KeyUnavailableError("Private key not found on " + deviceName);
+
+        rememberKey(lease, id, keys.front());
+        return keys.front();
+    }
+
+    /** Cache a private key handle found through the leased session */
+    void rememberKey(const Lease& lease, const std::string& id, Pkcs11::CK_OBJECT_HANDLE handle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Handles found on a session of an older generation may be gone already
+        if (lease.generation() == generation) keyHandles[id] = handle;
+    }
+
+    SlotStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        SlotStats result;
+        result.device = deviceName;
+        result.capacity = capacity;
+        result.open = open;
+        result.idle = idle.size();
+        result.sessionsOpened = sessionsOpened;
+        result.resets = resets;
+        result.handleHits = handleHits;
+        result.handleMisses = handleMisses;
+        return result;
+    }
+};
+
+/**
+ * Certificate found on a PKCS#11 token, with the CKA_ID of its private key
+ */
+struct Pkcs11Certificate : Keys::StoredCertificate {
+    std::string id;  // CKA_ID shared by the certificate and its private key
+    ListingEntry listing;
+    std::shared_ptr<Pkcs11Slot> slot;
+    Pkcs11::CK_KEY_TYPE keyType = Pkcs11::CKK_RSA;
+};
+
+/**
+ * Private key on a token; signs on a pooled session of its slot, so the
+ * slot's sessions are its device's concurrency
+ */
+class Pkcs11Key : public Keys::SigningKey {
+private:
+    static constexpr size_t MAX_HASH_LENGTH = 64;
+
+    std::shared_ptr<Pkcs11Slot> slot;
+    std::string id;
+    Pkcs11::CK_KEY_TYPE keyType;
+
+public:
+    Pkcs11Key(std::shared_ptr<Pkcs11Slot> tokenSlot, std::string keyId, Pkcs11::CK_KEY_TYPE type)
+        : slot(std::move(tokenSlot)), id(std::move(keyId)), keyType(type) {
+        Keys::KeyDevice device;
+        device.name = slot->device();
+        device.hardware = slot->hardware();
+        device.concurrency = slot->sessionCapacity();
+        setDevice(std::move(device));
+    }
+
+    Metrics::SignApi api() const override { return Metrics::SignApi::Pkcs11; }
+
+    /** PSS parameters for a hash: MGF1 with the same hash, salt as long as the hash */
+    static Pkcs11::CK_RSA_PKCS_PSS_PARAMS pssParams(const Crypto::HashInfo& hash) {
+        switch (hash.id) {
+            case Crypto::HashAlgorithm::Sha256: return { Pkcs11::CKM_SHA256, Pkcs11::CKG_MGF1_SHA256, 32 };
+            case Crypto::HashAlgorithm::Sha384: return { Pkcs11::CKM_SHA384, Pkcs11::CKG_MGF1_SHA384, 48 };
+            case Crypto::HashAlgorithm::Sha512: return { Pkcs11::CKM_SHA512, Pkcs11::CKG_MGF1_SHA512, 64 };
+            default: return { Pkcs11::CKM_SHA_1, Pkcs11::CKG_MGF1_SHA1, 20 };
+        }
+    }
+
+    size_t sign(const Crypto::SignatureAlgorithm& algorithm, const uint8_t* hash, size_t hashLength,
+                uint8_t* out, size_t capacity) const override {
+        // CKM_RSA_PKCS pads a DigestInfo we build; CKM_RSA_PKCS_PSS and CKM_ECDSA sign the hash itself
+        uint8_t data[32 + MAX_HASH_LENGTH];
+        size_t dataLength = 0;
+        if (hashLength > MAX_HASH_LENGTH || hashLength != algorithm.hashInfo().length) {
+            throw std::runtime_error("Invalid hash length for " + std::string(algorithm.name));
+        }
+        Pkcs11::CK_RSA_PKCS_PSS_PARAMS pss = pssParams(algorithm.hashInfo());
+        Pkcs11::CK_MECHANISM mechanism = { Pkcs11::CKM_ECDSA, nullptr, 0 };
+        bool rsa = algorithm.key == Crypto::KeyType::Rsa;
+        if (rsa != (keyType == Pkcs11::CKK_RSA)) {
+            throw std::runtime_error(std::string("Key cannot sign ") + algorithm.name);
+        }
+        if (algorithm.scheme == Crypto::Scheme::RsaPkcs1) {
+            std::string_view prefix = algorithm.hashInfo().digestInfo;
+            mechanism.mechanism = Pkcs11::CKM_RSA_PKCS;
+            memcpy(data, prefix.data(), prefix.size());
+            dataLength = prefix.size();
+        } else if (algorithm.scheme == Crypto::Scheme::RsaPss) {
+            mechanism = { Pkcs11::CKM_RSA_PKCS_PSS, &pss, sizeof(pss) };
+        } else {
+            // ECDSA uses the leftmost bits of a longer hash (FIPS 186-5); not every token truncates itself
+            hashLength = std::min(hashLength, algorithm.key == Crypto::KeyType::EcP256 ? (size_t)32 : (size_t)48);
+        }
+        memcpy(data + dataLength, hash, hashLength);
+        dataLength += hashLength;
+
+        const Pkcs11::CK_FUNCTION_LIST& functions = slot->api();
+        try {
+            Pkcs11Slot::Lease lease = slot->lease();
+            Pkcs11::CK_OBJECT_HANDLE key = slot->keyHandle(lease, id);
+            Pkcs11::CK_RV rv = functions.C_SignInit(lease.session(), &mechanism, key);
+            if (rv != Pkcs11::CKR_OK) {
+                if (Pkcs11::isDeviceGone(rv)) lease.discard();
+                throw Pkcs11::Error("C_SignInit", rv);
+            }
+            Pkcs11::CK_ULONG length = (Pkcs11::CK_ULONG)capacity;
+            rv = functions.C_Sign(lease.session(), data, (Pkcs11::CK_ULONG)dataLength, out, &length);
+            if (rv != Pkcs11::CKR_OK) {
+                // A failed C_Sign may leave the operation active; do not reuse the session
+                lease.discard();
+                throw Pkcs11::Error("C_Sign", rv);
+            }
+            return length;
+        }
+        catch (const Pkcs11::Error& e) {
+            if (!Pkcs11::isDeviceGone(e.rv())) throw;
+            slot->reset();
+            throw Keys::KeyUnavailableError(e.what());
+        }
+    }
+};
+
+/**
+ * KeyStore over the tokens of a PKCS#11 module (--pkcs11-module)
+ *
+ * Every slot with a token is searched once at startup: X.509 certificates
+ * are paired with private keys by CKA_ID, and those with an RSA or EC key
+ * are listed. The PIN (--pkcs11-pin or ARHINT_PKCS11_PIN) logs in each
+ * slot; tokens with a PIN pad log in through it. Signing runs on each
+ * slot's session pool, up to --pkcs11-sessions operations at once.
+ */
+class Pkcs11KeyStore : public Keys::KeyStore {
+private:
+    using CertificateEntry = std::shared_ptr<const Pkcs11Certificate>;
+
+    std::string modulePath;
+    std::vector<std::shared_ptr<Pkcs11Slot>> slots;
+    std::vector<CertificateEntry> certificates;
+    std::unordered_map<std::string, CertificateEntry> bySha1;
+    std::unordered_map<std::string, CertificateEntry> bySha256;
+    CertificateListing listed;
+
+    static Der::KeyAlgorithm algorithmOf(Pkcs11::CK_KEY_TYPE keyType) {
+        switch (keyType) {
+            case Pkcs11::CKK_RSA: return Der::KeyAlgorithm::Rsa;
+            case Pkcs11::CKK_EC: return Der::KeyAlgorithm::Ec;
+            default: return Der::KeyAlgorithm::Unknown;
+        }
+    }
+
+    void addSlot(const std::shared_ptr<Pkcs11::Module>& module, Pkcs11::CK_SLOT_ID id,
+                 const std::string& pin, size_t sessions) {
+        const Pkcs11::CK_FUNCTION_LIST& api = module->api();
+        Pkcs11::CK_SLOT_INFO slotInfo = {};
+        Pkcs11::CK_TOKEN_INFO token = {};
+        Pkcs11::CK_RV rv = api.C_GetSlotInfo(id, &slotInfo);
+        if (rv == Pkcs11::CKR_OK) rv = api.C_GetTokenInfo(id, &token);
+        if (rv != Pkcs11::CKR_OK) {
+            Log::warn("Skipping PKCS#11 slot ", id, ": ", Pkcs11::Error::message("C_GetTokenInfo", rv));
+            return;
+        }
+
+        std::string label = Pkcs11::fieldText(token.label, sizeof(token.label));
+        std::string device = label + " (slot " + std::to_string(id) + ")";
+        auto slot = std::make_shared<Pkcs11Slot>(module, id, device, (slotInfo.flags & Pkcs11::CKF_HW_SLOT) != 0,
+                                                 token, pin, sessions);
+        if (!slot->canLogin()) {
+            Log::warn("PKCS#11 token ", device, " needs a PIN; only its public objects are visible");
+        }
+
+        // Certificates and private keys, paired by CKA_ID
+        std::unordered_map<std::string, Pkcs11::CK_KEY_TYPE> keyTypes;
+        std::vector<std::pair<std::string, std::string>> found;  // (CKA_ID, DER)
+        try {
+            Pkcs11Slot::Lease lease = slot->lease();
+            Pkcs11::CK_OBJECT_CLASS keyClass = Pkcs11::CKO_PRIVATE_KEY;
+            Pkcs11::CK_ATTRIBUTE keyTemplate[] = { { Pkcs11::CKA_CLASS, &keyClass, sizeof(keyClass) } };
+            for (Pkcs11::CK_OBJECT_HANDLE key : Detail::findObjects(api, lease.session(), keyTemplate, 1)) {
+                std::string keyId = Detail::attributeBytes(api, lease.session(), key, Pkcs11::CKA_ID);
+                if (keyId.empty()) continue;
+                keyTypes[keyId] = Detail::attributeNumber(api, lease.session(), key, Pkcs11::CKA_KEY_TYPE,
+                                                          Pkcs11::CK_UNAVAILABLE_INFORMATION);
+                slot->rememberKey(lease, keyId, key);
+            }
+
+            Pkcs11::CK_OBJECT_CLASS certClass = Pkcs11::CKO_CERTIFICATE;
+            Pkcs11::CK_ULONG certType = Pkcs11::CKC_X_509;
+            Pkcs11::CK_ATTRIBUTE certTemplate[] = {
+                { Pkcs11::CKA_CLASS, &certClass, sizeof(certClass) },
+                { Pkcs11::CKA_CERTIFICATE_TYPE, &certType, sizeof(certType) },
+            };
+            for (Pkcs11::CK_OBJECT_HANDLE cert : Detail::findObjects(api, lease.session(), certTemplate, 2)) {
+                found.emplace_back(Detail::attributeBytes(api, lease.session(), cert, Pkcs11::CKA_ID),
+                                   Detail::attributeBytes(api, lease.session(), cert, Pkcs11::CKA_VALUE));
+            }
+        }
+        catch (const Pkcs11::Error& e) {
+            Log::error("Cannot read PKCS#11 token ", device, ": ", e.what());
+            return;
+        }
+
+        size_t withKey = 0;
+        for (auto& object : found) {
+            auto keyType = keyTypes.find(object.first);
+            if (keyType == keyTypes.end() || object.second.empty()) continue;
+            if (addCertificate(slot, object.first, std::move(object.second), keyType->second, device)) withKey++;
+        }
+        Log::info("PKCS#11 token ", device, ": ", found.size(), " certificates, ", withKey,
+                  " with private key, ", slot->sessionCapacity(), " sessions");
+        slots.push_back(std::move(slot));
+    }
+
+    bool addCertificate(const std::shared_ptr<Pkcs11Slot>& slot, const std::string& id, std::string der,
+                        Pkcs11::CK_KEY_TYPE keyType, const std::string& device) {
+        Der::Certificate parsed;
+        try {
+            Der::parse(der, parsed);
+        }
+        catch (const Der::ParseError& e) {
+            Log::warn("Skipping certificate on ", device, ": ", e.what());
+            return false;
+        }
+        if (algorithmOf(keyType) == Der::KeyAlgorithm::Unknown || algorithmOf(keyType) != parsed.keyAlgorithm) {
+            Log::warn("Skipping certificate on ", device, ": unsupported private key type");
+            return false;
+        }
+
+        auto entry = std::make_shared<Pkcs11Certificate>();
+        Crypto::Sha1::Digest sha1 = Crypto::Sha1::hash(der.data(), der.size());
+        Crypto::Sha256::Digest sha256 = Crypto::Sha256::hash(der.data(), der.size());
+        entry->sha1 = Utils::bytesToHex(sha1.data(), sha1.size());
+        entry->sha256 = Utils::bytesToHex(sha256.data(), sha256.size());
+        if (bySha1.count(entry->sha1)) return false;  // same certificate on several tokens
+
+        entry->keyAlgorithm = parsed.keyAlgorithm;
+        entry->keyBits = parsed.keyBits;
+        entry->id = id;
+        entry->slot = slot;
+        entry->keyType = keyType;
+        entry->listing.notBefore = parsed.notBefore;
+        entry->listing.notAfter = parsed.notAfter;
+        entry->listing.json = listingJson(parsed, entry->sha1, true, "present");
+        listed.add(entry->listing);
+        certificates.push_back(entry);
+        bySha1[entry->sha1] = entry;
+        bySha256[entry->sha256] = entry;
+        return true;
+    }
+
+public:
+    /**
+     * Load the module and read its tokens. A module that cannot be loaded
+     * is logged and leaves the store empty.
+     */
+    Pkcs11KeyStore(const std::string& path, const std::string& pin, size_t sessionsPerSlot)
+        : modulePath(path) {
+        std::shared_ptr<Pkcs11::Module> module;
+        std::vector<Pkcs11::CK_SLOT_ID> slotIds;
+        try {
+            module = std::make_shared<Pkcs11::Module>(path);
+            Pkcs11::CK_ULONG count = 0;
+            Pkcs11::CK_RV rv = module->api().C_GetSlotList(Pkcs11::CK_TRUE, nullptr, &count);
+            if (rv == Pkcs11::CKR_OK && count > 0) {
+                slotIds.resize(count);
+                rv = module->api().C_GetSlotList(Pkcs11::CK_TRUE, slotIds.data(), &count);
+                slotIds.resize(count);
+            }
+            if (rv != Pkcs11::CKR_OK) throw Pkcs11::Error("C_GetSlotList", rv);
+        }
+        catch (const std::exception& e) {
+            Log::error("Cannot use PKCS#11 module ", path, ": ", e.what());
+            return;
+        }
+
+        Log::info("PKCS#11 module: ", module->description(), ", ", slotIds.size(), " tokens");
+        for (Pkcs11::CK_SLOT_ID id : slotIds) {
+            addSlot(module, id, pin, sessionsPerSlot);
+        }
+    }
+
+    const char* name() const override { return "pkcs11"; }
+
+    Keys::CertificatePtr findByThumbprint(std::string_view hex) override {
+        thread_local std::string key;
+        if (!Utils::normalizeHex(hex, key)) return nullptr;
+        const auto& table = key.length() == 64 ? bySha256 : bySha1;
+        auto it = table.find(key);
+        return it != table.end() ? it->second : nullptr;
+    }
+
+    bool contains(const std::string& sha1) const override {
+        return bySha1.count(sha1) > 0;
+    }
+
+    std::shared_ptr<Keys::SigningKey> loadKey(const Keys::StoredCertificate& cert) override {
+        const auto& token = static_cast<const Pkcs11Certificate&>(cert);
+        return std::make_shared<Pkcs11Key>(token.slot, token.id, token.keyType);
+    }
+
+    std::shared_ptr<const Json::Writer> listing() override {
+        return listed.current();
+    }
+
+    void addStats(Json::Builder& response) override {
+        std::string slotsJson = "[";
+        for (const auto& slot : slots) {
+            SlotStats stats = slot->stats();
+            Json::Builder entry;
+            entry.addString("device", stats.device);
+            entry.addNumber("capacity", (long long)stats.capacity);
+            entry.addNumber("open", (long long)stats.open);
+            entry.addNumber("idle", (long long)stats.idle);
+            entry.addNumber("sessionsOpened", (long long)stats.sessionsOpened);
+            entry.addNumber("resets", (long long)stats.resets);
+            entry.addNumber("handleHits", (long long)stats.handleHits);
+            entry.addNumber("handleMisses", (long long)stats.handleMisses);
+            if (slotsJson.size() > 1) slotsJson += ',';
+            slotsJson += entry.toString();
+        }
+        slotsJson += "]";
+
+        Json::Builder storeJson;
+        storeJson.addString("module", modulePath);
+        storeJson.addNumber("certificates", (long long)certificates.size());
+        storeJson.addArray("slots", slotsJson);
+        response.addObject("pkcs11Store", storeJson.toString());
+    }
+};
+
+} // namespace Certificate
+} // namespace ArhintSigner
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "logger.h"
+#include "ec.h"
+
+namespace ArhintSigner {
+namespace Keys {
+
+/**
+ * Presignature pool settings (--presign-depth, --presign-rate)
+ */
+struct PresignatureLimits {
+    size_t depth = 32;               // presignatures kept per EC key, 0 = disabled
+    unsigned refillPerSecond = 500;  // produced per second across all keys, 0 = unlimited
+};
+
+/**
+ * Counters reported by PresignaturePool
+ */
+struct PresignatureStats {
+    uint64_t hits = 0;      // signatures finished from a presignature
+    uint64_t misses = 0;    // pool empty; signed with a fresh RFC 6979 nonce instead
+    uint64_t produced = 0;
+    size_t pooled = 0;      // presignatures ready now, all keys
+    size_t keys = 0;
+    size_t depth = 0;
+    unsigned refillPerSecond = 0;
+};
+
+namespace Detail {
+
+/** Wakes the producer when a key's pool is drawn from, or stops it */
+struct PresignatureSignal {
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool wanted = false;
+    bool stopping = false;
+
+    void notify() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wanted = true;
+        }
+        wake.notify_one();
+    }
+};
+
+/** Let the producer run only on otherwise idle CPU time */
+inline void lowerThreadPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#else
+    // Linux keeps the nice value per thread, so this leaves the workers alone
+    setpriority(PRIO_PROCESS, 0, 19);
+#endif
+}
+
+} // namespace Detail
+
+/**
+ * Ready presignatures of one EC key, a fixed ring of at most depth entries
+ *
+ * An entry is handed out once and wiped as it leaves the ring, so no nonce
+ * can sign twice. Held by the key's certificates and signing keys, and by
+ * the pool that fills it.
+ */
+class PresignatureQueue {
+private:
+    friend class PresignaturePool;
+
+    std::shared_ptr<const Crypto::Ec::PrivateKey> key;
+    std::shared_ptr<Detail::PresignatureSignal> signal;
+    mutable std::mutex mutex;
+    std::vector<Crypto::Ec::Presignature> ring;
+    size_t head = 0;
+    size_t count = 0;
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+
+    /** Add a presignature; false if the ring is full */
+    bool put(const Crypto::Ec::Presignature& presignature) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count == ring.size()) return false;
+        ring[(head + count) % ring.size()] = presignature;
+        count++;
+        return true;
+    }
+
+public:
+    PresignatureQueue(std::shared_ptr<const Crypto::Ec::PrivateKey> privateKey,
+                      std::shared_ptr<Detail::PresignatureSignal> producer, size_t depth)
+        : key(std::move(privateKey)), signal(std::move(producer)), ring(depth) {}
+
+    PresignatureQueue(const PresignatureQueue&) = delete;
+    PresignatureQueue& operator=(const PresignatureQueue&) = delete;
+
+    ~PresignatureQueue() {
+        if (!ring.empty()) Crypto::Bignum::wipe(ring.data(), ring.size() * sizeof(ring[0]));
+    }
+
+    /** Move the oldest presignature into out; false if none is ready */
+    bool take(Crypto::Ec::Presignature& out) {
+        bool taken = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (count > 0) {
+                Crypto::Ec::Presignature& slot = ring[head];
+                out = slot;
+                Crypto::Bignum::wipe(&slot, sizeof(slot));
+                head = (head + 1) % ring.size();
+                count--;
+                taken = true;
+            }
+        }
+        (taken ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+        signal->notify();
+        return taken;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    size_t capacity() const { return ring.size(); }
+};
+
+/**
+ * Background producer of ECDSA presignatures for software EC keys
+ *
+ * Most of an ECDSA signature (the nonce's scalar multiplication and
+ * inversion) does not depend on the message. One low-priority thread keeps
+ * every registered key's queue topped up, emptiest first and at most
+ * refillPerSecond presignatures a second, so a signature is one modular
+ * multiply-add when the queue has an entry. Pooled nonces are random
+ * (hedged with the key, see Ec::PrivateKey::presign); an empty queue
+ * signs with a deterministic RFC 6979 nonce as before.
+ */
+class PresignaturePool {
+private:
+    PresignatureLimits limits;
+    std::shared_ptr<Detail::PresignatureSignal> signal = std::make_shared<Detail::PresignatureSignal>();
+    std::vector<std::shared_ptr<PresignatureQueue>> queues;  // fixed once started
+    std::atomic<uint64_t> produced{ 0 };
+    std::thread producer;
+
+    /** Queue furthest below its depth, or null when all are full */
+    PresignatureQueue* emptiest() const {
+        PresignatureQueue* target = nullptr;
+        size_t lowest = limits.depth;
+        for (const auto& queue : queues) {
+            size_t size = queue->size();
+            if (size < lowest) {
+                lowest = size;
+                target = queue.get();
+            }
+        }
+        return target;
+    }
+
+    void produce() {
+        Detail::lowerThreadPriority();
+        auto interval = std::chrono::microseconds(limits.refillPerSecond > 0 ? 1000000 / limits.refillPerSecond : 0);
+        auto next = std::chrono::steady_clock::now();
+        Crypto::Ec::Presignature presignature;
+        std::unique_lock<std::mutex> lock(signal->mutex);
+        while (!signal->stopping) {
+            signal->wanted = false;
+            PresignatureQueue* target = emptiest();
+            if (!target) {
+                signal->wake.wait(lock, [this]() { return signal->stopping || signal->wanted; });
+                continue;
+            }
+            lock.unlock();
+            try {
+                target->key->presign(presignature);
+                target->put(presignature);
+                produced.fetch_add(1, std::memory_order_relaxed);
+            }
+            catch (const std::exception& ex) {
+                // No random numbers: keys keep signing with RFC 6979 nonces
+                Log::error("Presignature producer stopped: ", ex.what());
+                lock.lock();
+                break;
+            }
+            Crypto::Bignum::wipe(&presignature, sizeof(presignature));
+            lock.lock();
+
+            auto now = std::chrono::steady_clock::now();
+            next = std::max(next + interval, now);
+            if (next > now) signal->wake.wait_until(lock, next, [this]() { return signal->stopping; });
+        }
+    }
+
+public:
+    explicit PresignaturePool(const PresignatureLimits& poolLimits)
+        : limits(poolLimits) {}
+
+    PresignaturePool(const PresignaturePool&) = delete;
+    PresignaturePool& operator=(const PresignaturePool&) = delete;
+
+    ~PresignaturePool() {
+        {
+            std::lock_guard<std::mutex> lock(signal->mutex);
+            signal->stopping = true;
+        }
+        signal->wake.notify_one();
+        if (producer.joinable()) producer.join();
+    }
+
+    /** Queue for a key, or null when pooling is disabled; call before start() */
+    std::shared_ptr<PresignatureQueue> add(std::shared_ptr<const Crypto::Ec::PrivateKey> key) {
+        if (limits.depth == 0 || producer.joinable()) return nullptr;
+        auto queue = std::make_shared<PresignatureQueue>(std::move(key), signal, limits.depth);
+        queues.push_back(queue);
+        return queue;
+    }
+
+    /** Start filling the queues added so far */
+    void start() {
+        if (queues.empty() || producer.joinable()) return;
+        producer = std::thread([this]() { produce(); });
+    }
+
+    PresignatureStats stats() const {
+        PresignatureStats result;
+        for (const auto& queue : queues) {
+            result.hits += queue->hits.load(std::memory_order_relaxed);
+            result.misses += queue->misses.load(std::memory_order_relaxed);
+            result.pooled += queue->size();
+        }
+        result.produced = produced.load(std::memory_order_relaxed);
+        result.keys = queues.size();
+        result.depth = limits.depth;
+        result.refillPerSecond = limits.refillPerSecond;
+        return result;
+    }
+};
+
+} // namespace Keys
+} // namespace ArhintSigner
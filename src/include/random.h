@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#pragma comment(lib, "bcrypt.lib")
+#else
+#include <cerrno>
+#include <sys/random.h>
+#endif
+
+namespace ArhintSigner {
+namespace Crypto {
+namespace Random {
+
+/**
+ * Fill a buffer from the operating system's CSPRNG (BCryptGenRandom,
+ * getrandom); throws if none is available, never falls back to a weaker source
+ */
+inline void fill(void* buffer, size_t length) {
+#ifdef _WIN32
+    NTSTATUS status = BCryptGenRandom(nullptr, (PUCHAR)buffer, (ULONG)length, BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+    if (status != 0) throw std::runtime_error("System random number generator failed");
+#else
+    uint8_t* bytes = (uint8_t*)buffer;
+    while (length > 0) {
+        ssize_t got = getrandom(bytes, length, 0);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("System random number generator failed");
+        }
+        bytes += got;
+        length -= (size_t)got;
+    }
+#endif
+}
+
+} // namespace Random
+} // namespace Crypto
+} // namespace ArhintSigner
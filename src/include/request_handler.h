@@ -1,44 +1,370 @@
 #pragma once
 
-#include <windows.h>
-#include <http.h>
 #include <string>
-#include <iostream>
-#include "http_utils.h"
+#include <string_view>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <stdexcept>
+#include "logger.h"
+#include "config.h"
+#include "http_exchange.h"
 #include "json_utils.h"
-#include "certificate_manager.h"
+#include "string_utils.h"
+#include "key_cache.h"
+#include "signature_cache.h"
+#include "key_scheduler.h"
+#include "admission.h"
+#include "sign_batch.h"
+#include "merkle.h"
+#include "sha2.h"
+#include "arena.h"
+#include "metrics.h"
+#include "signing.h"
+#include "software_store.h"
+#include "pkcs11_store.h"
+#ifdef _WIN32
+#include "system_store.h"
+#include "buffer_pool.h"
+#endif
 
 namespace ArhintSigner {
 namespace RequestHandler {
 
 /**
- * Handle incoming HTTP requests and route to appropriate handlers
+ * Options in effect for request handling
+ */
+inline Config::Options& settings() {
+    static Config::Options options;
+    return options;
+}
+
+/**
+ * Apply command-line options to the request handling subsystems;
+ * concurrency is how many requests the server backend handles at once
+ */
+inline void configure(const Config::Options& options, unsigned concurrency) {
+    settings() = options;
+    Concurrency::AdmissionLimits admission;
+    admission.maxLimit = concurrency > 0 ? concurrency : 1;
+    admission.maxQueueDelay = std::chrono::milliseconds(options.maxQueueDelayMs);
+    admission.targetQueueDelay = std::chrono::milliseconds(options.targetQueueDelayMs);
+    Concurrency::admissionController().setLimits(admission);
+    Signing::keyCache().setLimits(options.keyCacheSize, std::chrono::seconds(options.keyCacheTtlSeconds));
+    Signing::signatureCache().setLimits(options.signatureCacheSize,
+                                        std::chrono::milliseconds(options.signatureCacheTtlMs));
+    Keys::KeySchedulerLimits queueLimits;
+    queueLimits.hardwareConcurrency = options.tokenConcurrency;
+    queueLimits.softwareConcurrency = options.softwareKeyConcurrency;
+    queueLimits.totalConcurrency = options.signConcurrency;
+    queueLimits.maxQueued = options.keyQueueLimit;
+    Signing::keyScheduler().setLimits(queueLimits);
+    Merkle::coalescer().setWindow(options.merkleMaxItems, std::chrono::milliseconds(options.merkleMaxWaitMs));
+
+    // Sign from a PKCS#11 module or the PEM directory if one is given, otherwise from the system store
+    if (!options.pkcs11Module.empty()) {
+        if (!options.keyDirectory.empty()) Log::warn("--key-dir is ignored when --pkcs11-module is given");
+        Signing::useKeyStore(std::make_unique<Certificate::Pkcs11KeyStore>(
+            options.pkcs11Module, options.pkcs11Pin, options.pkcs11Sessions));
+    } else if (!options.keyDirectory.empty()) {
+        Keys::PresignatureLimits presignatures;
+        presignatures.depth = options.presignDepth;
+        presignatures.refillPerSecond = options.presignRate;
+        Signing::useKeyStore(std::make_unique<Certificate::SoftwareKeyStore>(options.keyDirectory, presignatures));
+    } else {
+#ifdef _WIN32
+        Signing::useKeyStore(std::make_unique<Certificate::SystemKeyStore>(
+            std::chrono::milliseconds(options.keyProbeTimeoutMs)));
+#else
+        Log::warn("No certificate store on this platform; use --key-dir or --pkcs11-module to sign");
+#endif
+    }
+}
+
+/**
+ * Release signing resources after the server stopped serving requests
+ */
+inline void shutdown() {
+    Signing::closeKeyStore();
+}
+
+/**
+ * Serialize key cache counters
+ */
+inline std::string keyCacheStatsJson(const Keys::KeyCacheStats& stats) {
+    Json::Builder json;
+    json.addNumber("hits", (long long)stats.hits);
+    json.addNumber("misses", (long long)stats.misses);
+    json.addNumber("evictions", (long long)stats.evictions);
+    json.addNumber("invalidations", (long long)stats.invalidations);
+    json.addNumber("size", (long long)stats.size);
+    json.addNumber("capacity", (long long)stats.capacity);
+    json.addNumber("ttlSeconds", stats.ttlSeconds);
+    return json.toString();
+}
+
+/**
+ * Serialize signature cache counters
+ */
+inline std::string signatureCacheStatsJson(const Signatures::SignatureCacheStats& stats) {
+    Json::Builder json;
+    json.addNumber("hits", (long long)stats.hits);
+    json.addNumber("misses", (long long)stats.misses);
+    json.addNumber("coalesced", (long long)stats.coalesced);
+    json.addNumber("evictions", (long long)stats.evictions);
+    json.addNumber("bypassed", (long long)stats.bypassed);
+    json.addNumber("size", (long long)stats.size);
+    json.addNumber("capacity", (long long)stats.capacity);
+    json.addNumber("ttlMs", stats.ttlMs);
+    return json.toString();
+}
+
+/**
+ * Serialize admission control state
+ */
+inline std::string admissionStatsJson(const Concurrency::AdmissionStats& stats) {
+    Json::Builder json;
+    json.addBool("enabled", stats.enabled);
+    json.addNumber("limit", (long long)stats.limit);
+    json.addNumber("inFlight", (long long)stats.inFlight);
+    json.addNumber("admitted", (long long)stats.admitted);
+    json.addNumber("rejectedSign", (long long)stats.rejected[(size_t)Concurrency::AdmissionClass::Sign]);
+    json.addNumber("rejectedListing", (long long)stats.rejected[(size_t)Concurrency::AdmissionClass::Listing]);
+    json.addNumber("queueDelayMicros", (long long)stats.queueDelayMicros);
+    json.addNumber("serviceMicros", (long long)stats.serviceMicros);
+    json.addNumber("baselineMicros", (long long)stats.baselineMicros);
+    return json.toString();
+}
+
+/**
+ * Serialize per-device queue state
+ */
+inline std::string keyQueuesJson(const std::vector<Keys::KeyQueueStats>& queues) {
+    std::string json = "[";
+    for (const Keys::KeyQueueStats& queue : queues) {
+        Json::Builder entry;
+        entry.addString("device", queue.device);
+        entry.addBool("hardware", queue.hardware);
+        entry.addNumber("limit", (long long)queue.limit);
+        entry.addNumber("active", (long long)queue.active);
+        entry.addNumber("depth", (long long)queue.depth);
+        entry.addNumber("granted", (long long)queue.granted);
+        entry.addNumber("waited", (long long)queue.waited);
+        entry.addNumber("rejected", (long long)queue.rejected);
+        entry.addNumber("expired", (long long)queue.expired);
+        entry.addNumber("cancelled", (long long)queue.cancelled);
+        entry.addNumber("waitMicros", (long long)queue.waitMicros);
+        entry.addNumber("maxWaitMicros", (long long)queue.maxWaitMicros);
+        if (json.size() > 1) json += ',';
+        json += entry.toString();
+    }
+    return json + "]";
+}
+
+/**
+ * Endpoints, for per-route accounting
+ */
+enum class Route {
+    Options,
+    Home,
+    ListCerts,
+    Stats,
+    Metrics,
+    Sign,
+    SignBatch,
+    SignMerkle,
+    SignDocument,
+    NotFound,
+    Count
+};
+static_assert((size_t)Route::Count <= Metrics::MAX_ROUTES, "Metrics::MAX_ROUTES too small");
+
+inline const char* routeName(Route route) {
+    switch (route) {
+        case Route::Options: return "options";
+        case Route::Home: return "home";
+        case Route::ListCerts: return "listCerts";
+        case Route::Stats: return "stats";
+        case Route::Metrics: return "metrics";
+        case Route::Sign: return "sign";
+        case Route::SignBatch: return "signBatch";
+        case Route::SignMerkle: return "signMerkle";
+        case Route::SignDocument: return "signDocument";
+        default: return "notFound";
+    }
+}
+
+/**
+ * Endpoint a request is routed to
+ */
+inline Route routeOf(std::string_view method, std::string_view path) {
+    if (method == "OPTIONS") return Route::Options;
+    if (path == "/" && method == "GET") return Route::Home;
+    if (path == "/listCerts" || path == "/api/listCerts") return Route::ListCerts;
+    if ((path == "/stats" || path == "/api/stats") && method == "GET") return Route::Stats;
+    if (path == "/metrics" && method == "GET") return Route::Metrics;
+    if (method == "POST") {
+        if (path == "/sign" || path == "/api/sign") return Route::Sign;
+        if (path == "/signBatch" || path == "/api/signBatch") return Route::SignBatch;
+        if (path == "/signMerkle" || path == "/api/signMerkle") return Route::SignMerkle;
+        if (path == "/signDocument" || path == "/api/signDocument") return Route::SignDocument;
+    }
+    return Route::NotFound;
+}
+
+/**
+ * Whether a request can be served on an epoll reactor thread: only routes
+ * that answer from memory without waiting. Signing waits for keys, devices
+ * and batch windows, and listing may enumerate a token, so those run on the
+ * server's request workers.
+ */
+inline bool servedInline(std::string_view method, std::string_view path) {
+    switch (routeOf(method, path)) {
+        case Route::Options:
+        case Route::Home:
+        case Route::Stats:
+        case Route::Metrics:
+        case Route::NotFound: return true;
+        default: return false;
+    }
+}
+
+/**
+ * Admission class of a route: listings are shed before signing, cheap
+ * endpoints are never shed
+ */
+inline Concurrency::AdmissionClass admissionClassOf(Route route) {
+    switch (route) {
+        case Route::ListCerts: return Concurrency::AdmissionClass::Listing;
+        case Route::Sign:
+        case Route::SignBatch:
+        case Route::SignMerkle:
+        case Route::SignDocument: return Concurrency::AdmissionClass::Sign;
+        default: return Concurrency::AdmissionClass::Exempt;
+    }
+}
+
+/**
+ * Whether a route's service time tells the admission controller how loaded
+ * the server is. Not for uploads (bounded by the client's bandwidth), Merkle
+ * submissions (which wait for their batch window) or batches (whose time
+ * grows with the item count): their durations would read as overload and
+ * shrink the limit for /sign.
+ */
+inline bool sampledForAdmission(Route route) {
+    return route != Route::SignDocument && route != Route::SignMerkle && route != Route::SignBatch;
+}
+
+/**
+ * Lane named by an X-Priority header or "priority" field
+ */
+inline bool parseLane(std::string_view value, Keys::Lane& lane) {
+    if (Http::equalsIgnoreCase(value, "interactive")) {
+        lane = Keys::Lane::Interactive;
+        return true;
+    }
+    if (Http::equalsIgnoreCase(value, "bulk")) {
+        lane = Keys::Lane::Bulk;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Milliseconds in an X-Deadline-Ms header
+ */
+inline bool parseDeadlineMs(std::string_view value, unsigned& milliseconds) {
+    value = Utils::trimmed(value);
+    auto result = std::from_chars(value.data(), value.data() + value.size(), milliseconds);
+    return result.ec == std::errc() && result.ptr == value.data() + value.size();
+}
+
+/**
+ * Scheduling terms of a request: batch endpoints default to the bulk lane,
+ * X-Priority overrides the lane and X-Deadline-Ms sets a deadline relative
+ * to when the request arrived. Unparseable headers are ignored.
+ */
+inline Keys::RequestTerms requestTermsOf(Http::Exchange& exchange, Route route,
+                                         Keys::RequestTerms::Clock::time_point arrival) {
+    Keys::RequestTerms terms;
+    terms.arrival = arrival;
+    terms.lane = route == Route::SignBatch || route == Route::SignMerkle ? Keys::Lane::Bulk : Keys::Lane::Interactive;
+    parseLane(exchange.header("X-Priority"), terms.lane);
+    unsigned deadlineMs = 0;
+    if (parseDeadlineMs(exchange.header("X-Deadline-Ms"), deadlineMs)) {
+        terms.deadline = arrival + std::chrono::milliseconds(deadlineMs);
+    }
+    terms.clientGone = [](void* context) { return static_cast<Http::Exchange*>(context)->clientGone(); };
+    terms.context = &exchange;
+    return terms;
+}
+
+/**
+ * Heap allocations made while handling each route
  */
-inline void handleRequest(HANDLE hReqQueue, PHTTP_REQUEST pRequest) {
-    std::string url(pRequest->pRawUrl);
-    std::string method(pRequest->Verb == HttpVerbGET ? "GET" : 
-                      pRequest->Verb == HttpVerbPOST ? "POST" :
-                      pRequest->Verb == HttpVerbOPTIONS ? "OPTIONS" : "UNKNOWN");
+inline Memory::AllocationCounter& allocationCounter(Route route) {
+    static std::array<Memory::AllocationCounter, (size_t)Route::Count> counters;
+    return counters[(size_t)route];
+}
 
-    std::cout << "Request: " << method << " " << url << std::endl;
+/**
+ * Response buffer of the calling worker, cleared for a new document
+ * Its capacity is kept across requests, so small responses built in it do
+ * not allocate.
+ */
+inline Json::Writer& responseWriter() {
+    thread_local Json::Writer writer(1024);
+    writer.clear();
+    return writer;
+}
+
+/**
+ * Send {"error": message}
+ */
+inline void sendError(Http::Exchange& exchange, int statusCode, std::string_view message) {
+    static constexpr Json::StaticKey errorKey("error");
+    Json::Writer& response = responseWriter();
+    response.beginObject().key(errorKey).string(message).endObject();
+    exchange.send(statusCode, "application/json", response.view());
+}
 
+/**
+ * Feed the request body to a JSON handler as it arrives (Json::StreamParser)
+ * Sends the 400 / 413 error response itself and returns false if the body is
+ * missing, too large or not valid JSON.
+ */
+inline bool readJsonBody(Http::Exchange& exchange, size_t maxBytes, Json::Handler& handler) {
+    std::string error;
+    int statusCode = 400;
     try {
-        // Handle OPTIONS for CORS preflight
-        if (pRequest->Verb == HttpVerbOPTIONS) {
-            Http::sendResponse(hReqQueue, pRequest->RequestId, 200, "text/plain", "");
-            return;
+        Json::StreamParser parser(handler);
+        size_t bytesRead = Http::streamRequestBody(exchange, maxBytes, [&parser](const char* data, size_t length) {
+            parser.feed(data, length);
+        });
+        if (bytesRead == 0) {
+            error = "Request body is required";
+        } else if (bytesRead > maxBytes) {
+            error = "Request body too large (max " + std::to_string(maxBytes) + " bytes)";
+            statusCode = 413;
+        } else {
+            parser.finish();
         }
+    }
+    catch (const std::exception& ex) {
+        error = ex.what();
+    }
 
-        // Parse request path
-        std::string path = url;
-        size_t queryPos = path.find('?');
-        if (queryPos != std::string::npos) {
-            path = path.substr(0, queryPos);
-        }
+    if (error.empty()) return true;
+    sendError(exchange, statusCode, error);
+    return false;
+}
 
-        // Handle root path - display service info page
-        if (path == "/" && pRequest->Verb == HttpVerbGET) {
-            std::string homePage = R"(<!DOCTYPE html>
+/**
+ * GET / - service info page
+ */
+inline void handleHome(Http::Exchange& exchange) {
+    static const char homePage[] = R"(<!DOCTYPE html>
 <html lang="en">
 <head>
     <meta charset="UTF-8">
@@ -156,6 +482,42 @@ inline void handleRequest(HANDLE hReqQueue, PHTTP_REQUEST pRequest) {
             </div>
         </div>
         
+        <div class="endpoint">
+            <div class="endpoint-title">
+                <span class="endpoint-method">POST</span>
+                <code>/signBatch</code>
+            </div>
+            <div class="endpoint-description">
+                Sign many hashes in one request. Requires JSON body with an <code>items</code> array of hashes
+                (or objects with <code>hash</code>, <code>thumbprint</code> and <code>algorithm</code>).
+                Streams one NDJSON result line per item.
+            </div>
+        </div>
+        
+        <div class="endpoint">
+            <div class="endpoint-title">
+                <span class="endpoint-method">POST</span>
+                <code>/signMerkle</code>
+            </div>
+            <div class="endpoint-description">
+                Bulk signing with one private key operation per batch. Requires JSON body with <code>hashes</code>
+                (base64 SHA-256 hashes) and <code>thumbprint</code>. Returns the signed Merkle root and an
+                inclusion proof for each hash.
+            </div>
+        </div>
+        
+        <div class="endpoint">
+            <div class="endpoint-title">
+                <span class="endpoint-method">POST</span>
+                <code>/signDocument</code>
+            </div>
+            <div class="endpoint-description">
+                Sign a whole document sent as the request body. Takes <code>thumbprint</code> (and optionally
+                <code>algorithm</code> and <code>digests</code>) in the query string; the document is hashed as it
+                streams in. Returns the signature and the document's digests.
+            </div>
+        </div>
+        
         <h2>📚 API Documentation</h2>
         <p>
             <strong>Base URL:</strong> <code>http://localhost:8082</code>
@@ -182,135 +544,681 @@ inline void handleRequest(HANDLE hReqQueue, PHTTP_REQUEST pRequest) {
     </div>
 </body>
 </html>)";
-            Http::sendResponse(hReqQueue, pRequest->RequestId, 200, "text/html", homePage);
-            return;
+    exchange.send(200, "text/html", std::string_view(homePage, sizeof(homePage) - 1));
+}
+
+/**
+ * GET /listCerts - served from the key store's cached listing
+ */
+inline void handleListCerts(Http::Exchange& exchange) {
+    // Cached certificate fragments are sent in place, not copied into one body
+    std::shared_ptr<const Json::Writer> listing = Signing::keyStore().listing();
+    Log::debug("Response size: ", listing->size(), " bytes");
+    exchange.sendGather(200, "application/json", listing->slices());
+}
+
+/**
+ * Serialize the per-route allocation counters and the calling worker's arena
+ */
+inline std::string memoryStatsJson() {
+    Json::Builder routes;
+    for (size_t i = 0; i < (size_t)Route::Count; i++) {
+        Memory::AllocationStats stats = allocationCounter((Route)i).stats();
+        if (stats.requests == 0) continue;
+        Json::Builder routeJson;
+        routeJson.addNumber("requests", (long long)stats.requests);
+        routeJson.addNumber("heapAllocations", (long long)stats.heapAllocations);
+        routeJson.addNumber("allocationFreeRequests", (long long)stats.allocationFreeRequests);
+        routes.addObject(routeName((Route)i), routeJson.toString());
+    }
+
+    const Memory::Arena& arena = Memory::requestArena();
+    Json::Builder arenaJson;
+    arenaJson.addNumber("capacity", (long long)arena.capacity());
+    arenaJson.addNumber("largestRequest", (long long)arena.largestRequest());
+    arenaJson.addNumber("blocksAllocated", (long long)arena.blocksAllocated());
+
+    Json::Builder memory;
+    memory.addObject("routes", routes.toString());
+    memory.addObject("arena", arenaJson.toString());
+#ifdef _WIN32
+    Memory::BufferPoolStats bufferStats = Memory::receiveBuffers().stats();
+    Json::Builder bufferJson;
+    bufferJson.addNumber("bufferSize", (long long)bufferStats.bufferSize);
+    bufferJson.addNumber("acquired", (long long)bufferStats.acquired);
+    bufferJson.addNumber("reused", (long long)bufferStats.reused);
+    bufferJson.addNumber("allocated", (long long)bufferStats.allocated);
+    bufferJson.addNumber("oversized", (long long)bufferStats.oversized);
+    bufferJson.addNumber("pooled", (long long)bufferStats.pooled);
+    memory.addObject("receiveBuffers", bufferJson.toString());
+#endif
+    return memory.toString();
+}
+
+/**
+ * GET /stats - cache, memory and logging counters
+ */
+inline void handleStats(Http::Exchange& exchange) {
+    Json::Builder response;
+    Keys::KeyStore& store = Signing::keyStore();
+    response.addString("keyStore", store.name());
+    response.addObject("keyCache", keyCacheStatsJson(Signing::keyCache().stats()));
+    response.addObject("signatureCache", signatureCacheStatsJson(Signing::signatureCache().stats()));
+    response.addArray("keyQueues", keyQueuesJson(Signing::keyScheduler().stats()));
+    store.addStats(response);
+
+    Merkle::CoalescerStats merkleStats = Merkle::coalescer().stats();
+    Json::Builder merkleJson;
+    merkleJson.addNumber("submissions", (long long)merkleStats.submissions);
+    merkleJson.addNumber("leaves", (long long)merkleStats.leaves);
+    merkleJson.addNumber("batches", (long long)merkleStats.batches);
+    merkleJson.addNumber("fullBatches", (long long)merkleStats.fullBatches);
+    merkleJson.addNumber("failedBatches", (long long)merkleStats.failedBatches);
+    merkleJson.addNumber("maxItems", (long long)merkleStats.maxItems);
+    merkleJson.addNumber("maxWaitMs", merkleStats.maxWaitMs);
+    response.addObject("merkle", merkleJson.toString());
+    response.addObject("admission", admissionStatsJson(Concurrency::admissionController().stats()));
+    response.addObject("memory", memoryStatsJson());
+
+    Log::LogStats logStats = Log::Logger::instance().stats();
+    Json::Builder logJson;
+    logJson.addNumber("written", (long long)logStats.written);
+    logJson.addNumber("dropped", (long long)logStats.dropped);
+    logJson.addNumber("suppressed", (long long)logStats.suppressed);
+    response.addObject("log", logJson.toString());
+    exchange.send(200, "application/json", response.toString());
+}
+
+/**
+ * GET /metrics - Prometheus text exposition of the per-thread metric shards,
+ * summed here rather than on the request path
+ */
+inline void handleMetrics(Http::Exchange& exchange) {
+    std::unique_ptr<Metrics::Totals> totals = Metrics::Registry::instance().collect();
+    Metrics::Exposition metrics;
+
+    auto routeLabels = [](size_t route) {
+        return std::string("route=\"") + routeName((Route)route) + "\"";
+    };
+
+    metrics.family("arhint_http_requests_total", "counter", "Requests handled, by route and response status");
+    for (size_t route = 0; route < (size_t)Route::Count; route++) {
+        for (size_t status = 0; status < Metrics::STATUS_SLOTS; status++) {
+            uint64_t count = totals->requests[route][status].count;
+            if (count == 0) continue;
+            metrics.sample("arhint_http_requests_total",
+                           routeLabels(route) + ",status=\"" + Metrics::statusLabel(status) + "\"", count);
         }
+    }
 
-        // Handle /listCerts endpoint
-        if (path == "/listCerts" || path == "/api/listCerts") {
-            std::cout << "Listing certificates..." << std::endl;
-            std::string certs = Certificate::listCertificates();
-            std::cout << "Found certificates, sending response..." << std::endl;
-            
-            Json::Builder response;
-            response.addArray("result", certs);
-            std::string responseStr = response.toString();
-            
-            std::cout << "Response size: " << responseStr.length() << " bytes" << std::endl;
-            Http::sendResponse(hReqQueue, pRequest->RequestId, 200, "application/json", responseStr);
-            std::cout << "Response sent successfully" << std::endl;
+    metrics.family("arhint_http_requests_in_flight", "gauge", "Requests being handled, by route");
+    for (size_t route = 0; route < (size_t)Route::Count; route++) {
+        metrics.sample("arhint_http_requests_in_flight", routeLabels(route), totals->inFlight[route]);
+    }
+
+    metrics.family("arhint_http_request_duration_seconds", "histogram", "Request latency, by route and response status");
+    for (size_t route = 0; route < (size_t)Route::Count; route++) {
+        for (size_t status = 0; status < Metrics::STATUS_SLOTS; status++) {
+            const auto& histogram = totals->requests[route][status];
+            if (histogram.count == 0) continue;
+            metrics.histogram("arhint_http_request_duration_seconds",
+                              routeLabels(route) + ",status=\"" + Metrics::statusLabel(status) + "\"", histogram);
+        }
+    }
+
+    metrics.family("arhint_sign_duration_seconds", "histogram", "Private key signing latency, by API (CNG or legacy CryptoAPI)");
+    for (size_t api = 0; api < (size_t)Metrics::SignApi::Count; api++) {
+        metrics.histogram("arhint_sign_duration_seconds",
+                          std::string("api=\"") + Metrics::signApiName((Metrics::SignApi)api) + "\"", totals->signByApi[api]);
+    }
+
+    metrics.family("arhint_certificate_sign_duration_seconds", "histogram", "Private key signing latency, by certificate thumbprint");
+    const Metrics::CertificateSlots& certificates = Metrics::Registry::instance().certificateSlots();
+    for (size_t slot = 0; slot <= Metrics::MAX_CERTIFICATES; slot++) {
+        const auto& histogram = totals->signByCertificate[slot];
+        if (histogram.count == 0) continue;
+        metrics.histogram("arhint_certificate_sign_duration_seconds",
+                          "certificate=\"" + std::string(certificates.name(slot)) + "\"", histogram);
+    }
+
+    metrics.family("arhint_key_acquire_duration_seconds", "histogram", "Private key acquisition latency (key cache misses), by API");
+    for (size_t api = 0; api < (size_t)Metrics::SignApi::Count; api++) {
+        metrics.histogram("arhint_key_acquire_duration_seconds",
+                          std::string("api=\"") + Metrics::signApiName((Metrics::SignApi)api) + "\"", totals->keyAcquire[api]);
+    }
+
+    metrics.family("arhint_store_enumeration_duration_seconds", "histogram", "Certificate store enumeration time per index rebuild");
+    metrics.histogram("arhint_store_enumeration_duration_seconds", "", totals->storeEnumeration);
+
+    metrics.family("arhint_http_queue_delay_seconds", "histogram", "Time requests waited for a worker");
+    metrics.histogram("arhint_http_queue_delay_seconds", "", totals->queueDelay);
+
+    Concurrency::AdmissionStats admission = Concurrency::admissionController().stats();
+    metrics.family("arhint_admission_limit", "gauge", "Adaptive limit on requests in progress");
+    metrics.sample("arhint_admission_limit", "", (uint64_t)admission.limit);
+    metrics.family("arhint_admission_in_flight", "gauge", "Admitted requests in progress");
+    metrics.sample("arhint_admission_in_flight", "", (uint64_t)std::max<int64_t>(0, admission.inFlight));
+    metrics.family("arhint_admission_rejected_total", "counter", "Requests rejected with 503 by admission control, by class");
+    for (size_t i = (size_t)Concurrency::AdmissionClass::Sign; i < (size_t)Concurrency::AdmissionClass::Count; i++) {
+        metrics.sample("arhint_admission_rejected_total",
+                       std::string("class=\"") + Concurrency::admissionClassName((Concurrency::AdmissionClass)i) + "\"",
+                       admission.rejected[i]);
+    }
+
+    metrics.family("arhint_key_queue_wait_duration_seconds", "histogram", "Time key operations waited for their device");
+    metrics.histogram("arhint_key_queue_wait_duration_seconds", "", totals->keyQueueWait);
+    std::vector<Keys::KeyQueueStats> queues = Signing::keyScheduler().stats();
+    auto deviceLabels = [](const Keys::KeyQueueStats& queue) {
+        std::string labels = "device=\"";
+        for (char c : queue.device) {
+            if (c == '"' || c == '\\') labels += '\\';
+            labels += c;
+        }
+        return labels + "\",hardware=\"" + (queue.hardware ? "true" : "false") + "\"";
+    };
+    metrics.family("arhint_key_queue_depth", "gauge", "Key operations waiting for their device");
+    for (const auto& queue : queues) metrics.sample("arhint_key_queue_depth", deviceLabels(queue), queue.depth);
+    metrics.family("arhint_key_operations_active", "gauge", "Key operations running, by device");
+    for (const auto& queue : queues) metrics.sample("arhint_key_operations_active", deviceLabels(queue), queue.active);
+    metrics.family("arhint_key_queue_wait_seconds_total", "counter", "Total time key operations waited, by device");
+    for (const auto& queue : queues) metrics.sampleSeconds("arhint_key_queue_wait_seconds_total", deviceLabels(queue), queue.waitMicros);
+    metrics.family("arhint_key_queue_rejected_total", "counter", "Key operations rejected because the device queue was full");
+    for (const auto& queue : queues) metrics.sample("arhint_key_queue_rejected_total", deviceLabels(queue), queue.rejected);
+    metrics.family("arhint_key_queue_dropped_total", "counter", "Queued key operations dropped, by reason (deadline or disconnected)");
+    for (const auto& queue : queues) {
+        metrics.sample("arhint_key_queue_dropped_total", deviceLabels(queue) + ",reason=\"deadline\"", queue.expired);
+        metrics.sample("arhint_key_queue_dropped_total", deviceLabels(queue) + ",reason=\"disconnected\"", queue.cancelled);
+    }
+
+    exchange.send(200, Metrics::Exposition::CONTENT_TYPE, metrics.text());
+}
+
+/**
+ * POST /sign - sign one hash
+ * Allocation-free in steady state: the body is read into the request arena
+ * and parsed in place, the signature is produced into a stack buffer and the
+ * response is built in the worker's reusable writer.
+ */
+inline void handleSign(Http::Exchange& exchange, Memory::Arena& arena) {
+    // Security: Limit request body size to prevent DoS (max 10KB)
+    static constexpr size_t MAX_BODY = 10240;
+
+    size_t bodyLength = 0;
+    char* body = Http::readRequestBody(exchange, MAX_BODY, arena, bodyLength);
+    Metrics::requestPhases().mark(Metrics::Phase::Read);
+
+    if (bodyLength == 0) {
+        sendError(exchange, 400, "Request body is required");
+        return;
+    }
+    if (bodyLength > MAX_BODY) {
+        sendError(exchange, 413, "Request body too large (max 10KB)");
+        return;
+    }
+
+    Log::debug("Request body: ", std::string_view(body, bodyLength));
+
+    // Parse JSON request in place; a handful of nodes, no allocation
+    Json::FixedDocument<64> request;
+    try {
+        request.parse(body, bodyLength);
+    }
+    catch (const std::exception& ex) {
+        sendError(exchange, 400, ex.what());
+        return;
+    }
+    Json::Value params = request.root();
+
+    Log::debug("Parsed params - hash: '", params.getString("hash"), "', thumbprint: '", params.getString("thumbprint"), "'");
+    
+    if (!params.find("hash").isString() || !params.find("thumbprint").isString()) {
+        sendError(exchange, 400, "Missing required parameters: hash and thumbprint");
+        return;
+    }
+    
+    // Security: Validate hash parameter (base64 encoded, reasonable length)
+    std::string_view hash = params.getString("hash");
+    if (hash.empty() || hash.length() > 1024) {
+        sendError(exchange, 400, "Invalid hash parameter (max 1024 chars)");
+        return;
+    }
+    
+    // Security: Validate thumbprint (40 hex chars for SHA-1, 64 for SHA-256)
+    std::string_view thumbprint = params.getString("thumbprint");
+    if (thumbprint.length() != 40 && thumbprint.length() != 64) {
+        sendError(exchange, 400, "Invalid thumbprint (must be 40 or 64 hex characters)");
+        return;
+    }
+    
+    // Security: Validate thumbprint contains only hex characters
+    for (char c : thumbprint) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
+            sendError(exchange, 400, "Invalid thumbprint (must contain only hex characters)");
             return;
         }
+    }
+    // Optional scheduling fields override the X-Priority / X-Deadline-Ms headers
+    Keys::RequestTerms& terms = Keys::requestTerms();
+    Json::Value priority = params.find("priority");
+    if (priority.exists() && !(priority.isString() && parseLane(priority.asString(), terms.lane))) {
+        sendError(exchange, 400, "Invalid priority (must be \"interactive\" or \"bulk\")");
+        return;
+    }
+    Json::Value deadline = params.find("deadlineMs");
+    if (deadline.exists()) {
+        double milliseconds = deadline.isNumber() ? deadline.asNumber() : -1;
+        if (milliseconds < 0 || milliseconds > 86400000) {
+            sendError(exchange, 400, "Invalid deadlineMs (milliseconds, 0 to 86400000)");
+            return;
+        }
+        auto budget = std::chrono::milliseconds((long long)milliseconds);
+        terms.deadline = terms.arrival + budget;
+    }
+    // Optional algorithm fields; without them the certificate's key decides
+    Signing::SignOptions options;
+    for (auto field : { std::make_pair("algorithm", &options.algorithm), std::make_pair("padding", &options.padding),
+                        std::make_pair("format", &options.format) }) {
+        Json::Value value = params.find(field.first);
+        if (!value.exists()) continue;
+        if (!value.isString() || value.asString().empty() || value.asString().length() > 16) {
+            sendError(exchange, 400, std::string("Invalid ") + field.first + " (must be a short string)");
+            return;
+        }
+        *field.second = value.asString();
+    }
+    Metrics::requestPhases().mark(Metrics::Phase::Parse);
 
-        // Handle /sign endpoint
-        if ((path == "/sign" || path == "/api/sign") && pRequest->Verb == HttpVerbPOST) {
-            std::string requestBody = Http::readRequestBody(hReqQueue, pRequest);
+    // Sign the hash
+    try {
+        Signing::Signature signature;
+        Signing::signHash(hash, thumbprint, options, signature);
 
-            if (requestBody.empty()) {
-                Json::Builder errorResponse;
-                errorResponse.addString("error", "Request body is required");
-                Http::sendResponse(hReqQueue, pRequest->RequestId, 400, "application/json", 
-                                  errorResponse.toString());
-                return;
-            }
-            
-            // Security: Limit request body size to prevent DoS (max 10KB)
-            if (requestBody.length() > 10240) {
-                Json::Builder errorResponse;
-                errorResponse.addString("error", "Request body too large (max 10KB)");
-                Http::sendResponse(hReqQueue, pRequest->RequestId, 413, "application/json", 
-                                  errorResponse.toString());
-                return;
-            }
+        char* encoded = arena.allocateArray<char>(Crypto::Base64::encodedLength(signature.length));
+        size_t encodedLength = Crypto::Base64::encode(signature.bytes, signature.length, encoded);
 
-            std::cout << "Request body: " << requestBody << std::endl;
-
-            // Parse JSON request
-            auto params = Json::parse(requestBody);
-            
-            std::cout << "Parsed params - hash: '" << params["hash"] 
-                     << "', thumbprint: '" << params["thumbprint"] << "'" << std::endl;
-            
-            if (params.find("hash") == params.end() || params.find("thumbprint") == params.end()) {
-                Json::Builder errorResponse;
-                errorResponse.addString("error", "Missing required parameters: hash and thumbprint");
-                Http::sendResponse(hReqQueue, pRequest->RequestId, 400, "application/json", 
-                                  errorResponse.toString());
-                return;
-            }
-            
-            // Security: Validate hash parameter (base64 encoded, reasonable length)
-            const std::string& hash = params["hash"];
-            if (hash.empty() || hash.length() > 1024) {
-                Json::Builder errorResponse;
-                errorResponse.addString("error", "Invalid hash parameter (max 1024 chars)");
-                Http::sendResponse(hReqQueue, pRequest->RequestId, 400, "application/json", 
-                                  errorResponse.toString());
-                return;
-            }
-            
-            // Security: Validate thumbprint (40 hex chars for SHA1)
-            const std::string& thumbprint = params["thumbprint"];
-            if (thumbprint.length() != 40) {
-                Json::Builder errorResponse;
-                errorResponse.addString("error", "Invalid thumbprint (must be 40 hex characters)");
-                Http::sendResponse(hReqQueue, pRequest->RequestId, 400, "application/json", 
-                                  errorResponse.toString());
-                return;
-            }
-            
-            // Security: Validate thumbprint contains only hex characters
-            for (char c : thumbprint) {
-                if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
-                    Json::Builder errorResponse;
-                    errorResponse.addString("error", "Invalid thumbprint (must contain only hex characters)");
-                    Http::sendResponse(hReqQueue, pRequest->RequestId, 400, "application/json", 
-                                      errorResponse.toString());
-                    return;
-                }
-            }
+        static constexpr Json::StaticKey resultKey("result");
+        static constexpr Json::StaticKey algorithmKey("algorithm");
+        Json::Writer& response = responseWriter();
+        response.beginObject()
+            .key(resultKey).string(std::string_view(encoded, encodedLength))
+            .key(algorithmKey).string(signature.algorithm->name)
+            .endObject();
+        exchange.send(200, "application/json", response.view());
+    }
+    catch (const Keys::QueueFullError& ex) {
+        exchange.setRetryAfter(1);
+        sendError(exchange, 503, ex.what());
+    }
+    catch (const Keys::DeadlineExceededError& ex) {
+        sendError(exchange, 504, ex.what());
+    }
+    catch (const Keys::RequestCancelledError& ex) {
+        Log::info("Dropped: ", ex.what());
+        sendError(exchange, 499, ex.what());
+    }
+    catch (const std::exception& ex) {
+        std::string errorMsg = ex.what();
+        // Check if this is a validation error (user input error) or server error
+        bool isValidationError = 
+            errorMsg.find("Invalid") != std::string::npos ||
+            errorMsg.find("required") != std::string::npos ||
+            errorMsg.find("must be") != std::string::npos ||
+            errorMsg.find("Expected") != std::string::npos ||
+            errorMsg.find("not found") != std::string::npos;
+        
+        sendError(exchange, isValidationError ? 400 : 500, errorMsg);
+    }
+}
 
-            // Sign the hash
-            try {
-                std::string signature = Certificate::signHash(params["hash"], params["thumbprint"]);
-                Json::Builder response;
-                response.addString("result", signature);
-                Http::sendResponse(hReqQueue, pRequest->RequestId, 200, "application/json", 
-                                 response.toString());
+/**
+ * POST /signBatch - many hashes, one key acquisition per certificate
+ */
+inline void handleSignBatch(Http::Exchange& exchange) {
+    // Security: separate, larger but still bounded body limit for batches.
+    // The body is parsed as it arrives rather than buffered.
+    Batch::RequestReader reader;
+    if (!readJsonBody(exchange, settings().batchMaxBytes, reader)) return;
+
+    std::vector<Batch::BatchItem> items;
+    try {
+        items = reader.finish();
+    }
+    catch (const std::exception& ex) {
+        sendError(exchange, 400, ex.what());
+        return;
+    }
+
+    Log::debug("Batch of ", items.size(), " items");
+
+    // One NDJSON line per item as soon as it is signed, then a summary line
+    exchange.beginStream(200, "application/x-ndjson");
+    Batch::BatchSummary summary = Batch::signBatch(items, [&exchange](const std::string& line) {
+        return exchange.writeChunk(line);
+    });
+    exchange.writeChunk(Batch::summaryLine(summary));
+    exchange.endStream();
+    Log::info("Batch signed: ", summary.succeeded, " ok, ", summary.failed, " failed, ", summary.keyAcquisitions, " key acquisitions");
+}
+
+/**
+ * /signMerkle response: the signed root and one inclusion proof per submitted hash
+ */
+inline void sendSignedBatch(Http::Exchange& exchange, const std::string& algorithmName,
+                            const Merkle::SignedBatch& batch) {
+    static constexpr Json::StaticKey algorithmKey("algorithm");
+    static constexpr Json::StaticKey treeHashKey("treeHash");
+    static constexpr Json::StaticKey rootKey("root");
+    static constexpr Json::StaticKey signatureKey("signature");
+    static constexpr Json::StaticKey treeSizeKey("treeSize");
+    static constexpr Json::StaticKey itemsKey("items");
+    static constexpr Json::StaticKey leafIndexKey("leafIndex");
+    static constexpr Json::StaticKey proofKey("proof");
+
+    // About 48 bytes per proof hash plus the fixed members
+    size_t proofHashes = 0;
+    for (const auto& proof : batch.proofs) proofHashes += proof.path.size();
+    Json::Writer response(batch.signature.size() + batch.proofs.size() * 32 + proofHashes * 48 + 256);
+
+    response.beginObject();
+    response.key(algorithmKey).string(algorithmName);
+    response.key(treeHashKey).string("SHA256");
+    response.key(rootKey).string(Crypto::Base64::encode(batch.root.data(), batch.root.size()));
+    response.key(signatureKey).string(batch.signature);
+    response.key(treeSizeKey).number((long long)batch.treeSize);
+    response.key(itemsKey).beginArray();
+    for (const auto& proof : batch.proofs) {
+        response.beginObject();
+        response.key(leafIndexKey).number((long long)proof.leafIndex);
+        response.key(proofKey).beginArray();
+        for (const auto& node : proof.path) {
+            response.string(Crypto::Base64::encode(node.data(), node.size()));
+        }
+        response.endArray().endObject();
+    }
+    response.endArray().endObject();
+    exchange.send(200, "application/json", response.take());
+}
+
+/**
+ * POST /signMerkle - hashes coalesced into one signed Merkle root
+ * Where the backend can suspend the exchange, the request's latency is
+ * recorded by timer when the coalescer answers it.
+ */
+inline void handleSignMerkle(Http::Exchange& exchange, const Metrics::RequestTimer& timer) {
+    Merkle::SubmissionReader reader;
+    if (!readJsonBody(exchange, settings().batchMaxBytes, reader)) return;
+    std::vector<std::string> hashes = reader.hashes();
+    const std::string& thumbprint = reader.thumbprint();
+
+    std::string validationError;
+    if (hashes.empty()) {
+        validationError = "Missing required parameters: hashes (or hash) and thumbprint";
+    } else if (hashes.size() > Merkle::MAX_SUBMISSION_HASHES) {
+        validationError = "Too many hashes (max " + std::to_string(Merkle::MAX_SUBMISSION_HASHES) + ")";
+    } else if (thumbprint.length() != 40 && thumbprint.length() != 64) {
+        validationError = "Invalid thumbprint (must be 40 or 64 hex characters)";
+    }
+    if (!validationError.empty()) {
+        sendError(exchange, 400, validationError);
+        return;
+    }
+
+    std::vector<Merkle::Digest> leaves;
+    Keys::CertificatePtr cert;
+    const Crypto::SignatureAlgorithm* algorithm = nullptr;
+    try {
+        leaves.reserve(hashes.size());
+        for (const auto& hash : hashes) {
+            std::vector<uint8_t> hashBytes = Signing::decodeHash(hash);
+            if (hashBytes.size() != Merkle::Digest().size()) {
+                throw std::runtime_error("Invalid hash length: Merkle signing expects SHA-256 hashes (32 bytes)");
             }
-            catch (const std::exception& ex) {
-                std::string errorMsg = ex.what();
-                // Check if this is a validation error (user input error) or server error
-                bool isValidationError = 
-                    errorMsg.find("Invalid") != std::string::npos ||
-                    errorMsg.find("required") != std::string::npos ||
-                    errorMsg.find("must be") != std::string::npos ||
-                    errorMsg.find("Expected") != std::string::npos ||
-                    errorMsg.find("not found") != std::string::npos;
-                
-                int statusCode = isValidationError ? 400 : 500;
-                Json::Builder errorResponse;
-                errorResponse.addString("error", errorMsg);
-                Http::sendResponse(hReqQueue, pRequest->RequestId, static_cast<USHORT>(statusCode), "application/json", 
-                                  errorResponse.toString());
+            Merkle::Digest leaf;
+            std::copy(hashBytes.begin(), hashBytes.end(), leaf.begin());
+            leaves.push_back(leaf);
+        }
+        cert = Signing::findCertificate(thumbprint);
+        if (cert->keyAlgorithm == Der::KeyAlgorithm::Ec && cert->keyBits == 384) {
+            throw std::runtime_error("Invalid certificate for Merkle signing: roots are SHA-256 hashes, "
+                                     "which P-384 keys do not sign (use /sign with SHA-384)");
+        }
+        // The same algorithm the coalescer signs the root with
+        algorithm = &Signing::resolveAlgorithm(*cert, Merkle::Digest().size(), "", "");
+    }
+    catch (const std::exception& ex) {
+        sendError(exchange, 400, ex.what());
+        return;
+    }
+
+    std::string algorithmName = algorithm->name;
+    if (exchange.suspend()) {
+        // The coalescer thread answers once the batch this submission joined is
+        // signed; this worker is free for other requests meanwhile
+        Metrics::RequestTimer requestTimer = timer;
+        try {
+            Merkle::coalescer().submit(cert->sha1, leaves,
+                [&exchange, algorithmName, requestTimer](const Merkle::SignedBatch* batch,
+                                                         const std::string& error) mutable {
+                    if (batch) {
+                        sendSignedBatch(exchange, algorithmName, *batch);
+                    } else {
+                        sendError(exchange, 500, error);
+                    }
+                    requestTimer.finish(exchange.status());
+                    exchange.resume();
+                });
+        }
+        catch (const std::exception& ex) {
+            sendError(exchange, 500, ex.what());
+            requestTimer.finish(exchange.status());
+            exchange.resume();
+        }
+        return;
+    }
+
+    try {
+        // Blocks until the batch this submission joined has its root signed
+        sendSignedBatch(exchange, algorithmName, Merkle::coalescer().submit(cert->sha1, leaves));
+    }
+    catch (const std::exception& ex) {
+        sendError(exchange, 500, ex.what());
+    }
+}
+
+/**
+ * POST /signDocument?thumbprint=...[&algorithm=SHA256][&padding=pss][&format=der][&digests=SHA256,SHA512]
+ * Sign a document sent as the raw request body. The body is hashed chunk by
+ * chunk as it arrives, never buffered, so memory use does not depend on its
+ * size; every hash named in digests is computed in the same pass and
+ * reported next to the signature. Without algorithm the certificate's key
+ * picks the hash (Signing::documentHash()).
+ */
+inline void handleSignDocument(Http::Exchange& exchange, Memory::Arena& arena) {
+    static constexpr size_t CHUNK_SIZE = 65536;
+
+    std::string_view thumbprint = Http::queryParameter(exchange, "thumbprint", arena);
+    Signing::SignOptions options;
+    options.algorithm = Http::queryParameter(exchange, "algorithm", arena);
+    options.padding = Http::queryParameter(exchange, "padding", arena);
+    options.format = Http::queryParameter(exchange, "format", arena);
+    std::string_view digestNames = Http::queryParameter(exchange, "digests", arena);
+    if (thumbprint.empty()) {
+        sendError(exchange, 400, "Missing required query parameter: thumbprint");
+        return;
+    }
+    if (options.algorithm.length() > 16 || options.padding.length() > 16 || options.format.length() > 16 ||
+        digestNames.length() > 64) {
+        sendError(exchange, 400, "Invalid query parameter (too long)");
+        return;
+    }
+
+    // Everything is checked before the upload is read, so a bad request fails fast
+    Keys::CertificatePtr cert;
+    const Crypto::SignatureAlgorithm* algorithm = nullptr;
+    Signing::SignatureFormat format = Signing::SignatureFormat::Raw;
+    Crypto::Sha2Digests digests;
+    try {
+        cert = Signing::findCertificate(thumbprint);
+        const Crypto::HashInfo& hash = Signing::documentHash(*cert, options.algorithm);
+        algorithm = &Signing::resolveAlgorithm(*cert, hash.length, hash.name, options.padding);
+        format = Signing::parseFormat(options.format, *algorithm);
+        digests.select(hash.id);
+        while (!digestNames.empty()) {
+            size_t comma = digestNames.find(',');
+            std::string_view name = Utils::trimmed(digestNames.substr(0, comma));
+            digestNames = comma == std::string_view::npos ? std::string_view() : digestNames.substr(comma + 1);
+            const Crypto::HashInfo* extra = Crypto::hashNamed(name);
+            if (!extra || !digests.select(extra->id)) {
+                throw std::runtime_error("Invalid digest '" + std::string(name) + "'. Expected SHA256, SHA384 or SHA512");
             }
+        }
+    }
+    catch (const std::exception& ex) {
+        sendError(exchange, 400, ex.what());
+        return;
+    }
+    Metrics::requestPhases().mark(Metrics::Phase::Lookup);
+
+    // One reusable chunk from the request arena, however large the document
+    const uint64_t maxBytes = settings().documentMaxBytes;
+    char* chunk = arena.allocateArray<char>(CHUNK_SIZE);
+    for (;;) {
+        size_t bytesRead = exchange.readBody(chunk, CHUNK_SIZE);
+        if (bytesRead == 0) break;
+        if (digests.length() + bytesRead > maxBytes) {
+            sendError(exchange, 413, "Document too large (max " + std::to_string(maxBytes) + " bytes)");
             return;
         }
+        digests.update(chunk, bytesRead);
+    }
+    Metrics::requestPhases().mark(Metrics::Phase::Read);
+    if (digests.length() == 0) {
+        sendError(exchange, 400, "Request body (the document) is required");
+        return;
+    }
 
-        // 404 Not Found
-        Json::Builder errorResponse;
-        errorResponse.addString("error", "Endpoint not found");
-        Http::sendResponse(hReqQueue, pRequest->RequestId, 404, "application/json", 
-                          errorResponse.toString());
+    try {
+        uint8_t digest[Signing::MAX_HASH_LENGTH];
+        size_t digestLength = digests.finish(algorithm->hash, digest);
+        Signing::Signature signature;
+        Signing::signDigest(cert, *algorithm, format, digest, digestLength, signature);
+
+        static constexpr Json::StaticKey resultKey("result");
+        static constexpr Json::StaticKey algorithmKey("algorithm");
+        static constexpr Json::StaticKey lengthKey("length");
+        static constexpr Json::StaticKey digestsKey("digests");
+        char* encoded = arena.allocateArray<char>(Crypto::Base64::encodedLength(Signing::Signature::CAPACITY));
+        Json::Writer& response = responseWriter();
+        response.beginObject()
+            .key(resultKey).string(std::string_view(encoded, Crypto::Base64::encode(signature.bytes, signature.length, encoded)))
+            .key(algorithmKey).string(signature.algorithm->name)
+            .key(lengthKey).number((long long)digests.length())
+            .key(digestsKey).beginObject();
+        response.key(algorithm->hashInfo().name)
+            .string(std::string_view(encoded, Crypto::Base64::encode(digest, digestLength, encoded)));
+        for (const Crypto::HashInfo& hash : Crypto::HASHES) {
+            if (hash.id == algorithm->hash || !digests.selected(hash.id)) continue;
+            digestLength = digests.finish(hash.id, digest);
+            response.key(hash.name).string(std::string_view(encoded, Crypto::Base64::encode(digest, digestLength, encoded)));
+        }
+        response.endObject().endObject();
+        exchange.send(200, "application/json", response.view());
+    }
+    catch (const Keys::QueueFullError& ex) {
+        exchange.setRetryAfter(1);
+        sendError(exchange, 503, ex.what());
+    }
+    catch (const Keys::DeadlineExceededError& ex) {
+        sendError(exchange, 504, ex.what());
+    }
+    catch (const Keys::RequestCancelledError& ex) {
+        Log::info("Dropped: ", ex.what());
+        sendError(exchange, 499, ex.what());
     }
     catch (const std::exception& ex) {
-        std::cerr << "Error: " << ex.what() << std::endl;
-        Json::Builder errorResponse;
-        errorResponse.addString("error", ex.what());
-        Http::sendResponse(hReqQueue, pRequest->RequestId, 500, "application/json", 
-                          errorResponse.toString());
+        sendError(exchange, 500, ex.what());
+    }
+}
+
+/**
+ * Run the handler for a route
+ */
+inline void handleRoute(Http::Exchange& exchange, Route route, Memory::Arena& arena,
+                        const Metrics::RequestTimer& timer) {
+    switch (route) {
+        case Route::Options:
+            // CORS preflight
+            exchange.send(200, "text/plain", "");
+            return;
+        case Route::Home: handleHome(exchange); return;
+        case Route::ListCerts: handleListCerts(exchange); return;
+        case Route::Stats: handleStats(exchange); return;
+        case Route::Metrics: handleMetrics(exchange); return;
+        case Route::Sign: handleSign(exchange, arena); return;
+        case Route::SignBatch: handleSignBatch(exchange); return;
+        case Route::SignMerkle: handleSignMerkle(exchange, timer); return;
+        case Route::SignDocument: handleSignDocument(exchange, arena); return;
+        default: sendError(exchange, 404, "Endpoint not found"); return;
     }
 }
 
+/**
+ * Handle incoming HTTP requests and route to appropriate handlers
+ * Runs unchanged on the HTTP.sys and epoll server backends. Request-lifetime
+ * data goes to the worker's arena, which is reset when the request is done,
+ * and the heap allocations made meanwhile are counted per route (/stats).
+ * Latency is recorded per route and status in the worker's metric shard (/metrics),
+ * and the time spent in each phase goes out in the Server-Timing header.
+ * The request's lane, deadline and connection are published as its
+ * Keys::requestTerms() for the key scheduler. Requests beyond the adaptive
+ * concurrency limit get 503 with Retry-After before any work is done.
+ * A handler that suspends the exchange (/signMerkle) gives back its worker
+ * and its admission ticket; its latency is recorded when it is answered.
+ */
+inline void handleRequest(Http::Exchange& exchange) {
+    Memory::RequestScope scope;
+    uint64_t allocationsBefore = Memory::heapAllocations();
+    Route route = routeOf(exchange.method(), exchange.path());
+    Metrics::RequestTimer timer((size_t)route);
+    Metrics::RequestPhases& phases = Metrics::requestPhases();
+    phases.begin();
+    exchange.setPhases(&phases);
+    Keys::ScopedRequestTerms terms(requestTermsOf(exchange, route, exchange.arrival()));
+    Concurrency::AdmissionController& admission = Concurrency::admissionController();
+    Concurrency::AdmissionController::Ticket ticket =
+        admission.admit(admissionClassOf(route), exchange.arrival(), sampledForAdmission(route));
+    Metrics::recordQueueDelay((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - exchange.arrival()).count());
+
+    Log::info("Request: ", exchange.method(), " ", exchange.url());
+
+    if (!ticket.admitted()) {
+        // Overloaded - fail fast rather than keep the client waiting
+        exchange.setRetryAfter(admission.retryAfterSeconds());
+        sendError(exchange, 503, "Server is busy, try again later");
+    } else {
+        try {
+            handleRoute(exchange, route, scope.arena(), timer);
+        }
+        catch (const std::exception& ex) {
+            Log::error("Error: ", ex.what());
+            sendError(exchange, 500, ex.what());
+        }
+    }
+
+    phases.mark(Metrics::Phase::Respond);
+    // A suspended exchange may be answered on another thread at any time; its latency is recorded there
+    bool suspended = exchange.suspended();
+    if (Log::enabled(Log::Level::Debug) && !suspended) {
+        char timing[256];
+        size_t timingLength = phases.format(timing, sizeof(timing));
+        Log::debug("Timing: ", exchange.method(), " ", exchange.path(), " ", std::string_view(timing, timingLength));
+    }
+    phases.end();
+
+    if (!suspended) timer.finish(exchange.status());
+    allocationCounter(route).record(Memory::heapAllocations() - allocationsBefore);
+}
+
 } // namespace RequestHandler
 } // namespace ArhintSigner
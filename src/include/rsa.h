@@ -0,0 +1,328 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "x509.h"
+#include "bignum.h"
+#include "signature_algorithm.h"
+#include "sha2.h"
+#include "random.h"
+
+namespace ArhintSigner {
+namespace Crypto {
+namespace Rsa {
+
+/** Largest modulus a PrivateKey accepts; signatures then fit Signing::Signature */
+constexpr size_t MAX_MODULUS_BITS = Bignum::MAX_BITS;
+constexpr size_t MIN_MODULUS_BITS = 1024;
+
+namespace Detail {
+
+/**
+ * EMSA-PSS encoding (RFC 8017 section 9.1.1) of a hash into encoded
+ * (emBits bits, big-endian), with MGF1 over the same hash and a random salt
+ * as long as the hash
+ */
+template <class Hash>
+void encodePss(const uint8_t* hash, size_t emBits, uint8_t* encoded) {
+    constexpr size_t hashLength = Hash::DIGEST_SIZE;
+    size_t emLength = (emBits + 7) / 8;
+    if (emLength < 2 * hashLength + 2) throw std::runtime_error("RSA key too small for hash");
+
+    uint8_t salt[hashLength];
+    Random::fill(salt, sizeof(salt));
+    static const uint8_t zeros[8] = {};
+    Hash digest;
+    digest.update(zeros, sizeof(zeros));
+    digest.update(hash, hashLength);
+    digest.update(salt, sizeof(salt));
+    typename Hash::Digest h = digest.finish();
+
+    // DB = PS || 01 || salt, masked with MGF1(H)
+    size_t dbLength = emLength - hashLength - 1;
+    memset(encoded, 0, dbLength - hashLength - 1);
+    encoded[dbLength - hashLength - 1] = 0x01;
+    memcpy(encoded + dbLength - hashLength, salt, hashLength);
+    for (uint32_t counter = 0; (size_t)counter * hashLength < dbLength; counter++) {
+        uint8_t counterBytes[4] = { (uint8_t)(counter >> 24), (uint8_t)(counter >> 16),
+                                    (uint8_t)(counter >> 8), (uint8_t)counter };
+        digest.update(h.data(), h.size());
+        digest.update(counterBytes, sizeof(counterBytes));
+        typename Hash::Digest mask = digest.finish();
+        for (size_t i = 0; i < hashLength && counter * hashLength + i < dbLength; i++) {
+            encoded[counter * hashLength + i] ^= mask[i];
+        }
+    }
+    encoded[0] &= (uint8_t)(0xFF >> (8 * emLength - emBits));
+    memcpy(encoded + dbLength, h.data(), hashLength);
+    encoded[emLength - 1] = 0xBC;
+    Bignum::wipe(salt, sizeof(salt));
+}
+
+} // namespace Detail
+
+/**
+ * RSA private key held in memory, ready for CRT signing
+ *
+ * Loading precomputes everything a signature needs: Montgomery contexts for
+ * p, q and n, and the reduction factors for messages of the modulus' size.
+ * A signature is two half-size exponentiations (m^dp mod p, m^dq mod q)
+ * recombined with qInv, then checked with the public exponent so a
+ * computation fault can never leak a prime. sign() uses no heap and is safe
+ * to call from several threads.
+ */
+class PrivateKey {
+private:
+    using Limb = Bignum::Limb;
+
+    size_t modulusBytes = 0;
+    std::string modulusValue;  // big-endian, no leading zeros
+    uint64_t publicExponent = 0;
+    Bignum::Montgomery n, p, q;
+    Limb dp[Bignum::MAX_LIMBS] = {};
+    Limb dq[Bignum::MAX_LIMBS] = {};
+    Limb qInv[Bignum::MAX_LIMBS] = {};
+    size_t dpBits = 0;
+    size_t dqBits = 0;
+
+    static std::string_view readInteger(Der::Reader& reader) {
+        return reader.read(Der::Tag::INTEGER).contents;
+    }
+
+    static void loadInteger(std::string_view bytes, Limb* limbs, size_t count, const char* name) {
+        if (!bytes.empty() && (uint8_t)bytes[0] & 0x80) {
+            throw std::runtime_error(std::string("Invalid RSA key: negative ") + name);
+        }
+        if (!Bignum::fromBytes(bytes, limbs, count)) {
+            throw std::runtime_error(std::string("Invalid RSA key: ") + name + " too large");
+        }
+    }
+
+    void load(std::string_view pkcs1) {
+        Der::Reader outer(pkcs1);
+        Der::Reader key(outer.read(Der::Tag::SEQUENCE).contents);
+        std::string_view version = readInteger(key);
+        if (version.size() != 1 || version[0] != 0) {
+            throw std::runtime_error("Unsupported RSA key: multi-prime keys are not supported");
+        }
+        std::string_view modulus = readInteger(key);
+        std::string_view exponent = readInteger(key);
+        readInteger(key);  // private exponent; the CRT values below replace it
+        std::string_view prime1 = readInteger(key);
+        std::string_view prime2 = readInteger(key);
+        std::string_view exponent1 = readInteger(key);
+        std::string_view exponent2 = readInteger(key);
+        std::string_view coefficient = readInteger(key);
+
+        if (!modulus.empty() && (uint8_t)modulus[0] & 0x80) throw std::runtime_error("Invalid RSA key: negative modulus");
+        while (!modulus.empty() && modulus[0] == 0) modulus.remove_prefix(1);
+        size_t bits = Der::Detail::integerBits(modulus);
+        if (bits < MIN_MODULUS_BITS || bits > MAX_MODULUS_BITS) {
+            throw std::runtime_error("Unsupported RSA key size: " + std::to_string(bits) + " bits");
+        }
+        modulusValue.assign(modulus.data(), modulus.size());
+        modulusBytes = modulus.size();
+
+        Limb e[Bignum::MAX_LIMBS];
+        loadInteger(exponent, e, Bignum::MAX_LIMBS, "public exponent");
+        if (Bignum::usedLimbs(e, Bignum::MAX_LIMBS) > 1 || e[0] < 3 || (e[0] & 1) == 0) {
+            throw std::runtime_error("Unsupported RSA public exponent");
+        }
+        publicExponent = e[0];
+
+        // Primes get one spare limb for keys whose factors differ in size
+        size_t nLimbs = (bits + 63) / 64;
+        size_t primeLimbs = nLimbs / 2 + 1;
+        Limb value[Bignum::MAX_LIMBS];
+        Bignum::fromBytes(modulus, value, nLimbs);
+        n.init(value, nLimbs);
+        loadInteger(prime1, value, primeLimbs, "prime");
+        if ((value[0] & 1) == 0) throw std::runtime_error("Invalid RSA key: even prime");
+        p.init(value, primeLimbs);
+        loadInteger(prime2, value, primeLimbs, "prime");
+        if ((value[0] & 1) == 0) throw std::runtime_error("Invalid RSA key: even prime");
+        q.init(value, primeLimbs);
+        Bignum::wipe(value, sizeof(value));
+
+        loadInteger(exponent1, dp, p.limbs(), "exponent");
+        loadInteger(exponent2, dq, q.limbs(), "exponent");
+        loadInteger(coefficient, qInv, p.limbs(), "coefficient");
+        if (!Bignum::less(qInv, p.value(), p.limbs())) throw std::runtime_error("Invalid RSA key: coefficient");
+        dpBits = Bignum::bitLength(dp, p.limbs());
+        dqBits = Bignum::bitLength(dq, q.limbs());
+
+        p.prepareReduce(n.limbs());
+        q.prepareReduce(n.limbs());
+    }
+
+    /** out = em^d mod n (n.limbs() limbs), verified against the public key */
+    void privateOperation(const Limb* em, Limb* out) const {
+        size_t length = n.limbs();
+        Limb s1[Bignum::MAX_LIMBS];
+        Limb s2[Bignum::MAX_LIMBS];
+        Limb work[Bignum::MAX_LIMBS];
+
+        p.reduce(em, work);
+        p.power(work, dp, dpBits, s1);
+        q.reduce(em, work);
+        q.power(work, dq, dqBits, s2);
+        q.fromMontgomery(s2, s2);
+
+        // h = (s1 - s2) * qInv mod p; multiplying the Montgomery-form difference leaves h in normal form
+        Limb wide[Bignum::MAX_LIMBS];
+        memset(wide, 0, length * sizeof(Limb));
+        memcpy(wide, s2, q.limbs() * sizeof(Limb));
+        p.reduce(wide, work);
+        p.subtract(s1, work, s1);
+        Limb h[Bignum::MAX_LIMBS];
+        p.multiply(s1, qInv, h);
+
+        // s = s2 + h * q
+        Limb product[2 * Bignum::MAX_LIMBS + 1];
+        size_t productLength = p.limbs() + q.limbs();
+        memset(product, 0, (productLength + 1) * sizeof(Limb));
+        for (size_t i = 0; i < p.limbs(); i++) {
+            Limb carry = 0;
+            for (size_t j = 0; j < q.limbs(); j++) {
+                product[i + j] = Bignum::mulAdd(h[i], q.value()[j], product[i + j], carry, carry);
+            }
+            product[i + q.limbs()] = carry;
+        }
+        Limb carry = 0;
+        for (size_t j = 0; j <= productLength; j++) {
+            product[j] = Bignum::mulAdd(j < q.limbs() ? s2[j] : 0, 1, product[j], carry, carry);
+        }
+        memcpy(out, product, length * sizeof(Limb));
+
+        // Fault check: s^e must give the message back
+        Limb check[Bignum::MAX_LIMBS];
+        n.toMontgomery(out, check);
+        n.powerPublic(check, publicExponent, check);
+        n.fromMontgomery(check, check);
+        bool valid = Bignum::usedLimbs(product + length, productLength + 1 - length) == 1 && product[length] == 0 &&
+                     memcmp(check, em, length * sizeof(Limb)) == 0;
+
+        Bignum::wipe(s1, sizeof(s1));
+        Bignum::wipe(s2, sizeof(s2));
+        Bignum::wipe(work, sizeof(work));
+        Bignum::wipe(wide, sizeof(wide));
+        Bignum::wipe(h, sizeof(h));
+        Bignum::wipe(product, sizeof(product));
+        if (!valid) throw std::runtime_error("RSA signature failed its consistency check");
+    }
+
+public:
+    PrivateKey() = default;
+    PrivateKey(const PrivateKey&) = delete;
+    PrivateKey& operator=(const PrivateKey&) = delete;
+
+    ~PrivateKey() {
+        Bignum::wipe(dp, sizeof(dp));
+        Bignum::wipe(dq, sizeof(dq));
+        Bignum::wipe(qInv, sizeof(qInv));
+    }
+
+    /**
+     * Load an unencrypted RSAPrivateKey (PKCS#1) or an RSA or RSA-PSS
+     * PrivateKeyInfo (PKCS#8); throws on malformed or unsupported keys
+     */
+    static std::unique_ptr<PrivateKey> fromDer(std::string_view der) {
+        auto key = std::make_unique<PrivateKey>();
+        try {
+            Der::Reader outer(der);
+            Der::Reader body(outer.read(Der::Tag::SEQUENCE).contents);
+            body.read(Der::Tag::INTEGER);
+            if (body.peek(Der::Tag::SEQUENCE)) {
+                // PrivateKeyInfo: version, algorithm, OCTET STRING holding the PKCS#1 key
+                Der::Reader algorithm(body.read(Der::Tag::SEQUENCE).contents);
+                std::string_view oid = algorithm.read(Der::Tag::OID).contents;
+                if (oid != Der::Oid::rsaEncryption && oid != Der::Oid::rsaPss) {
+                    throw std::runtime_error("Unsupported private key algorithm (only RSA keys can be loaded)");
+                }
+                key->load(body.read(Der::Tag::OCTET_STRING).contents);
+            } else {
+                key->load(der);
+            }
+        }
+        catch (const Der::ParseError&) {
+            throw std::runtime_error("Invalid RSA private key encoding");
+        }
+
+        // One signature up front proves the CRT values belong to the modulus
+        uint8_t hash[32] = {};
+        uint8_t signature[MAX_MODULUS_BITS / 8];
+        key->signPkcs1(hash, sizeof(hash), signature, sizeof(signature));
+        return key;
+    }
+
+    /** Modulus, big-endian without leading zeros; matches the certificate's public key */
+    std::string_view modulus() const { return modulusValue; }
+
+    size_t bits() const { return Der::Detail::integerBits(modulusValue); }
+
+    /** Signature length in bytes */
+    size_t size() const { return modulusBytes; }
+
+    /**
+     * RSASSA-PKCS1-v1_5 signature of a SHA-1, SHA-256, SHA-384 or SHA-512
+     * hash (the algorithm follows from its length) into out; returns its length
+     */
+    size_t signPkcs1(const uint8_t* hash, size_t hashLength, uint8_t* out, size_t capacity) const {
+        const HashInfo* hashAlgorithm = hashOfLength(hashLength);
+        if (!hashAlgorithm) throw std::runtime_error("Invalid hash length for RSA signing");
+        std::string_view prefix = hashAlgorithm->digestInfo;
+        if (capacity < modulusBytes) throw std::runtime_error("Signature too large");
+        if (modulusBytes < prefix.size() + hashLength + 11) throw std::runtime_error("RSA key too small for hash");
+
+        // EM = 00 01 FF..FF 00 || DigestInfo || hash
+        uint8_t encoded[MAX_MODULUS_BITS / 8];
+        size_t padding = modulusBytes - prefix.size() - hashLength - 3;
+        encoded[0] = 0x00;
+        encoded[1] = 0x01;
+        memset(encoded + 2, 0xFF, padding);
+        encoded[2 + padding] = 0x00;
+        memcpy(encoded + 3 + padding, prefix.data(), prefix.size());
+        memcpy(encoded + 3 + padding + prefix.size(), hash, hashLength);
+
+        Limb message[Bignum::MAX_LIMBS];
+        Limb signature[Bignum::MAX_LIMBS];
+        Bignum::fromBytes(std::string_view((const char*)encoded, modulusBytes), message, n.limbs());
+        privateOperation(message, signature);
+        Bignum::toBytes(signature, n.limbs(), out, modulusBytes);
+        return modulusBytes;
+    }
+
+    /**
+     * RSASSA-PSS signature of a SHA-256, SHA-384 or SHA-512 hash (the
+     * algorithm follows from its length; MGF1 and the salt use the same hash)
+     * into out; returns its length
+     */
+    size_t signPss(const uint8_t* hash, size_t hashLength, uint8_t* out, size_t capacity) const {
+        if (capacity < modulusBytes) throw std::runtime_error("Signature too large");
+        // emBits = modBits - 1: the encoding is one byte shorter when modBits is 1 mod 8
+        size_t emBits = bits() - 1;
+        size_t emLength = (emBits + 7) / 8;
+        uint8_t encoded[MAX_MODULUS_BITS / 8];
+        switch (hashLength) {
+            case Sha256::DIGEST_SIZE: Detail::encodePss<Sha256>(hash, emBits, encoded); break;
+            case Sha384::DIGEST_SIZE: Detail::encodePss<Sha384>(hash, emBits, encoded); break;
+            case Sha512::DIGEST_SIZE: Detail::encodePss<Sha512>(hash, emBits, encoded); break;
+            default: throw std::runtime_error("Invalid hash length for RSA-PSS signing");
+        }
+
+        Limb message[Bignum::MAX_LIMBS];
+        Limb signature[Bignum::MAX_LIMBS];
+        Bignum::fromBytes(std::string_view((const char*)encoded, emLength), message, n.limbs());
+        privateOperation(message, signature);
+        Bignum::toBytes(signature, n.limbs(), out, modulusBytes);
+        return modulusBytes;
+    }
+};
+
+} // namespace Rsa
+} // namespace Crypto
+} // namespace ArhintSigner
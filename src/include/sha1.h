@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace ArhintSigner {
+namespace Crypto {
+
+/**
+ * Portable, incremental SHA-1 (FIPS 180-4)
+ * Only for certificate thumbprints, which clients know certificates by;
+ * never used to sign.
+ */
+class Sha1 {
+public:
+    static constexpr size_t DIGEST_SIZE = 20;
+    static constexpr size_t BLOCK_SIZE = 64;
+    using Digest = std::array<uint8_t, DIGEST_SIZE>;
+
+private:
+    uint32_t state[5];
+    uint8_t block[BLOCK_SIZE];
+    size_t blockLength;
+    uint64_t totalLength;
+
+    static uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    void compress(const uint8_t* data) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = ((uint32_t)data[i * 4] << 24) | ((uint32_t)data[i * 4 + 1] << 16) |
+                   ((uint32_t)data[i * 4 + 2] << 8) | (uint32_t)data[i * 4 + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rotl(b, 30); b = a; a = t;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+    }
+
+public:
+    Sha1() {
+        reset();
+    }
+
+    void reset() {
+        static const uint32_t initial[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+        memcpy(state, initial, sizeof(state));
+        blockLength = 0;
+        totalLength = 0;
+    }
+
+    void update(const void* input, size_t length) {
+        const uint8_t* data = (const uint8_t*)input;
+        totalLength += length;
+
+        if (blockLength > 0) {
+            size_t take = BLOCK_SIZE - blockLength < length ? BLOCK_SIZE - blockLength : length;
+            memcpy(block + blockLength, data, take);
+            blockLength += take;
+            data += take;
+            length -= take;
+            if (blockLength < BLOCK_SIZE) return;
+            compress(block);
+            blockLength = 0;
+        }
+        while (length >= BLOCK_SIZE) {
+            compress(data);
+            data += BLOCK_SIZE;
+            length -= BLOCK_SIZE;
+        }
+        if (length > 0) {
+            memcpy(block, data, length);
+            blockLength = length;
+        }
+    }
+
+    Digest finish() {
+        uint64_t bitLength = totalLength * 8;
+        uint8_t padding[BLOCK_SIZE * 2] = { 0x80 };
+        size_t padLength = (blockLength < 56 ? 56 : 120) - blockLength;
+        for (int i = 0; i < 8; i++) {
+            padding[padLength + i] = (uint8_t)(bitLength >> (56 - i * 8));
+        }
+        update(padding, padLength + 8);
+
+        Digest digest;
+        for (int i = 0; i < 5; i++) {
+            digest[i * 4] = (uint8_t)(state[i] >> 24);
+            digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+            digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+            digest[i * 4 + 3] = (uint8_t)state[i];
+        }
+        reset();
+        return digest;
+    }
+
+    /** One-shot digest */
+    static Digest hash(const void* data, size_t length) {
+        Sha1 sha;
+        sha.update(data, length);
+        return sha.finish();
+    }
+};
+
+} // namespace Crypto
+} // namespace ArhintSigner
@@ -0,0 +1,588 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "cpu_features.h"
+#include "signature_algorithm.h"
+
+#ifdef ARHINT_CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace ArhintSigner {
+namespace Crypto {
+
+/**
+ * Incremental SHA-256 (FIPS 180-4)
+ * Used where no platform hash provider is involved, e.g. Merkle tree nodes
+ * and /signDocument uploads. Blocks go through the SHA-NI instructions when
+ * the CPU has them, otherwise through portable code.
+ */
+class Sha256 {
+public:
+    static constexpr size_t DIGEST_SIZE = 32;
+    static constexpr size_t BLOCK_SIZE = 64;
+    using Digest = std::array<uint8_t, DIGEST_SIZE>;
+    enum class Kernel { Scalar, ShaNi };
+
+    /** Fastest kernel supported by this CPU */
+    static Kernel bestKernel() {
+        static const Kernel best = Cpu::features().sha ? Kernel::ShaNi : Kernel::Scalar;
+        return best;
+    }
+
+    static const char* kernelName(Kernel kernel) {
+        return kernel == Kernel::ShaNi ? "sha-ni" : "scalar";
+    }
+
+private:
+    static constexpr uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    Kernel kernel;
+    uint32_t state[8];
+    uint8_t block[BLOCK_SIZE];
+    size_t blockLength;
+    uint64_t totalLength;
+
+    static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    static void compressScalar(uint32_t* state, const uint8_t* data) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = ((uint32_t)data[i * 4] << 24) | ((uint32_t)data[i * 4 + 1] << 16) |
+                   ((uint32_t)data[i * 4 + 2] << 8) | (uint32_t)data[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + K[i] + w[i];
+            uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+#ifdef ARHINT_CPU_X86
+    /** Four rounds with message words msg (Intel SHA extensions) */
+    ARHINT_TARGET("sha,sse4.1")
+    static void roundsShaNi(__m128i& abef, __m128i& cdgh, __m128i msg, int index) {
+        __m128i words = _mm_add_epi32(msg, _mm_loadu_si128((const __m128i*)(K + index)));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0E));
+    }
+
+    /** Finish the next four message words from the current and previous ones */
+    ARHINT_TARGET("sha,sse4.1")
+    static void scheduleShaNi(__m128i& next, __m128i current, __m128i previous) {
+        next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(current, previous, 4)), current);
+    }
+
+    /** Compress blocks with the state held in registers throughout */
+    ARHINT_TARGET("sha,sse4.1")
+    static void compressShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+
+        // The rounds instruction wants the state as ABEF and CDGH
+        __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0xB1);
+        __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(state + 4)), 0x1B);
+        __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+        for (; blocks > 0; blocks--, data += BLOCK_SIZE) {
+            __m128i abefBefore = abef;
+            __m128i cdghBefore = cdgh;
+
+            __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), byteSwap);
+            roundsShaNi(abef, cdgh, m0, 0);
+            __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), byteSwap);
+            roundsShaNi(abef, cdgh, m1, 4);
+            m0 = _mm_sha256msg1_epu32(m0, m1);
+            __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), byteSwap);
+            roundsShaNi(abef, cdgh, m2, 8);
+            m1 = _mm_sha256msg1_epu32(m1, m2);
+            __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), byteSwap);
+            roundsShaNi(abef, cdgh, m3, 12);
+            scheduleShaNi(m0, m3, m2);
+            m2 = _mm_sha256msg1_epu32(m2, m3);
+
+            // The last pass also schedules words past round 63, which are never used
+            for (int index = 16; index < 64; index += 16) {
+                roundsShaNi(abef, cdgh, m0, index);
+                scheduleShaNi(m1, m0, m3);
+                m3 = _mm_sha256msg1_epu32(m3, m0);
+                roundsShaNi(abef, cdgh, m1, index + 4);
+                scheduleShaNi(m2, m1, m0);
+                m0 = _mm_sha256msg1_epu32(m0, m1);
+                roundsShaNi(abef, cdgh, m2, index + 8);
+                scheduleShaNi(m3, m2, m1);
+                m1 = _mm_sha256msg1_epu32(m1, m2);
+                roundsShaNi(abef, cdgh, m3, index + 12);
+                scheduleShaNi(m0, m3, m2);
+                m2 = _mm_sha256msg1_epu32(m2, m3);
+            }
+
+            abef = _mm_add_epi32(abef, abefBefore);
+            cdgh = _mm_add_epi32(cdgh, cdghBefore);
+        }
+
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128((__m128i*)state, _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128((__m128i*)(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+#endif
+
+    void compress(const uint8_t* data, size_t blocks) {
+#ifdef ARHINT_CPU_X86
+        if (kernel == Kernel::ShaNi) {
+            compressShaNi(state, data, blocks);
+            return;
+        }
+#endif
+        for (; blocks > 0; blocks--, data += BLOCK_SIZE) compressScalar(state, data);
+    }
+
+public:
+    explicit Sha256(Kernel useKernel = bestKernel())
+        : kernel(useKernel) {
+        reset();
+    }
+
+    void reset() {
+        static const uint32_t initial[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        memcpy(state, initial, sizeof(state));
+        blockLength = 0;
+        totalLength = 0;
+    }
+
+    void update(const void* input, size_t length) {
+        const uint8_t* data = (const uint8_t*)input;
+        totalLength += length;
+
+        if (blockLength > 0) {
+            size_t take = BLOCK_SIZE - blockLength < length ? BLOCK_SIZE - blockLength : length;
+            memcpy(block + blockLength, data, take);
+            blockLength += take;
+            data += take;
+            length -= take;
+            if (blockLength < BLOCK_SIZE) return;
+            compress(block, 1);
+            blockLength = 0;
+        }
+        size_t blocks = length / BLOCK_SIZE;
+        if (blocks > 0) {
+            compress(data, blocks);
+            data += blocks * BLOCK_SIZE;
+            length -= blocks * BLOCK_SIZE;
+        }
+        if (length > 0) {
+            memcpy(block, data, length);
+            blockLength = length;
+        }
+    }
+
+    Digest finish() {
+        uint64_t bitLength = totalLength * 8;
+        uint8_t padding[BLOCK_SIZE * 2] = { 0x80 };
+        size_t padLength = (blockLength < 56 ? 56 : 120) - blockLength;
+        for (int i = 0; i < 8; i++) {
+            padding[padLength + i] = (uint8_t)(bitLength >> (56 - i * 8));
+        }
+        update(padding, padLength + 8);
+
+        Digest digest;
+        for (int i = 0; i < 8; i++) {
+            digest[i * 4] = (uint8_t)(state[i] >> 24);
+            digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+            digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+            digest[i * 4 + 3] = (uint8_t)state[i];
+        }
+        reset();
+        return digest;
+    }
+
+    /** One-shot digest */
+    static Digest hash(const void* data, size_t length) {
+        Sha256 sha;
+        sha.update(data, length);
+        return sha.finish();
+    }
+};
+
+namespace Detail {
+
+/** SHA-512 round constants, shared by SHA-384 and SHA-512 */
+alignas(32) constexpr uint64_t SHA512_K[80] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+    0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+    0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+    0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+    0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+    0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+    0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+    0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+    0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+    0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+    0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+    0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+    0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+    0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+    0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+};
+
+#ifdef ARHINT_CPU_X86
+/** Shift right by n, or rotate right by n when left == 64 - n, in each 64-bit lane */
+ARHINT_TARGET("avx2")
+inline __m256i shiftOr(__m256i x, int n, int left) {
+    return left == 0 ? _mm256_srli_epi64(x, n) : _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, left));
+}
+
+ARHINT_TARGET("avx2")
+inline __m256i sha512Sigma0(__m256i x) {
+    return _mm256_xor_si256(_mm256_xor_si256(shiftOr(x, 1, 63), shiftOr(x, 8, 56)), shiftOr(x, 7, 0));
+}
+
+ARHINT_TARGET("avx2")
+inline __m256i sha512Sigma1(__m256i x) {
+    return _mm256_xor_si256(_mm256_xor_si256(shiftOr(x, 19, 45), shiftOr(x, 61, 3)), shiftOr(x, 6, 0));
+}
+
+/** Lanes 1-3 of low followed by lane 0 of high: words n+1 .. n+4 from words n .. n+7 */
+ARHINT_TARGET("avx2")
+inline __m256i nextWords(__m256i low, __m256i high) {
+    return _mm256_alignr_epi8(_mm256_permute2x128_si256(low, high, 0x21), low, 8);
+}
+
+/**
+ * SHA-512 message schedule of one block, four words at a time in registers,
+ * written as w[i] + K[i] for the rounds. Word i needs word i - 2, so each
+ * group of four takes two steps: the first two words from the previous
+ * group, the last two from the first.
+ */
+ARHINT_TARGET("avx2")
+inline void sha512ScheduleAvx2(const uint8_t* data, uint64_t* wk) {
+    const __m256i byteSwap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                              7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    // Words i-16 .. i-1 as four groups, oldest first
+    __m256i w0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)data), byteSwap);
+    __m256i w1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(data + 32)), byteSwap);
+    __m256i w2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(data + 64)), byteSwap);
+    __m256i w3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(data + 96)), byteSwap);
+    _mm256_storeu_si256((__m256i*)wk, _mm256_add_epi64(w0, _mm256_load_si256((const __m256i*)SHA512_K)));
+    _mm256_storeu_si256((__m256i*)(wk + 4), _mm256_add_epi64(w1, _mm256_load_si256((const __m256i*)(SHA512_K + 4))));
+    _mm256_storeu_si256((__m256i*)(wk + 8), _mm256_add_epi64(w2, _mm256_load_si256((const __m256i*)(SHA512_K + 8))));
+    _mm256_storeu_si256((__m256i*)(wk + 12), _mm256_add_epi64(w3, _mm256_load_si256((const __m256i*)(SHA512_K + 12))));
+
+    for (int i = 16; i < 80; i += 4) {
+        __m256i sum = _mm256_add_epi64(w0, nextWords(w2, w3));
+        sum = _mm256_add_epi64(sum, sha512Sigma0(nextWords(w0, w1)));
+        sum = _mm256_add_epi64(sum, sha512Sigma1(_mm256_permute2x128_si256(w3, w3, 0x81)));
+        __m256i words = _mm256_add_epi64(sum, sha512Sigma1(_mm256_permute2x128_si256(sum, sum, 0x08)));
+        _mm256_storeu_si256((__m256i*)(wk + i), _mm256_add_epi64(words, _mm256_load_si256((const __m256i*)(SHA512_K + i))));
+        w0 = w1;
+        w1 = w2;
+        w2 = w3;
+        w3 = words;
+    }
+}
+#endif
+
+} // namespace Detail
+
+/**
+ * Incremental SHA-512 and SHA-384 (FIPS 180-4); SHA-384 is SHA-512 with
+ * its own initial state, truncated to 48 bytes.
+ * Used by RSA-PSS mask generation, ECDSA nonces for the larger hashes and
+ * /signDocument uploads. With AVX2 the message schedule is computed four
+ * words at a time; the rounds are scalar either way (SHA-NI has no SHA-512).
+ */
+template <size_t DigestBytes>
+class Sha512Family {
+    static_assert(DigestBytes == 48 || DigestBytes == 64, "SHA-384 or SHA-512");
+
+public:
+    static constexpr size_t DIGEST_SIZE = DigestBytes;
+    static constexpr size_t BLOCK_SIZE = 128;
+    using Digest = std::array<uint8_t, DIGEST_SIZE>;
+    enum class Kernel { Scalar, Avx2 };
+
+    /** Fastest kernel supported by this CPU */
+    static Kernel bestKernel() {
+        static const Kernel best = Cpu::features().avx2 ? Kernel::Avx2 : Kernel::Scalar;
+        return best;
+    }
+
+    static const char* kernelName(Kernel kernel) {
+        return kernel == Kernel::Avx2 ? "avx2" : "scalar";
+    }
+
+private:
+    Kernel kernel;
+    uint64_t state[8];
+    uint8_t block[BLOCK_SIZE];
+    size_t blockLength;
+    uint64_t totalLength;
+
+    static uint64_t rotr(uint64_t x, int n) { return (x >> n) | (x << (64 - n)); }
+
+    static void scheduleScalar(const uint8_t* data, uint64_t* wk) {
+        uint64_t w[80];
+        for (int i = 0; i < 16; i++) {
+            uint64_t word = 0;
+            for (int j = 0; j < 8; j++) word = (word << 8) | data[i * 8 + j];
+            w[i] = word;
+        }
+        for (int i = 16; i < 80; i++) {
+            uint64_t s0 = rotr(w[i - 15], 1) ^ rotr(w[i - 15], 8) ^ (w[i - 15] >> 7);
+            uint64_t s1 = rotr(w[i - 2], 19) ^ rotr(w[i - 2], 61) ^ (w[i - 2] >> 6);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        for (int i = 0; i < 80; i++) wk[i] = w[i] + Detail::SHA512_K[i];
+    }
+
+    /** One round; the caller renames the variables for the next */
+    static void round(uint64_t a, uint64_t b, uint64_t c, uint64_t& d,
+                      uint64_t e, uint64_t f, uint64_t g, uint64_t& h, uint64_t wk) {
+        uint64_t t1 = h + (rotr(e, 14) ^ rotr(e, 18) ^ rotr(e, 41)) + ((e & f) ^ (~e & g)) + wk;
+        uint64_t t2 = (rotr(a, 28) ^ rotr(a, 34) ^ rotr(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+        d += t1;
+        h = t1 + t2;
+    }
+
+    void compress(const uint8_t* data) {
+        uint64_t wk[80];
+#ifdef ARHINT_CPU_X86
+        if (kernel == Kernel::Avx2) Detail::sha512ScheduleAvx2(data, wk);
+        else scheduleScalar(data, wk);
+#else
+        scheduleScalar(data, wk);
+#endif
+
+        // Eight rounds per pass with the variables' roles rotated instead of moved
+        uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 80; i += 8) {
+            round(a, b, c, d, e, f, g, h, wk[i]);
+            round(h, a, b, c, d, e, f, g, wk[i + 1]);
+            round(g, h, a, b, c, d, e, f, wk[i + 2]);
+            round(f, g, h, a, b, c, d, e, wk[i + 3]);
+            round(e, f, g, h, a, b, c, d, wk[i + 4]);
+            round(d, e, f, g, h, a, b, c, wk[i + 5]);
+            round(c, d, e, f, g, h, a, b, wk[i + 6]);
+            round(b, c, d, e, f, g, h, a, wk[i + 7]);
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+public:
+    explicit Sha512Family(Kernel useKernel = bestKernel())
+        : kernel(useKernel) {
+        reset();
+    }
+
+    void reset() {
+        static const uint64_t initial512[8] = {
+            0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+            0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179
+        };
+        static const uint64_t initial384[8] = {
+            0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17, 0x152fecd8f70e5939,
+            0x67332667ffc00b31, 0x8eb44a8768581511, 0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4
+        };
+        memcpy(state, DigestBytes == 64 ? initial512 : initial384, sizeof(state));
+        blockLength = 0;
+        totalLength = 0;
+    }
+
+    void update(const void* input, size_t length) {
+        const uint8_t* data = (const uint8_t*)input;
+        totalLength += length;
+
+        if (blockLength > 0) {
+            size_t take = BLOCK_SIZE - blockLength < length ? BLOCK_SIZE - blockLength : length;
+            memcpy(block + blockLength, data, take);
+            blockLength += take;
+            data += take;
+            length -= take;
+            if (blockLength < BLOCK_SIZE) return;
+            compress(block);
+            blockLength = 0;
+        }
+        while (length >= BLOCK_SIZE) {
+            compress(data);
+            data += BLOCK_SIZE;
+            length -= BLOCK_SIZE;
+        }
+        if (length > 0) {
+            memcpy(block, data, length);
+            blockLength = length;
+        }
+    }
+
+    Digest finish() {
+        // The 128-bit length field's high half stays zero: inputs are far below 2^61 bytes
+        uint64_t bitLength = totalLength * 8;
+        uint8_t padding[BLOCK_SIZE * 2] = { 0x80 };
+        size_t padLength = (blockLength < 112 ? 112 : 240) - blockLength;
+        for (int i = 0; i < 8; i++) {
+            padding[padLength + 8 + i] = (uint8_t)(bitLength >> (56 - i * 8));
+        }
+        update(padding, padLength + 16);
+
+        Digest digest;
+        for (size_t i = 0; i < DIGEST_SIZE; i++) {
+            digest[i] = (uint8_t)(state[i / 8] >> (56 - (i % 8) * 8));
+        }
+        reset();
+        return digest;
+    }
+
+    /** One-shot digest */
+    static Digest hash(const void* data, size_t length) {
+        Sha512Family sha;
+        sha.update(data, length);
+        return sha.finish();
+    }
+};
+
+using Sha384 = Sha512Family<48>;
+using Sha512 = Sha512Family<64>;
+
+/**
+ * HMAC (RFC 2104) over one of the hashes above
+ */
+template <class Hash>
+class Hmac {
+private:
+    Hash inner;
+    Hash outer;
+
+public:
+    using Digest = typename Hash::Digest;
+
+    Hmac(const void* key, size_t keyLength) {
+        uint8_t pad[Hash::BLOCK_SIZE] = {};
+        if (keyLength > Hash::BLOCK_SIZE) {
+            Digest hashed = Hash::hash(key, keyLength);
+            memcpy(pad, hashed.data(), hashed.size());
+        } else {
+            memcpy(pad, key, keyLength);
+        }
+        for (uint8_t& byte : pad) byte ^= 0x36;
+        inner.update(pad, sizeof(pad));
+        for (uint8_t& byte : pad) byte ^= 0x36 ^ 0x5c;
+        outer.update(pad, sizeof(pad));
+        for (uint8_t& byte : pad) byte = 0;
+    }
+
+    void update(const void* data, size_t length) { inner.update(data, length); }
+
+    Digest finish() {
+        Digest innerDigest = inner.finish();
+        outer.update(innerDigest.data(), innerDigest.size());
+        return outer.finish();
+    }
+};
+
+/**
+ * SHA-256, SHA-384 and SHA-512 digests of one input, in a single pass
+ *
+ * Input is handed to every selected hash a slice at a time, small enough to
+ * stay in the L1 cache from one hash to the next, so it is read from memory
+ * once however many digests are wanted. State is fixed-size, whatever the
+ * input length.
+ */
+class Sha2Digests {
+private:
+    static constexpr size_t SLICE = 16384;
+
+    bool wanted[4] = {};  // by HashAlgorithm
+    Sha256 sha256;
+    Sha384 sha384;
+    Sha512 sha512;
+    uint64_t totalLength = 0;
+
+public:
+    /** Compute this hash too; false for SHA-1, which is not offered */
+    bool select(HashAlgorithm hash) {
+        if (hash == HashAlgorithm::Sha1) return false;
+        wanted[(size_t)hash] = true;
+        return true;
+    }
+
+    bool selected(HashAlgorithm hash) const { return wanted[(size_t)hash]; }
+
+    void update(const void* input, size_t length) {
+        const uint8_t* data = (const uint8_t*)input;
+        totalLength += length;
+        while (length > 0) {
+            size_t slice = length < SLICE ? length : SLICE;
+            if (wanted[(size_t)HashAlgorithm::Sha256]) sha256.update(data, slice);
+            if (wanted[(size_t)HashAlgorithm::Sha384]) sha384.update(data, slice);
+            if (wanted[(size_t)HashAlgorithm::Sha512]) sha512.update(data, slice);
+            data += slice;
+            length -= slice;
+        }
+    }
+
+    /** Bytes hashed so far */
+    uint64_t length() const { return totalLength; }
+
+    /**
+     * Write the digest of a selected hash to out (hashInfo(hash).length
+     * bytes) and return its length; that hash starts over afterwards
+     */
+    size_t finish(HashAlgorithm hash, uint8_t* out) {
+        switch (hash) {
+            case HashAlgorithm::Sha256: {
+                Sha256::Digest digest = sha256.finish();
+                memcpy(out, digest.data(), digest.size());
+                return digest.size();
+            }
+            case HashAlgorithm::Sha384: {
+                Sha384::Digest digest = sha384.finish();
+                memcpy(out, digest.data(), digest.size());
+                return digest.size();
+            }
+            case HashAlgorithm::Sha512: {
+                Sha512::Digest digest = sha512.finish();
+                memcpy(out, digest.data(), digest.size());
+                return digest.size();
+            }
+            default:
+                return 0;
+        }
+    }
+};
+
+} // namespace Crypto
+} // namespace ArhintSigner
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include "json_utils.h"
+#include "signing.h"
+
+namespace ArhintSigner {
+namespace Batch {
+
+/** Most items accepted in one /signBatch request */
+constexpr size_t MAX_BATCH_ITEMS = 1000;
+
+/**
+ * One hash to sign, with its position in the request
+ */
+struct BatchItem {
+    size_t index = 0;
+    std::string hash;
+    std::string thumbprint;
+    std::string algorithm;
+    std::string error;  // set when the item was rejected while parsing
+};
+
+/**
+ * Totals reported in the last line of a /signBatch response
+ */
+struct BatchSummary {
+    size_t items = 0;
+    size_t succeeded = 0;
+    size_t failed = 0;
+    size_t keyAcquisitions = 0;
+};
+
+/**
+ * Canonical algorithm name, e.g. "sha-256" -> "SHA256"
+ */
+inline std::string normalizeAlgorithm(const std::string& algorithm) {
+    std::string result;
+    for (char c : algorithm) {
+        if (c == '-' || c == '_') continue;
+        result += (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+    }
+    return result;
+}
+
+/**
+ * Hashes the signing engine accepts; the scheme follows from each
+ * certificate's key, as for /sign without a padding
+ */
+inline bool isSupportedAlgorithm(const std::string& algorithm) {
+    return Crypto::hashNamed(algorithm) != nullptr;
+}
+
+/**
+ * Streaming reader for a /signBatch request body
+ *
+ * {"thumbprint": "...", "algorithm": "SHA256",
+ *  "items": ["<hash>", {"hash": "...", "thumbprint": "...", "algorithm": "..."}]}
+ *
+ * Fed by Json::StreamParser as the body arrives, so the body is never held
+ * in memory as a whole. Top-level thumbprint and algorithm are defaults for
+ * items without their own and may appear before or after items. Problems
+ * with a single item are recorded in BatchItem::error and reported for
+ * that item only; problems with the document throw.
+ */
+class RequestReader : public Json::Handler {
+private:
+    enum class Field { Other, Thumbprint, Algorithm, Items, Hash };
+
+    std::vector<BatchItem> items;
+    std::vector<bool> ownThumbprint;
+    std::vector<bool> ownAlgorithm;
+    std::string defaultThumbprint;
+    std::string defaultAlgorithm = "SHA256";
+    std::string scratch;
+    size_t depth = 0;            // open containers
+    Field topField = Field::Other;
+    Field itemField = Field::Other;
+    bool sawItems = false;
+    bool inItems = false;        // inside the items array
+    bool inItemObject = false;   // inside an object element of items
+
+    static Field classify(std::string_view name) {
+        if (name == "thumbprint") return Field::Thumbprint;
+        if (name == "algorithm") return Field::Algorithm;
+        if (name == "items") return Field::Items;
+        if (name == "hash") return Field::Hash;
+        return Field::Other;
+    }
+
+    BatchItem& addItem() {
+        if (items.size() >= MAX_BATCH_ITEMS) {
+            throw std::runtime_error("Invalid batch request: too many items (max " +
+                                     std::to_string(MAX_BATCH_ITEMS) + ")");
+        }
+        items.emplace_back();
+        items.back().index = items.size() - 1;
+        ownThumbprint.push_back(false);
+        ownAlgorithm.push_back(false);
+        return items.back();
+    }
+
+    /** Any value other than a string or an item object */
+    void otherValue() {
+        if (depth == 0) throw std::runtime_error("Invalid batch request: expected a JSON object");
+        if (depth == 1 && topField == Field::Items) {
+            throw std::runtime_error("Invalid batch request: items array is required");
+        }
+        if (depth == 2 && inItems) {
+            addItem().error = "Invalid item: expected a hash string or an object";
+        }
+    }
+
+    void open(bool object) {
+        if (depth == 0 && !object) throw std::runtime_error("Invalid batch request: expected a JSON object");
+        if (depth == 1 && topField == Field::Items) {
+            if (object) throw std::runtime_error("Invalid batch request: items array is required");
+            sawItems = true;
+            inItems = true;
+        } else if (depth == 2 && inItems) {
+            if (object) {
+                addItem();
+                inItemObject = true;
+                itemField = Field::Other;
+            } else {
+                otherValue();
+            }
+        }
+        depth++;
+    }
+
+    void close() {
+        depth--;
+        if (depth == 1) inItems = false;
+        if (depth == 2) inItemObject = false;
+    }
+
+public:
+    void startObject() override { open(true); }
+    void endObject() override { close(); }
+    void startArray() override { open(false); }
+    void endArray() override { close(); }
+
+    void key(std::string_view raw, bool escaped) override {
+        Field field = classify(Json::decoded(raw, escaped, scratch));
+        if (depth == 1) topField = field;
+        else if (depth == 3 && inItemObject) itemField = field;
+    }
+
+    void string(std::string_view raw, bool escaped) override {
+        if (depth == 1) {
+            if (topField == Field::Thumbprint) defaultThumbprint = Json::decoded(raw, escaped, scratch);
+            else if (topField == Field::Algorithm) defaultAlgorithm = Json::decoded(raw, escaped, scratch);
+            else if (topField == Field::Items) otherValue();
+        } else if (depth == 2 && inItems) {
+            addItem().hash = Json::decoded(raw, escaped, scratch);
+        } else if (depth == 3 && inItemObject) {
+            BatchItem& item = items.back();
+            if (itemField == Field::Hash) {
+                item.hash = Json::decoded(raw, escaped, scratch);
+            } else if (itemField == Field::Thumbprint) {
+                item.thumbprint = Json::decoded(raw, escaped, scratch);
+                ownThumbprint.back() = true;
+            } else if (itemField == Field::Algorithm) {
+                item.algorithm = Json::decoded(raw, escaped, scratch);
+                ownAlgorithm.back() = true;
+            }
+        } else if (depth == 0) {
+            otherValue();
+        }
+    }
+
+    void number(std::string_view) override { otherValue(); }
+    void boolean(bool) override { otherValue(); }
+    void null() override { otherValue(); }
+
+    /**
+     * Items of the completely parsed request, with defaults applied and
+     * each item validated
+     */
+    std::vector<BatchItem> finish() {
+        if (!sawItems) {
+            throw std::runtime_error("Invalid batch request: items array is required");
+        }
+        if (items.empty()) {
+            throw std::runtime_error("Invalid batch request: items must not be empty");
+        }
+
+        for (size_t i = 0; i < items.size(); i++) {
+            BatchItem& item = items[i];
+            if (!ownThumbprint[i]) item.thumbprint = defaultThumbprint;
+            if (!ownAlgorithm[i]) item.algorithm = defaultAlgorithm;
+            item.algorithm = normalizeAlgorithm(item.algorithm);
+
+            if (item.error.empty()) {
+                if (item.hash.empty() || item.hash.length() > 1024) {
+                    item.error = "Invalid hash parameter (max 1024 chars)";
+                } else if (item.thumbprint.length() != 40 && item.thumbprint.length() != 64) {
+                    item.error = "Invalid thumbprint (must be 40 or 64 hex characters)";
+                } else if (!isSupportedAlgorithm(item.algorithm)) {
+                    item.error = "Unsupported algorithm: " + item.algorithm;
+                }
+            }
+        }
+        return std::move(items);
+    }
+};
+
+/** NDJSON line for a signed item */
+inline std::string resultLine(size_t index, const std::string& signature) {
+    static constexpr Json::StaticKey indexKey("index");
+    static constexpr Json::StaticKey resultKey("result");
+    Json::Writer line(signature.size() + 40);
+    line.beginObject();
+    line.key(indexKey).number((long long)index);
+    line.key(resultKey).string(signature);
+    line.endObject().raw("\n");
+    return line.take();
+}
+
+/** NDJSON line for a failed item */
+inline std::string errorLine(size_t index, const std::string& error) {
+    static constexpr Json::StaticKey indexKey("index");
+    static constexpr Json::StaticKey errorKey("error");
+    Json::Writer line(error.size() + 40);
+    line.beginObject();
+    line.key(indexKey).number((long long)index);
+    line.key(errorKey).string(error);
+    line.endObject().raw("\n");
+    return line.take();
+}
+
+/** Last NDJSON line of a batch */
+inline std::string summaryLine(const BatchSummary& summary) {
+    static constexpr Json::StaticKey summaryKey("summary");
+    static constexpr Json::StaticKey itemsKey("items");
+    static constexpr Json::StaticKey succeededKey("succeeded");
+    static constexpr Json::StaticKey failedKey("failed");
+    static constexpr Json::StaticKey keyAcquisitionsKey("keyAcquisitions");
+    Json::Writer line(128);
+    line.beginObject().key(summaryKey).beginObject();
+    line.key(itemsKey).number((long long)summary.items);
+    line.key(succeededKey).number((long long)summary.succeeded);
+    line.key(failedKey).number((long long)summary.failed);
+    line.key(keyAcquisitionsKey).number((long long)summary.keyAcquisitions);
+    line.endObject().endObject().raw("\n");
+    return line.take();
+}
+
+/**
+ * Sign a parsed batch, grouped by certificate and algorithm
+ *
+ * Each certificate is looked up once and each group acquires its key once, then signs
+ * all of its items with that key. Every result is handed to emit() as soon
+ * as it is available; signing stops early if emit() returns false (client
+ * disconnected).
+ */
+inline BatchSummary signBatch(const std::vector<BatchItem>& items,
+                              const std::function<bool(const std::string& line)>& emit) {
+    BatchSummary summary;
+    summary.items = items.size();
+
+    auto fail = [&](size_t index, const std::string& error) {
+        summary.failed++;
+        return emit(errorLine(index, error));
+    };
+
+    struct Group {
+        Keys::CertificatePtr cert;
+        std::vector<const BatchItem*> items;
+    };
+
+    // Rejected items and unknown certificates are answered first; the rest
+    // are grouped by certificate and algorithm in order of first appearance
+    std::vector<Group> groups;
+    std::unordered_map<std::string, size_t> groupByKey;
+    std::unordered_map<std::string, Keys::CertificatePtr> certByThumbprint;
+    for (const auto& item : items) {
+        if (!item.error.empty()) {
+            if (!fail(item.index, item.error)) return summary;
+            continue;
+        }
+
+        Keys::CertificatePtr cert;
+        auto known = certByThumbprint.find(item.thumbprint);
+        if (known != certByThumbprint.end()) {
+            cert = known->second;
+        } else {
+            try {
+                cert = Signing::findCertificate(item.thumbprint);
+            }
+            catch (const std::exception& ex) {
+                if (!fail(item.index, ex.what())) return summary;
+                continue;
+            }
+            certByThumbprint[item.thumbprint] = cert;
+        }
+
+        auto inserted = groupByKey.emplace(cert->sha1 + "|" + item.algorithm, groups.size());
+        if (inserted.second) groups.push_back(Group{ cert, {} });
+        groups[inserted.first->second].items.push_back(&item);
+    }
+
+    for (const auto& group : groups) {
+        std::shared_ptr<Keys::SigningKey> key;
+        try {
+            Keys::requestTerms().check();
+            key = Signing::acquireKey(group.cert);
+            summary.keyAcquisitions++;
+        }
+        catch (const std::exception& ex) {
+            for (const BatchItem* item : group.items) {
+                if (!fail(item->index, ex.what())) return summary;
+            }
+            continue;
+        }
+
+        for (const BatchItem* item : group.items) {
+            std::string line;
+            try {
+                std::vector<uint8_t> hashBytes = Signing::decodeHash(item->hash);
+                const Crypto::SignatureAlgorithm& algorithm =
+                    Signing::resolveAlgorithm(*group.cert, hashBytes.size(), item->algorithm, "");
+                line = resultLine(item->index, Signing::signWithCertificate(group.cert, key, algorithm, hashBytes));
+                summary.succeeded++;
+            }
+            catch (const std::exception& ex) {
+                line = errorLine(item->index, ex.what());
+                summary.failed++;
+            }
+            if (!emit(line)) return summary;
+        }
+    }
+    return summary;
+}
+
+} // namespace Batch
+} // namespace ArhintSigner
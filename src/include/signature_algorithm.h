@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ArhintSigner {
+namespace Crypto {
+
+/**
+ * Hash a client signs; it sends the digest, so the algorithm is only ever
+ * named or implied by the digest's length
+ */
+enum class HashAlgorithm : uint8_t { Sha1, Sha256, Sha384, Sha512 };
+
+struct HashInfo {
+    HashAlgorithm id;
+    const char* name;             // "SHA256", as /signBatch items name it
+    size_t length;
+    std::string_view digestInfo;  // DER prefix of the PKCS#1 v1.5 DigestInfo (RFC 8017 section 9.2)
+};
+
+constexpr HashInfo HASHES[] = {
+    { HashAlgorithm::Sha1, "SHA1", 20,
+      std::string_view("\x30\x21\x30\x09\x06\x05\x2b\x0e\x03\x02\x1a\x05\x00\x04\x14", 15) },
+    { HashAlgorithm::Sha256, "SHA256", 32,
+      std::string_view("\x30\x31\x30\x0d\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x01\x05\x00\x04\x20", 19) },
+    { HashAlgorithm::Sha384, "SHA384", 48,
+      std::string_view("\x30\x41\x30\x0d\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x02\x05\x00\x04\x30", 19) },
+    { HashAlgorithm::Sha512, "SHA512", 64,
+      std::string_view("\x30\x51\x30\x0d\x06\x09\x60\x86\x48\x01\x65\x03\x04\x02\x03\x05\x00\x04\x40", 19) },
+};
+
+constexpr const HashInfo& hashInfo(HashAlgorithm hash) {
+    return HASHES[(size_t)hash];
+}
+
+/** Hash with a digest of this length, or null */
+constexpr const HashInfo* hashOfLength(size_t length) {
+    for (const HashInfo& hash : HASHES) {
+        if (hash.length == length) return &hash;
+    }
+    return nullptr;
+}
+
+/** Hash by name: "SHA256", "sha-256", ... (case and dashes ignored), or null */
+inline const HashInfo* hashNamed(std::string_view name) {
+    char normalized[8];
+    size_t length = 0;
+    for (char c : name) {
+        if (c == '-') continue;
+        if (length == sizeof(normalized)) return nullptr;
+        normalized[length++] = (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+    }
+    for (const HashInfo& hash : HASHES) {
+        if (std::string_view(hash.name) == std::string_view(normalized, length)) return &hash;
+    }
+    return nullptr;
+}
+
+/** Private key types the signing engine can drive */
+enum class KeyType : uint8_t { Rsa, EcP256, EcP384 };
+
+constexpr const char* keyTypeName(KeyType type) {
+    return type == KeyType::Rsa ? "RSA" : type == KeyType::EcP256 ? "P-256" : "P-384";
+}
+
+/** Signature scheme (padding) a key signs with */
+enum class Scheme : uint8_t { RsaPkcs1, RsaPss, Ecdsa, Unknown };
+
+constexpr const char* schemeName(Scheme scheme) {
+    return scheme == Scheme::RsaPkcs1 ? "PKCS#1 v1.5" : scheme == Scheme::RsaPss ? "PSS" : "ECDSA";
+}
+
+/**
+ * One supported (key type, scheme, hash) combination. Every backend signs
+ * exactly these; PSS always uses MGF1 with the same hash and a salt as long
+ * as the hash.
+ */
+struct SignatureAlgorithm {
+    KeyType key;
+    Scheme scheme;
+    HashAlgorithm hash;
+    const char* name;  // reported in /sign responses and part of signature cache keys
+
+    const HashInfo& hashInfo() const { return Crypto::hashInfo(hash); }
+};
+
+/**
+ * Every combination the signing engine accepts. SHA-1 stays available for
+ * PKCS#1 v1.5 only, for clients that still send it; ECDSA needs a hash at
+ * least as strong as its curve (FIPS 186-5).
+ */
+constexpr SignatureAlgorithm SIGNATURE_ALGORITHMS[] = {
+    { KeyType::Rsa, Scheme::RsaPkcs1, HashAlgorithm::Sha1, "RSA-PKCS1-SHA1" },
+    { KeyType::Rsa, Scheme::RsaPkcs1, HashAlgorithm::Sha256, "RSA-PKCS1-SHA256" },
+    { KeyType::Rsa, Scheme::RsaPkcs1, HashAlgorithm::Sha384, "RSA-PKCS1-SHA384" },
+    { KeyType::Rsa, Scheme::RsaPkcs1, HashAlgorithm::Sha512, "RSA-PKCS1-SHA512" },
+    { KeyType::Rsa, Scheme::RsaPss, HashAlgorithm::Sha256, "RSA-PSS-SHA256" },
+    { KeyType::Rsa, Scheme::RsaPss, HashAlgorithm::Sha384, "RSA-PSS-SHA384" },
+    { KeyType::Rsa, Scheme::RsaPss, HashAlgorithm::Sha512, "RSA-PSS-SHA512" },
+    { KeyType::EcP256, Scheme::Ecdsa, HashAlgorithm::Sha256, "ECDSA-P256-SHA256" },
+    { KeyType::EcP256, Scheme::Ecdsa, HashAlgorithm::Sha384, "ECDSA-P256-SHA384" },
+    { KeyType::EcP256, Scheme::Ecdsa, HashAlgorithm::Sha512, "ECDSA-P256-SHA512" },
+    { KeyType::EcP384, Scheme::Ecdsa, HashAlgorithm::Sha384, "ECDSA-P384-SHA384" },
+    { KeyType::EcP384, Scheme::Ecdsa, HashAlgorithm::Sha512, "ECDSA-P384-SHA512" },
+};
+
+/** Table entry for a combination, or null if it is not supported */
+constexpr const SignatureAlgorithm* findSignatureAlgorithm(KeyType key, Scheme scheme, HashAlgorithm hash) {
+    for (const SignatureAlgorithm& algorithm : SIGNATURE_ALGORITHMS) {
+        if (algorithm.key == key && algorithm.scheme == scheme && algorithm.hash == hash) return &algorithm;
+    }
+    return nullptr;
+}
+
+static_assert(hashInfo(HashAlgorithm::Sha1).length == 20 && hashInfo(HashAlgorithm::Sha256).length == 32 &&
+              hashInfo(HashAlgorithm::Sha384).length == 48 && hashInfo(HashAlgorithm::Sha512).length == 64,
+              "HASHES is indexed by HashAlgorithm");
+static_assert(findSignatureAlgorithm(KeyType::Rsa, Scheme::RsaPss, HashAlgorithm::Sha1) == nullptr,
+              "PSS with SHA-1 is not offered");
+static_assert(findSignatureAlgorithm(KeyType::EcP384, Scheme::Ecdsa, HashAlgorithm::Sha256) == nullptr,
+              "P-384 needs at least SHA-384");
+
+} // namespace Crypto
+} // namespace ArhintSigner
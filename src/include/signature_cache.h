@@ -0,0 +1,287 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "key_scheduler.h"
+#include "signature_algorithm.h"
+
+namespace ArhintSigner {
+namespace Signatures {
+
+using Scheme = Crypto::Scheme;
+
+/**
+ * Only deterministic schemes may be answered from the cache: PSS and ECDSA
+ * (on tokens, or from presignatures) produce a different signature every time
+ */
+inline bool isDeterministic(Scheme scheme) {
+    return scheme == Scheme::RsaPkcs1;
+}
+
+/**
+ * Counters reported by SignatureCache
+ */
+struct SignatureCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t coalesced = 0;   // waited for an identical signature in progress
+    uint64_t evictions = 0;   // dropped for capacity or TTL
+    uint64_t bypassed = 0;    // non-deterministic scheme or cache disabled
+    size_t size = 0;
+    size_t capacity = 0;
+    long long ttlMs = 0;
+};
+
+/**
+ * Identity of a signature: thumbprint, scheme, hash algorithm and hash bytes,
+ * packed into a fixed buffer so lookups do not allocate
+ */
+class SignatureKey {
+private:
+    std::array<char, 136> bytes{};
+    size_t length = 0;
+
+public:
+    SignatureKey(std::string_view thumbprint, Scheme scheme, std::string_view algorithm,
+                 const uint8_t* hash, size_t hashLength) {
+        if (thumbprint.size() + algorithm.size() + hashLength + 3 > bytes.size()) {
+            throw std::length_error("Signature cache key too long");
+        }
+        auto append = [this](const void* data, size_t size) {
+            memcpy(bytes.data() + length, data, size);
+            length += size;
+        };
+        uint8_t lengths[3] = { (uint8_t)thumbprint.size(), (uint8_t)scheme, (uint8_t)algorithm.size() };
+        append(lengths, sizeof(lengths));
+        append(thumbprint.data(), thumbprint.size());
+        append(algorithm.data(), algorithm.size());
+        append(hash, hashLength);
+    }
+
+    std::string_view view() const { return std::string_view(bytes.data(), length); }
+
+    bool operator==(const SignatureKey& other) const { return view() == other.view(); }
+
+    struct Hash {
+        size_t operator()(const SignatureKey& key) const {
+            // FNV-1a
+            uint64_t hash = 14695981039346656037ull;
+            for (char c : key.view()) {
+                hash ^= (uint8_t)c;
+                hash *= 1099511628211ull;
+            }
+            return (size_t)hash;
+        }
+    };
+};
+
+/**
+ * Bounded, short-TTL cache of recent signatures with single-flight signing
+ *
+ * sign() answers from the cache when it can; otherwise identical concurrent
+ * requests share one call to the signer (the first caller signs, the others
+ * wait for its result or its exception). Waiters keep their own request
+ * terms: they give up at their own deadline or disconnect, and a leader that
+ * gave up on its own terms hands the signing to the next waiter instead of
+ * its error. Interactive requests never wait on a bulk leader. Least recently
+ * used entries are evicted first. Capacity 0 disables both caching and
+ * coalescing; TTL 0 keeps only the coalescing.
+ */
+class SignatureCache {
+private:
+    struct Entry {
+        SignatureKey key;
+        std::vector<uint8_t> signature;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    struct Flight {
+        bool done = false;
+        bool abandoned = false;  // the leader's own deadline or client ended it; a waiter takes over
+        std::vector<uint8_t> signature;
+        std::exception_ptr error;
+    };
+
+    using FlightMap = std::unordered_map<SignatureKey, std::shared_ptr<Flight>, SignatureKey::Hash>;
+
+    // How often a waiter re-checks whether its own client is still there
+    static constexpr std::chrono::milliseconds WAITER_POLL_INTERVAL{ 50 };
+
+    mutable std::mutex mutex;
+    std::condition_variable flightDone;
+    std::list<Entry> lru;  // most recently used first
+    std::unordered_map<SignatureKey, std::list<Entry>::iterator, SignatureKey::Hash> index;
+    std::array<FlightMap, 2> flights;  // per Keys::Lane, so a bulk leader never delays an interactive request
+    size_t capacity;
+    std::chrono::milliseconds ttl;
+    SignatureCacheStats counters;
+    std::atomic<bool> enabled;  // capacity > 0, readable without the lock
+    std::atomic<uint64_t> bypassed{ 0 };
+
+    void evictOverflow() {
+        while (lru.size() > capacity) {
+            index.erase(lru.back().key);
+            lru.pop_back();
+            counters.evictions++;
+        }
+    }
+
+    /**
+     * Wait for another request's flight under the calling request's own
+     * terms; throws when the caller's deadline passes or its client leaves
+     */
+    void await(std::unique_lock<std::mutex>& lock, const Flight& flight, const Keys::RequestTerms& terms) {
+        while (!flight.done) {
+            terms.check();
+            auto wakeAt = std::chrono::steady_clock::now() + WAITER_POLL_INTERVAL;
+            flightDone.wait_until(lock, terms.deadline < wakeAt ? terms.deadline : wakeAt);
+        }
+    }
+
+    static size_t copyOut(const std::vector<uint8_t>& signature, uint8_t* out, size_t outCapacity) {
+        if (signature.size() > outCapacity) throw std::runtime_error("Signature too large");
+        memcpy(out, signature.data(), signature.size());
+        return signature.size();
+    }
+
+public:
+    explicit SignatureCache(size_t maxEntries = 0, std::chrono::milliseconds timeToLive = std::chrono::milliseconds(10000))
+        : capacity(maxEntries)
+        , ttl(timeToLive)
+        , enabled(maxEntries > 0) {
+    }
+
+    /**
+     * Change the limits; capacity 0 disables the cache
+     */
+    void setLimits(size_t maxEntries, std::chrono::milliseconds timeToLive) {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity = maxEntries;
+        ttl = timeToLive;
+        enabled = maxEntries > 0;
+        evictOverflow();
+    }
+
+    /**
+     * Signature for key into out (at most outCapacity bytes), returning its
+     * length. signer(out, outCapacity) produces it on a miss and returns the
+     * length; it runs without the cache lock held and may throw. Failures are
+     * passed to coalesced waiters but not cached, except the leader's own
+     * DeadlineExceededError or RequestCancelledError, which only it sees.
+     */
+    template <typename Signer>
+    size_t sign(const SignatureKey& key, Scheme scheme, uint8_t* out, size_t outCapacity, Signer signer) {
+        if (!enabled.load(std::memory_order_relaxed) || !isDeterministic(scheme)) {
+            bypassed.fetch_add(1, std::memory_order_relaxed);
+            return signer(out, outCapacity);
+        }
+
+        const Keys::RequestTerms& terms = Keys::requestTerms();
+        FlightMap& laneFlights = flights[(size_t)terms.lane];
+        std::shared_ptr<Flight> flight;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!flight) {
+                auto now = std::chrono::steady_clock::now();
+                auto it = index.find(key);
+                if (it != index.end()) {
+                    if (it->second->expires > now) {
+                        lru.splice(lru.begin(), lru, it->second);
+                        counters.hits++;
+                        return copyOut(it->second->signature, out, outCapacity);
+                    }
+                    lru.erase(it->second);
+                    index.erase(it);
+                    counters.evictions++;
+                }
+
+                // Same signature already in progress - wait for it (bulk requests may join either lane)
+                std::shared_ptr<Flight> leader;
+                for (size_t lane = 0; lane <= (size_t)terms.lane && !leader; lane++) {
+                    auto pending = flights[lane].find(key);
+                    if (pending != flights[lane].end()) leader = pending->second;
+                }
+                if (!leader) {
+                    counters.misses++;
+                    flight = std::make_shared<Flight>();
+                    laneFlights.emplace(key, flight);
+                    break;
+                }
+
+                counters.coalesced++;
+                await(lock, *leader, terms);
+                if (leader->abandoned) continue;  // sign it ourselves, or join whoever took over
+                if (leader->error) std::rethrow_exception(leader->error);
+                return copyOut(leader->signature, out, outCapacity);
+            }
+        }
+
+        size_t length = 0;
+        std::exception_ptr error;
+        bool abandoned = false;
+        try {
+            length = signer(out, outCapacity);
+        }
+        catch (const Keys::DeadlineExceededError&) {
+            error = std::current_exception();
+            abandoned = true;
+        }
+        catch (const Keys::RequestCancelledError&) {
+            error = std::current_exception();
+            abandoned = true;
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            laneFlights.erase(key);
+            flight->done = true;
+            flight->abandoned = abandoned;
+            if (!abandoned) flight->error = error;
+            if (!error) {
+                flight->signature.assign(out, out + length);
+                if (ttl.count() > 0 && capacity > 0) {
+                    auto existing = index.find(key);
+                    if (existing != index.end()) {
+                        lru.erase(existing->second);
+                        index.erase(existing);
+                    }
+                    lru.push_front(Entry{ key, flight->signature, std::chrono::steady_clock::now() + ttl });
+                    index.emplace(key, lru.begin());
+                    evictOverflow();
+                }
+            }
+        }
+        flightDone.notify_all();
+
+        if (error) std::rethrow_exception(error);
+        return length;
+    }
+
+    SignatureCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        SignatureCacheStats result = counters;
+        result.bypassed = bypassed.load(std::memory_order_relaxed);
+        result.size = lru.size();
+        result.capacity = capacity;
+        result.ttlMs = (long long)ttl.count();
+        return result;
+    }
+};
+
+} // namespace Signatures
+} // namespace ArhintSigner
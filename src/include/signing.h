@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "logger.h"
+#include "metrics.h"
+#include "base64.h"
+#include "string_utils.h"
+#include "key_store.h"
+#include "key_cache.h"
+#include "key_scheduler.h"
+#include "signature_cache.h"
+#include "signature_algorithm.h"
+#include "ec.h"
+
+namespace ArhintSigner {
+namespace Signing {
+
+namespace Detail {
+inline std::unique_ptr<Keys::KeyStore>& installedStore() {
+    static std::unique_ptr<Keys::KeyStore> store = std::make_unique<Keys::UnavailableKeyStore>();
+    return store;
+}
+} // namespace Detail
+
+/**
+ * The key store requests are served from. Everything below is the
+ * backend-independent signing path in front of it: certificate lookup, key
+ * cache, device queue and signature cache.
+ */
+inline Keys::KeyStore& keyStore() {
+    return *Detail::installedStore();
+}
+
+/**
+ * Cache of opened private keys, shared by all request workers.
+ * Keys of certificates that leave the store are dropped when it reports a change.
+ */
+inline Keys::KeyHandleCache<Keys::SigningKey>& keyCache() {
+    static Keys::KeyHandleCache<Keys::SigningKey> cache;
+    return cache;
+}
+
+/**
+ * Per-device queues for private key operations (--token-concurrency and friends)
+ */
+inline Keys::KeyScheduler& keyScheduler() {
+    static Keys::KeyScheduler scheduler;
+    return scheduler;
+}
+
+/**
+ * Recently produced signatures, opt-in (--signature-cache-size)
+ */
+inline Signatures::SignatureCache& signatureCache() {
+    static Signatures::SignatureCache cache;
+    return cache;
+}
+
+/**
+ * Install the key store; call once at startup, before requests are served
+ */
+inline void useKeyStore(std::unique_ptr<Keys::KeyStore> store) {
+    Detail::installedStore() = std::move(store);
+    keyStore().onChange([]() {
+        keyCache().retainOnly([](const std::string& thumbprint) {
+            return keyStore().contains(thumbprint);
+        });
+    });
+    Log::info("Key store: ", keyStore().name());
+}
+
+/**
+ * Release every opened key and the key store; call once requests are no
+ * longer served. Stores backed by a loaded module (PKCS#11) unload it here,
+ * while the module's own statics are still alive.
+ */
+inline void closeKeyStore() {
+    keyCache().invalidateAll();
+    Detail::installedStore() = std::make_unique<Keys::UnavailableKeyStore>();
+}
+
+/**
+ * Raw signature bytes, held inline so signing does not allocate
+ * 1024 bytes cover RSA keys up to 8192 bits and every ECDSA curve.
+ */
+struct Signature {
+    static constexpr size_t CAPACITY = 1024;
+    uint8_t bytes[CAPACITY];
+    size_t length = 0;
+    const Crypto::SignatureAlgorithm* algorithm = nullptr;  // what produced it
+};
+
+/** Encoding of an ECDSA signature: raw r || s (as PKCS#11 and CNG return it) or DER */
+enum class SignatureFormat { Raw, Der };
+
+/**
+ * Optional /sign fields beyond the hash; empty fields take the defaults
+ */
+struct SignOptions {
+    std::string_view algorithm;  // hash name ("SHA256", ...), checked against the hash length
+    std::string_view padding;    // "pkcs1" or "pss", RSA only; default pkcs1, pss for RSA-PSS certificates
+    std::string_view format;     // "raw" or "der", ECDSA only; default raw
+};
+
+/**
+ * Signature algorithm for a certificate's key and a hash, from
+ * Crypto::SIGNATURE_ALGORITHMS: the key type comes from the certificate, the
+ * hash from its length (an explicit hashName must agree) and the scheme from
+ * the key, with padding choosing between PKCS#1 v1.5 and PSS for RSA.
+ * Throws an "Invalid ..." error for combinations the table does not hold.
+ */
+inline const Crypto::SignatureAlgorithm& resolveAlgorithm(const Keys::StoredCertificate& cert, size_t hashLength,
+                                                          std::string_view hashName, std::string_view padding) {
+    const Crypto::HashInfo* hash = Crypto::hashOfLength(hashLength);
+    if (!hash) throw std::runtime_error("Invalid hash length: " + std::to_string(hashLength) + " bytes");
+    if (!hashName.empty()) {
+        const Crypto::HashInfo* named = Crypto::hashNamed(hashName);
+        if (!named) {
+            throw std::runtime_error("Invalid algorithm '" + std::string(hashName) +
+                                     "'. Expected SHA1, SHA256, SHA384 or SHA512");
+        }
+        if (named != hash) {
+            throw std::runtime_error("Invalid hash length: " + std::to_string(hashLength) + " bytes for " +
+                                     named->name + " (expected " + std::to_string(named->length) + ")");
+        }
+    }
+
+    Crypto::KeyType keyType = Crypto::KeyType::Rsa;
+    Crypto::Scheme scheme = Crypto::Scheme::RsaPkcs1;
+    switch (cert.keyAlgorithm) {
+        case Der::KeyAlgorithm::Rsa:
+        case Der::KeyAlgorithm::Unknown:  // certificate the store could not parse; signed as RSA, as always
+            break;
+        case Der::KeyAlgorithm::RsaPss:
+            scheme = Crypto::Scheme::RsaPss;
+            break;
+        case Der::KeyAlgorithm::Ec:
+            if (cert.keyBits == 256 || cert.keyBits == 384) {
+                keyType = cert.keyBits == 256 ? Crypto::KeyType::EcP256 : Crypto::KeyType::EcP384;
+                scheme = Crypto::Scheme::Ecdsa;
+                break;
+            }
+            throw std::runtime_error("Invalid certificate for signing: only P-256 and P-384 curves are supported");
+        default:
+            throw std::runtime_error("Invalid certificate for signing: only RSA and EC keys are supported");
+    }
+
+    if (!padding.empty()) {
+        if (keyType != Crypto::KeyType::Rsa) throw std::runtime_error("Invalid padding: only RSA keys take a padding");
+        if (padding == "pss") {
+            scheme = Crypto::Scheme::RsaPss;
+        } else if (padding != "pkcs1") {
+            throw std::runtime_error("Invalid padding '" + std::string(padding) + "'. Expected pkcs1 or pss");
+        } else if (cert.keyAlgorithm == Der::KeyAlgorithm::RsaPss) {
+            throw std::runtime_error("Invalid padding: RSA-PSS certificates only sign with pss");
+        } else {
+            scheme = Crypto::Scheme::RsaPkcs1;
+        }
+    }
+
+    const Crypto::SignatureAlgorithm* algorithm = Crypto::findSignatureAlgorithm(keyType, scheme, hash->id);
+    if (!algorithm) {
+        throw std::runtime_error(std::string("Invalid algorithm: ") + Crypto::keyTypeName(keyType) + " " +
+                                 Crypto::schemeName(scheme) + " signatures over " + hash->name + " are not supported");
+    }
+    return *algorithm;
+}
+
+/** Parse the "format" option for a signature algorithm */
+inline SignatureFormat parseFormat(std::string_view format, const Crypto::SignatureAlgorithm& algorithm) {
+    if (format.empty() || format == "raw") return SignatureFormat::Raw;
+    if (format != "der") throw std::runtime_error("Invalid format '" + std::string(format) + "'. Expected raw or der");
+    if (algorithm.scheme != Crypto::Scheme::Ecdsa) {
+        throw std::runtime_error("Invalid format: only ECDSA signatures have a DER form");
+    }
+    return SignatureFormat::Der;
+}
+
+/**
+ * Largest hash decodeHash() accepts (SHA-512)
+ */
+constexpr size_t MAX_HASH_LENGTH = 64;
+
+/**
+ * Validate and decode a base64 hash to sign into hashBytes (MAX_HASH_LENGTH
+ * bytes), returning its length
+ */
+inline size_t decodeHash(std::string_view hashB64Input, uint8_t* hashBytes) {
+    std::string_view hashB64 = Utils::trimmed(hashB64Input);
+    if (hashB64.empty()) {
+        throw std::runtime_error("Hash is required and must be a string");
+    }
+
+    // Decode hash; validation happens while decoding. Text too long for any
+    // accepted hash still gets decoded (on the heap) so the error says why.
+    uint8_t stackBuffer[Crypto::Base64::maxDecodedLength(128)];
+    std::vector<uint8_t> heapBuffer;
+    uint8_t* decoded = stackBuffer;
+    if (Crypto::Base64::maxDecodedLength(hashB64.length()) > sizeof(stackBuffer)) {
+        heapBuffer.resize(Crypto::Base64::maxDecodedLength(hashB64.length()));
+        decoded = heapBuffer.data();
+    }
+
+    size_t hashLength = 0;
+    if (!Crypto::Base64::decode(hashB64.data(), hashB64.length(), decoded, hashLength)) {
+        std::string error = "Hash must be valid base64 encoded string. Received: '" + std::string(hashB64) +
+                          "' (length: " + std::to_string(hashB64.length()) + ")";
+        Log::warn(error);
+        throw std::runtime_error(error);
+    }
+    if (hashLength == 0) {
+        throw std::runtime_error("Invalid base64 hash - unable to decode");
+    }
+
+    // Validate hash length (SHA-1 = 20, SHA-256 = 32, SHA-384 = 48, SHA-512 = 64 bytes)
+    if (!Crypto::hashOfLength(hashLength)) {
+        std::string error = "Invalid hash length: " + std::to_string(hashLength) +
+                          " bytes. Expected 20 (SHA-1), 32 (SHA-256), 48 (SHA-384) or 64 (SHA-512) bytes";
+        throw std::runtime_error(error);
+    }
+    memcpy(hashBytes, decoded, hashLength);
+    return hashLength;
+}
+
+/**
+ * Validate and decode a base64 hash to sign
+ */
+inline std::vector<uint8_t> decodeHash(const std::string& hashB64Input) {
+    uint8_t hashBytes[MAX_HASH_LENGTH];
+    size_t hashLength = decodeHash(std::string_view(hashB64Input), hashBytes);
+    return std::vector<uint8_t>(hashBytes, hashBytes + hashLength);
+}
+
+/**
+ * Find a signing certificate by SHA-1 or SHA-256 thumbprint
+ */
+inline Keys::CertificatePtr findCertificate(std::string_view thumbprintInput) {
+    std::string_view thumbprint = Utils::trimmed(thumbprintInput);
+    if (thumbprint.empty()) {
+        throw std::runtime_error("Thumbprint is required and must be a string");
+    }
+
+    // Security: Validate thumbprint length (SHA-1 or SHA-256, hex encoded)
+    if (thumbprint.length() != 40 && thumbprint.length() != 64) {
+        throw std::runtime_error("Invalid thumbprint length (expected 40 or 64 hex characters)");
+    }
+
+    Keys::CertificatePtr cert = keyStore().findByThumbprint(thumbprint);
+    if (!cert) {
+        throw std::runtime_error("Certificate not found");
+    }
+    return cert;
+}
+
+/**
+ * Private key of a certificate, from the key cache (opened on a miss)
+ */
+inline std::shared_ptr<Keys::SigningKey> acquireKey(const Keys::CertificatePtr& cert) {
+    // Cache key is the canonical (upper-case) SHA-1 thumbprint
+    return keyCache().acquire(cert->sha1, [&cert](const std::string&) {
+        Metrics::Stopwatch stopwatch;
+        std::shared_ptr<Keys::SigningKey> key = keyStore().loadKey(*cert);
+        Metrics::recordKeyAcquire(key->api(), stopwatch.elapsedMicros());
+        return key;
+    });
+}
+
+/**
+ * Sign with a key once its device has a free slot (see KeyScheduler), under
+ * the calling request's lane and deadline. A request that expired or lost
+ * its client while queued is dropped without using the key.
+ */
+inline void signWhenDeviceFree(const Keys::SigningKey& key, const Crypto::SignatureAlgorithm& algorithm,
+                               const uint8_t* hashBytes, size_t hashLength, Signature& signature,
+                               Metrics::Stopwatch& stopwatch) {
+    const Keys::RequestTerms& terms = Keys::requestTerms();
+    if (terms.expired()) throw Keys::DeadlineExceededError("Request deadline exceeded");
+    const Keys::KeyDevice& device = key.device();
+    Keys::KeyScheduler::Permit permit = keyScheduler().acquire(device.name, device.hardware, terms, device.concurrency);
+    Metrics::recordKeyQueueWait(permit.waitedMicros());
+    if (permit.waitedMicros() > 0) terms.check();
+    Metrics::requestPhases().mark(Metrics::Phase::Queue);
+    stopwatch = Metrics::Stopwatch();
+    signature.length = key.sign(algorithm, hashBytes, hashLength, signature.bytes, Signature::CAPACITY);
+    signature.algorithm = &algorithm;
+}
+
+/**
+ * Sign with a certificate's key (algorithm from resolveAlgorithm()),
+ * re-acquiring it once if the token went away.
+ * key holds the key to use and is replaced when it had to be re-acquired.
+ * Throws Keys::QueueFullError when the key's device has too many waiters, and
+ * Keys::DeadlineExceededError / Keys::RequestCancelledError when the request
+ * is dropped.
+ */
+inline void signWithCertificate(const Keys::CertificatePtr& cert, std::shared_ptr<Keys::SigningKey>& key,
+                                const Crypto::SignatureAlgorithm& algorithm, const uint8_t* hashBytes,
+                                size_t hashLength, Signature& signature) {
+    Metrics::RequestPhases& phases = Metrics::requestPhases();
+    Metrics::Stopwatch stopwatch;
+    try {
+        signWhenDeviceFree(*key, algorithm, hashBytes, hashLength, signature, stopwatch);
+    }
+    catch (const Keys::KeyUnavailableError&) {
+        // Token was removed or reset since the key was cached - acquire it once more
+        phases.mark(Metrics::Phase::Sign);
+        keyCache().invalidate(cert->sha1);
+        key = acquireKey(cert);
+        phases.mark(Metrics::Phase::Key);
+        signWhenDeviceFree(*key, algorithm, hashBytes, hashLength, signature, stopwatch);
+    }
+    phases.mark(Metrics::Phase::Sign);
+    Metrics::recordSign(key->api(), cert->sha1, stopwatch.elapsedMicros());
+}
+
+/**
+ * Same, returning the base64 signature
+ */
+inline std::string signWithCertificate(const Keys::CertificatePtr& cert, std::shared_ptr<Keys::SigningKey>& key,
+                                       const Crypto::SignatureAlgorithm& algorithm,
+                                       const std::vector<uint8_t>& hashBytes) {
+    Signature signature;
+    signWithCertificate(cert, key, algorithm, hashBytes.data(), hashBytes.size(), signature);
+    return Crypto::Base64::encode(signature.bytes, signature.length);
+}
+
+/**
+ * Hash a /signDocument upload is signed over: the named one, or by default
+ * SHA-384 for P-384 keys (which need at least that) and SHA-256 otherwise
+ */
+inline const Crypto::HashInfo& documentHash(const Keys::StoredCertificate& cert, std::string_view hashName) {
+    if (hashName.empty()) {
+        bool p384 = cert.keyAlgorithm == Der::KeyAlgorithm::Ec && cert.keyBits == 384;
+        return Crypto::hashInfo(p384 ? Crypto::HashAlgorithm::Sha384 : Crypto::HashAlgorithm::Sha256);
+    }
+    const Crypto::HashInfo* named = Crypto::hashNamed(hashName);
+    if (!named || named->id == Crypto::HashAlgorithm::Sha1) {
+        throw std::runtime_error("Invalid algorithm '" + std::string(hashName) + "'. Expected SHA256, SHA384 or SHA512");
+    }
+    return *named;
+}
+
+/**
+ * Sign a digest with a certificate's key and a resolved algorithm, through
+ * the signature cache, and encode it as format asks
+ */
+inline void signDigest(const Keys::CertificatePtr& cert, const Crypto::SignatureAlgorithm& algorithm,
+                       SignatureFormat format, const uint8_t* hashBytes, size_t hashLength, Signature& signature) {
+    Metrics::RequestPhases& phases = Metrics::requestPhases();
+
+    // Identical requests share one signature (see SignatureCache)
+    Signatures::SignatureKey cacheKey(cert->sha1, algorithm.scheme, algorithm.name, hashBytes, hashLength);
+    signature.length = signatureCache().sign(cacheKey, algorithm.scheme, signature.bytes, Signature::CAPACITY,
+        [&cert, &algorithm, hashBytes, hashLength, &signature, &phases](uint8_t*, size_t) {
+            // Signs straight into signature, which is the cache's output buffer
+            Keys::requestTerms().check();
+            std::shared_ptr<Keys::SigningKey> key = acquireKey(cert);
+            phases.mark(Metrics::Phase::Key);
+            signWithCertificate(cert, key, algorithm, hashBytes, hashLength, signature);
+            return signature.length;
+        });
+    signature.algorithm = &algorithm;
+    if (format == SignatureFormat::Der) {
+        signature.length = Crypto::Ec::rawToDer(signature.bytes, signature.length, signature.bytes, Signature::CAPACITY);
+    }
+}
+
+/**
+ * Sign a hash using a certificate identified by thumbprint, with the
+ * algorithm resolveAlgorithm() picks for its key and the request's options
+ * Allocation-free once the certificate's key is cached (and, with the
+ * signature cache enabled, on cache hits).
+ */
+inline void signHash(std::string_view hashB64Input, std::string_view thumbprintInput, const SignOptions& options,
+                     Signature& signature) {
+    if (Utils::trimmed(hashB64Input).empty()) {
+        throw std::runtime_error("Hash is required and must be a string");
+    }
+    if (Utils::trimmed(thumbprintInput).empty()) {
+        throw std::runtime_error("Thumbprint is required and must be a string");
+    }
+
+    Metrics::RequestPhases& phases = Metrics::requestPhases();
+    uint8_t hashBytes[MAX_HASH_LENGTH];
+    size_t hashLength = decodeHash(hashB64Input, hashBytes);
+    phases.mark(Metrics::Phase::Parse);
+    Keys::CertificatePtr cert = findCertificate(thumbprintInput);
+    const Crypto::SignatureAlgorithm& algorithm = resolveAlgorithm(*cert, hashLength, options.algorithm, options.padding);
+    SignatureFormat format = parseFormat(options.format, algorithm);
+    phases.mark(Metrics::Phase::Lookup);
+    signDigest(cert, algorithm, format, hashBytes, hashLength, signature);
+}
+
+} // namespace Signing
+} // namespace ArhintSigner
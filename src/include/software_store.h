@@ -0,0 +1,392 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "logger.h"
+#include "x509.h"
+#include "rsa.h"
+#include "ec.h"
+#include "sha1.h"
+#include "sha2.h"
+#include "base64.h"
+#include "string_utils.h"
+#include "json_utils.h"
+#include "key_store.h"
+#include "presignature_pool.h"
+#include "certificate_listing.h"
+
+namespace ArhintSigner {
+namespace Certificate {
+
+namespace Detail {
+
+/**
+ * One "-----BEGIN label-----" block of a PEM file
+ */
+struct PemBlock {
+    std::string label;
+    std::string der;
+    bool hasHeaders = false;  // "Proc-Type:" and friends, used by legacy encrypted keys
+};
+
+/**
+ * Split PEM text into its blocks; blocks that are not valid base64 are skipped
+ */
+inline std::vector<PemBlock> parsePem(std::string_view text) {
+    static constexpr std::string_view begin = "-----BEGIN ";
+    static constexpr std::string_view dashes = "-----";
+
+    std::vector<PemBlock> blocks;
+    size_t position = 0;
+    while ((position = text.find(begin, position)) != std::string_view::npos) {
+        size_t labelStart = position + begin.size();
+        size_t labelEnd = text.find(dashes, labelStart);
+        if (labelEnd == std::string_view::npos) break;
+
+        PemBlock block;
+        block.label.assign(text.substr(labelStart, labelEnd - labelStart));
+        std::string end = "-----END " + block.label + "-----";
+        size_t bodyStart = labelEnd + dashes.size();
+        size_t bodyEnd = text.find(end, bodyStart);
+        if (bodyEnd == std::string_view::npos) break;
+        position = bodyEnd + end.size();
+
+        std::string base64;
+        base64.reserve(bodyEnd - bodyStart);
+        for (char c : text.substr(bodyStart, bodyEnd - bodyStart)) {
+            if (c == ':') block.hasHeaders = true;
+            if (!std::isspace((unsigned char)c)) base64 += c;
+        }
+        if (block.hasHeaders) {
+            blocks.push_back(std::move(block));
+            continue;
+        }
+
+        block.der.resize(Crypto::Base64::maxDecodedLength(base64.size()));
+        size_t length = 0;
+        if (!Crypto::Base64::decode(base64.data(), base64.size(), (uint8_t*)&block.der[0], length)) continue;
+        block.der.resize(length);
+        blocks.push_back(std::move(block));
+    }
+    return blocks;
+}
+
+/**
+ * Key of a certificate's public key for pairing it with a private key: the
+ * RSA modulus (big-endian without leading zeros) or the uncompressed EC
+ * point; empty for other keys
+ */
+inline std::string_view publicKeyIdentity(const Der::Certificate& cert) {
+    if (cert.keyAlgorithm == Der::KeyAlgorithm::Ec) return cert.publicKey;
+    if (cert.keyAlgorithm != Der::KeyAlgorithm::Rsa && cert.keyAlgorithm != Der::KeyAlgorithm::RsaPss) {
+        return std::string_view();
+    }
+    Der::Reader outer(cert.publicKey);
+    Der::Reader rsaKey(outer.read(Der::Tag::SEQUENCE).contents);
+    std::string_view modulus = rsaKey.read(Der::Tag::INTEGER).contents;
+    while (!modulus.empty() && modulus[0] == 0) modulus.remove_prefix(1);
+    return modulus;
+}
+
+/**
+ * Private key loaded from the directory: RSA or EC, whichever it holds
+ */
+struct SoftwarePrivateKey {
+    std::shared_ptr<const Crypto::Rsa::PrivateKey> rsa;
+    std::shared_ptr<const Crypto::Ec::PrivateKey> ec;
+    std::shared_ptr<Keys::PresignatureQueue> presignatures;  // EC keys, unless pooling is disabled
+
+    explicit operator bool() const { return rsa || ec; }
+};
+
+} // namespace Detail
+
+/**
+ * Certificate loaded from the key directory, with its private key if one
+ * was found
+ */
+struct SoftwareCertificate : Keys::StoredCertificate {
+    std::string der;
+    ListingEntry listing;
+    Detail::SoftwarePrivateKey privateKey;
+};
+
+/**
+ * Private key held in process memory; signs with precomputed CRT values
+ * (RSA) or generator tables and presignatures (EC) and needs no device, so
+ * every key is its own queue
+ */
+class SoftwareKey : public Keys::SigningKey {
+private:
+    Detail::SoftwarePrivateKey key;
+
+public:
+    SoftwareKey(Detail::SoftwarePrivateKey privateKey, const std::string& thumbprint)
+        : key(std::move(privateKey)) {
+        Keys::KeyDevice device;
+        device.name = thumbprint;
+        setDevice(std::move(device));
+    }
+
+    Metrics::SignApi api() const override { return Metrics::SignApi::Software; }
+
+    size_t sign(const Crypto::SignatureAlgorithm& algorithm, const uint8_t* hash, size_t hashLength,
+                uint8_t* out, size_t capacity) const override {
+        switch (algorithm.scheme) {
+            case Crypto::Scheme::RsaPkcs1:
+                if (key.rsa) return key.rsa->signPkcs1(hash, hashLength, out, capacity);
+                break;
+            case Crypto::Scheme::RsaPss:
+                if (key.rsa) return key.rsa->signPss(hash, hashLength, out, capacity);
+                break;
+            case Crypto::Scheme::Ecdsa:
+                if (key.ec && key.ec->type() == algorithm.key) {
+                    Crypto::Ec::Presignature presignature;
+                    if (key.presignatures && key.presignatures->take(presignature)) {
+                        size_t length = key.ec->sign(presignature, hash, hashLength, out, capacity);
+                        Crypto::Bignum::wipe(&presignature, sizeof(presignature));
+                        if (length > 0) return length;
+                    }
+                    return key.ec->sign(hash, hashLength, out, capacity);
+                }
+                break;
+            default:
+                break;
+        }
+        throw std::runtime_error(std::string("Key cannot sign ") + algorithm.name);
+    }
+};
+
+/**
+ * KeyStore over a directory of PEM files (--key-dir)
+ *
+ * Every *.pem, *.crt, *.cer and *.key file is read once at startup.
+ * Certificates (PEM or DER) are paired with unencrypted RSA private keys
+ * (PKCS#1 "RSA PRIVATE KEY" or PKCS#8 "PRIVATE KEY") by modulus and with
+ * P-256/P-384 keys (SEC1 "EC PRIVATE KEY" or PKCS#8) by public point,
+ * wherever in the directory they are. Keys stay resident and sign in process, so
+ * the whole signing path runs on any platform and without a token.
+ */
+class SoftwareKeyStore : public Keys::KeyStore {
+private:
+    using CertificateEntry = std::shared_ptr<const SoftwareCertificate>;
+
+    static constexpr size_t MAX_FILE_SIZE = 1048576;
+
+    std::string directory;
+    std::vector<std::shared_ptr<SoftwareCertificate>> certificates;  // in file name order
+    std::unordered_map<std::string, CertificateEntry> bySha1;
+    std::unordered_map<std::string, CertificateEntry> bySha256;
+    size_t keyCount = 0;
+    CertificateListing listed;  // certificates with a key
+    Keys::PresignaturePool presignatures;
+
+    static bool hasExtension(const std::filesystem::path& path, std::initializer_list<const char*> extensions) {
+        std::string extension = path.extension().u8string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return (char)std::tolower(c); });
+        for (const char* candidate : extensions) {
+            if (extension == candidate) return true;
+        }
+        return false;
+    }
+
+    static bool readFile(const std::filesystem::path& path, std::string& contents) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !file.bad();
+    }
+
+    void addCertificate(std::string der, const std::string& source) {
+        auto entry = std::make_shared<SoftwareCertificate>();
+        entry->der = std::move(der);
+        Der::Certificate parsed;
+        try {
+            Der::parse(entry->der, parsed);
+        }
+        catch (const Der::ParseError& e) {
+            Log::warn("Skipping certificate in ", source, ": ", e.what());
+            return;
+        }
+
+        Crypto::Sha1::Digest sha1 = Crypto::Sha1::hash(entry->der.data(), entry->der.size());
+        Crypto::Sha256::Digest sha256 = Crypto::Sha256::hash(entry->der.data(), entry->der.size());
+        entry->sha1 = Utils::bytesToHex(sha1.data(), sha1.size());
+        entry->sha256 = Utils::bytesToHex(sha256.data(), sha256.size());
+        if (bySha1.count(entry->sha1)) return;  // same certificate in several files
+
+        entry->keyAlgorithm = parsed.keyAlgorithm;
+        entry->keyBits = parsed.keyBits;
+        entry->listing.notBefore = parsed.notBefore;
+        entry->listing.notAfter = parsed.notAfter;
+        certificates.push_back(entry);
+        bySha1[entry->sha1] = entry;
+        bySha256[entry->sha256] = entry;
+    }
+
+    void addKey(std::string_view der, bool ec, const std::string& source,
+                std::unordered_map<std::string, Detail::SoftwarePrivateKey>& byPublicKey) {
+        try {
+            Detail::SoftwarePrivateKey key;
+            if (ec || Crypto::Ec::PrivateKey::isEcPrivateKeyInfo(der)) {
+                key.ec = Crypto::Ec::PrivateKey::fromDer(der);
+                byPublicKey.emplace(std::string(key.ec->publicKey()), key);
+            } else {
+                key.rsa = Crypto::Rsa::PrivateKey::fromDer(der);
+                byPublicKey.emplace(std::string(key.rsa->modulus()), key);
+            }
+        }
+        catch (const std::exception& e) {
+            Log::warn("Skipping private key in ", source, ": ", e.what());
+        }
+    }
+
+    void loadFile(const std::filesystem::path& path,
+                  std::unordered_map<std::string, Detail::SoftwarePrivateKey>& byPublicKey) {
+        std::string source = path.filename().u8string();
+        if (hasExtension(path, { ".p12", ".pfx" })) {
+            Log::warn("Skipping ", source, ": PKCS#12 files are not supported, convert them to PEM");
+            return;
+        }
+        if (!hasExtension(path, { ".pem", ".crt", ".cer", ".key" })) return;
+
+        std::string contents;
+        std::error_code error;
+        if (std::filesystem::file_size(path, error) > MAX_FILE_SIZE || error || !readFile(path, contents)) {
+            Log::warn("Skipping ", source, ": cannot read file");
+            return;
+        }
+
+        // DER certificate (.cer files are often binary)
+        if (!contents.empty() && (uint8_t)contents[0] == 0x30) {
+            addCertificate(std::move(contents), source);
+            return;
+        }
+
+        for (Detail::PemBlock& block : Detail::parsePem(contents)) {
+            if (block.label == "CERTIFICATE") {
+                addCertificate(std::move(block.der), source);
+            } else if (block.label == "RSA PRIVATE KEY" || block.label == "EC PRIVATE KEY" ||
+                       block.label == "PRIVATE KEY") {
+                if (block.hasHeaders) {
+                    Log::warn("Skipping encrypted private key in ", source);
+                } else {
+                    addKey(block.der, block.label == "EC PRIVATE KEY", source, byPublicKey);
+                }
+                Crypto::Bignum::wipe(&block.der[0], block.der.size());
+            } else if (block.label == "ENCRYPTED PRIVATE KEY") {
+                Log::warn("Skipping encrypted private key in ", source);
+            } else if (block.label.find("PRIVATE KEY") != std::string::npos) {
+                Log::warn("Skipping ", block.label, " in ", source, ": only RSA and EC keys are supported");
+            }
+        }
+        // Key material stays only in the loaded keys
+        Crypto::Bignum::wipe(&contents[0], contents.size());
+    }
+
+public:
+    explicit SoftwareKeyStore(const std::string& path, const Keys::PresignatureLimits& presignatureLimits = {})
+        : directory(path), presignatures(presignatureLimits) {
+        std::error_code error;
+        std::vector<std::filesystem::path> files;
+        for (std::filesystem::directory_iterator it(std::filesystem::u8path(path), error), end;
+             !error && it != end; it.increment(error)) {
+            if (it->is_regular_file(error)) files.push_back(it->path());
+        }
+        if (error) {
+            Log::error("Cannot read key directory ", path, ": ", error.message());
+        }
+        std::sort(files.begin(), files.end());
+
+        std::unordered_map<std::string, Detail::SoftwarePrivateKey> byPublicKey;
+        for (const auto& file : files) {
+            loadFile(file, byPublicKey);
+        }
+
+        // Pair certificates with keys; those with a key are listed
+        for (const auto& entry : certificates) {
+            SoftwareCertificate& cert = *entry;
+            Der::Certificate parsed;
+            Der::parse(cert.der, parsed);
+            try {
+                std::string_view identity = Detail::publicKeyIdentity(parsed);
+                auto key = identity.empty() ? byPublicKey.end() : byPublicKey.find(std::string(identity));
+                if (key != byPublicKey.end()) {
+                    // Only keys with a certificate get presignatures; certificates sharing a key share them
+                    Detail::SoftwarePrivateKey& privateKey = key->second;
+                    if (privateKey.ec && !privateKey.presignatures) {
+                        privateKey.presignatures = presignatures.add(privateKey.ec);
+                    }
+                    cert.privateKey = privateKey;
+                }
+            }
+            catch (const Der::ParseError&) {
+                // Malformed public key - the certificate stays without a key
+            }
+            if (!cert.privateKey) continue;
+            keyCount++;
+            cert.listing.json = listingJson(parsed, cert.sha1, true, "present");
+            listed.add(cert.listing);
+        }
+        Log::info("Software key store: ", certificates.size(), " certificates, ", keyCount,
+                  " with private key, from ", path);
+        presignatures.start();
+    }
+
+    const char* name() const override { return "software"; }
+
+    Keys::CertificatePtr findByThumbprint(std::string_view hex) override {
+        // Per-thread scratch key: a lookup does not allocate once it has grown to thumbprint size
+        thread_local std::string key;
+        if (!Utils::normalizeHex(hex, key)) return nullptr;
+        const auto& table = key.length() == 64 ? bySha256 : bySha1;
+        auto it = table.find(key);
+        return it != table.end() ? it->second : nullptr;
+    }
+
+    bool contains(const std::string& sha1) const override {
+        return bySha1.count(sha1) > 0;
+    }
+
+    std::shared_ptr<Keys::SigningKey> loadKey(const Keys::StoredCertificate& cert) override {
+        const auto& software = static_cast<const SoftwareCertificate&>(cert);
+        if (!software.privateKey) {
+            throw std::runtime_error("Certificate has no private key");
+        }
+        return std::make_shared<SoftwareKey>(software.privateKey, software.sha1);
+    }
+
+    std::shared_ptr<const Json::Writer> listing() override {
+        return listed.current();
+    }
+
+    void addStats(Json::Builder& response) override {
+        Json::Builder storeJson;
+        storeJson.addString("directory", directory);
+        storeJson.addNumber("certificates", (long long)certificates.size());
+        storeJson.addNumber("withPrivateKey", (long long)keyCount);
+        Keys::PresignatureStats pool = presignatures.stats();
+        Json::Builder poolJson;
+        poolJson.addNumber("hits", (long long)pool.hits);
+        poolJson.addNumber("misses", (long long)pool.misses);
+        poolJson.addNumber("produced", (long long)pool.produced);
+        poolJson.addNumber("pooled", (long long)pool.pooled);
+        poolJson.addNumber("keys", (long long)pool.keys);
+        poolJson.addNumber("depth", (long long)pool.depth);
+        poolJson.addNumber("refillPerSecond", (long long)pool.refillPerSecond);
+        storeJson.addObject("presignatures", poolJson.toString());
+        response.addObject("softwareStore", storeJson.toString());
+    }
+};
+
+} // namespace Certificate
+} // namespace ArhintSigner
@@ -1,63 +1,61 @@
 #pragma once
 
-#include <windows.h>
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <regex>
+#include <string_view>
 
 namespace ArhintSigner {
 namespace Utils {
 
 /**
- * Extract a field value from a DN (Distinguished Name) string
- * Example: "CN=John Doe, O=Company" -> extractDNField(dn, "CN") returns "John Doe"
+ * Trim whitespace from both ends of a string
  */
-inline std::string extractDNField(const std::string& dn, const std::string& field) {
-    std::regex pattern("\\b" + field + "=([^,+]+)");
-    std::smatch match;
-    if (std::regex_search(dn, match, pattern)) {
-        std::string value = match[1].str();
-        // Trim whitespace
-        value.erase(0, value.find_first_not_of(" \t"));
-        value.erase(value.find_last_not_of(" \t") + 1);
-        return value;
-    }
-    return "";
+inline std::string trim(const std::string& str) {
+    std::string result = str;
+    result.erase(0, result.find_first_not_of(" \t\r\n"));
+    result.erase(result.find_last_not_of(" \t\r\n") + 1);
+    return result;
 }
 
 /**
- * Convert Windows FILETIME to ISO 8601 string
+ * Same without copying: the part of str between leading and trailing whitespace
  */
-inline std::string fileTimeToISO(const FILETIME& ft) {
-    SYSTEMTIME st;
-    FileTimeToSystemTime(&ft, &st);
-    
-    char buffer[100];
-    sprintf_s(buffer, "%04d-%02d-%02dT%02d:%02d:%02d.000Z",
-              st.wYear, st.wMonth, st.wDay,
-              st.wHour, st.wMinute, st.wSecond);
-    return std::string(buffer);
+inline std::string_view trimmed(std::string_view str) {
+    size_t start = str.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) return std::string_view();
+    return str.substr(start, str.find_last_not_of(" \t\r\n") - start + 1);
 }
 
 /**
- * Convert Windows FILETIME to short date string (MM/DD/YYYY)
+ * Normalize a hex identifier to upper case.
+ * Returns false if it contains anything but hex digits.
  */
-inline std::string fileTimeToShortDate(const FILETIME& ft) {
-    SYSTEMTIME st;
-    FileTimeToSystemTime(&ft, &st);
-    
-    char buffer[50];
-    sprintf_s(buffer, "%02d/%02d/%04d", st.wMonth, st.wDay, st.wYear);
-    return std::string(buffer);
+inline bool normalizeHex(std::string_view input, std::string& output) {
+    output.resize(input.size());
+    for (size_t i = 0; i < input.size(); i++) {
+        char c = input[i];
+        if (c >= 'a' && c <= 'f') {
+            c = (char)(c - 'a' + 'A');
+        } else if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F'))) {
+            return false;
+        }
+        output[i] = c;
+    }
+    return true;
 }
 
 /**
- * Trim whitespace from both ends of a string
+ * Format bytes as upper-case hex
  */
-inline std::string trim(const std::string& str) {
-    std::string result = str;
-    result.erase(0, result.find_first_not_of(" \t\r\n"));
-    result.erase(result.find_last_not_of(" \t\r\n") + 1);
-    return result;
+inline std::string bytesToHex(const uint8_t* data, size_t length) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string hex(length * 2, '0');
+    for (size_t i = 0; i < length; i++) {
+        hex[i * 2] = digits[data[i] >> 4];
+        hex[i * 2 + 1] = digits[data[i] & 0x0F];
+    }
+    return hex;
 }
 
 } // namespace Utils
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "key_store.h"
+#include "json_utils.h"
+#include "certificate_index.h"
+#include "certificate_inventory.h"
+#include "certificate_manager.h"
+
+namespace ArhintSigner {
+namespace Certificate {
+
+/**
+ * KeyStore over the current user's Windows certificate store (MY)
+ *
+ * Lookups go through the CertificateIndex, /listCerts is the cached
+ * CertificateInventory response and keys are opened with CryptoAPI/CNG.
+ */
+class SystemKeyStore : public Keys::KeyStore {
+public:
+    /**
+     * Build the certificate index and inventory now rather than on the
+     * first request
+     */
+    explicit SystemKeyStore(std::chrono::milliseconds probeTimeout) {
+        CertificateInventory::setProbeTimeout(probeTimeout);
+        CertificateInventory::instance();
+    }
+
+    const char* name() const override { return "system"; }
+
+    Keys::CertificatePtr findByThumbprint(std::string_view hex) override {
+        return CertificateIndex::instance().findByThumbprint(hex);
+    }
+
+    bool contains(const std::string& sha1) const override {
+        auto current = CertificateIndex::instance().current();
+        return current && current->bySha1.count(sha1) > 0;
+    }
+
+    std::shared_ptr<Keys::SigningKey> loadKey(const Keys::StoredCertificate& cert) override {
+        return Certificate::loadKey(static_cast<const IndexedCertificate&>(cert).context, cert.sha1);
+    }
+
+    std::shared_ptr<const Json::Writer> listing() override {
+        // Shares ownership with the cached response, which keeps the fragments alive
+        auto response = CertificateInventory::instance().currentResponse();
+        return std::shared_ptr<const Json::Writer>(response, &response->body);
+    }
+
+    void onChange(ChangeListener listener) override {
+        CertificateIndex::instance().onRebuild([listener](const IndexSnapshot&) { listener(); });
+    }
+
+    void addStats(Json::Builder& response) override {
+        IndexStats indexStats = CertificateIndex::instance().stats();
+        Json::Builder indexJson;
+        indexJson.addNumber("size", (long long)indexStats.size);
+        indexJson.addNumber("generation", (long long)indexStats.generation);
+        indexJson.addNumber("rebuilds", (long long)indexStats.rebuilds);
+        indexJson.addNumber("lookups", (long long)indexStats.lookups);
+        indexJson.addNumber("hits", (long long)indexStats.hits);
+        response.addObject("certificateIndex", indexJson.toString());
+
+        InventoryStats inventoryStats = CertificateInventory::instance().stats();
+        Json::Builder inventoryJson;
+        inventoryJson.addNumber("generation", (long long)inventoryStats.generation);
+        inventoryJson.addNumber("certificates", (long long)inventoryStats.certificates);
+        inventoryJson.addNumber("withPrivateKey", (long long)inventoryStats.withPrivateKey);
+        inventoryJson.addNumber("updates", (long long)inventoryStats.updates);
+        inventoryJson.addNumber("processed", (long long)inventoryStats.processed);
+        inventoryJson.addNumber("reused", (long long)inventoryStats.reused);
+        inventoryJson.addNumber("serializations", (long long)inventoryStats.serializations);
+        inventoryJson.addNumber("keyTimeouts", (long long)inventoryStats.keyTimeouts);
+        inventoryJson.addNumber("probesSkipped", (long long)inventoryStats.probes.skipped);
+        inventoryJson.addNumber("probes", (long long)inventoryStats.probes.probed);
+        inventoryJson.addNumber("probeTimeouts", (long long)inventoryStats.probes.timeouts);
+        inventoryJson.addNumber("lateProbes", (long long)inventoryStats.probes.late);
+        inventoryJson.addNumber("probesInFlight", (long long)inventoryStats.probes.inFlight);
+        response.addObject("inventory", inventoryJson.toString());
+    }
+};
+
+} // namespace Certificate
+} // namespace ArhintSigner
@@ -3,6 +3,7 @@
 #include <windows.h>
 #include <shellapi.h>
 #include <string>
+#include <iostream>
 #include <functional>
 
 namespace ArhintSigner {
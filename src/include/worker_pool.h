@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ArhintSigner {
+namespace Concurrency {
+
+/**
+ * Fixed-size worker pool with per-thread deques and work stealing
+ *
+ * Each worker owns a deque: it pushes and pops its own work at the back
+ * (LIFO, cache friendly) and steals from the front of other workers' deques
+ * when its own runs dry. Tasks submitted from outside the pool (e.g. the
+ * HTTP receive loop) are distributed round-robin across the deques.
+ */
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending;
+    std::atomic<unsigned> nextQueue;
+    std::atomic<bool> stopping;
+
+    static const WorkStealingPool*& currentPool() {
+        static thread_local const WorkStealingPool* pool = nullptr;
+        return pool;
+    }
+
+    static int& currentIndex() {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    bool popLocal(unsigned index, Task& task) {
+        WorkerQueue& queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned thief, Task& task) {
+        size_t count = queues.size();
+        for (size_t offset = 1; offset < count; offset++) {
+            WorkerQueue& victim = *queues[(thief + offset) % count];
+            std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned index) {
+        currentPool() = this;
+        currentIndex() = (int)index;
+
+        while (true) {
+            Task task;
+            if (popLocal(index, task) || steal(index, task)) {
+                pending.fetch_sub(1);
+                try {
+                    task();
+                }
+                catch (...) {
+                    // Tasks are responsible for their own error reporting
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            if (stopping && pending.load() == 0) break;
+            wake.wait(lock, [this]() { return pending.load() > 0 || stopping.load(); });
+            if (stopping && pending.load() == 0) break;
+        }
+
+        currentPool() = nullptr;
+        currentIndex() = -1;
+    }
+
+public:
+    explicit WorkStealingPool(unsigned workerCount)
+        : pending(0)
+        , nextQueue(0)
+        , stopping(false) {
+        if (workerCount == 0) workerCount = 1;
+        for (unsigned i = 0; i < workerCount; i++) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        for (unsigned i = 0; i < workerCount; i++) {
+            threads.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        shutdown();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * Queue a task. Workers push to their own deque, other threads round-robin.
+     */
+    void submit(Task task) {
+        unsigned index;
+        if (currentPool() == this) {
+            index = (unsigned)currentIndex();
+        } else {
+            index = nextQueue.fetch_add(1) % (unsigned)queues.size();
+        }
+
+        // Count the task before it becomes visible: a worker may pop it and
+        // decrement as soon as the queue lock is released
+        pending.fetch_add(1);
+        {
+            WorkerQueue& queue = *queues[index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_one();
+    }
+
+    /**
+     * Stop accepting work, run everything already queued and join the workers
+     */
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto& thread : threads) {
+            if (thread.joinable()) thread.join();
+        }
+        threads.clear();
+    }
+
+    unsigned size() const { return (unsigned)queues.size(); }
+    size_t pendingTasks() const { return pending.load(); }
+
+    /**
+     * Index of the calling worker thread in its pool, or -1 outside any pool
+     */
+    static int workerIndex() { return currentIndex(); }
+};
+
+} // namespace Concurrency
+} // namespace ArhintSigner
@@ -0,0 +1,697 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+namespace ArhintSigner {
+namespace Der {
+
+/** Byte string from a literal, embedded zeros included */
+template<size_t N>
+constexpr std::string_view bytes(const char (&literal)[N]) {
+    return std::string_view(literal, N - 1);
+}
+
+/**
+ * Encoded object identifiers (contents of the DER OBJECT IDENTIFIER)
+ */
+namespace Oid {
+    constexpr std::string_view commonName = bytes("\x55\x04\x03");
+    constexpr std::string_view surname = bytes("\x55\x04\x04");
+    constexpr std::string_view serialNumber = bytes("\x55\x04\x05");
+    constexpr std::string_view country = bytes("\x55\x04\x06");
+    constexpr std::string_view locality = bytes("\x55\x04\x07");
+    constexpr std::string_view state = bytes("\x55\x04\x08");
+    constexpr std::string_view street = bytes("\x55\x04\x09");
+    constexpr std::string_view organization = bytes("\x55\x04\x0A");
+    constexpr std::string_view organizationalUnit = bytes("\x55\x04\x0B");
+    constexpr std::string_view title = bytes("\x55\x04\x0C");
+    constexpr std::string_view description = bytes("\x55\x04\x0D");
+    constexpr std::string_view postalCode = bytes("\x55\x04\x11");
+    constexpr std::string_view givenName = bytes("\x55\x04\x2A");
+    constexpr std::string_view initials = bytes("\x55\x04\x2B");
+    constexpr std::string_view email = bytes("\x2A\x86\x48\x86\xF7\x0D\x01\x09\x01");
+    constexpr std::string_view domainComponent = bytes("\x09\x92\x26\x89\x93\xF2\x2C\x64\x01\x19");
+
+    constexpr std::string_view keyUsage = bytes("\x55\x1D\x0F");
+    constexpr std::string_view extendedKeyUsage = bytes("\x55\x1D\x25");
+
+    constexpr std::string_view rsaEncryption = bytes("\x2A\x86\x48\x86\xF7\x0D\x01\x01\x01");
+    constexpr std::string_view rsaPss = bytes("\x2A\x86\x48\x86\xF7\x0D\x01\x01\x0A");
+    constexpr std::string_view ecPublicKey = bytes("\x2A\x86\x48\xCE\x3D\x02\x01");
+    constexpr std::string_view ed25519 = bytes("\x2B\x65\x70");
+    constexpr std::string_view ed448 = bytes("\x2B\x65\x71");
+    constexpr std::string_view p256 = bytes("\x2A\x86\x48\xCE\x3D\x03\x01\x07");
+    constexpr std::string_view p384 = bytes("\x2B\x81\x04\x00\x22");
+    constexpr std::string_view p521 = bytes("\x2B\x81\x04\x00\x23");
+
+    constexpr std::string_view clientAuth = bytes("\x2B\x06\x01\x05\x05\x07\x03\x02");
+    constexpr std::string_view codeSigning = bytes("\x2B\x06\x01\x05\x05\x07\x03\x03");
+    constexpr std::string_view emailProtection = bytes("\x2B\x06\x01\x05\x05\x07\x03\x04");
+    constexpr std::string_view documentSigning = bytes("\x2B\x06\x01\x04\x01\x82\x37\x0A\x03\x0C");
+
+    /** Dotted form, e.g. "2.5.4.3"; empty if the encoding is malformed */
+    inline std::string toString(std::string_view oid) {
+        std::string result;
+        uint64_t value = 0;
+        bool first = true;
+        for (size_t i = 0; i < oid.size(); i++) {
+            uint8_t b = (uint8_t)oid[i];
+            if (value == 0 && b == 0x80) return "";  // non-minimal
+            if (value > (UINT64_MAX >> 7)) return "";
+            value = (value << 7) | (b & 0x7F);
+            if (b & 0x80) continue;
+            if (first) {
+                unsigned arc = value < 40 ? 0 : value < 80 ? 1 : 2;
+                result = std::to_string(arc) + "." + std::to_string(value - arc * 40);
+                first = false;
+            } else {
+                result += "." + std::to_string(value);
+            }
+            value = 0;
+        }
+        if (oid.empty() || ((uint8_t)oid.back() & 0x80)) return "";
+        return result;
+    }
+}
+
+/**
+ * DER tags used in certificates
+ */
+namespace Tag {
+    constexpr uint8_t BOOLEAN_VALUE = 0x01;
+    constexpr uint8_t INTEGER = 0x02;
+    constexpr uint8_t BIT_STRING = 0x03;
+    constexpr uint8_t OCTET_STRING = 0x04;
+    constexpr uint8_t NULL_VALUE = 0x05;
+    constexpr uint8_t OID = 0x06;
+    constexpr uint8_t UTF8_STRING = 0x0C;
+    constexpr uint8_t NUMERIC_STRING = 0x12;
+    constexpr uint8_t PRINTABLE_STRING = 0x13;
+    constexpr uint8_t TELETEX_STRING = 0x14;
+    constexpr uint8_t IA5_STRING = 0x16;
+    constexpr uint8_t UTC_TIME = 0x17;
+    constexpr uint8_t GENERALIZED_TIME = 0x18;
+    constexpr uint8_t VISIBLE_STRING = 0x1A;
+    constexpr uint8_t UNIVERSAL_STRING = 0x1C;
+    constexpr uint8_t BMP_STRING = 0x1E;
+    constexpr uint8_t SEQUENCE = 0x30;
+    constexpr uint8_t SET = 0x31;
+}
+
+/**
+ * Thrown for certificates that are not well-formed DER
+ */
+class ParseError : public std::runtime_error {
+public:
+    explicit ParseError(const std::string& message) : std::runtime_error("Invalid certificate: " + message) {}
+};
+
+/**
+ * One TLV element; views point into the parsed buffer
+ */
+struct Element {
+    uint8_t tag = 0;
+    std::string_view contents;
+    std::string_view encoded;  // tag, length and contents
+};
+
+/**
+ * Sequential reader over DER elements
+ * Only definite lengths and low tag numbers, which is all X.509 uses.
+ */
+class Reader {
+private:
+    const uint8_t* position;
+    const uint8_t* end;
+
+public:
+    explicit Reader(std::string_view der)
+        : position((const uint8_t*)der.data())
+        , end((const uint8_t*)der.data() + der.size()) {
+    }
+
+    bool atEnd() const { return position == end; }
+
+    bool peek(uint8_t tag) const { return position < end && *position == tag; }
+
+    Element read() {
+        const uint8_t* start = position;
+        if (end - position < 2) throw ParseError("truncated element");
+        uint8_t tag = *position++;
+        if ((tag & 0x1F) == 0x1F) throw ParseError("unsupported tag");
+
+        size_t length = *position++;
+        if (length & 0x80) {
+            size_t count = length & 0x7F;
+            if (count == 0) throw ParseError("indefinite length");
+            if (count > 4) throw ParseError("length too large");
+            if ((size_t)(end - position) < count) throw ParseError("truncated length");
+            length = 0;
+            for (size_t i = 0; i < count; i++) {
+                length = (length << 8) | *position++;
+            }
+            if (length < 0x80 || (length >> ((count - 1) * 8)) == 0) throw ParseError("non-minimal length");
+        }
+        if ((size_t)(end - position) < length) throw ParseError("truncated contents");
+
+        Element element;
+        element.tag = tag;
+        element.contents = std::string_view((const char*)position, length);
+        position += length;
+        element.encoded = std::string_view((const char*)start, (size_t)(position - start));
+        return element;
+    }
+
+    Element read(uint8_t tag) {
+        if (!peek(tag)) throw ParseError("unexpected tag");
+        return read();
+    }
+
+    /** Read the next element if it has the given tag */
+    bool readOptional(uint8_t tag, Element& element) {
+        if (!peek(tag)) return false;
+        element = read();
+        return true;
+    }
+};
+
+/**
+ * Name attribute (AttributeTypeAndValue)
+ */
+struct Attribute {
+    std::string_view type;   // encoded OID
+    uint8_t tag = 0;         // string type of the value
+    std::string_view value;  // value contents, in the encoding given by tag
+    size_t rdn = 0;          // attributes with the same index form one multi-valued RDN
+
+    /**
+     * Value as UTF-8. Returns a view of the certificate for UTF-8 and ASCII
+     * string types and converts the others into scratch.
+     */
+    std::string_view text(std::string& scratch) const {
+        switch (tag) {
+            case Tag::UTF8_STRING:
+            case Tag::PRINTABLE_STRING:
+            case Tag::IA5_STRING:
+            case Tag::NUMERIC_STRING:
+            case Tag::VISIBLE_STRING:
+                return value;
+            case Tag::TELETEX_STRING:
+                // Treated as Latin-1, like most implementations
+                scratch.clear();
+                for (char c : value) appendUtf8(scratch, (uint8_t)c);
+                return scratch;
+            case Tag::BMP_STRING:
+                scratch.clear();
+                for (size_t i = 0; i + 1 < value.size(); i += 2) {
+                    uint32_t unit = ((uint32_t)(uint8_t)value[i] << 8) | (uint8_t)value[i + 1];
+                    if (unit >= 0xD800 && unit <= 0xDBFF && i + 3 < value.size()) {
+                        uint32_t low = ((uint32_t)(uint8_t)value[i + 2] << 8) | (uint8_t)value[i + 3];
+                        if (low >= 0xDC00 && low <= 0xDFFF) {
+                            appendUtf8(scratch, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                            i += 2;
+                            continue;
+                        }
+                    }
+                    appendUtf8(scratch, unit);
+                }
+                return scratch;
+            case Tag::UNIVERSAL_STRING:
+                scratch.clear();
+                for (size_t i = 0; i + 3 < value.size(); i += 4) {
+                    appendUtf8(scratch, ((uint32_t)(uint8_t)value[i] << 24) | ((uint32_t)(uint8_t)value[i + 1] << 16) |
+                                        ((uint32_t)(uint8_t)value[i + 2] << 8) | (uint8_t)value[i + 3]);
+                }
+                return scratch;
+            default:
+                // Not a string: hex of the whole value, as in "#0403..." RFC 4514 form
+                scratch = "#";
+                scratch += hexTag(tag);
+                scratch += hexLength(value.size());
+                for (char c : value) scratch += hexTag((uint8_t)c);
+                return scratch;
+        }
+    }
+
+    std::string text() const {
+        std::string scratch;
+        return std::string(text(scratch));
+    }
+
+private:
+    static void appendUtf8(std::string& out, uint32_t cp) {
+        if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF) cp = 0xFFFD;
+        if (cp < 0x80) {
+            out += (char)cp;
+        } else if (cp < 0x800) {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    static std::string hexTag(uint8_t b) {
+        static const char digits[] = "0123456789ABCDEF";
+        return std::string{ digits[b >> 4], digits[b & 0x0F] };
+    }
+
+    static std::string hexLength(size_t length) {
+        if (length < 0x80) return hexTag((uint8_t)length);
+        std::string encoded;
+        size_t count = 0;
+        for (size_t l = length; l > 0; l >>= 8) count++;
+        encoded = hexTag((uint8_t)(0x80 | count));
+        for (size_t i = count; i > 0; i--) encoded += hexTag((uint8_t)(length >> ((i - 1) * 8)));
+        return encoded;
+    }
+};
+
+/**
+ * Distinguished name with its attributes in encoding order
+ */
+struct Name {
+    static constexpr size_t MAX_ATTRIBUTES = 32;
+
+    std::string_view der;  // the encoded Name
+    Attribute attributes[MAX_ATTRIBUTES];
+    size_t count = 0;
+
+    /** First attribute of the given type, or nullptr */
+    const Attribute* find(std::string_view type) const {
+        for (size_t i = 0; i < count; i++) {
+            if (attributes[i].type == type) return &attributes[i];
+        }
+        return nullptr;
+    }
+
+    /** Text of the first attribute of the given type, empty if absent */
+    std::string get(std::string_view type) const {
+        const Attribute* attribute = find(type);
+        return attribute ? attribute->text() : std::string();
+    }
+
+    /**
+     * Display name picked the way CERT_NAME_SIMPLE_DISPLAY_TYPE does:
+     * the first of CN, OU, O and e-mail that is present
+     */
+    std::string simpleDisplayName() const {
+        static const std::string_view preference[] = {
+            Oid::commonName, Oid::organizationalUnit, Oid::organization, Oid::email
+        };
+        for (std::string_view type : preference) {
+            const Attribute* attribute = find(type);
+            if (attribute) return attribute->text();
+        }
+        return "";
+    }
+
+    /**
+     * X.500 string in CertNameToStr (CERT_X500_NAME_STR) form, encoding order:
+     * "C=SI, O=Company, CN=John Doe". Multi-valued RDNs are joined with " + ",
+     * and values with special characters are quoted.
+     */
+    std::string toString() const {
+        std::string result;
+        std::string scratch;
+        for (size_t i = 0; i < count; i++) {
+            const Attribute& attribute = attributes[i];
+            if (i > 0) result += attribute.rdn == attributes[i - 1].rdn ? " + " : ", ";
+            const char* label = typeLabel(attribute.type);
+            if (label) {
+                result += label;
+            } else {
+                result += "OID.";
+                result += Oid::toString(attribute.type);
+            }
+            result += '=';
+            appendQuoted(result, attribute.text(scratch));
+        }
+        return result;
+    }
+
+    static const char* typeLabel(std::string_view type) {
+        static const struct { std::string_view type; const char* label; } labels[] = {
+            { Oid::commonName, "CN" }, { Oid::surname, "SN" }, { Oid::serialNumber, "SERIALNUMBER" },
+            { Oid::country, "C" }, { Oid::locality, "L" }, { Oid::state, "S" }, { Oid::street, "STREET" },
+            { Oid::organization, "O" }, { Oid::organizationalUnit, "OU" }, { Oid::title, "T" },
+            { Oid::description, "Description" }, { Oid::postalCode, "PostalCode" }, { Oid::givenName, "G" },
+            { Oid::initials, "I" }, { Oid::email, "E" }, { Oid::domainComponent, "DC" }
+        };
+        for (const auto& entry : labels) {
+            if (entry.type == type) return entry.label;
+        }
+        return nullptr;
+    }
+
+private:
+    static void appendQuoted(std::string& out, std::string_view value) {
+        bool quote = value.empty() || value.front() == ' ' || value.back() == ' ' ||
+                     value.find_first_of(",+=\"\n<>#;") != std::string_view::npos;
+        if (!quote) {
+            out += value;
+            return;
+        }
+        out += '"';
+        for (char c : value) {
+            if (c == '"') out += '"';
+            out += c;
+        }
+        out += '"';
+    }
+};
+
+/**
+ * UTCTime or GeneralizedTime, always UTC
+ */
+struct Time {
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+
+    /** "2026-01-31T12:00:00.000Z" */
+    std::string toIso() const {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d.000Z",
+                 year, month, day, hour, minute, second);
+        return buffer;
+    }
+
+    /** "01/31/2026" */
+    std::string toShortDate() const {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%02d/%02d/%04d", month, day, year);
+        return buffer;
+    }
+
+    /** Current time from the system clock */
+    static Time now() {
+        long long seconds = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        long long days = seconds / 86400;
+        long long secondOfDay = seconds % 86400;
+
+        // Civil date from days since 1970-01-01 (proleptic Gregorian)
+        days += 719468;
+        long long era = days / 146097;
+        long long dayOfEra = days - era * 146097;
+        long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        long long monthIndex = (5 * dayOfYear + 2) / 153;
+
+        Time time;
+        time.day = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+        time.month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+        time.year = (int)(yearOfEra + era * 400 + (time.month <= 2 ? 1 : 0));
+        time.hour = (int)(secondOfDay / 3600);
+        time.minute = (int)(secondOfDay / 60 % 60);
+        time.second = (int)(secondOfDay % 60);
+        return time;
+    }
+
+    bool operator<(const Time& other) const {
+        const int a[] = { year, month, day, hour, minute, second };
+        const int b[] = { other.year, other.month, other.day, other.hour, other.minute, other.second };
+        for (int i = 0; i < 6; i++) {
+            if (a[i] != b[i]) return a[i] < b[i];
+        }
+        return false;
+    }
+};
+
+/**
+ * KeyUsage bits (RFC 5280 section 4.2.1.3)
+ */
+namespace KeyUsage {
+    constexpr uint16_t DIGITAL_SIGNATURE = 1 << 0;
+    constexpr uint16_t NON_REPUDIATION = 1 << 1;
+    constexpr uint16_t KEY_ENCIPHERMENT = 1 << 2;
+    constexpr uint16_t DATA_ENCIPHERMENT = 1 << 3;
+    constexpr uint16_t KEY_AGREEMENT = 1 << 4;
+    constexpr uint16_t KEY_CERT_SIGN = 1 << 5;
+    constexpr uint16_t CRL_SIGN = 1 << 6;
+    constexpr uint16_t ENCIPHER_ONLY = 1 << 7;
+    constexpr uint16_t DECIPHER_ONLY = 1 << 8;
+}
+
+enum class KeyAlgorithm { Unknown, Rsa, RsaPss, Ec, Ed25519, Ed448 };
+
+inline const char* keyAlgorithmName(KeyAlgorithm algorithm) {
+    switch (algorithm) {
+        case KeyAlgorithm::Rsa: return "RSA";
+        case KeyAlgorithm::RsaPss: return "RSA-PSS";
+        case KeyAlgorithm::Ec: return "EC";
+        case KeyAlgorithm::Ed25519: return "Ed25519";
+        case KeyAlgorithm::Ed448: return "Ed448";
+        default: return "unknown";
+    }
+}
+
+/**
+ * Metadata of one certificate
+ *
+ * Produced by a single pass over the DER encoding. All views point into the
+ * buffer passed to parse(), which must outlive the result; nothing is
+ * allocated.
+ */
+struct Certificate {
+    std::string_view der;
+    int version = 1;
+    std::string_view serialNumber;        // INTEGER contents, big-endian
+    std::string_view signatureAlgorithm;  // encoded OID
+    Name issuer;
+    Name subject;
+    Time notBefore;
+    Time notAfter;
+
+    KeyAlgorithm keyAlgorithm = KeyAlgorithm::Unknown;
+    std::string_view keyAlgorithmOid;
+    std::string_view curve;         // encoded named-curve OID for EC keys
+    std::string_view publicKey;     // subjectPublicKey bits
+    size_t keyBits = 0;             // RSA modulus or curve size; 0 if unknown
+
+    bool hasKeyUsage = false;
+    uint16_t keyUsage = 0;          // KeyUsage bits; meaningful if hasKeyUsage
+    std::string_view extendedKeyUsage;  // SEQUENCE OF OID contents; empty if absent
+
+    /** No extendedKeyUsage extension means any purpose */
+    bool allowsExtendedKeyUsage(std::string_view purpose) const {
+        if (extendedKeyUsage.empty()) return true;
+        Reader reader(extendedKeyUsage);
+        while (!reader.atEnd()) {
+            if (reader.read(Tag::OID).contents == purpose) return true;
+        }
+        return false;
+    }
+
+    bool allowsKeyUsage(uint16_t bits) const {
+        return !hasKeyUsage || (keyUsage & bits) == bits;
+    }
+};
+
+namespace Detail {
+
+inline int digits(std::string_view text, size_t offset, size_t count) {
+    int value = 0;
+    for (size_t i = offset; i < offset + count; i++) {
+        char c = text[i];
+        if (c < '0' || c > '9') throw ParseError("invalid time");
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+inline Time parseTime(const Element& element) {
+    std::string_view text = element.contents;
+    Time time;
+    size_t offset;
+    if (element.tag == Tag::UTC_TIME) {
+        if (text.size() != 13) throw ParseError("invalid time");
+        int yy = digits(text, 0, 2);
+        time.year = yy >= 50 ? 1900 + yy : 2000 + yy;
+        offset = 2;
+    } else if (element.tag == Tag::GENERALIZED_TIME) {
+        if (text.size() != 15) throw ParseError("invalid time");
+        time.year = digits(text, 0, 4);
+        offset = 4;
+    } else {
+        throw ParseError("invalid time");
+    }
+    time.month = digits(text, offset, 2);
+    time.day = digits(text, offset + 2, 2);
+    time.hour = digits(text, offset + 4, 2);
+    time.minute = digits(text, offset + 6, 2);
+    time.second = digits(text, offset + 8, 2);
+    if (text[offset + 10] != 'Z' || time.month < 1 || time.month > 12 || time.day < 1 || time.day > 31 ||
+        time.hour > 23 || time.minute > 59 || time.second > 59) {
+        throw ParseError("invalid time");
+    }
+    return time;
+}
+
+inline void parseName(const Element& element, Name& name) {
+    if (element.tag != Tag::SEQUENCE) throw ParseError("invalid name");
+    name.der = element.encoded;
+    name.count = 0;
+    Reader rdns(element.contents);
+    for (size_t rdn = 0; !rdns.atEnd(); rdn++) {
+        Reader set(rdns.read(Tag::SET).contents);
+        if (set.atEnd()) throw ParseError("empty RDN");
+        while (!set.atEnd()) {
+            Reader pair(set.read(Tag::SEQUENCE).contents);
+            if (name.count == Name::MAX_ATTRIBUTES) throw ParseError("too many name attributes");
+            Attribute& attribute = name.attributes[name.count++];
+            attribute.type = pair.read(Tag::OID).contents;
+            Element value = pair.read();
+            attribute.tag = value.tag;
+            attribute.value = value.contents;
+            attribute.rdn = rdn;
+            if (!pair.atEnd()) throw ParseError("invalid name attribute");
+        }
+    }
+}
+
+/** Significant bits of a big-endian unsigned INTEGER */
+inline size_t integerBits(std::string_view integer) {
+    size_t i = 0;
+    while (i < integer.size() && integer[i] == 0) i++;
+    if (i == integer.size()) return 0;
+    size_t bits = (integer.size() - i) * 8;
+    for (uint8_t top = (uint8_t)integer[i]; (top & 0x80) == 0; top <<= 1) bits--;
+    return bits;
+}
+
+inline void parsePublicKey(const Element& element, Certificate& cert) {
+    if (element.tag != Tag::SEQUENCE) throw ParseError("invalid public key");
+    Reader spki(element.contents);
+    Reader algorithm(spki.read(Tag::SEQUENCE).contents);
+    cert.keyAlgorithmOid = algorithm.read(Tag::OID).contents;
+    Element parameters;
+    bool hasParameters = !algorithm.atEnd();
+    if (hasParameters) parameters = algorithm.read();
+
+    std::string_view bits = spki.read(Tag::BIT_STRING).contents;
+    if (bits.empty() || bits[0] != 0) throw ParseError("invalid public key");
+    cert.publicKey = bits.substr(1);
+
+    if (cert.keyAlgorithmOid == Oid::rsaEncryption || cert.keyAlgorithmOid == Oid::rsaPss) {
+        cert.keyAlgorithm = cert.keyAlgorithmOid == Oid::rsaEncryption ? KeyAlgorithm::Rsa : KeyAlgorithm::RsaPss;
+        Reader outer(cert.publicKey);
+        Reader rsaKey(outer.read(Tag::SEQUENCE).contents);
+        cert.keyBits = integerBits(rsaKey.read(Tag::INTEGER).contents);
+    } else if (cert.keyAlgorithmOid == Oid::ecPublicKey) {
+        cert.keyAlgorithm = KeyAlgorithm::Ec;
+        if (hasParameters && parameters.tag == Tag::OID) cert.curve = parameters.contents;
+        if (cert.curve == Oid::p256) cert.keyBits = 256;
+        else if (cert.curve == Oid::p384) cert.keyBits = 384;
+        else if (cert.curve == Oid::p521) cert.keyBits = 521;
+        else if (cert.publicKey.size() > 1 && cert.publicKey[0] == 0x04) cert.keyBits = (cert.publicKey.size() - 1) / 2 * 8;
+    } else if (cert.keyAlgorithmOid == Oid::ed25519) {
+        cert.keyAlgorithm = KeyAlgorithm::Ed25519;
+        cert.keyBits = 256;
+    } else if (cert.keyAlgorithmOid == Oid::ed448) {
+        cert.keyAlgorithm = KeyAlgorithm::Ed448;
+        cert.keyBits = 456;
+    }
+}
+
+inline void parseExtensions(const Element& element, Certificate& cert) {
+    Reader explicitTag(element.contents);
+    Reader extensions(explicitTag.read(Tag::SEQUENCE).contents);
+    if (!explicitTag.atEnd()) throw ParseError("invalid extensions");
+    while (!extensions.atEnd()) {
+        Reader extension(extensions.read(Tag::SEQUENCE).contents);
+        std::string_view id = extension.read(Tag::OID).contents;
+        Element critical;
+        extension.readOptional(Tag::BOOLEAN_VALUE, critical);
+        std::string_view value = extension.read(Tag::OCTET_STRING).contents;
+        if (!extension.atEnd()) throw ParseError("invalid extension");
+
+        if (id == Oid::keyUsage) {
+            Reader reader(value);
+            std::string_view bits = reader.read(Tag::BIT_STRING).contents;
+            if (bits.empty() || (uint8_t)bits[0] > 7) throw ParseError("invalid key usage");
+            cert.hasKeyUsage = true;
+            cert.keyUsage = 0;
+            for (int bit = 0; bit < 9; bit++) {
+                size_t index = 1 + bit / 8;
+                if (index < bits.size() && ((uint8_t)bits[index] & (0x80 >> (bit % 8)))) {
+                    cert.keyUsage |= (uint16_t)(1 << bit);
+                }
+            }
+        } else if (id == Oid::extendedKeyUsage) {
+            Reader reader(value);
+            cert.extendedKeyUsage = reader.read(Tag::SEQUENCE).contents;
+            // Validate up front so allowsExtendedKeyUsage() cannot throw
+            Reader purposes(cert.extendedKeyUsage);
+            if (purposes.atEnd()) throw ParseError("empty extended key usage");
+            while (!purposes.atEnd()) purposes.read(Tag::OID);
+        }
+    }
+}
+
+} // namespace Detail
+
+/**
+ * Parse certificate metadata from DER; throws ParseError if malformed
+ */
+inline void parse(std::string_view der, Certificate& cert) {
+    cert = Certificate();
+    cert.der = der;
+
+    Reader outer(der);
+    Element certificate = outer.read(Tag::SEQUENCE);
+    if (!outer.atEnd()) throw ParseError("trailing data");
+
+    Reader body(certificate.contents);
+    Reader tbs(body.read(Tag::SEQUENCE).contents);
+    Reader signatureAlgorithm(body.read(Tag::SEQUENCE).contents);
+    cert.signatureAlgorithm = signatureAlgorithm.read(Tag::OID).contents;
+    body.read(Tag::BIT_STRING);
+    if (!body.atEnd()) throw ParseError("trailing data");
+
+    Element element;
+    if (tbs.readOptional(0xA0, element)) {
+        Reader version(element.contents);
+        std::string_view number = version.read(Tag::INTEGER).contents;
+        if (number.size() != 1 || (uint8_t)number[0] > 2) throw ParseError("unsupported version");
+        cert.version = number[0] + 1;
+    }
+    cert.serialNumber = tbs.read(Tag::INTEGER).contents;
+    tbs.read(Tag::SEQUENCE);  // signature algorithm, repeated
+    Detail::parseName(tbs.read(), cert.issuer);
+
+    Reader validity(tbs.read(Tag::SEQUENCE).contents);
+    cert.notBefore = Detail::parseTime(validity.read());
+    cert.notAfter = Detail::parseTime(validity.read());
+    if (!validity.atEnd()) throw ParseError("invalid validity");
+
+    Detail::parseName(tbs.read(), cert.subject);
+    Detail::parsePublicKey(tbs.read(), cert);
+
+    tbs.readOptional(0x81, element);  // issuerUniqueID
+    tbs.readOptional(0x82, element);  // subjectUniqueID
+    if (tbs.readOptional(0xA3, element)) {
+        Detail::parseExtensions(element, cert);
+    }
+    if (!tbs.atEnd()) throw ParseError("trailing data");
+}
+
+} // namespace Der
+} // namespace ArhintSigner
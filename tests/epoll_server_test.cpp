@@ -0,0 +1,255 @@
+/**
+ * Epoll HTTP server connection handling (src/include/epoll_server.h)
+ *
+ * Starts the server on a free port with a handler that echoes the request
+ * path and talks to it over plain sockets. A client that sends a request
+ * and then shuts down its side of the connection (shutdown(SHUT_WR), as
+ * "curl --http1.0" or a scripted "printf ... | nc -N" do) must still get
+ * the answer to everything it sent, pipelined requests included, and then
+ * see the connection closed. A request cut short by the shutdown gets no
+ * answer but must not leave the connection open. Each case is repeated
+ * many times, since the request and the end of input often arrive at the
+ * reactor in the same read.
+ *
+ * Paths under /worker/ are not served inline and run on the request
+ * workers. With a single reactor, a request to one that is still being
+ * handled must not hold up requests on other connections. A request
+ * pipelined behind a slow one must report, through Exchange::arrival(),
+ * that it has waited since its bytes were read, not since dispatch. The
+ * server has one request worker, and requests whose handler suspends the
+ * exchange and is answered later from another thread must not hold it:
+ * several of them are answered together.
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "epoll_server.h"
+
+std::atomic<bool> g_running(true);
+
+using namespace ArhintSigner;
+
+namespace {
+
+constexpr int ROUNDS = 200;
+constexpr int READ_TIMEOUT_MS = 5000;
+constexpr auto SLOW_HANDLER_TIME = std::chrono::milliseconds(500);
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+void echoPath(Http::Exchange& exchange) {
+    if (exchange.path() == "/worker/suspended" && exchange.suspend()) {
+        std::thread([&exchange]() {
+            std::this_thread::sleep_for(SLOW_HANDLER_TIME);
+            exchange.send(200, "text/plain", "resumed");
+            exchange.resume();
+        }).detach();
+        return;
+    }
+    if (exchange.path() == "/worker/slow") std::this_thread::sleep_for(SLOW_HANDLER_TIME);
+    if (exchange.path() == "/worker/waited") {
+        auto waited = std::chrono::steady_clock::now() - exchange.arrival();
+        exchange.send(200, "text/plain",
+                      std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(waited).count()));
+        return;
+    }
+    exchange.send(200, "text/plain", exchange.path());
+}
+
+bool servedInline(std::string_view method, std::string_view path) {
+    (void)method;
+    return path.rfind("/worker/", 0) != 0;
+}
+
+int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)port);
+    if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Everything the server sends until it closes the connection; "timeout" if it never does */
+std::string readUntilClosed(int fd) {
+    std::string received;
+    char buffer[4096];
+    while (true) {
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, READ_TIMEOUT_MS) <= 0) return "timeout";
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0) return received;
+        received.append(buffer, (size_t)count);
+    }
+}
+
+/** Send the requests, shut down the write side and collect the answers */
+std::string halfCloseExchange(int port, const std::string& requests) {
+    int fd = connectTo(port);
+    if (fd < 0) return "connect failed";
+    ::send(fd, requests.data(), requests.size(), MSG_NOSIGNAL);
+    ::shutdown(fd, SHUT_WR);
+    std::string received = readUntilClosed(fd);
+    close(fd);
+    return received;
+}
+
+size_t countOf(const std::string& text, const std::string& part) {
+    size_t count = 0;
+    for (size_t pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + part.size())) count++;
+    return count;
+}
+
+void checkHalfClose(int port) {
+    int answered = 0;
+    for (int i = 0; i < ROUNDS; i++) {
+        std::string received = halfCloseExchange(port, "GET /one HTTP/1.1\r\nHost: test\r\n\r\n");
+        if (received.rfind("HTTP/1.1 200", 0) == 0 && received.size() >= 4 &&
+            received.compare(received.size() - 4, 4, "/one") == 0) {
+            answered++;
+        }
+    }
+    check(answered == ROUNDS, "GET then SHUT_WR answered in " + std::to_string(answered) + " of " +
+                              std::to_string(ROUNDS) + " tries");
+}
+
+void checkPipelinedHalfClose(int port) {
+    int answered = 0;
+    for (int i = 0; i < ROUNDS; i++) {
+        std::string received = halfCloseExchange(port,
+            "GET /one HTTP/1.1\r\nHost: test\r\n\r\n"
+            "POST /worker/two HTTP/1.1\r\nHost: test\r\nContent-Length: 5\r\n\r\nhello"
+            "GET /three HTTP/1.1\r\nHost: test\r\n\r\n");
+        size_t one = received.find("/one");
+        size_t two = received.find("/worker/two");
+        size_t three = received.find("/three");
+        if (countOf(received, "HTTP/1.1 200") == 3 && one < two && two < three && three != std::string::npos) {
+            answered++;
+        }
+    }
+    check(answered == ROUNDS, "three pipelined requests then SHUT_WR answered in " + std::to_string(answered) +
+                              " of " + std::to_string(ROUNDS) + " tries");
+}
+
+void checkIncompleteHalfClose(int port) {
+    int closed = 0;
+    for (int i = 0; i < ROUNDS / 4; i++) {
+        // The second request's body never comes
+        std::string received = halfCloseExchange(port,
+            "GET /one HTTP/1.1\r\nHost: test\r\n\r\n"
+            "POST /two HTTP/1.1\r\nHost: test\r\nContent-Length: 100\r\n\r\nshort");
+        if (received != "timeout" && countOf(received, "HTTP/1.1 200") == 1 && received.find("/two") == std::string::npos) {
+            closed++;
+        }
+    }
+    check(closed == ROUNDS / 4, "incomplete request then SHUT_WR closed after the complete one in " +
+                                std::to_string(closed) + " of " + std::to_string(ROUNDS / 4) + " tries");
+}
+
+void checkWorkerDispatch(int port) {
+    using Clock = std::chrono::steady_clock;
+    int slow = connectTo(port);
+    std::string request = "GET /worker/slow HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+    ::send(slow, request.data(), request.size(), MSG_NOSIGNAL);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto start = Clock::now();
+    std::string fast = halfCloseExchange(port, "GET /fast HTTP/1.1\r\nHost: test\r\n\r\n");
+    auto fastTime = Clock::now() - start;
+    std::string slowResponse = readUntilClosed(slow);
+    auto slowTime = Clock::now() - start;
+    close(slow);
+
+    check(fast.find("/fast") != std::string::npos, "inline request answered while a worker is busy");
+    check(fastTime < SLOW_HANDLER_TIME / 2, "inline request waited " +
+          std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(fastTime).count()) +
+          " ms behind a request on a worker");
+    check(slowResponse.find("/worker/slow") != std::string::npos && slowTime >= SLOW_HANDLER_TIME / 2,
+          "request on a worker answered when its handler returned");
+}
+
+void checkArrival(int port) {
+    std::string received = halfCloseExchange(port,
+        "GET /worker/slow HTTP/1.1\r\nHost: test\r\n\r\n"
+        "GET /worker/waited HTTP/1.1\r\nHost: test\r\n\r\n");
+    size_t bodyStart = received.rfind("\r\n\r\n");
+    long long waitedMs = bodyStart == std::string::npos ? -1 : atoll(received.c_str() + bodyStart + 4);
+    check(countOf(received, "HTTP/1.1 200") == 2 &&
+          waitedMs >= std::chrono::duration_cast<std::chrono::milliseconds>(SLOW_HANDLER_TIME / 2).count(),
+          "request pipelined behind a slow one reported waiting " + std::to_string(waitedMs) + " ms");
+}
+
+void checkSuspended(int port) {
+    const int count = 6;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    std::vector<std::string> responses(count);
+    for (int i = 0; i < count; i++) {
+        clients.emplace_back([port, &responses, i]() {
+            responses[i] = halfCloseExchange(port, "GET /worker/suspended HTTP/1.1\r\nHost: test\r\n\r\n");
+        });
+    }
+    for (auto& client : clients) client.join();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    int resumed = 0;
+    for (const std::string& response : responses) {
+        if (response.rfind("HTTP/1.1 200", 0) == 0 && response.find("resumed") != std::string::npos) resumed++;
+    }
+    check(resumed == count, "suspended requests answered: " + std::to_string(resumed) + " of " + std::to_string(count));
+    check(elapsed < SLOW_HANDLER_TIME * 3, std::to_string(count) + " suspended requests on one request worker took " +
+          std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) + " ms");
+}
+
+} // namespace
+
+int main() {
+    Log::minimumLevel = Log::Level::Warn;
+
+    // One reactor and one request worker, so every connection shares them
+    Server::EpollHttpServer server(0, 1);
+    server.setRequestWorkers(1);
+    if (!server.initialize()) {
+        printf("FAILED: cannot listen on a free port\n");
+        return 1;
+    }
+    int port = server.getPort();
+    std::thread serving([&server]() { server.processRequests(echoPath, servedInline); });
+
+    checkHalfClose(port);
+    checkPipelinedHalfClose(port);
+    checkIncompleteHalfClose(port);
+    checkWorkerDispatch(port);
+    checkArrival(port);
+    checkSuspended(port);
+
+    g_running = false;
+    serving.join();
+    server.shutdown();
+
+    printf("Half-closed connections, worker dispatch, arrival times and suspended requests checked on port %d, "
+           "%d failures\n",
+           port, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+/**
+ * Key handle cache (Keys::KeyHandleCache in src/include/key_cache.h)
+ *
+ * Fills the cache from a fake key source that counts its loads and whose
+ * keys count their own destruction, standing in for platform handles that
+ * must be closed. A cached key is returned without loading it again until
+ * its TTL has passed, the least recently used key is evicted first when
+ * the cache is full, and a key dropped by the cache (for capacity, TTL,
+ * invalidation or lower limits) is released as soon as no caller holds it,
+ * but not while a caller still does. Failed loads are not cached.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "key_cache.h"
+
+using namespace ArhintSigner;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+/** Stands in for a platform key handle; counts the handles still open */
+struct FakeKey {
+    static int open;
+    std::string thumbprint;
+
+    explicit FakeKey(std::string thumbprint) : thumbprint(std::move(thumbprint)) { open++; }
+    ~FakeKey() { open--; }
+};
+
+int FakeKey::open = 0;
+
+using Cache = Keys::KeyHandleCache<FakeKey>;
+
+/** Key source that counts loads per thumbprint and fails for "missing" */
+struct FakeSource {
+    std::map<std::string, int> loads;
+
+    Cache::Loader loader() {
+        return [this](const std::string& thumbprint) {
+            loads[thumbprint]++;
+            if (thumbprint == "missing") throw std::runtime_error("key not found");
+            return std::make_shared<FakeKey>(thumbprint);
+        };
+    }
+
+    int total() const {
+        int sum = 0;
+        for (const auto& entry : loads) sum += entry.second;
+        return sum;
+    }
+};
+
+void checkHits() {
+    FakeSource source;
+    Cache cache(4, std::chrono::seconds(300));
+    auto first = cache.acquire("a", source.loader());
+    auto second = cache.acquire("a", source.loader());
+    cache.acquire("b", source.loader());
+    auto third = cache.acquire("a", source.loader());
+
+    check(first && first->thumbprint == "a", "hits: loader result returned");
+    check(first == second && first == third, "hits: cached key returned on later acquires");
+    check(source.loads["a"] == 1 && source.loads["b"] == 1, "hits: each key loaded once");
+    Keys::KeyCacheStats stats = cache.stats();
+    check(stats.hits == 2 && stats.misses == 2 && stats.size == 2 && stats.evictions == 0, "hits: stats");
+}
+
+void checkFailedLoad() {
+    FakeSource source;
+    Cache cache(4, std::chrono::seconds(300));
+    for (int i = 0; i < 2; i++) {
+        bool thrown = false;
+        try {
+            cache.acquire("missing", source.loader());
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        check(thrown, "failed load: loader error reaches the caller");
+    }
+    check(source.loads["missing"] == 2 && cache.stats().size == 0, "failed load: failure not cached");
+}
+
+void checkTtl() {
+    FakeSource source;
+    Cache cache(4, std::chrono::seconds(1));
+    std::weak_ptr<FakeKey> expired = cache.acquire("a", source.loader());
+    check(cache.acquire("a", source.loader()) == expired.lock(), "ttl: key cached within its TTL");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    auto reloaded = cache.acquire("a", source.loader());
+    check(source.loads["a"] == 2, "ttl: key loaded again after its TTL");
+    check(expired.expired(), "ttl: expired key released");
+    check(reloaded && reloaded->thumbprint == "a" && cache.stats().evictions == 1 && cache.stats().size == 1,
+          "ttl: reloaded key replaces the expired one");
+}
+
+void checkLruOrder() {
+    FakeSource source;
+    Cache cache(3, std::chrono::seconds(300));
+    cache.acquire("a", source.loader());
+    cache.acquire("b", source.loader());
+    cache.acquire("c", source.loader());
+    cache.acquire("a", source.loader());  // b is now the least recently used
+    cache.acquire("d", source.loader());  // evicts b
+    cache.acquire("e", source.loader());  // evicts c
+
+    int before = source.total();
+    cache.acquire("a", source.loader());
+    cache.acquire("d", source.loader());
+    cache.acquire("e", source.loader());
+    check(source.total() == before, "lru: recently used keys kept");
+
+    cache.acquire("b", source.loader());  // evicts a, the least recently used of a, d, e
+    check(source.loads["b"] == 2, "lru: least recently used key evicted first");
+    cache.acquire("d", source.loader());
+    cache.acquire("e", source.loader());
+    cache.acquire("a", source.loader());
+    check(source.loads["d"] == 1 && source.loads["e"] == 1 && source.loads["a"] == 2,
+          "lru: eviction follows use, not insertion order");
+
+    Keys::KeyCacheStats stats = cache.stats();
+    check(stats.size == 3 && stats.capacity == 3 && stats.evictions == 4, "lru: stats");
+}
+
+void checkRelease() {
+    FakeSource source;
+    {
+        Cache cache(2, std::chrono::seconds(300));
+        std::shared_ptr<FakeKey> held = cache.acquire("a", source.loader());
+        cache.acquire("b", source.loader());
+        cache.acquire("c", source.loader());  // evicts a while it is held
+        cache.acquire("d", source.loader());  // evicts b, held by no one
+        check(FakeKey::open == 3, "release: evicted key released, held one kept (" +
+                                  std::to_string(FakeKey::open) + " open)");
+        check(held->thumbprint == "a", "release: held key still usable after eviction");
+        held.reset();
+        check(FakeKey::open == 2, "release: evicted key released when its caller lets go");
+
+        cache.invalidate("c");
+        check(FakeKey::open == 1 && cache.stats().invalidations == 1, "release: invalidated key released");
+
+        cache.acquire("e", source.loader());
+        cache.retainOnly([](const std::string& thumbprint) { return thumbprint == "e"; });
+        check(FakeKey::open == 1 && cache.stats().size == 1, "release: keys dropped by retainOnly released");
+
+        cache.setLimits(0, std::chrono::seconds(300));
+        check(FakeKey::open == 0 && cache.stats().size == 0, "release: keys released when capacity drops to 0");
+
+        auto uncached = cache.acquire("f", source.loader());
+        check(uncached && cache.stats().size == 0, "release: capacity 0 loads without caching");
+        uncached.reset();
+        check(FakeKey::open == 0, "release: uncached key released by its caller");
+
+        cache.setLimits(2, std::chrono::seconds(300));
+        cache.acquire("g", source.loader());
+        cache.invalidateAll();
+        check(FakeKey::open == 0, "release: invalidateAll released every key");
+        cache.acquire("h", source.loader());
+    }
+    check(FakeKey::open == 0, "release: keys released with the cache");
+}
+
+} // namespace
+
+int main() {
+    checkHits();
+    checkFailedLoad();
+    checkTtl();
+    checkLruOrder();
+    checkRelease();
+    printf("Key cache hits, TTL expiry, LRU eviction and key release checked, %d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/**
+ * Merkle batch coalescing (Merkle::Coalescer in src/include/merkle.h)
+ *
+ * Drives a Coalescer whose root signer only counts its calls. Submissions
+ * must return without waiting for the batch window, however many there
+ * are, and all of them must be completed from one signed root with proofs
+ * that verify against it. A batch is sealed at maxItems hashes or when its
+ * window closes, a submission that does not fit starts the next batch
+ * instead of straddling two, keys are batched separately, and a failed
+ * root signature fails every submission in its batch. The blocking
+ * submit() used where a request cannot be suspended must give the same
+ * results.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "base64.h"
+#include "merkle.h"
+
+using namespace ArhintSigner;
+using Merkle::Digest;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr auto WINDOW = std::chrono::milliseconds(200);
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+Digest hashOf(size_t i) {
+    uint8_t bytes[2] = { (uint8_t)i, (uint8_t)(i >> 8) };
+    return Crypto::Sha256::hash(bytes, sizeof(bytes));
+}
+
+/** Completions collected from the coalescer thread */
+struct Results {
+    struct Entry {
+        bool ok = false;
+        std::string error;
+        Merkle::SignedBatch batch;
+        Clock::time_point completedAt;
+    };
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<Entry> entries;
+    size_t completed = 0;
+
+    explicit Results(size_t count) : entries(count) {}
+
+    Merkle::Coalescer::Completion slot(size_t index) {
+        return [this, index](const Merkle::SignedBatch* batch, const std::string& error) {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries[index].ok = batch != nullptr;
+            if (batch) entries[index].batch = *batch;
+            entries[index].error = error;
+            entries[index].completedAt = Clock::now();
+            completed++;
+            changed.notify_all();
+        };
+    }
+
+    bool waitAll() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, std::chrono::seconds(10), [this]() { return completed == entries.size(); });
+    }
+};
+
+struct CountingSigner {
+    std::atomic<int> calls{ 0 };
+    std::atomic<bool> fail{ false };
+
+    Merkle::Coalescer::RootSigner signer() {
+        return [this](const std::string& key, const Digest& root) {
+            calls++;
+            if (fail) throw std::runtime_error("token removed");
+            return key + ":" + Crypto::Base64::encode(root.data(), root.size());
+        };
+    }
+};
+
+/** Many submissions from one thread: none waits, all share one root */
+void checkOneWindow() {
+    CountingSigner counter;
+    Merkle::Coalescer coalescer(counter.signer(), 256, WINDOW);
+    const size_t count = 64;
+    Results results(count);
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        coalescer.submit("key", { hashOf(i) }, results.slot(i));
+    }
+    auto submitted = Clock::now() - start;
+    check(submitted < WINDOW / 2, "64 submissions waited for the batch window");
+    check(results.waitAll(), "one window: every submission completed");
+
+    bool sameRoot = true;
+    bool verified = true;
+    for (size_t i = 0; i < count; i++) {
+        const Results::Entry& entry = results.entries[i];
+        if (!entry.ok || entry.batch.treeSize != count || entry.batch.root != results.entries[0].batch.root ||
+            entry.batch.proofs.size() != 1) {
+            sameRoot = false;
+            continue;
+        }
+        Digest leaf = hashOf(i);
+        verified = verified && entry.batch.proofs[0].leafIndex == i &&
+                   Merkle::verifyInclusion(leaf.data(), leaf.size(), entry.batch.proofs[0], entry.batch.root);
+    }
+    check(sameRoot, "one window: 64 submissions in one tree of 64 leaves");
+    check(verified, "one window: every proof verifies against the signed root");
+    check(counter.calls == 1, "one window: root signed " + std::to_string(counter.calls.load()) + " times");
+    check(results.entries[0].completedAt - start >= WINDOW, "one window: batch signed before its window closed");
+
+    Merkle::CoalescerStats stats = coalescer.stats();
+    check(stats.submissions == count && stats.leaves == count && stats.batches == 1 && stats.fullBatches == 0,
+          "one window: stats");
+}
+
+/** maxItems seals batches early, and a submission never straddles two */
+void checkFullBatches() {
+    CountingSigner counter;
+    Merkle::Coalescer coalescer(counter.signer(), 10, std::chrono::seconds(5));
+    Results results(5);
+
+    auto start = Clock::now();
+    std::vector<Digest> three = { hashOf(100), hashOf(101), hashOf(102) };
+    coalescer.submit("key", three, results.slot(0));   // batch A: 3
+    coalescer.submit("key", three, results.slot(1));   // batch A: 6
+    coalescer.submit("key", three, results.slot(2));   // batch A: 9
+    coalescer.submit("key", three, results.slot(3));   // does not fit: A sealed, batch B: 3
+    std::vector<Digest> seven(7, hashOf(7));
+    coalescer.submit("key", seven, results.slot(4));   // batch B: 10, sealed when full
+    check(results.waitAll(), "full batches: every submission completed");
+
+    check(Clock::now() - start < std::chrono::seconds(2), "full batches waited for the window");
+    const auto& entries = results.entries;
+    check(entries[0].batch.treeSize == 9 && entries[2].batch.root == entries[0].batch.root,
+          "full batches: first batch holds the first three submissions");
+    check(entries[3].batch.treeSize == 10 && entries[4].batch.root == entries[3].batch.root &&
+          entries[3].batch.root != entries[0].batch.root, "full batches: the fourth submission starts the next batch");
+    check(entries[3].batch.proofs.size() == 3 && entries[3].batch.proofs[0].leafIndex == 0 &&
+          entries[4].batch.proofs.size() == 7 && entries[4].batch.proofs[0].leafIndex == 3,
+          "full batches: leaf indexes continue within the batch");
+    check(coalescer.stats().fullBatches == 2, "full batches: both batches counted as full");
+}
+
+/** Each key has its own batch and its own root signature */
+void checkKeys() {
+    CountingSigner counter;
+    Merkle::Coalescer coalescer(counter.signer(), 256, WINDOW);
+    Results results(4);
+    coalescer.submit("a", { hashOf(1) }, results.slot(0));
+    coalescer.submit("b", { hashOf(2) }, results.slot(1));
+    coalescer.submit("a", { hashOf(3) }, results.slot(2));
+    coalescer.submit("b", { hashOf(4) }, results.slot(3));
+    check(results.waitAll(), "keys: every submission completed");
+    check(counter.calls == 2, "keys: one root signature per key");
+    check(results.entries[0].batch.signature.rfind("a:", 0) == 0 && results.entries[0].batch.treeSize == 2 &&
+          results.entries[1].batch.signature.rfind("b:", 0) == 0 && results.entries[1].batch.treeSize == 2,
+          "keys: roots signed with their own key");
+}
+
+/** A failed root signature fails its whole batch, blocking callers included */
+void checkFailure() {
+    CountingSigner counter;
+    counter.fail = true;
+    Merkle::Coalescer coalescer(counter.signer(), 256, std::chrono::milliseconds(20));
+    Results results(2);
+    coalescer.submit("key", { hashOf(1) }, results.slot(0));
+    coalescer.submit("key", { hashOf(2) }, results.slot(1));
+    check(results.waitAll(), "failure: every submission completed");
+    check(!results.entries[0].ok && !results.entries[1].ok && results.entries[1].error == "token removed",
+          "failure: submissions get the signer's error");
+
+    bool thrown = false;
+    try {
+        coalescer.submit("key", std::vector<Digest>{ hashOf(3) });
+    }
+    catch (const std::runtime_error& ex) {
+        thrown = std::string(ex.what()) == "token removed";
+    }
+    check(thrown, "failure: blocking submit throws the signer's error");
+    check(coalescer.stats().failedBatches == 2, "failure: failed batches counted");
+}
+
+/** Blocking submissions from several threads share a batch too */
+void checkBlocking() {
+    CountingSigner counter;
+    Merkle::Coalescer coalescer(counter.signer(), 256, WINDOW);
+    const size_t threadCount = 8;
+    std::vector<Merkle::SignedBatch> batches(threadCount);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back([&coalescer, &batches, i]() {
+            batches[i] = coalescer.submit("key", std::vector<Digest>{ hashOf(i), hashOf(i + 100) });
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    bool shared = true;
+    for (size_t i = 0; i < threadCount; i++) {
+        Digest leaf = hashOf(i + 100);
+        shared = shared && batches[i].treeSize == threadCount * 2 && batches[i].proofs.size() == 2 &&
+                 Merkle::verifyInclusion(leaf.data(), leaf.size(), batches[i].proofs[1], batches[i].root);
+    }
+    check(shared && counter.calls == 1, "blocking: 8 threads share one signed root");
+}
+
+} // namespace
+
+int main() {
+    Log::minimumLevel = Log::Level::Warn;
+    checkOneWindow();
+    checkFullBatches();
+    checkKeys();
+    checkFailure();
+    checkBlocking();
+    printf("Coalescer windows, full batches, keys, failures and blocking submissions checked, %d failures\n",
+           failures);
+    return failures == 0 ? 0 : 1;
+}
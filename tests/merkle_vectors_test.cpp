@@ -0,0 +1,188 @@
+/**
+ * Merkle tree and inclusion proof check (src/include/merkle.h)
+ *
+ * Checks Merkle::Tree and Merkle::verifyInclusion against the test vectors
+ * published in the README (/signMerkle), then against a direct recursive
+ * implementation of RFC 9162 section 2.1 (MTH and PATH) for every tree
+ * size up to MAX_LEAVES, odd sizes included. Every proof must verify, and
+ * a proof with the wrong index, a tree size that needs a different path, a
+ * changed, missing or extra path hash, or for a different leaf must be
+ * rejected.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "base64.h"
+#include "merkle.h"
+
+using namespace ArhintSigner;
+using Merkle::Digest;
+
+namespace {
+
+constexpr size_t MAX_LEAVES = 70;
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+std::string base64(const Digest& digest) {
+    return Crypto::Base64::encode(digest.data(), digest.size());
+}
+
+/** The README leaves: SHA-256 of the single byte i */
+std::vector<Digest> makeLeaves(size_t count) {
+    std::vector<Digest> leaves;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t byte = (uint8_t)i;
+        leaves.push_back(Crypto::Sha256::hash(&byte, 1));
+    }
+    return leaves;
+}
+
+/** Largest power of two smaller than n (n > 1) */
+size_t split(size_t n) {
+    size_t k = 1;
+    while (k * 2 < n) k *= 2;
+    return k;
+}
+
+/** MTH(D[begin:end]), RFC 9162 section 2.1.1 */
+Digest referenceRoot(const std::vector<Digest>& leaves, size_t begin, size_t end) {
+    if (end - begin == 1) return Merkle::leafHash(leaves[begin].data(), leaves[begin].size());
+    size_t k = split(end - begin);
+    return Merkle::nodeHash(referenceRoot(leaves, begin, begin + k), referenceRoot(leaves, begin + k, end));
+}
+
+/** PATH(m, D[begin:end]), RFC 9162 section 2.1.3.1, leaf level first */
+std::vector<Digest> referencePath(const std::vector<Digest>& leaves, size_t m, size_t begin, size_t end) {
+    if (end - begin == 1) return {};
+    size_t k = split(end - begin);
+    std::vector<Digest> path;
+    if (m < k) {
+        path = referencePath(leaves, m, begin, begin + k);
+        path.push_back(referenceRoot(leaves, begin + k, end));
+    } else {
+        path = referencePath(leaves, m - k, begin + k, end);
+        path.push_back(referenceRoot(leaves, begin, begin + k));
+    }
+    return path;
+}
+
+void checkReadme() {
+    const struct {
+        size_t leaves;
+        const char* root;
+    } roots[] = {
+        { 1, "2d4nYlRFAD2KlzmoUeP/jUHAaDYwtNY6iDJ6aqo3xAk=" },
+        { 2, "YE1UDwkmi5FnKrAROU1SZszX1EhNDRCUEaVYSBJqGyw=" },
+        { 5, "azE7YRtAZ2ueHf1wxFA/I3n4jw8cJ0D7fhyswywRNGU=" },
+    };
+    for (const auto& vector : roots) {
+        Merkle::Tree tree(makeLeaves(vector.leaves));
+        check(base64(tree.root()) == vector.root, "README root for " + std::to_string(vector.leaves) + " leaves");
+    }
+
+    const struct {
+        size_t index;
+        const char* hash;
+        std::vector<std::string> proof;
+    } proofs[] = {
+        { 0, "bjQLnP+zepicpUTmu3gKLHiQHT+zNzh2hRGjBhevoB0=",
+          { "nRhDwaJKZUo5/zRIcUvJ/mnaAXD6OQsaxnBHN3unLw4=", "Iud70QxFuScTwsOZnpMzTG60QJBcZcEgOoNhwqkfC4M=",
+            "EtJClxZP/d/Y/rvQInXDxf8kkW3HHV80dpMUgIVLMRM=" } },
+        { 2, "28G0yQD/5I1XW12lxjgEASX2XbD+PiRJS3bqmGRX2YY=",
+          { "NuSXDnyE5VntcpAwTDwGciiaaRjndG1IOXsOEi23dI8=", "YE1UDwkmi5FnKrAROU1SZszX1EhNDRCUEaVYSBJqGyw=",
+            "EtJClxZP/d/Y/rvQInXDxf8kkW3HHV80dpMUgIVLMRM=" } },
+        { 4, "5S2cUIxQI0c0TYwHrZHL1gaK/HX/YpLwYqCco4HInnE=",
+          { "DcwrZFwA36Izjhx6wsS1cL7aWkdtWINuVeKL3lXmvuE=" } },
+    };
+    std::vector<Digest> leaves = makeLeaves(5);
+    Merkle::Tree tree(leaves);
+    for (const auto& vector : proofs) {
+        std::string name = "README proof for index " + std::to_string(vector.index);
+        check(base64(leaves[vector.index]) == vector.hash, name + ": hash");
+
+        // Verify the published proof itself, decoded from base64
+        std::vector<uint8_t> hash;
+        check(Crypto::Base64::decode(vector.hash, hash) && hash.size() == 32, name + ": hash decodes");
+        Merkle::InclusionProof proof;
+        proof.leafIndex = vector.index;
+        proof.treeSize = 5;
+        for (const std::string& encoded : vector.proof) {
+            std::vector<uint8_t> bytes;
+            Digest digest{};
+            check(Crypto::Base64::decode(encoded, bytes) && bytes.size() == digest.size(), name + ": path decodes");
+            std::copy(bytes.begin(), bytes.begin() + std::min(bytes.size(), digest.size()), digest.begin());
+            proof.path.push_back(digest);
+        }
+        check(proof.path == tree.proof(vector.index).path, name + ": Tree::proof matches");
+        check(hash.size() == 32 && Merkle::verifyInclusion(hash.data(), hash.size(), proof, tree.root()),
+              name + ": verifyInclusion accepts it");
+    }
+}
+
+void checkRejected(const Digest& leaf, const Merkle::InclusionProof& proof, const Digest& root,
+                   const std::string& name) {
+    check(!Merkle::verifyInclusion(leaf.data(), leaf.size(), proof, root), name + " is rejected");
+}
+
+void checkSizes() {
+    for (size_t n = 1; n <= MAX_LEAVES; n++) {
+        std::vector<Digest> leaves = makeLeaves(n);
+        Merkle::Tree tree(leaves);
+        Digest root = referenceRoot(leaves, 0, n);
+        std::string size = std::to_string(n) + " leaves";
+        check(tree.root() == root, size + ": root matches MTH");
+
+        for (size_t m = 0; m < n; m++) {
+            std::string name = size + ", index " + std::to_string(m);
+            Merkle::InclusionProof proof = tree.proof(m);
+            check(proof.leafIndex == m && proof.treeSize == n, name + ": proof index and size");
+            check(proof.path == referencePath(leaves, m, 0, n), name + ": path matches PATH");
+            check(Merkle::verifyInclusion(leaves[m].data(), leaves[m].size(), proof, root), name + ": verifies");
+
+            Merkle::InclusionProof wrong = proof;
+            if (n > 1) {
+                wrong.leafIndex = (m + 1) % n;
+                checkRejected(leaves[m], wrong, root, name + ": wrong leafIndex");
+                checkRejected(leaves[(m + 1) % n], proof, root, name + ": another leaf");
+            }
+            // The tree size only decides the shape of the path: a leaf in a
+            // complete left subtree has the same path in a slightly larger
+            // tree, so use a size that needs one more level
+            wrong = proof;
+            wrong.treeSize = n * 2;
+            checkRejected(leaves[m], wrong, root, name + ": treeSize * 2");
+            wrong.treeSize = m;
+            checkRejected(leaves[m], wrong, root, name + ": treeSize <= leafIndex");
+            wrong = proof;
+            wrong.path.push_back(root);
+            checkRejected(leaves[m], wrong, root, name + ": extra path hash");
+            if (!proof.path.empty()) {
+                wrong = proof;
+                wrong.path.pop_back();
+                checkRejected(leaves[m], wrong, root, name + ": missing path hash");
+                wrong = proof;
+                wrong.path[m % wrong.path.size()][0] ^= 1;
+                checkRejected(leaves[m], wrong, root, name + ": changed path hash");
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    checkReadme();
+    checkSizes();
+    printf("README vectors and trees of 1..%zu leaves checked, %d failures\n", MAX_LEAVES, failures);
+    return failures == 0 ? 0 : 1;
+}
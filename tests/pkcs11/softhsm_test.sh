@@ -0,0 +1,32 @@
+#!/bin/sh
+# Runs pkcs11_softhsm_test against a throwaway SoftHSM2 token
+#
+# Usage: softhsm_test.sh <pkcs11_softhsm_test> <libsofthsm2.so>
+#
+# The token lives in a temporary directory (SOFTHSM2_CONF points there), so
+# the tokens of the machine are not touched. The keys in this directory are
+# test fixtures only.
+set -eu
+
+driver=$1
+module=$2
+fixtures=$(cd "$(dirname "$0")" && pwd)
+label=arhint-test
+pin=1234
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+mkdir "$work/tokens"
+cat > "$work/softhsm2.conf" <<CONF
+directories.tokendir = $work/tokens
+objectstore.backend = file
+log.level = ERROR
+CONF
+export SOFTHSM2_CONF="$work/softhsm2.conf"
+
+softhsm2-util --module "$module" --init-token --free --label "$label" --so-pin 0000 --pin "$pin" >/dev/null
+# Each import also stores the public key, which the driver verifies with
+softhsm2-util --module "$module" --import "$fixtures/rsa.key" --token "$label" --label rsa --id 01 --pin "$pin" >/dev/null
+softhsm2-util --module "$module" --import "$fixtures/ec.key" --token "$label" --label ec --id 02 --pin "$pin" >/dev/null
+
+"$driver" "$module" "$pin" "$fixtures"
@@ -0,0 +1,330 @@
+/**
+ * PKCS#11 key store check against SoftHSM2 (src/include/pkcs11_store.h)
+ *
+ * Usage: pkcs11_softhsm_test <module> <pin> <fixture dir>
+ *
+ * Run by pkcs11/softhsm_test.sh, which creates a throwaway SoftHSM2 token
+ * labelled TOKEN_LABEL and imports the fixture keys with softhsm2-util:
+ * rsa.key with CKA_ID 01 and ec.key (P-256) with CKA_ID 02, each with its
+ * public key. This program adds the matching certificates with
+ * C_CreateObject, loads the token through Pkcs11KeyStore and checks that:
+ *
+ * - a wrong PIN leaves the store empty;
+ * - THREADS threads signing at once share the slot's pool: more than one
+ *   session is opened but never more than SESSIONS, every session is back
+ *   in the pool afterwards, and every key handle comes from the cache;
+ * - signing keeps working while the pool is reset under load, and the
+ *   handle cache is rebuilt;
+ * - every signature verifies with the token's public key (C_Verify), and
+ *   RSA PKCS#1 v1.5 signatures equal those of the in-tree RSA signer.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pkcs11_store.h"
+#include "software_store.h"
+
+using namespace ArhintSigner;
+
+namespace {
+
+const char* const TOKEN_LABEL = "arhint-test";
+constexpr size_t SESSIONS = 4;
+constexpr int THREADS = 16;
+constexpr int SIGNATURES_PER_THREAD = 24;
+constexpr int RESETS = 5;
+
+std::atomic<int> failures(0);
+std::mutex outputMutex;
+
+void check(bool condition, const std::string& what) {
+    if (condition) return;
+    std::lock_guard<std::mutex> lock(outputMutex);
+    printf("FAILED: %s\n", what.c_str());
+    failures++;
+}
+
+/** Fixture certificate and key, as DER */
+struct Fixture {
+    std::string name;
+    std::string id;  // CKA_ID softhsm_test.sh imported the key with
+    std::string certificate;
+    std::string key;
+    std::string sha1;
+};
+
+std::string pemFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    for (Certificate::Detail::PemBlock& block : Certificate::Detail::parsePem(content.str())) {
+        return block.der;
+    }
+    throw std::runtime_error("No PEM block in " + path);
+}
+
+Fixture loadFixture(const std::string& dir, const std::string& name, char id) {
+    Fixture fixture;
+    fixture.name = name;
+    fixture.id = std::string(1, id);
+    fixture.certificate = pemFile(dir + "/" + name + ".crt");
+    fixture.key = pemFile(dir + "/" + name + ".key");
+    Crypto::Sha1::Digest sha1 = Crypto::Sha1::hash(fixture.certificate.data(), fixture.certificate.size());
+    fixture.sha1 = Utils::bytesToHex(sha1.data(), sha1.size());
+    return fixture;
+}
+
+/** Store the fixture certificates on the test token, next to their keys */
+void importCertificates(const std::string& modulePath, const std::string& pin, const std::vector<Fixture>& fixtures) {
+    Pkcs11::Module module(modulePath);
+    const Pkcs11::CK_FUNCTION_LIST& api = module.api();
+
+    Pkcs11::CK_ULONG count = 0;
+    std::vector<Pkcs11::CK_SLOT_ID> slots;
+    Pkcs11::CK_RV rv = api.C_GetSlotList(Pkcs11::CK_TRUE, nullptr, &count);
+    if (rv == Pkcs11::CKR_OK) {
+        slots.resize(count);
+        rv = api.C_GetSlotList(Pkcs11::CK_TRUE, slots.data(), &count);
+        slots.resize(count);
+    }
+    if (rv != Pkcs11::CKR_OK) throw Pkcs11::Error("C_GetSlotList", rv);
+
+    for (Pkcs11::CK_SLOT_ID slot : slots) {
+        Pkcs11::CK_TOKEN_INFO token = {};
+        if (api.C_GetTokenInfo(slot, &token) != Pkcs11::CKR_OK ||
+            Pkcs11::fieldText(token.label, sizeof(token.label)) != TOKEN_LABEL) {
+            continue;
+        }
+
+        Pkcs11::CK_SESSION_HANDLE session = 0;
+        rv = api.C_OpenSession(slot, Pkcs11::CKF_SERIAL_SESSION | Pkcs11::CKF_RW_SESSION, nullptr, nullptr, &session);
+        if (rv != Pkcs11::CKR_OK) throw Pkcs11::Error("C_OpenSession", rv);
+        rv = api.C_Login(session, Pkcs11::CKU_USER, (Pkcs11::CK_BYTE*)pin.data(), (Pkcs11::CK_ULONG)pin.size());
+        for (size_t i = 0; i < fixtures.size() && rv == Pkcs11::CKR_OK; i++) {
+            const Fixture& fixture = fixtures[i];
+            Der::Certificate parsed;
+            Der::parse(fixture.certificate, parsed);
+
+            Pkcs11::CK_OBJECT_CLASS certClass = Pkcs11::CKO_CERTIFICATE;
+            Pkcs11::CK_ULONG certType = Pkcs11::CKC_X_509;
+            Pkcs11::CK_BYTE onToken = Pkcs11::CK_TRUE;
+            Pkcs11::CK_ATTRIBUTE templ[] = {
+                { Pkcs11::CKA_CLASS, &certClass, sizeof(certClass) },
+                { Pkcs11::CKA_CERTIFICATE_TYPE, &certType, sizeof(certType) },
+                { Pkcs11::CKA_TOKEN, &onToken, sizeof(onToken) },
+                { Pkcs11::CKA_LABEL, (void*)fixture.name.data(), (Pkcs11::CK_ULONG)fixture.name.size() },
+                { Pkcs11::CKA_ID, (void*)fixture.id.data(), (Pkcs11::CK_ULONG)fixture.id.size() },
+                { Pkcs11::CKA_SUBJECT, (void*)parsed.subject.der.data(), (Pkcs11::CK_ULONG)parsed.subject.der.size() },
+                { Pkcs11::CKA_VALUE, (void*)fixture.certificate.data(), (Pkcs11::CK_ULONG)fixture.certificate.size() },
+            };
+            Pkcs11::CK_OBJECT_HANDLE object = 0;
+            rv = api.C_CreateObject(session, templ, sizeof(templ) / sizeof(templ[0]), &object);
+        }
+        api.C_CloseSession(session);
+        if (rv != Pkcs11::CKR_OK) throw Pkcs11::Error("C_CreateObject", rv);
+        return;
+    }
+    throw std::runtime_error(std::string("No token labelled ") + TOKEN_LABEL);
+}
+
+/** Key and signature algorithm one signing thread uses */
+struct Job {
+    const Fixture* fixture;
+    Keys::CertificatePtr certificate;
+    std::shared_ptr<Keys::SigningKey> key;
+    const Crypto::SignatureAlgorithm* algorithm;
+};
+
+struct Signed {
+    const Job* job;
+    Crypto::Sha256::Digest hash;
+    std::vector<uint8_t> signature;
+};
+
+/**
+ * THREADS threads each sign SIGNATURES_PER_THREAD distinct hashes, cycling
+ * through the jobs; during() runs on its own thread at the same time
+ */
+std::vector<Signed> signConcurrently(const std::vector<Job>& jobs, const std::function<void()>& during) {
+    std::vector<std::vector<Signed>> perThread(THREADS);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&jobs, &perThread, t]() {
+            for (int i = 0; i < SIGNATURES_PER_THREAD; i++) {
+                Signed result;
+                result.job = &jobs[(size_t)(t + i) % jobs.size()];
+                int seed[2] = { t, i };
+                result.hash = Crypto::Sha256::hash(seed, sizeof(seed));
+                uint8_t signature[512];
+                try {
+                    size_t length = result.job->key->sign(*result.job->algorithm, result.hash.data(),
+                                                          result.hash.size(), signature, sizeof(signature));
+                    result.signature.assign(signature, signature + length);
+                    perThread[t].push_back(std::move(result));
+                }
+                catch (const std::exception& e) {
+                    check(false, std::string(result.job->algorithm->name) + " signature: " + e.what());
+                }
+            }
+        });
+    }
+    std::thread other(during);
+    for (auto& thread : threads) thread.join();
+    other.join();
+
+    std::vector<Signed> all;
+    for (auto& results : perThread) {
+        for (auto& result : results) all.push_back(std::move(result));
+    }
+    return all;
+}
+
+/** Check a signature with the public key the token holds for the job's CKA_ID */
+bool verifyOnToken(const Signed& result) {
+    const auto& token = static_cast<const Certificate::Pkcs11Certificate&>(*result.job->certificate);
+    const Pkcs11::CK_FUNCTION_LIST& api = token.slot->api();
+    Certificate::Pkcs11Slot::Lease lease = token.slot->lease();
+
+    Pkcs11::CK_OBJECT_CLASS keyClass = Pkcs11::CKO_PUBLIC_KEY;
+    Pkcs11::CK_ATTRIBUTE templ[] = {
+        { Pkcs11::CKA_CLASS, &keyClass, sizeof(keyClass) },
+        { Pkcs11::CKA_ID, (void*)token.id.data(), (Pkcs11::CK_ULONG)token.id.size() },
+    };
+    std::vector<Pkcs11::CK_OBJECT_HANDLE> keys = Certificate::Detail::findObjects(api, lease.session(), templ, 2);
+    if (keys.empty()) throw std::runtime_error("No public key for " + result.job->fixture->name);
+
+    // The same mechanisms Pkcs11Key signs with: CKM_RSA_PKCS over DigestInfo || hash, the others over the hash
+    const Crypto::SignatureAlgorithm& algorithm = *result.job->algorithm;
+    std::string data((const char*)result.hash.data(), result.hash.size());
+    Pkcs11::CK_RSA_PKCS_PSS_PARAMS pss = Certificate::Pkcs11Key::pssParams(algorithm.hashInfo());
+    Pkcs11::CK_MECHANISM mechanism = { Pkcs11::CKM_ECDSA, nullptr, 0 };
+    if (algorithm.scheme == Crypto::Scheme::RsaPkcs1) {
+        mechanism.mechanism = Pkcs11::CKM_RSA_PKCS;
+        data.insert(0, algorithm.hashInfo().digestInfo);
+    } else if (algorithm.scheme == Crypto::Scheme::RsaPss) {
+        mechanism = { Pkcs11::CKM_RSA_PKCS_PSS, &pss, sizeof(pss) };
+    }
+
+    Pkcs11::CK_RV rv = api.C_VerifyInit(lease.session(), &mechanism, keys.front());
+    if (rv != Pkcs11::CKR_OK) throw Pkcs11::Error("C_VerifyInit", rv);
+    rv = api.C_Verify(lease.session(), (Pkcs11::CK_BYTE*)&data[0], (Pkcs11::CK_ULONG)data.size(),
+                      (Pkcs11::CK_BYTE*)result.signature.data(), (Pkcs11::CK_ULONG)result.signature.size());
+    return rv == Pkcs11::CKR_OK;
+}
+
+void verifyAll(const std::vector<Signed>& results, const Crypto::Rsa::PrivateKey& rsaKey, const char* phase) {
+    check(results.size() == (size_t)(THREADS * SIGNATURES_PER_THREAD), std::string(phase) + ": every signature made");
+    size_t verified = 0;
+    for (const Signed& result : results) {
+        const char* name = result.job->algorithm->name;
+        if (result.job->algorithm->scheme == Crypto::Scheme::RsaPkcs1) {
+            uint8_t expected[512];
+            size_t length = rsaKey.signPkcs1(result.hash.data(), result.hash.size(), expected, sizeof(expected));
+            check(result.signature == std::vector<uint8_t>(expected, expected + length),
+                  std::string(phase) + ": " + name + " equals the in-tree signature");
+        }
+        try {
+            bool valid = verifyOnToken(result);
+            check(valid, std::string(phase) + ": " + name + " verifies on the token");
+            if (valid) verified++;
+        }
+        catch (const std::exception& e) {
+            check(false, std::string(phase) + ": " + name + " verification: " + e.what());
+        }
+    }
+    printf("%s: %zu signatures, %zu verified\n", phase, results.size(), verified);
+}
+
+void printStats(const char* phase, const Certificate::SlotStats& stats) {
+    printf("%s: capacity %zu, open %zu, idle %zu, opened %llu, resets %llu, handle hits %llu, misses %llu\n", phase,
+           stats.capacity, stats.open, stats.idle, (unsigned long long)stats.sessionsOpened,
+           (unsigned long long)stats.resets, (unsigned long long)stats.handleHits,
+           (unsigned long long)stats.handleMisses);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <module> <pin> <fixture dir>\n", argv[0]);
+        return 2;
+    }
+    std::string modulePath = argv[1];
+    std::string pin = argv[2];
+    std::string dir = argv[3];
+    Log::minimumLevel = Log::Level::Warn;
+
+    try {
+        std::vector<Fixture> fixtures = { loadFixture(dir, "rsa", '\x01'), loadFixture(dir, "ec", '\x02') };
+        std::unique_ptr<Crypto::Rsa::PrivateKey> rsaKey = Crypto::Rsa::PrivateKey::fromDer(fixtures[0].key);
+        importCertificates(modulePath, pin, fixtures);
+
+        // Before the real store: login is per application, so a logged-in store would hide a wrong PIN
+        {
+            Certificate::Pkcs11KeyStore wrongPin(modulePath, pin + "0", SESSIONS);
+            check(!wrongPin.findByThumbprint(fixtures[0].sha1), "a wrong PIN lists no certificates");
+        }
+
+        Certificate::Pkcs11KeyStore store(modulePath, pin, SESSIONS);
+        std::vector<Job> jobs;
+        for (const Fixture& fixture : fixtures) {
+            Keys::CertificatePtr certificate = store.findByThumbprint(fixture.sha1);
+            if (!certificate) throw std::runtime_error("Certificate " + fixture.name + " not listed");
+            std::shared_ptr<Keys::SigningKey> key = store.loadKey(*certificate);
+            if (certificate->keyAlgorithm == Der::KeyAlgorithm::Ec) {
+                jobs.push_back({ &fixture, certificate, key, Crypto::findSignatureAlgorithm(
+                    Crypto::KeyType::EcP256, Crypto::Scheme::Ecdsa, Crypto::HashAlgorithm::Sha256) });
+            } else {
+                for (Crypto::Scheme scheme : { Crypto::Scheme::RsaPkcs1, Crypto::Scheme::RsaPss }) {
+                    jobs.push_back({ &fixture, certificate, key, Crypto::findSignatureAlgorithm(
+                        Crypto::KeyType::Rsa, scheme, Crypto::HashAlgorithm::Sha256) });
+                }
+            }
+        }
+        const auto& slot = static_cast<const Certificate::Pkcs11Certificate&>(*jobs.front().certificate).slot;
+        check(slot->sessionCapacity() == SESSIONS, "the pool holds --pkcs11-sessions sessions");
+
+        // Concurrent signing on the pool; both keys were found at startup
+        std::vector<Signed> results = signConcurrently(jobs, []() {});
+        Certificate::SlotStats stats = slot->stats();
+        printStats("concurrent", stats);
+        check(stats.sessionsOpened > 1, "concurrent signatures run on more than one session");
+        check(stats.sessionsOpened <= SESSIONS && stats.open <= SESSIONS, "never more than SESSIONS sessions");
+        check(stats.idle == stats.open, "every session is back in the pool");
+        check(stats.handleMisses == 0, "key handles cached at startup");
+        check(stats.handleHits == (uint64_t)(THREADS * SIGNATURES_PER_THREAD), "every signature used a cached handle");
+        verifyAll(results, *rsaKey, "concurrent");
+
+        // Reset the pool while signatures are running, as when a token is reinserted
+        results = signConcurrently(jobs, [&slot]() {
+            for (int i = 0; i < RESETS; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                slot->reset();
+            }
+        });
+        uint8_t signature[512];
+        Crypto::Sha256::Digest hash = Crypto::Sha256::hash("after reset", 11);
+        jobs.front().key->sign(*jobs.front().algorithm, hash.data(), hash.size(), signature, sizeof(signature));
+        stats = slot->stats();
+        printStats("reset", stats);
+        check(stats.resets == (uint64_t)RESETS, "every reset counted");
+        check(stats.handleMisses > 0, "key handles found again after a reset");
+        check(stats.open <= SESSIONS && stats.idle == stats.open, "pool consistent after resets");
+        verifyAll(results, *rsaKey, "reset");
+    }
+    catch (const std::exception& e) {
+        printf("FAILED: %s\n", e.what());
+        return 1;
+    }
+
+    printf("%d failures\n", failures.load());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+/**
+ * DER certificate corpus check for Der::parse() (src/include/x509.h)
+ *
+ * Usage: x509_corpus_test <dir> [--print]
+ *
+ * <dir>/expected.txt lists one certificate per line: the file name and the
+ * fields the parser extracted, tab separated, or "error" for files in
+ * <dir>/invalid that must be rejected with Der::ParseError. Every .der file
+ * under <dir>/corpus and <dir>/invalid must be listed. The expectations were
+ * cross-checked against OpenSSL; --print writes the current results in the
+ * same format, to review and replace expected.txt after a deliberate change.
+ *
+ * Afterwards the valid certificates are mutated (bytes replaced, bits
+ * flipped, truncated, inserted, removed) with a fixed seed: the parser
+ * must either accept a mutant or throw Der::ParseError, never crash or
+ * throw anything else. Run it under ASan/UBSan to catch overreads.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "x509.h"
+
+using namespace ArhintSigner;
+
+namespace {
+
+constexpr int MUTATIONS = 20000;
+
+std::string readFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+std::string describe(const Der::Certificate& cert) {
+    std::string keyUsage = "-";
+    if (cert.hasKeyUsage) {
+        char hex[8];
+        snprintf(hex, sizeof(hex), "0x%03x", cert.keyUsage);
+        keyUsage = hex;
+    }
+
+    std::string extendedKeyUsage;
+    Der::Reader purposes(cert.extendedKeyUsage);
+    while (!purposes.atEnd()) {
+        if (!extendedKeyUsage.empty()) extendedKeyUsage += ',';
+        extendedKeyUsage += Der::Oid::toString(purposes.read(Der::Tag::OID).contents);
+    }
+    if (extendedKeyUsage.empty()) extendedKeyUsage = "-";
+
+    return "v" + std::to_string(cert.version) + "\t" + Der::keyAlgorithmName(cert.keyAlgorithm) + "\t" +
+           std::to_string(cert.keyBits) + "\tku=" + keyUsage + "\teku=" + extendedKeyUsage + "\t" +
+           cert.notBefore.toIso() + "\t" + cert.notAfter.toIso() + "\t" +
+           cert.subject.toString() + "\t" + cert.issuer.toString();
+}
+
+/** Parse result of one file: its description, or "error" when rejected */
+std::string result(const std::string& der) {
+    Der::Certificate cert;
+    try {
+        Der::parse(der, cert);
+    }
+    catch (const Der::ParseError&) {
+        return "error";
+    }
+    return describe(cert);
+}
+
+std::map<std::string, std::string> loadExpected(const std::filesystem::path& path) {
+    std::map<std::string, std::string> expected;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) continue;
+        expected[line.substr(0, tab)] = line.substr(tab + 1);
+    }
+    return expected;
+}
+
+/** Mutate the valid certificates; returns the number of unexpected exceptions */
+int mutate(const std::vector<std::string>& corpus) {
+    std::mt19937 random(20251016);
+    int failures = 0;
+    size_t accepted = 0;
+    for (int i = 0; i < MUTATIONS; i++) {
+        std::string mutant = corpus[random() % corpus.size()];
+        int edits = 1 + (int)(random() % 4);
+        for (int edit = 0; edit < edits && !mutant.empty(); edit++) {
+            size_t position = random() % mutant.size();
+            switch (random() % 5) {
+                case 0: mutant[position] = (char)random(); break;
+                case 1: mutant[position] ^= (char)(1 << (random() % 8)); break;
+                case 2: mutant.resize(position); break;
+                case 3: mutant.insert(position, 1, (char)random()); break;
+                default: mutant.erase(position, 1 + random() % 8); break;
+            }
+        }
+
+        // Exactly sized heap copy, so a sanitizer sees any read past the end
+        std::vector<char> buffer(mutant.begin(), mutant.end());
+        Der::Certificate cert;
+        try {
+            Der::parse(std::string_view(buffer.data(), buffer.size()), cert);
+            describe(cert);
+            accepted++;
+        }
+        catch (const Der::ParseError&) {
+        }
+        catch (const std::exception& ex) {
+            printf("mutant %d: unexpected %s\n", i, ex.what());
+            failures++;
+        }
+    }
+    printf("%d mutants: %zu accepted, %zu rejected\n", MUTATIONS, accepted, MUTATIONS - accepted);
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <dir> [--print]\n", argv[0]);
+        return 2;
+    }
+    std::filesystem::path dir = argv[1];
+    bool print = argc > 2 && std::string(argv[2]) == "--print";
+
+    std::map<std::string, std::string> expected = loadExpected(dir / "expected.txt");
+    std::vector<std::string> corpus;
+    int failures = 0;
+    size_t checked = 0;
+
+    for (const char* subdir : { "corpus", "invalid" }) {
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator(dir / subdir)) {
+            if (entry.path().extension() == ".der") files.push_back(entry.path());
+        }
+        std::sort(files.begin(), files.end());
+
+        for (const auto& path : files) {
+            std::string name = std::string(subdir) + "/" + path.filename().string();
+            std::string der = readFile(path);
+            std::string actual = result(der);
+            if (actual != "error") corpus.push_back(der);
+            if (print) {
+                printf("%s\t%s\n", name.c_str(), actual.c_str());
+                continue;
+            }
+
+            auto it = expected.find(name);
+            if (it == expected.end()) {
+                printf("%s: not listed in expected.txt\n", name.c_str());
+                failures++;
+            } else if (it->second != actual) {
+                printf("%s:\n  expected %s\n  actual   %s\n", name.c_str(), it->second.c_str(), actual.c_str());
+                failures++;
+            }
+            checked++;
+        }
+    }
+    if (print) return 0;
+    printf("%zu certificates checked, %d mismatches\n", checked, failures);
+
+    if (corpus.empty()) {
+        printf("no valid certificates to mutate\n");
+        return 1;
+    }
+    failures += mutate(corpus);
+    return failures == 0 ? 0 : 1;
+}